@@ -0,0 +1,189 @@
+use criterion::{criterion_group, criterion_main, BatchSize, Criterion};
+use cranelift_object::{ObjectBuilder, ObjectModule};
+use rono_lang::compiler::make_isa;
+use rono_lang::*;
+use target_lexicon::Triple;
+
+use std::io::{Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::path::Path;
+use std::process::{Command, Stdio};
+
+// Every stage of the pipeline over the programs in benches/corpus: lexing,
+// parsing, semantic analysis, IR generation, interpretation, and running
+// the executable `rono compile` builds. `cargo bench` runs them all;
+// `cargo bench -- parse/` picks a stage, `cargo bench -- /structs` a program.
+//
+// http.rono talks to a mock server on 127.0.0.1 that the benches start, so
+// it measures the client and not the network. It uses the interpreter's
+// http_get and only runs through the front end and the interpreter.
+
+const CORPUS: &[&str] = &["recursion", "lists", "structs", "interpolation", "http"];
+
+// Programs the code generator can compile
+const COMPILED: &[&str] = &["recursion", "lists", "structs", "interpolation"];
+
+const MOCK_BODY: &str = "{\"status\":\"ok\",\"items\":[1,2,3,4,5,6,7,8,9,10]}";
+
+struct CorpusProgram {
+    name: &'static str,
+    source: String,
+}
+
+fn corpus(mock_url: &str) -> Vec<CorpusProgram> {
+    CORPUS
+        .iter()
+        .map(|&name| {
+            let path = Path::new(env!("CARGO_MANIFEST_DIR")).join("benches/corpus").join(format!("{}.rono", name));
+            let source = std::fs::read_to_string(&path).unwrap_or_else(|e| panic!("{}: {}", path.display(), e));
+            CorpusProgram { name, source: source.replace("MOCK_URL", mock_url) }
+        })
+        .collect()
+}
+
+fn parse(source: &str) -> Program {
+    let tokens = Lexer::new(source).tokenize().expect("corpus program lexes");
+    Parser::new(tokens).parse().expect("corpus program parses")
+}
+
+fn analyze(program: &Program) -> AnalyzedProgram {
+    SemanticAnalyzer::new().analyze(program).expect("corpus program type-checks")
+}
+
+fn object_generator() -> IRGenerator<ObjectModule> {
+    let isa = make_isa(Triple::host(), &OptLevel::Speed, &[]).expect("host ISA");
+    let builder = ObjectBuilder::new(isa, "rono_bench".to_string(), cranelift_module::default_libcall_names())
+        .expect("object builder");
+    IRGenerator::new(ObjectModule::new(builder))
+}
+
+fn front_end(c: &mut Criterion, programs: &[CorpusProgram]) {
+    for program in programs {
+        c.bench_function(&format!("lex/{}", program.name), |b| {
+            b.iter(|| Lexer::new(&program.source).tokenize().unwrap())
+        });
+
+        c.bench_function(&format!("parse/{}", program.name), |b| {
+            b.iter_batched(
+                || Lexer::new(&program.source).tokenize().unwrap(),
+                |tokens| Parser::new(tokens).parse().unwrap(),
+                BatchSize::SmallInput,
+            )
+        });
+    }
+}
+
+fn back_end(c: &mut Criterion, programs: &[CorpusProgram]) {
+    for program in programs.iter().filter(|program| COMPILED.contains(&program.name)) {
+        let ast = parse(&program.source);
+
+        c.bench_function(&format!("analyze/{}", program.name), |b| {
+            b.iter(|| SemanticAnalyzer::new().analyze(&ast).unwrap())
+        });
+
+        let analyzed = analyze(&ast);
+        c.bench_function(&format!("ir_gen/{}", program.name), |b| {
+            b.iter_batched(
+                object_generator,
+                |mut generator| {
+                    generator.generate(&analyzed).unwrap();
+                    generator
+                },
+                BatchSize::SmallInput,
+            )
+        });
+    }
+}
+
+fn interpret(c: &mut Criterion, programs: &[CorpusProgram]) {
+    let mut group = c.benchmark_group("interpret");
+    group.sample_size(20);
+    for program in programs {
+        let ast = parse(&program.source);
+        group.bench_function(program.name, |b| {
+            b.iter(|| Interpreter::new().execute(&ast).unwrap())
+        });
+    }
+    group.finish();
+}
+
+// Builds each program once with `rono compile -O speed` and times whole
+// runs of the executable, process start-up included
+fn executable(c: &mut Criterion, programs: &[CorpusProgram]) {
+    let rono = env!("CARGO_BIN_EXE_rono");
+    let scratch = tempfile::tempdir().expect("scratch directory");
+
+    let mut group = c.benchmark_group("executable");
+    group.sample_size(20);
+    for program in programs.iter().filter(|program| COMPILED.contains(&program.name)) {
+        let source = scratch.path().join(format!("{}.rono", program.name));
+        std::fs::write(&source, &program.source).unwrap();
+        let name = format!("bench-{}", program.name);
+        let status = Command::new(rono)
+            .arg("compile")
+            .arg(&source)
+            .args(["-o", &name, "-O", "speed"])
+            .stdout(Stdio::null())
+            .status()
+            .expect("rono compile runs");
+        assert!(status.success(), "rono compile failed for {}", program.name);
+
+        let executable = format!("build/{}", name);
+        group.bench_function(program.name, |b| {
+            b.iter(|| {
+                let status = Command::new(&executable).stdout(Stdio::null()).status().unwrap();
+                assert!(status.success());
+            })
+        });
+        let _ = std::fs::remove_file(&executable);
+        let _ = std::fs::remove_file(format!("{}.o", executable));
+    }
+    group.finish();
+}
+
+// Minimal HTTP/1.1 server answering every request with MOCK_BODY; keeps
+// connections alive so the client's pool is exercised. Returns its URL.
+fn start_mock_server() -> String {
+    let listener = TcpListener::bind("127.0.0.1:0").expect("mock server binds");
+    let url = format!("http://{}/", listener.local_addr().unwrap());
+    std::thread::spawn(move || {
+        for stream in listener.incoming().flatten() {
+            std::thread::spawn(move || serve(stream));
+        }
+    });
+    url
+}
+
+fn serve(mut stream: TcpStream) {
+    let response = format!(
+        "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: {}\r\n\r\n{}",
+        MOCK_BODY.len(),
+        MOCK_BODY
+    );
+    let mut request = Vec::new();
+    let mut buffer = [0u8; 4096];
+    loop {
+        // Requests from the corpus have no body: one reply per header block
+        while let Some(end) = request.windows(4).position(|window| window == b"\r\n\r\n") {
+            request.drain(..end + 4);
+            if stream.write_all(response.as_bytes()).is_err() {
+                return;
+            }
+        }
+        match stream.read(&mut buffer) {
+            Ok(0) | Err(_) => return,
+            Ok(read) => request.extend_from_slice(&buffer[..read]),
+        }
+    }
+}
+
+fn pipeline(c: &mut Criterion) {
+    let programs = corpus(&start_mock_server());
+    front_end(c, &programs);
+    back_end(c, &programs);
+    interpret(c, &programs);
+    executable(c, &programs);
+}
+
+criterion_group!(benches, pipeline);
+criterion_main!(benches);
@@ -0,0 +1,30 @@
+// With the `jit` feature, src/runtime.c is compiled into rono itself so
+// `rono run --jit` can call the runtime in-process. `rono compile` keeps
+// building its own runtime object next to the program (see compiler.rs).
+fn main() {
+    println!("cargo:rerun-if-changed=src/runtime.c");
+    
+    #[cfg(feature = "jit")]
+    build_runtime();
+}
+
+#[cfg(feature = "jit")]
+fn build_runtime() {
+    let mut build = cc::Build::new();
+    build
+        .file("src/runtime.c")
+        .opt_level(2)
+        // No FMA contraction: randf must round exactly like the inline IR and the interpreter
+        .flag_if_supported("-ffp-contract=off");
+    // Runtime counters for `rono run --jit`, reported with RONO_METRICS set
+    if cfg!(feature = "metrics") {
+        build.define("RONO_METRICS", None);
+    }
+    build.compile("rono_runtime");
+    
+    println!("cargo:rustc-link-lib=curl");
+    if std::env::var("CARGO_CFG_TARGET_OS").as_deref() == Ok("linux") {
+        // HTTP connection pool locking
+        println!("cargo:rustc-link-lib=pthread");
+    }
+}
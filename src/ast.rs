@@ -1,4 +1,5 @@
 use crate::types::{ChifType, ChifValue};
+use std::rc::Rc;
 
 #[derive(Debug, Clone)]
 pub struct Program {
@@ -26,6 +27,8 @@ pub struct Function {
     pub return_type: Option<ChifType>,
     pub body: Block,
     pub is_main: bool,
+    // Frame slot names assigned by the resolver, parameters first; empty until resolved
+    pub locals: Rc<Vec<String>>,
 }
 
 #[derive(Debug, Clone)]
@@ -39,6 +42,9 @@ pub struct Parameter {
 pub struct StructDef {
     pub name: String,
     pub fields: Vec<StructField>,
+    // `soa struct`: compiled lists and arrays of it store each field in its
+    // own column; the interpreters ignore it
+    pub soa: bool,
 }
 
 #[derive(Debug, Clone)]
@@ -56,6 +62,9 @@ pub struct StructImpl {
 #[derive(Debug, Clone)]
 pub struct Block {
     pub statements: Vec<Statement>,
+    // Source line of each statement as parsed, for `rono run --profile`.
+    // Optimization passes don't keep it in step; only the interpreter reads it.
+    pub lines: Vec<u32>,
 }
 
 #[derive(Debug, Clone)]
@@ -67,6 +76,7 @@ pub enum Statement {
     For(ForStatement),
     While(WhileStatement),
     Switch(SwitchStatement),
+    ParFor(ParForStatement),
     Return(Option<Expression>),
     Break,
     Continue,
@@ -78,6 +88,8 @@ pub struct VarDecl {
     pub var_type: ChifType,
     pub value: Option<Expression>,
     pub is_mutable: bool,
+    // Frame slot of the declared variable, set by the resolver
+    pub slot: Option<usize>,
 }
 
 #[derive(Debug, Clone)]
@@ -107,6 +119,34 @@ pub struct WhileStatement {
     pub body: Block,
 }
 
+// `par for (i in start..end; sum total) { ... }`: iterations of the
+// end-exclusive integer range run in parallel. The body may only read
+// variables from outside the loop; reduction targets are the exception and
+// are combined from per-worker partial results (see parallel.rs).
+#[derive(Debug, Clone)]
+pub struct ParForStatement {
+    pub var: String,
+    pub start: Expression,
+    pub end: Expression,
+    pub reductions: Vec<Reduction>,
+    pub body: Block,
+    // Frame slot of the loop variable, set by the resolver
+    pub slot: Option<usize>,
+}
+
+#[derive(Debug, Clone)]
+pub struct Reduction {
+    pub op: ReductionOp,
+    pub name: String,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum ReductionOp {
+    Sum,
+    Min,
+    Max,
+}
+
 #[derive(Debug, Clone)]
 pub struct SwitchStatement {
     pub expr: Expression,
@@ -124,6 +164,7 @@ pub struct SwitchCase {
 pub enum Expression {
     Literal(ChifValue),
     Identifier(String),
+    Local(LocalVar),
     Binary(BinaryOp),
     Unary(UnaryOp),
     Call(FunctionCall),
@@ -135,6 +176,31 @@ pub enum Expression {
     StructLiteral(StructLiteral),
     Reference(Box<Expression>),
     Dereference(Box<Expression>),
+    Template(Template),
+}
+
+// String literal with `{expr}` holes, split into parts once by the parser.
+// `source` is the literal as written, for code that wants the raw text.
+#[derive(Debug, Clone)]
+pub struct Template {
+    pub source: String,
+    pub parts: Vec<TemplatePart>,
+}
+
+#[derive(Debug, Clone)]
+pub enum TemplatePart {
+    Literal(String),
+    // `text` is the hole as written, printed in braces if evaluation fails
+    Hole { expr: Expression, text: String },
+    // `{}`: the next positional argument of con.out in compiled code
+    Positional,
+}
+
+// Identifier resolved to a slot of the enclosing function's frame
+#[derive(Debug, Clone)]
+pub struct LocalVar {
+    pub name: String,
+    pub slot: usize,
 }
 
 #[derive(Debug, Clone)]
@@ -0,0 +1,319 @@
+use serde::Serialize;
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::cell::Cell;
+use std::fs;
+use std::path::Path;
+use std::process::{Command, Stdio};
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::time::Instant;
+
+// `rono bench file.rono`: runs a program several times in each execution
+// mode and reports wall time, peak resident set size and heap allocations
+// as JSON, so results can be stored and compared between commits. Every
+// run is a separate process (rono itself for the interpreter modes and the
+// JIT, the linked executable for AOT), so runs don't share caches, heaps or
+// the peak RSS of earlier runs.
+//
+// Allocations are counted by `CountingAllocator`, rono's global allocator.
+// A child started by the bench writes its count to RONO_BENCH_ALLOCS when
+// it finishes. AOT executables allocate through the C runtime, which isn't
+// counted, so their allocations are reported as null.
+
+// Counts allocations of the process it is installed in (see main.rs)
+pub struct CountingAllocator;
+
+// One counter per cache line. A thread takes the next shard on its first
+// allocation and only bumps that one, so the workers of a par for don't
+// contend on a single atomic; reads sum all shards.
+#[repr(align(64))]
+struct Shard(AtomicU64);
+
+const SHARDS: usize = 64;
+const EMPTY_SHARD: Shard = Shard(AtomicU64::new(0));
+static ALLOCATIONS: [Shard; SHARDS] = [EMPTY_SHARD; SHARDS];
+static NEXT_SHARD: AtomicUsize = AtomicUsize::new(0);
+
+thread_local! {
+    static SHARD: Cell<usize> = const { Cell::new(usize::MAX) };
+}
+
+fn count_allocation() {
+    let shard = SHARD.try_with(|shard| {
+        if shard.get() == usize::MAX {
+            shard.set(NEXT_SHARD.fetch_add(1, Ordering::Relaxed) % SHARDS);
+        }
+        shard.get()
+    }).unwrap_or(0);
+    ALLOCATIONS[shard].0.fetch_add(1, Ordering::Relaxed);
+}
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        count_allocation();
+        System.alloc(layout)
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        count_allocation();
+        System.alloc_zeroed(layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        count_allocation();
+        System.realloc(ptr, layout, new_size)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+}
+
+// Heap allocations (including reallocations) made so far by this process
+pub fn allocations() -> u64 {
+    ALLOCATIONS.iter().map(|shard| shard.0.load(Ordering::Relaxed)).sum()
+}
+
+const ALLOCS_ENV: &str = "RONO_BENCH_ALLOCS";
+
+// Called by `rono run` before it exits: hands the allocation count to the
+// bench that started it. Does nothing outside a bench.
+pub fn report_allocations() {
+    if let Some(path) = std::env::var_os(ALLOCS_ENV) {
+        let _ = fs::write(path, allocations().to_string());
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Serialize)]
+#[serde(rename_all = "lowercase")]
+pub enum Mode {
+    // Tree-walking interpreter (`rono run`)
+    Interpreter,
+    // Bytecode VM (`rono run --engine=vm`)
+    Vm,
+    // Interpreter with hot functions compiled (`rono run --tiered`)
+    Tiered,
+    // In-process native code (`rono run --jit`)
+    Jit,
+    // Executable built by `rono compile`
+    Aot,
+}
+
+impl Mode {
+    pub fn parse(name: &str) -> Option<Mode> {
+        match name {
+            "interpreter" => Some(Mode::Interpreter),
+            "vm" => Some(Mode::Vm),
+            "tiered" => Some(Mode::Tiered),
+            "jit" => Some(Mode::Jit),
+            "aot" => Some(Mode::Aot),
+            _ => None,
+        }
+    }
+
+    fn run_args(self) -> &'static [&'static str] {
+        match self {
+            Mode::Interpreter => &[],
+            Mode::Vm => &["--engine=vm"],
+            Mode::Tiered => &["--tiered"],
+            Mode::Jit => &["--jit"],
+            // Runs the compiled executable instead of rono
+            Mode::Aot => &[],
+        }
+    }
+}
+
+pub struct BenchOptions {
+    pub runs: usize,
+    pub modes: Vec<Mode>,
+    // -O level for `rono compile` in AOT mode
+    pub optimize: String,
+}
+
+#[derive(Debug, Serialize)]
+pub struct BenchReport {
+    pub file: String,
+    pub runs: usize,
+    pub modes: Vec<ModeReport>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct ModeReport {
+    pub mode: Mode,
+    // Set when the mode couldn't run the program; the other fields are then empty
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub error: Option<String>,
+    pub wall_ms: Option<Summary>,
+    // Largest peak RSS of any run, in KiB; null where the OS doesn't report it
+    pub peak_rss_kib: Option<u64>,
+    // Median allocations per run; null for AOT executables
+    pub allocations: Option<u64>,
+    pub samples: Vec<Sample>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct Summary {
+    pub min: f64,
+    pub median: f64,
+    pub mean: f64,
+    pub max: f64,
+}
+
+#[derive(Debug, Serialize)]
+pub struct Sample {
+    pub wall_ms: f64,
+    pub peak_rss_kib: Option<u64>,
+    pub allocations: Option<u64>,
+}
+
+// Runs `file` `options.runs` times in each mode. A mode that fails (the
+// program doesn't compile, or exits with an error) is reported with its
+// error and doesn't stop the others.
+pub fn run(file: &str, options: &BenchOptions) -> Result<BenchReport, String> {
+    let rono = std::env::current_exe().map_err(|e| format!("Can't locate the rono executable: {}", e))?;
+    let scratch = std::env::temp_dir().join(format!("rono-bench-{}", std::process::id()));
+    fs::create_dir_all(&scratch).map_err(|e| format!("Can't create {}: {}", scratch.display(), e))?;
+
+    let mut modes = Vec::new();
+    for &mode in &options.modes {
+        let report = match bench_mode(&rono, file, mode, options, &scratch) {
+            Ok(samples) => ModeReport::from_samples(mode, samples),
+            Err(error) => ModeReport::failed(mode, error),
+        };
+        modes.push(report);
+    }
+
+    let _ = fs::remove_dir_all(&scratch);
+    Ok(BenchReport { file: file.to_string(), runs: options.runs, modes })
+}
+
+fn bench_mode(rono: &Path, file: &str, mode: Mode, options: &BenchOptions, scratch: &Path) -> Result<Vec<Sample>, String> {
+    let allocs_path = scratch.join("allocations");
+    let executable = if mode == Mode::Aot { Some(compile(rono, file, options, scratch)?) } else { None };
+
+    let mut samples = Vec::with_capacity(options.runs);
+    for _ in 0..options.runs {
+        let _ = fs::remove_file(&allocs_path);
+        let mut command = match &executable {
+            Some(executable) => Command::new(executable),
+            None => {
+                let mut command = Command::new(rono);
+                command.arg("run").args(mode.run_args()).arg(file).env(ALLOCS_ENV, &allocs_path);
+                command
+            }
+        };
+        let sample = measure(&mut command);
+        let allocations = fs::read_to_string(&allocs_path).ok().and_then(|count| count.trim().parse().ok());
+        match sample {
+            Ok(sample) => samples.push(Sample { allocations, ..sample }),
+            Err(error) => {
+                remove_executable(executable.as_deref());
+                return Err(error);
+            }
+        }
+    }
+
+    remove_executable(executable.as_deref());
+    Ok(samples)
+}
+
+fn remove_executable(executable: Option<&str>) {
+    if let Some(executable) = executable {
+        let _ = fs::remove_file(executable);
+        let _ = fs::remove_file(format!("{}.o", executable));
+    }
+}
+
+// Builds the AOT executable once; compile time isn't part of the samples
+fn compile(rono: &Path, file: &str, options: &BenchOptions, scratch: &Path) -> Result<String, String> {
+    let stem = Path::new(file).file_stem().and_then(|s| s.to_str()).unwrap_or("program");
+    let name = format!("bench-{}-{}", stem, scratch.file_name().and_then(|s| s.to_str()).unwrap_or("run"));
+
+    let output = Command::new(rono)
+        .args(["compile", file, "-o", &name, "-O", &options.optimize])
+        .stdin(Stdio::null())
+        .output()
+        .map_err(|e| format!("Failed to run rono compile: {}", e))?;
+    if !output.status.success() {
+        let stderr = String::from_utf8_lossy(&output.stderr);
+        return Err(format!("rono compile failed: {}", stderr.trim()));
+    }
+
+    // `rono compile` writes into build/ (see Compiler::compile)
+    Ok(format!("build/{}", name))
+}
+
+// One run with the program's output discarded
+fn measure(command: &mut Command) -> Result<Sample, String> {
+    command.stdin(Stdio::null()).stdout(Stdio::null()).stderr(Stdio::piped());
+
+    let start = Instant::now();
+    let mut child = command.spawn().map_err(|e| format!("Failed to start {:?}: {}", command.get_program(), e))?;
+    // Read stderr before waiting so a chatty program can't block on a full pipe
+    let mut stderr = String::new();
+    if let Some(mut pipe) = child.stderr.take() {
+        use std::io::Read;
+        let _ = pipe.read_to_string(&mut stderr);
+    }
+    let (success, peak_rss_kib) = wait(child)?;
+    let wall_ms = start.elapsed().as_secs_f64() * 1000.0;
+
+    if !success {
+        return Err(format!("Program failed: {}", stderr.trim()));
+    }
+    Ok(Sample { wall_ms, peak_rss_kib, allocations: None })
+}
+
+// Waits with wait4 to get the child's own resource usage; ru_maxrss is in
+// KiB on Linux and in bytes on macOS
+#[cfg(unix)]
+fn wait(child: std::process::Child) -> Result<(bool, Option<u64>), String> {
+    let pid = child.id() as libc::pid_t;
+    let mut status = 0;
+    let mut usage: libc::rusage = unsafe { std::mem::zeroed() };
+    if unsafe { libc::wait4(pid, &mut status, 0, &mut usage) } < 0 {
+        return Err(format!("wait4 failed: {}", std::io::Error::last_os_error()));
+    }
+
+    let max_rss = usage.ru_maxrss as u64;
+    let peak_rss_kib = if cfg!(target_os = "macos") { max_rss / 1024 } else { max_rss };
+    let success = libc::WIFEXITED(status) && libc::WEXITSTATUS(status) == 0;
+    Ok((success, Some(peak_rss_kib)))
+}
+
+#[cfg(not(unix))]
+fn wait(mut child: std::process::Child) -> Result<(bool, Option<u64>), String> {
+    let status = child.wait().map_err(|e| format!("Failed to wait for the program: {}", e))?;
+    Ok((status.success(), None))
+}
+
+impl ModeReport {
+    fn from_samples(mode: Mode, samples: Vec<Sample>) -> Self {
+        let mut wall: Vec<f64> = samples.iter().map(|sample| sample.wall_ms).collect();
+        wall.sort_by(|a, b| a.total_cmp(b));
+        let mut allocations: Vec<u64> = samples.iter().filter_map(|sample| sample.allocations).collect();
+        allocations.sort_unstable();
+
+        Self {
+            mode,
+            error: None,
+            wall_ms: summarize(&wall),
+            peak_rss_kib: samples.iter().filter_map(|sample| sample.peak_rss_kib).max(),
+            allocations: allocations.get(allocations.len() / 2).copied(),
+            samples,
+        }
+    }
+
+    fn failed(mode: Mode, error: String) -> Self {
+        Self { mode, error: Some(error), wall_ms: None, peak_rss_kib: None, allocations: None, samples: Vec::new() }
+    }
+}
+
+// Summary of sorted wall times; None without samples
+fn summarize(sorted: &[f64]) -> Option<Summary> {
+    let (&min, &max) = (sorted.first()?, sorted.last()?);
+    let middle = sorted.len() / 2;
+    let median = if sorted.len() % 2 == 0 { (sorted[middle - 1] + sorted[middle]) / 2.0 } else { sorted[middle] };
+    let mean = sorted.iter().sum::<f64>() / sorted.len() as f64;
+    Some(Summary { min, median, mean, max })
+}
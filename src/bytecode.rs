@@ -0,0 +1,495 @@
+use crate::ast::*;
+use crate::types::ChifValue;
+use std::collections::{HashMap, HashSet};
+use std::rc::Rc;
+
+// Bytecode for the `--engine=vm` engine. Each function compiles to a Chunk
+// of register instructions. Registers are the function's frame slots: the
+// locals assigned by the resolver come first (so the tree-walker sees the
+// same variables), temporaries follow. Function calls carry pre-resolved
+// function IDs; string and field names live in per-chunk constant pools.
+//
+// Constructs the VM doesn't implement itself (builtins, struct and module
+// methods, assignments to fields) compile to Eval/Exec, which run that AST
+// node on the interpreter against the same frame.
+
+pub type Reg = u32;
+
+#[derive(Debug, Clone)]
+pub enum Op {
+    // dst = constants[index]
+    Const { dst: Reg, index: u32 },
+    Move { dst: Reg, src: Reg },
+    // Array value declared with a list type becomes a List
+    ToList { reg: Reg },
+    Binary { op: BinaryOperator, dst: Reg, lhs: Reg, rhs: Reg },
+    Unary { op: UnaryOperator, dst: Reg, src: Reg },
+    Index { dst: Reg, object: Reg, index: Reg },
+    // dst = object.names[field]
+    Field { dst: Reg, object: Reg, field: u32 },
+    // dst = object.len() for strings, arrays and lists, otherwise exprs[fallback]
+    Len { dst: Reg, object: Reg, fallback: u32 },
+    // dst = functions[func](args .. args + argc)
+    Call { dst: Reg, func: u32, args: Reg, argc: u32 },
+    // con.out(src); strings are interpolated unless src holds a rendered template
+    Print { src: Reg, interpolate: bool },
+    Jump { target: u32 },
+    JumpIfFalse { cond: Reg, target: u32 },
+    // Switch case test, compares like the interpreter's values_equal
+    JumpIfNotEqual { lhs: Reg, rhs: Reg, target: u32 },
+    // dst = interpreter result of exprs[expr]
+    Eval { dst: Reg, expr: u32 },
+    // Interpreter runs stmts[stmt]
+    Exec { stmt: u32 },
+    Return { src: Reg },
+    ReturnNil,
+}
+
+#[derive(Debug)]
+pub struct Chunk {
+    pub name: String,
+    pub code: Vec<Op>,
+    pub constants: Vec<ChifValue>,
+    pub names: Vec<String>,
+    pub exprs: Vec<Expression>,
+    pub stmts: Vec<Statement>,
+    // Frame slot names from the resolver, parameters first
+    pub locals: Rc<Vec<String>>,
+    pub param_slots: Vec<Reg>,
+    pub registers: usize,
+}
+
+#[derive(Debug)]
+pub struct BytecodeProgram {
+    pub chunks: Vec<Rc<Chunk>>,
+    pub function_ids: HashMap<String, u32>,
+}
+
+// Calls the interpreter dispatches before looking up user functions
+const BUILTIN_FUNCTIONS: [&str; 8] = ["toInt", "toFloat", "toStr", "randi", "randf", "rands", "randfill", "randseed"];
+
+fn is_builtin_function(name: &str) -> bool {
+    BUILTIN_FUNCTIONS.contains(&name) || name.starts_with("http_")
+}
+
+// Context the compiler needs about the loaded program
+pub struct ProgramInfo<'a> {
+    pub functions: &'a HashMap<String, Rc<Function>>,
+    pub modules: &'a HashSet<String>,
+    pub struct_names: &'a HashSet<String>,
+}
+
+pub fn compile_program(info: &ProgramInfo) -> BytecodeProgram {
+    // Sorted so function IDs don't depend on HashMap order
+    let mut names: Vec<&String> = info.functions.keys().collect();
+    names.sort();
+    let function_ids: HashMap<String, u32> = names.iter()
+        .enumerate()
+        .map(|(id, name)| ((*name).clone(), id as u32))
+        .collect();
+
+    let chunks = names.iter()
+        .map(|name| Rc::new(FunctionCompiler::new(info, &function_ids, &info.functions[*name]).compile()))
+        .collect();
+
+    BytecodeProgram { chunks, function_ids }
+}
+
+struct LoopLabels {
+    continue_target: Option<u32>,
+    continue_jumps: Vec<usize>,
+    break_jumps: Vec<usize>,
+}
+
+struct FunctionCompiler<'a> {
+    info: &'a ProgramInfo<'a>,
+    function_ids: &'a HashMap<String, u32>,
+    func: &'a Function,
+    code: Vec<Op>,
+    constants: Vec<ChifValue>,
+    names: Vec<String>,
+    exprs: Vec<Expression>,
+    stmts: Vec<Statement>,
+    next_register: Reg,
+    registers: usize,
+    loops: Vec<LoopLabels>,
+}
+
+impl<'a> FunctionCompiler<'a> {
+    fn new(info: &'a ProgramInfo<'a>, function_ids: &'a HashMap<String, u32>, func: &'a Function) -> Self {
+        let locals = func.locals.len();
+        Self {
+            info,
+            function_ids,
+            func,
+            code: Vec::new(),
+            constants: Vec::new(),
+            names: Vec::new(),
+            exprs: Vec::new(),
+            stmts: Vec::new(),
+            next_register: locals as Reg,
+            registers: locals,
+            loops: Vec::new(),
+        }
+    }
+
+    fn compile(mut self) -> Chunk {
+        for statement in &self.func.body.statements {
+            self.compile_statement(statement);
+        }
+        self.code.push(Op::ReturnNil);
+
+        let param_slots = self.func.params.iter()
+            .map(|param| self.local_slot(&param.name).unwrap_or(0))
+            .collect();
+        Chunk {
+            name: self.func.name.clone(),
+            code: self.code,
+            constants: self.constants,
+            names: self.names,
+            exprs: self.exprs,
+            stmts: self.stmts,
+            locals: self.func.locals.clone(),
+            param_slots,
+            registers: self.registers,
+        }
+    }
+
+    fn local_slot(&self, name: &str) -> Option<Reg> {
+        self.func.locals.iter().position(|local| local == name).map(|slot| slot as Reg)
+    }
+
+    fn temp(&mut self) -> Reg {
+        let reg = self.next_register;
+        self.next_register += 1;
+        self.registers = self.registers.max(self.next_register as usize);
+        reg
+    }
+
+    fn here(&self) -> u32 {
+        self.code.len() as u32
+    }
+
+    fn emit_jump(&mut self, op: Op) -> usize {
+        self.code.push(op);
+        self.code.len() - 1
+    }
+
+    fn patch(&mut self, at: usize, target: u32) {
+        match &mut self.code[at] {
+            Op::Jump { target: t } | Op::JumpIfFalse { target: t, .. } | Op::JumpIfNotEqual { target: t, .. } => *t = target,
+            _ => unreachable!("patching a non-jump instruction"),
+        }
+    }
+
+    fn constant(&mut self, value: ChifValue) -> u32 {
+        self.constants.push(value);
+        (self.constants.len() - 1) as u32
+    }
+
+    fn name(&mut self, name: &str) -> u32 {
+        if let Some(index) = self.names.iter().position(|existing| existing == name) {
+            return index as u32;
+        }
+        self.names.push(name.to_string());
+        (self.names.len() - 1) as u32
+    }
+
+    fn exec(&mut self, statement: &Statement) {
+        self.stmts.push(statement.clone());
+        let stmt = (self.stmts.len() - 1) as u32;
+        self.code.push(Op::Exec { stmt });
+    }
+
+    fn eval(&mut self, expr: &Expression, dst: Reg) {
+        self.exprs.push(expr.clone());
+        let expr = (self.exprs.len() - 1) as u32;
+        self.code.push(Op::Eval { dst, expr });
+    }
+
+    fn compile_block(&mut self, block: &Block) {
+        for statement in &block.statements {
+            self.compile_statement(statement);
+        }
+    }
+
+    fn compile_statement(&mut self, statement: &Statement) {
+        // Temporaries live until the end of their statement
+        let mark = self.next_register;
+
+        match statement {
+            Statement::VarDecl(var_decl) => match var_decl.slot {
+                Some(slot) => {
+                    let slot = slot as Reg;
+                    match &var_decl.value {
+                        Some(value) => {
+                            self.compile_expression(value, slot);
+                            if let crate::types::ChifType::List(_, _) = &var_decl.var_type {
+                                self.code.push(Op::ToList { reg: slot });
+                            }
+                        }
+                        None => {
+                            let index = self.constant(ChifValue::Nil);
+                            self.code.push(Op::Const { dst: slot, index });
+                        }
+                    }
+                }
+                None => self.exec(statement),
+            },
+            Statement::Assignment(assignment) => match &assignment.target {
+                Expression::Local(local) => self.compile_expression(&assignment.value, local.slot as Reg),
+                _ => self.exec(statement),
+            },
+            Statement::Expression(expr) => {
+                let dst = self.temp();
+                self.compile_expression(expr, dst);
+            }
+            Statement::If(if_stmt) => {
+                let cond = self.operand(&if_stmt.condition);
+                let to_else = self.emit_jump(Op::JumpIfFalse { cond, target: 0 });
+                self.compile_block(&if_stmt.then_block);
+                match &if_stmt.else_block {
+                    Some(else_block) => {
+                        let to_end = self.emit_jump(Op::Jump { target: 0 });
+                        let else_start = self.here();
+                        self.patch(to_else, else_start);
+                        self.compile_block(else_block);
+                        let end = self.here();
+                        self.patch(to_end, end);
+                    }
+                    None => {
+                        let end = self.here();
+                        self.patch(to_else, end);
+                    }
+                }
+            }
+            Statement::While(while_stmt) => {
+                let start = self.here();
+                let cond = self.operand(&while_stmt.condition);
+                let to_end = self.emit_jump(Op::JumpIfFalse { cond, target: 0 });
+                self.loops.push(LoopLabels { continue_target: Some(start), continue_jumps: Vec::new(), break_jumps: vec![to_end] });
+                self.compile_block(&while_stmt.body);
+                self.code.push(Op::Jump { target: start });
+                self.finish_loop(start);
+            }
+            Statement::For(for_stmt) => {
+                if let Some(init) = &for_stmt.init {
+                    self.compile_statement(init);
+                }
+                let start = self.here();
+                let mut break_jumps = Vec::new();
+                if let Some(condition) = &for_stmt.condition {
+                    let cond = self.operand(condition);
+                    break_jumps.push(self.emit_jump(Op::JumpIfFalse { cond, target: 0 }));
+                }
+                // `continue` runs the update, whose address isn't known yet
+                self.loops.push(LoopLabels { continue_target: None, continue_jumps: Vec::new(), break_jumps });
+                self.compile_block(&for_stmt.body);
+                let update = self.here();
+                if let Some(update_stmt) = &for_stmt.update {
+                    self.compile_statement(update_stmt);
+                }
+                self.code.push(Op::Jump { target: start });
+                self.finish_loop(update);
+            }
+            Statement::Switch(switch_stmt) => {
+                let value = self.operand_copy(&switch_stmt.expr);
+                let mut end_jumps = Vec::new();
+                for case in &switch_stmt.cases {
+                    let case_mark = self.next_register;
+                    let case_value = self.operand(&case.value);
+                    let to_next = self.emit_jump(Op::JumpIfNotEqual { lhs: value, rhs: case_value, target: 0 });
+                    self.next_register = case_mark;
+                    self.compile_block(&case.body);
+                    end_jumps.push(self.emit_jump(Op::Jump { target: 0 }));
+                    let next = self.here();
+                    self.patch(to_next, next);
+                }
+                if let Some(default_case) = &switch_stmt.default_case {
+                    self.compile_block(default_case);
+                }
+                let end = self.here();
+                for jump in end_jumps {
+                    self.patch(jump, end);
+                }
+            }
+            // Runs on the interpreter's worker threads; it can't return or break
+            Statement::ParFor(_) => self.exec(statement),
+            Statement::Return(expr) => match expr {
+                Some(expr) => {
+                    let src = self.operand(expr);
+                    self.code.push(Op::Return { src });
+                }
+                None => self.code.push(Op::ReturnNil),
+            },
+            Statement::Break => match self.loops.last() {
+                Some(_) => {
+                    let jump = self.emit_jump(Op::Jump { target: 0 });
+                    self.loops.last_mut().unwrap().break_jumps.push(jump);
+                }
+                // Outside a loop the interpreter reports the stray break
+                None => self.exec(statement),
+            },
+            Statement::Continue => match self.loops.last().map(|labels| labels.continue_target) {
+                Some(Some(target)) => self.code.push(Op::Jump { target }),
+                Some(None) => {
+                    let jump = self.emit_jump(Op::Jump { target: 0 });
+                    self.loops.last_mut().unwrap().continue_jumps.push(jump);
+                }
+                None => self.exec(statement),
+            },
+        }
+
+        self.next_register = mark;
+    }
+
+    fn finish_loop(&mut self, continue_target: u32) {
+        let labels = self.loops.pop().expect("loop labels");
+        let end = self.here();
+        for jump in labels.break_jumps {
+            self.patch(jump, end);
+        }
+        for jump in labels.continue_jumps {
+            self.patch(jump, continue_target);
+        }
+    }
+
+    // Register holding the value of `expr`: a local's own slot, or a fresh
+    // temporary the expression is compiled into
+    fn operand(&mut self, expr: &Expression) -> Reg {
+        if let Expression::Local(local) = expr {
+            return local.slot as Reg;
+        }
+        let dst = self.temp();
+        self.compile_expression(expr, dst);
+        dst
+    }
+
+    // Like operand, but copies locals so later side effects can't change
+    // a value that was already evaluated
+    fn operand_copy(&mut self, expr: &Expression) -> Reg {
+        let dst = self.temp();
+        self.compile_expression(expr, dst);
+        dst
+    }
+
+    // Evaluating expr can't assign variables of this frame
+    fn is_pure(expr: &Expression) -> bool {
+        match expr {
+            Expression::Literal(_) | Expression::Local(_) => true,
+            Expression::Binary(binary_op) => Self::is_pure(&binary_op.left) && Self::is_pure(&binary_op.right),
+            Expression::Unary(unary_op) => Self::is_pure(&unary_op.operand),
+            _ => false,
+        }
+    }
+
+    fn compile_expression(&mut self, expr: &Expression, dst: Reg) {
+        match expr {
+            // Braces left in a string literal are an unclosed hole, which the
+            // interpreter reports; templates go to it as well
+            Expression::Literal(ChifValue::Str(s)) if s.contains(['{', '}']) => self.eval(expr, dst),
+            Expression::Literal(value) => {
+                let index = self.constant(value.clone());
+                self.code.push(Op::Const { dst, index });
+            }
+            Expression::Local(local) => {
+                let src = local.slot as Reg;
+                if src != dst {
+                    self.code.push(Op::Move { dst, src });
+                }
+            }
+            Expression::Binary(binary_op) => {
+                let lhs = if Self::is_pure(&binary_op.right) {
+                    self.operand(&binary_op.left)
+                } else {
+                    self.operand_copy(&binary_op.left)
+                };
+                let rhs = self.operand(&binary_op.right);
+                self.code.push(Op::Binary { op: binary_op.operator.clone(), dst, lhs, rhs });
+            }
+            Expression::Unary(unary_op) => {
+                let src = self.operand(&unary_op.operand);
+                self.code.push(Op::Unary { op: unary_op.operator.clone(), dst, src });
+            }
+            Expression::Call(call) => {
+                let func = self.function_ids.get(&call.name).copied();
+                // Reference arguments write back through the interpreter
+                let by_value = !call.args.iter().any(|arg| matches!(arg, Expression::Reference(_)));
+                match func {
+                    Some(func) if by_value && !is_builtin_function(&call.name) => {
+                        let args = self.next_register;
+                        for _ in &call.args {
+                            self.temp();
+                        }
+                        for (i, arg) in call.args.iter().enumerate() {
+                            self.compile_expression(arg, args + i as Reg);
+                        }
+                        self.code.push(Op::Call { dst, func, args, argc: call.args.len() as u32 });
+                    }
+                    _ => self.eval(expr, dst),
+                }
+            }
+            Expression::MethodCall(method_call) => self.compile_method_call(expr, method_call, dst),
+            Expression::Index(index_access) => {
+                let mut object = self.operand(&index_access.object);
+                if !index_access.indices.iter().all(Self::is_pure) {
+                    object = self.copy_if_local(object);
+                }
+                for (i, index_expr) in index_access.indices.iter().enumerate() {
+                    let index = self.operand(index_expr);
+                    let target = if i + 1 == index_access.indices.len() { dst } else { self.temp() };
+                    self.code.push(Op::Index { dst: target, object, index });
+                    object = target;
+                }
+                if index_access.indices.is_empty() && object != dst {
+                    self.code.push(Op::Move { dst, src: object });
+                }
+            }
+            Expression::FieldAccess(field_access) => {
+                let object = self.operand(&field_access.object);
+                let field = self.name(&field_access.field);
+                self.code.push(Op::Field { dst, object, field });
+            }
+            _ => self.eval(expr, dst),
+        }
+    }
+
+    fn copy_if_local(&mut self, reg: Reg) -> Reg {
+        if (reg as usize) < self.func.locals.len() {
+            let copy = self.temp();
+            self.code.push(Op::Move { dst: copy, src: reg });
+            copy
+        } else {
+            reg
+        }
+    }
+
+    // Receivers that are bare names go through the interpreter's module,
+    // list and struct method dispatch, except for con.out and .len()
+    fn compile_method_call(&mut self, expr: &Expression, method_call: &MethodCall, dst: Reg) {
+        if let Expression::Identifier(object_name) = &*method_call.object {
+            let is_module = self.info.modules.contains(object_name);
+            let local = self.local_slot(object_name);
+
+            if object_name == "con" && method_call.method == "out" && method_call.args.len() == 1
+                && !is_module && local.is_none() && !self.info.struct_names.contains("Console") {
+                let src = self.operand(&method_call.args[0]);
+                let interpolate = !matches!(method_call.args[0], Expression::Template(_));
+                self.code.push(Op::Print { src, interpolate });
+                let index = self.constant(ChifValue::Nil);
+                self.code.push(Op::Const { dst, index });
+                return;
+            }
+
+            if method_call.method == "len" && method_call.args.is_empty() && !is_module {
+                if let Some(object) = local {
+                    self.exprs.push(expr.clone());
+                    let fallback = (self.exprs.len() - 1) as u32;
+                    self.code.push(Op::Len { dst, object, fallback });
+                    return;
+                }
+            }
+        }
+        self.eval(expr, dst);
+    }
+}
@@ -1,7 +1,9 @@
 use crate::ast::Program;
 use crate::semantic::SemanticAnalyzer;
+use crate::optimize;
 use crate::ir_gen::IRGenerator;
 
+use cranelift::codegen::isa::OwnedTargetIsa;
 use cranelift::prelude::settings::{self, Configurable};
 use cranelift_object::{ObjectBuilder, ObjectModule};
 use target_lexicon::Triple;
@@ -101,12 +103,23 @@ impl OptLevel {
             OptLevel::Size => settings::OptLevel::SpeedAndSize,
         }
     }
+    
+    // C compiler flag and object name suffix for the matching runtime build
+    fn runtime_flag(&self) -> &'static str {
+        match self {
+            OptLevel::None => "-O0",
+            OptLevel::Speed => "-O2",
+            OptLevel::Size => "-Os",
+        }
+    }
 }
 
 pub struct Compiler {
     target: Target,
     optimization_level: OptLevel,
     debug_info: bool,
+    // Link a runtime built with -DRONO_METRICS (see runtime.c)
+    metrics: bool,
     diagnostics: Vec<CompilerDiagnostic>,
 }
 
@@ -154,10 +167,17 @@ impl Compiler {
             target,
             optimization_level,
             debug_info,
+            metrics: false,
             diagnostics: Vec::new(),
         })
     }
     
+    // `rono compile --metrics`: the program counts HTTP, I/O and allocations
+    // and reports them when run with RONO_METRICS set
+    pub fn enable_metrics(&mut self) {
+        self.metrics = true;
+    }
+    
     pub fn compile(&mut self, ast: &Program, output_path: &str) -> Result<(), CompilerError> {
         println!("Starting compilation for target: {:?}", self.target);
         println!("Optimization level: {:?}", self.optimization_level);
@@ -166,30 +186,24 @@ impl Compiler {
         // 1. Semantic analysis
         println!("Performing semantic analysis...");
         let mut analyzer = SemanticAnalyzer::new();
-        let analyzed_program = analyzer.analyze(ast)
+        let mut analyzed_program = analyzer.analyze(ast)
             .map_err(|e| CompilerError::SemanticAnalysis(e.to_string()))?;
         
-        // 2. Setup Cranelift
+        // 2. Whole-program optimizations, before Cranelift sees functions
+        if !matches!(self.optimization_level, OptLevel::None) {
+            println!("Optimizing...");
+            for stats in optimize::optimize(&mut analyzed_program, &self.optimization_level) {
+                println!("  {}", stats);
+            }
+        }
+        
+        // 3. Setup Cranelift
         println!("Setting up code generator...");
         let triple = self.target.to_triple();
         
-        // Create ISA builder
-        let mut builder = settings::builder();
-        builder.set("opt_level", &self.optimization_level.to_cranelift_opt_level().to_string())
-            .map_err(|e| CompilerError::CodeGeneration(format!("Failed to set optimization level: {}", e)))?;
-            
         // Enable PIC for macOS ARM64
-        #[cfg(target_os = "macos")]
-        {
-            builder.set("is_pic", "true")
-                .map_err(|e| CompilerError::CodeGeneration(format!("Failed to set PIC: {}", e)))?;
-        }
-        
-        let flags = settings::Flags::new(builder);
-        let isa = cranelift::codegen::isa::lookup(triple.clone())
-            .map_err(|e| CompilerError::CodeGeneration(format!("Failed to lookup ISA: {}", e)))?
-            .finish(flags)
-            .map_err(|e| CompilerError::CodeGeneration(format!("Failed to create ISA: {}", e)))?;
+        let pic_flags: &[(&str, &str)] = if cfg!(target_os = "macos") { &[("is_pic", "true")] } else { &[] };
+        let isa = make_isa(triple, &self.optimization_level, pic_flags)?;
         
         let mut object_builder = ObjectBuilder::new(
             isa,
@@ -205,17 +219,17 @@ impl Compiler {
         
         let module = ObjectModule::new(object_builder);
         
-        // 3. IR generation
+        // 4. IR generation
         println!("Generating IR...");
         let mut ir_generator = IRGenerator::new(module);
         ir_generator.generate(&analyzed_program)
             .map_err(|e| CompilerError::IRGeneration(e.to_string()))?;
         
-        // 4. Code generation and object file creation
+        // 5. Code generation and object file creation
         println!("Generating object file...");
         let object_product = ir_generator.finalize().finish();
         
-        // 5. Write object file
+        // 6. Write object file
         let object_bytes = object_product.emit()
             .map_err(|e| CompilerError::ObjectWrite(e.to_string()))?;
         
@@ -229,7 +243,7 @@ impl Compiler {
         
         println!("Object file created: {}", object_path);
         
-        // 6. Link to create executable
+        // 7. Link to create executable
         println!("Linking executable...");
         self.link_executable(&object_path, &executable_path)?;
         
@@ -244,16 +258,33 @@ impl Compiler {
     fn link_executable(&self, object_file: &str, output_path: &str) -> Result<(), CompilerError> {
         use std::process::Command;
         
-        // First, compile runtime library if needed
-        let runtime_obj = "build/runtime.o";
-        if !std::path::Path::new(runtime_obj).exists() {
+        // First, compile runtime library if needed (missing or older than runtime.c).
+        // Each optimization level gets its own object so the runtime is built to match.
+        let runtime_flag = self.optimization_level.runtime_flag();
+        let runtime_obj = format!("build/runtime{}{}.o", runtime_flag, if self.metrics { "-metrics" } else { "" });
+        let runtime_obj = runtime_obj.as_str();
+        let runtime_stale = match (std::fs::metadata(runtime_obj), std::fs::metadata("src/runtime.c")) {
+            (Ok(obj), Ok(src)) => match (obj.modified(), src.modified()) {
+                (Ok(obj_time), Ok(src_time)) => obj_time < src_time,
+                _ => false,
+            },
+            (Err(_), _) => true,
+            _ => false,
+        };
+        if runtime_stale {
             println!("Compiling runtime library...");
             std::fs::create_dir_all("build")?;
             let mut compile_cmd = Command::new("cc");
+            // No FMA contraction: randf must round exactly like the inline IR and the interpreter
             compile_cmd.arg("-c")
+                      .arg(runtime_flag)
+                      .arg("-ffp-contract=off")
                       .arg("src/runtime.c")
                       .arg("-o")
                       .arg(runtime_obj);
+            if self.metrics {
+                compile_cmd.arg("-DRONO_METRICS");
+            }
             
             let compile_output = compile_cmd.output()
                 .map_err(|e| CompilerError::CodeGeneration(format!("Failed to compile runtime: {}", e)))?;
@@ -286,6 +317,7 @@ impl Compiler {
         {
             cmd.arg("-lc");
             cmd.arg("-lcurl"); // Link with libcurl
+            cmd.arg("-lpthread"); // HTTP connection pool locking
         }
         #[cfg(target_os = "windows")]
         {
@@ -354,6 +386,24 @@ impl Compiler {
     }
 }
 
+// Cranelift ISA for the triple at the given optimization level, with extra
+// settings on top of the defaults
+pub fn make_isa(triple: Triple, opt_level: &OptLevel, extra_flags: &[(&str, &str)]) -> Result<OwnedTargetIsa, CompilerError> {
+    let mut builder = settings::builder();
+    builder.set("opt_level", &opt_level.to_cranelift_opt_level().to_string())
+        .map_err(|e| CompilerError::CodeGeneration(format!("Failed to set optimization level: {}", e)))?;
+    for (name, value) in extra_flags {
+        builder.set(name, value)
+            .map_err(|e| CompilerError::CodeGeneration(format!("Failed to set {}: {}", name, e)))?;
+    }
+    
+    let flags = settings::Flags::new(builder);
+    cranelift::codegen::isa::lookup(triple)
+        .map_err(|e| CompilerError::CodeGeneration(format!("Failed to lookup ISA: {}", e)))?
+        .finish(flags)
+        .map_err(|e| CompilerError::CodeGeneration(format!("Failed to create ISA: {}", e)))
+}
+
 // Helper function to detect host target
 pub fn detect_host_target() -> Target {
     let triple = Triple::host();
@@ -33,13 +33,11 @@ pub enum ChifError {
     #[error("Invalid operation: {message}")]
     InvalidOperation { message: String },
     
-    #[error("Return value")]
-    Return(crate::types::ChifValue),
-    
-    #[error("Break statement")]
+    // `break` / `continue` that reached a function boundary outside a loop
+    #[error("Break statement outside of loop")]
     Break,
     
-    #[error("Continue statement")]
+    #[error("Continue statement outside of loop")]
     Continue,
 }
 
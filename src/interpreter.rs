@@ -1,22 +1,304 @@
 use crate::ast::*;
 use crate::error::{ChifError, Result};
-use crate::types::ChifValue;
-use rand::Rng;
+use crate::modules;
+use crate::parallel::{self, Detached, Scalar, SharedValue, Snapshot};
+use crate::parser::Parser;
+use crate::profile::Profiler;
+use crate::resolver;
+#[cfg(feature = "jit")]
+use crate::tier::Tier;
+use crate::types::{ChifValue, StructLayout};
+use std::cell::OnceCell;
 use std::collections::HashMap;
-use std::io;
+use std::io::{self, IsTerminal, Write};
+use std::rc::Rc;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Arc;
 
 pub struct Interpreter {
     globals: HashMap<String, ChifValue>,
-    locals: Vec<HashMap<String, ChifValue>>,
-    functions: HashMap<String, Function>,
+    pub(crate) locals: Vec<Frame>,
+    frame_pool: Vec<Frame>,
+    pub(crate) functions: HashMap<String, Rc<Function>>,
     structs: HashMap<String, StructDef>,
-    struct_methods: HashMap<String, Vec<Function>>,
+    struct_layouts: HashMap<String, Rc<StructLayout>>,
+    http_response_layout: Rc<StructLayout>,
+    pub(crate) struct_methods: HashMap<String, Vec<Rc<Function>>>,
+    pub(crate) modules: HashMap<String, Module>,
+    http_client: Option<reqwest::blocking::Client>,
+    http_pool_size: usize,
+    http_idle_timeout: u64,
+    http_streams: HashMap<i64, HttpStream>,
+    next_http_stream: i64,
+    out: io::BufWriter<io::Stdout>,
+    out_line_flush: bool,
+    // Lines written by con.out, kept here instead of printed once a test
+    // calls capture_output
+    #[cfg(test)]
+    captured: Option<String>,
+    rng: RonoRng,
+    #[cfg(feature = "jit")]
+    tier: Option<Tier>,
+    profiler: Option<Box<Profiler>>,
+    // Program copies for par for workers, reused by every loop
+    par_images: Vec<Detached<WorkerImage>>,
+    // In a par for worker: the variables of the loop's frame
+    shared: Option<SharedFrame>,
+}
+
+// Call frame laid out by the resolver: one slot per local, None until the
+// variable is first assigned. Names the resolver never saw (set through
+// references or by name from builtins) go to `extra`. The VM engine
+// appends its temporary registers after the named slots. Frames of
+// finished calls go back to a pool and are reused by later calls.
+pub(crate) struct Frame {
+    pub(crate) slots: Vec<Option<ChifValue>>,
+    pub(crate) names: Rc<Vec<String>>,
+    extra: HashMap<String, ChifValue>,
+    // Loop iterations run in this call, for tiered execution
+    back_edges: u64,
+}
+
+impl Frame {
+    fn new() -> Self {
+        Self {
+            slots: Vec::new(),
+            names: Rc::new(Vec::new()),
+            extra: HashMap::new(),
+            back_edges: 0,
+        }
+    }
+    
+    // Lays the frame out for another call, keeping its allocations
+    fn reset(&mut self, names: Rc<Vec<String>>, registers: usize) {
+        self.slots.clear();
+        self.slots.resize(registers.max(names.len()), None);
+        self.names = names;
+        self.extra.clear();
+        self.back_edges = 0;
+    }
+    
+    fn slot_of(&self, name: &str) -> Option<usize> {
+        self.names.iter().position(|local| local == name)
+    }
+    
+    fn get(&self, name: &str) -> Option<&ChifValue> {
+        match self.slot_of(name) {
+            Some(slot) => self.slots[slot].as_ref(),
+            None => self.extra.get(name),
+        }
+    }
+    
+    fn get_mut(&mut self, name: &str) -> Option<&mut ChifValue> {
+        match self.slot_of(name) {
+            Some(slot) => self.slots[slot].as_mut(),
+            None => self.extra.get_mut(name),
+        }
+    }
+    
+    fn set(&mut self, name: &str, value: ChifValue) {
+        match self.slot_of(name) {
+            Some(slot) => self.slots[slot] = Some(value),
+            None => {
+                self.extra.insert(name.to_string(), value);
+            }
+        }
+    }
+}
+
+// How a statement finished. Return, break and continue travel up to the
+// enclosing call or loop as ordinary results, not through the error path.
+pub(crate) enum ControlFlow {
+    Normal,
+    Return(ChifValue),
+    Break,
+    Continue,
+}
+
+// con.out buffer size, same default as the C runtime (RONO_OUTPUT_BUFFER)
+const OUTPUT_DEFAULT_BUFFER: usize = 64 * 1024;
+
+// Open http_open stream: the response being read and its current chunk
+struct HttpStream {
+    response: reqwest::blocking::Response,
+    chunk: Vec<u8>,
+}
+
+// Read size for streamed bodies, matches libcurl's default chunk size
+const HTTP_CHUNK_SIZE: usize = 16 * 1024;
+
+// Connection pool defaults, kept in sync with the C runtime
+const HTTP_DEFAULT_POOL_SIZE: usize = 8;
+const HTTP_DEFAULT_IDLE_TIMEOUT: u64 = 60;
+
+// Interleaved streams of randfill, RONO_RAND_LANES in the C runtime
+const RAND_LANES: usize = 4;
+
+// xoshiro256** generator behind randi/randf/rands/randfill. Seeding, range
+// reduction and float conversion follow rono_rand_* in the C runtime, so a
+// program calling randseed(n) produces the same numbers in both engines.
+struct RonoRng {
+    s: [u64; 4],
+}
+
+impl RonoRng {
+    fn from_seed(seed: u64) -> Self {
+        // Stream 0 of the runtime's splitmix64 seeding
+        let mut x = seed;
+        let mut s = [0u64; 4];
+        for word in s.iter_mut() {
+            x = x.wrapping_add(0x9E3779B97F4A7C15);
+            let mut z = x;
+            z = (z ^ (z >> 30)).wrapping_mul(0xBF58476D1CE4E5B9);
+            z = (z ^ (z >> 27)).wrapping_mul(0x94D049BB133111EB);
+            *word = z ^ (z >> 31);
+        }
+        Self { s }
+    }
+
+    fn next_u64(&mut self) -> u64 {
+        Self::step(&mut self.s)
+    }
+
+    fn step(s: &mut [u64; 4]) -> u64 {
+        let result = s[1].wrapping_mul(5).rotate_left(7).wrapping_mul(9);
+        let t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = s[3].rotate_left(45);
+        result
+    }
+
+    // Uniform value in [0, range), range == 0 meaning the full u64 range
+    fn below(&mut self, range: u64) -> u64 {
+        let x = self.next_u64();
+        if range == 0 {
+            return x;
+        }
+        let mut m = x as u128 * range as u128;
+        if (m as u64) < range {
+            let threshold = range.wrapping_neg() % range;
+            while (m as u64) < threshold {
+                m = self.next_u64() as u128 * range as u128;
+            }
+        }
+        (m >> 64) as u64
+    }
+
+    fn unit(&mut self) -> f64 {
+        Self::to_unit(self.next_u64())
+    }
+
+    fn to_unit(x: u64) -> f64 {
+        (x >> 11) as f64 * (1.0 / (1u64 << 53) as f64)
+    }
+
+    // Raw draws for randfill: RAND_LANES streams seeded from this generator
+    // and interleaved, the tail from the generator itself, as in
+    // rono_rand_fill_raw
+    fn fill_raw(&mut self, count: usize) -> Vec<u64> {
+        let mut lanes = [[0u64; 4]; RAND_LANES];
+        for lane in lanes.iter_mut() {
+            for word in lane.iter_mut() {
+                *word = self.next_u64();
+            }
+        }
+        let mut out = Vec::with_capacity(count);
+        while out.len() + RAND_LANES <= count {
+            for lane in lanes.iter_mut() {
+                out.push(Self::step(lane));
+            }
+        }
+        while out.len() < count {
+            out.push(self.next_u64());
+        }
+        out
+    }
+
+    // Like rono_rand_fill_int: a draw that would be biased is replaced by
+    // one from the generator itself
+    fn fill_int(&mut self, count: usize, min: i64, max: i64) -> Vec<i64> {
+        let raw = self.fill_raw(count);
+        let range = (max as u64).wrapping_sub(min as u64).wrapping_add(1);
+        if range == 0 {
+            return raw.into_iter().map(|x| x as i64).collect();
+        }
+        let threshold = range.wrapping_neg() % range;
+        raw.into_iter()
+            .map(|x| {
+                let m = x as u128 * range as u128;
+                let offset = if (m as u64) < threshold { self.below(range) } else { (m >> 64) as u64 };
+                (min as u64).wrapping_add(offset) as i64
+            })
+            .collect()
+    }
+
+    fn fill_float(&mut self, count: usize, min: f64, max: f64) -> Vec<f64> {
+        self.fill_raw(count).into_iter().map(|x| min + Self::to_unit(x) * (max - min)).collect()
+    }
+}
+
+// A par for worker's copy of the program's tables, sharing no Rc with the
+// parent interpreter (see parallel::Detached). Built when a loop first
+// needs it and handed back by the worker, so later loops don't copy the
+// program again.
+struct WorkerImage {
+    functions: HashMap<String, Rc<Function>>,
+    structs: HashMap<String, StructDef>,
+    struct_layouts: HashMap<String, Rc<StructLayout>>,
+    struct_methods: HashMap<String, Vec<Rc<Function>>>,
     modules: HashMap<String, Module>,
 }
 
+// The rest of what a worker starts from, for one execution of the loop
+struct WorkerStart {
+    snapshot: Arc<Snapshot>,
+    par_for: ParForStatement,
+    http_client: Option<reqwest::blocking::Client>,
+    http_pool_size: usize,
+    http_idle_timeout: u64,
+    out_line_flush: bool,
+    seed: u64,
+}
+
+// A worker's view of the snapshot: a variable is copied out the first time
+// it is read as a whole, and indexing reads elements in place
+struct SharedFrame {
+    snapshot: Arc<Snapshot>,
+    thawed: Vec<OnceCell<ChifValue>>,
+}
+
+impl SharedFrame {
+    fn new(snapshot: Arc<Snapshot>) -> Self {
+        let thawed = (0..snapshot.variables.len()).map(|_| OnceCell::new()).collect();
+        Self { snapshot, thawed }
+    }
+    
+    fn position(&self, name: &str) -> Option<usize> {
+        self.snapshot.variables.iter().position(|(variable, _)| variable == name)
+    }
+    
+    fn get(&self, name: &str, layouts: &HashMap<String, Rc<StructLayout>>) -> Option<&ChifValue> {
+        let index = self.position(name)?;
+        Some(self.thawed[index].get_or_init(|| self.snapshot.variables[index].1.thaw(layouts)))
+    }
+    
+    // The frozen value, while the worker has no copy of it
+    fn frozen(&self, name: &str) -> Option<&SharedValue> {
+        let index = self.position(name)?;
+        match self.thawed[index].get() {
+            Some(_) => None,
+            None => Some(&self.snapshot.variables[index].1),
+        }
+    }
+}
+
 #[derive(Debug, Clone)]
 pub struct Module {
-    pub functions: HashMap<String, Function>,
+    pub functions: HashMap<String, Rc<Function>>,
     pub structs: HashMap<String, StructDef>,
 }
 
@@ -25,62 +307,162 @@ impl Interpreter {
         let mut globals = HashMap::new();
         
         // Add console object
-        let mut console_methods = HashMap::new();
-        console_methods.insert("out".to_string(), ChifValue::Str("console_out".to_string()));
-        console_methods.insert("in".to_string(), ChifValue::Str("console_in".to_string()));
-        globals.insert("con".to_string(), ChifValue::Struct("Console".to_string(), console_methods));
+        let console = StructLayout::new("Console", vec!["out".to_string(), "in".to_string()]);
+        let console_methods = vec![ChifValue::Str("console_out".into()), ChifValue::Str("console_in".into())];
+        globals.insert("con".to_string(), ChifValue::Struct(console, console_methods.into()));
         
         Self {
             globals,
             locals: Vec::new(),
+            frame_pool: Vec::new(),
             functions: HashMap::new(),
             structs: HashMap::new(),
+            struct_layouts: HashMap::new(),
+            http_response_layout: StructLayout::new(
+                "HttpResponse",
+                vec!["status".to_string(), "body".to_string(), "content_type".to_string()],
+            ),
             struct_methods: HashMap::new(),
             modules: HashMap::new(),
+            http_client: None,
+            http_pool_size: HTTP_DEFAULT_POOL_SIZE,
+            http_idle_timeout: HTTP_DEFAULT_IDLE_TIMEOUT,
+            http_streams: HashMap::new(),
+            next_http_stream: 1,
+            out: io::BufWriter::with_capacity(Self::output_buffer_size(), io::stdout()),
+            out_line_flush: io::stdout().is_terminal(),
+            #[cfg(test)]
+            captured: None,
+            rng: RonoRng::from_seed(rand::random()),
+            #[cfg(feature = "jit")]
+            tier: None,
+            profiler: None,
+            par_images: Vec::new(),
+            shared: None,
         }
     }
     
+    // `rono run --tiered`: profile calls and run hot numeric functions as
+    // native code. Has to be enabled before the program is loaded.
+    #[cfg(feature = "jit")]
+    pub fn enable_tiering(&mut self, opt_level: crate::compiler::OptLevel) {
+        self.tier = Some(Tier::new(opt_level));
+    }
+    
+    // Promotion state of `--tiered`, None when tiering isn't enabled
+    #[cfg(feature = "jit")]
+    pub fn tier(&self) -> Option<&Tier> {
+        self.tier.as_ref()
+    }
+    
+    // `rono run --profile`: time every call and statement. Has to be enabled
+    // before the program is loaded; read the results with `profiler`.
+    pub fn enable_profiling(&mut self) {
+        self.profiler = Some(Box::new(Profiler::new()));
+    }
+    
+    pub fn profiler(&self) -> Option<&Profiler> {
+        self.profiler.as_deref()
+    }
+    
     pub fn execute(&mut self, program: &Program) -> Result<()> {
-        // First pass: process imports and collect all functions and structs
+        self.load(program)?;
+        let main_func = self.main_function()?;
+        
+        let result = self.call_function(&main_func, Vec::new());
+        // Flush before the caller reports a possible error on stderr
+        self.flush_output();
+        result?;
+        
+        Ok(())
+    }
+    
+    // Process imports and collect all functions and structs
+    pub(crate) fn load(&mut self, program: &Program) -> Result<()> {
+        self.par_images.clear();
+        modules::preload(&program.items);
         for item in &program.items {
             match item {
                 Item::Import(import) => {
                     self.process_import(import)?;
                 }
                 Item::Function(func) => {
-                    self.functions.insert(func.name.clone(), func.clone());
+                    let resolved = Self::resolved(func);
+                    self.tier_register(func, &resolved);
+                    let resolved = Rc::new(resolved);
+                    self.profile_name(&resolved, || func.name.clone());
+                    self.functions.insert(func.name.clone(), resolved);
                 }
                 Item::Struct(struct_def) => {
-                    self.structs.insert(struct_def.name.clone(), struct_def.clone());
+                    self.register_struct(struct_def);
                 }
                 Item::StructImpl(impl_block) => {
-                    self.struct_methods
-                        .entry(impl_block.struct_name.clone())
-                        .or_insert_with(Vec::new)
-                        .extend(impl_block.methods.clone());
+                    self.register_methods(impl_block);
                 }
             }
         }
         
-        // Find and execute main function
-        if let Some(main_func) = self.functions.get("main").cloned() {
-            if main_func.is_main {
-                self.call_function(&main_func, Vec::new())?;
-            } else {
-                return Err(ChifError::RuntimeError {
-                    message: "Main function must be marked with 'chif'".to_string(),
-                });
-            }
-        } else {
-            return Err(ChifError::RuntimeError {
+        Ok(())
+    }
+    
+    pub(crate) fn main_function(&self) -> Result<Rc<Function>> {
+        match self.functions.get("main") {
+            Some(main_func) if main_func.is_main => Ok(Rc::clone(main_func)),
+            Some(_) => Err(ChifError::RuntimeError {
+                message: "Main function must be marked with 'chif'".to_string(),
+            }),
+            None => Err(ChifError::RuntimeError {
                 message: "No main function found".to_string(),
-            });
+            }),
+        }
+    }
+    
+    // Interns the struct's layout: instances share it and keep only field values
+    fn register_struct(&mut self, struct_def: &StructDef) {
+        let fields = struct_def.fields.iter().map(|field| field.name.clone()).collect();
+        self.struct_layouts.insert(struct_def.name.clone(), StructLayout::new(struct_def.name.clone(), fields));
+        self.structs.insert(struct_def.name.clone(), struct_def.clone());
+    }
+    
+    // Layout for a literal; a struct without a definition is laid out in the
+    // literal's field order the first time it is built
+    fn struct_layout(&mut self, struct_literal: &StructLiteral) -> Rc<StructLayout> {
+        if let Some(layout) = self.struct_layouts.get(&struct_literal.struct_name) {
+            return Rc::clone(layout);
+        }
+        let fields = struct_literal.fields.iter().map(|(name, _)| name.clone()).collect();
+        let layout = StructLayout::new(struct_literal.struct_name.clone(), fields);
+        self.struct_layouts.insert(struct_literal.struct_name.clone(), Rc::clone(&layout));
+        layout
+    }
+    
+    fn register_methods(&mut self, impl_block: &StructImpl) {
+        for method in &impl_block.methods {
+            let method = Rc::new(Self::resolved(method));
+            self.profile_name(&method, || format!("{}.{}", impl_block.struct_name, method.name));
+            self.struct_methods.entry(impl_block.struct_name.clone()).or_insert_with(Vec::new).push(method);
         }
-        
-        Ok(())
+    }
+    
+    fn struct_method(&self, struct_name: &str, method_name: &str) -> Option<Rc<Function>> {
+        self.struct_methods.get(struct_name)?.iter().find(|method| method.name == method_name).cloned()
+    }
+    
+    // Copy of a function with its locals resolved to frame slots
+    fn resolved(func: &Function) -> Function {
+        let mut func = func.clone();
+        resolver::resolve_function(&mut func);
+        func
     }
     
     fn call_function(&mut self, func: &Function, args: Vec<ChifValue>) -> Result<ChifValue> {
+        if self.profiler.is_some() {
+            return self.profiled_call(func, |interpreter| interpreter.run_function(func, args));
+        }
+        self.run_function(func, args)
+    }
+    
+    fn run_function(&mut self, func: &Function, args: Vec<ChifValue>) -> Result<ChifValue> {
         if args.len() != func.params.len() {
             return Err(ChifError::RuntimeError {
                 message: format!(
@@ -92,35 +474,140 @@ impl Interpreter {
             });
         }
         
-        // Create new scope
-        let mut scope = HashMap::new();
-        
-        // Bind parameters
-        for (param, arg) in func.params.iter().zip(args.iter()) {
-            scope.insert(param.name.clone(), arg.clone());
+        #[cfg(feature = "jit")]
+        if let Some(tier) = &mut self.tier {
+            if let Some(value) = tier.call(func, &args) {
+                return Ok(value);
+            }
         }
         
-        self.locals.push(scope);
+        self.enter_call(func, args);
         
         let result = self.execute_block(&func.body);
         
-        self.locals.pop();
+        let back_edges = self.leave_frame();
+        self.tier_leave(func, back_edges);
         
-        match result {
-            Ok(_) => Ok(ChifValue::Nil),
-            Err(ChifError::Return(value)) => Ok(value),
-            Err(e) => Err(e),
+        Self::call_result(result?)
+    }
+    
+    // Pushes a frame for a call (from the pool when there is one) with the
+    // arguments in the parameter slots, which the resolver puts first
+    fn enter_call(&mut self, func: &Function, args: Vec<ChifValue>) {
+        let frame = self.enter_frame(Rc::clone(&func.locals), func.locals.len());
+        for (slot, arg) in frame.slots.iter_mut().zip(args) {
+            *slot = Some(arg);
+        }
+    }
+    
+    pub(crate) fn enter_frame(&mut self, names: Rc<Vec<String>>, registers: usize) -> &mut Frame {
+        let mut frame = self.frame_pool.pop().unwrap_or_else(Frame::new);
+        frame.reset(names, registers);
+        self.locals.push(frame);
+        self.locals.last_mut().expect("frame just pushed")
+    }
+    
+    // Pops the current frame back into the pool, dropping its values now;
+    // returns the loop iterations the call ran
+    pub(crate) fn leave_frame(&mut self) -> u64 {
+        match self.locals.pop() {
+            Some(mut frame) => {
+                let back_edges = frame.back_edges;
+                frame.slots.clear();
+                frame.extra.clear();
+                self.frame_pool.push(frame);
+                back_edges
+            }
+            None => 0,
+        }
+    }
+    
+    // Value of a call whose body finished with `flow`. A break or continue
+    // that reaches the function is outside any loop.
+    pub(crate) fn call_result(flow: ControlFlow) -> Result<ChifValue> {
+        match flow {
+            ControlFlow::Normal => Ok(ChifValue::Nil),
+            ControlFlow::Return(value) => Ok(value),
+            ControlFlow::Break => Err(ChifError::Break),
+            ControlFlow::Continue => Err(ChifError::Continue),
+        }
+    }
+    
+    #[cfg(feature = "jit")]
+    fn tier_register(&mut self, source: &Function, resolved: &Function) {
+        if let Some(tier) = &mut self.tier {
+            tier.register(source, resolved);
+        }
+    }
+    
+    #[cfg(not(feature = "jit"))]
+    fn tier_register(&mut self, _source: &Function, _resolved: &Function) {}
+    
+    // Loop iterations of a finished call count towards compiling the function
+    #[cfg(feature = "jit")]
+    fn tier_leave(&mut self, func: &Function, back_edges: u64) {
+        if let Some(tier) = &mut self.tier {
+            if back_edges > 0 {
+                tier.record_back_edges(func, back_edges);
+            }
+        }
+    }
+    
+    #[cfg(not(feature = "jit"))]
+    fn tier_leave(&mut self, _func: &Function, _back_edges: u64) {}
+    
+    fn count_back_edge(&mut self) {
+        if let Some(frame) = self.locals.last_mut() {
+            frame.back_edges += 1;
         }
     }
     
-    fn execute_block(&mut self, block: &Block) -> Result<()> {
+    fn execute_block(&mut self, block: &Block) -> Result<ControlFlow> {
+        if self.profiler.is_some() {
+            return self.execute_block_profiled(block);
+        }
         for statement in &block.statements {
-            self.execute_statement(statement)?;
+            match self.execute_statement(statement)? {
+                ControlFlow::Normal => {}
+                flow => return Ok(flow),
+            }
+        }
+        Ok(ControlFlow::Normal)
+    }
+    
+    // Profiling is kept off the normal paths: with it disabled, calls and
+    // blocks only pay for the `profiler.is_some()` check
+    fn execute_block_profiled(&mut self, block: &Block) -> Result<ControlFlow> {
+        for (index, statement) in block.statements.iter().enumerate() {
+            self.profiler_mut().enter_statement();
+            let flow = self.execute_statement(statement);
+            self.profiler_mut().leave_statement(block.lines.get(index).copied().unwrap_or(0));
+            match flow? {
+                ControlFlow::Normal => {}
+                flow => return Ok(flow),
+            }
+        }
+        Ok(ControlFlow::Normal)
+    }
+    
+    fn profiled_call(&mut self, func: &Function, call: impl FnOnce(&mut Self) -> Result<ChifValue>) -> Result<ChifValue> {
+        self.profiler_mut().enter_call(func);
+        let result = call(self);
+        self.profiler_mut().leave_call();
+        result
+    }
+    
+    fn profiler_mut(&mut self) -> &mut Profiler {
+        self.profiler.as_deref_mut().expect("profiling is enabled")
+    }
+    
+    fn profile_name(&mut self, func: &Function, name: impl FnOnce() -> String) {
+        if let Some(profiler) = &mut self.profiler {
+            profiler.name(func, name());
         }
-        Ok(())
     }
     
-    fn execute_statement(&mut self, statement: &Statement) -> Result<()> {
+    pub(crate) fn execute_statement(&mut self, statement: &Statement) -> Result<ControlFlow> {
         match statement {
             Statement::VarDecl(var_decl) => {
                 let value = if let Some(expr) = &var_decl.value {
@@ -138,11 +625,17 @@ impl Interpreter {
                     ChifValue::Nil
                 };
                 
-                self.set_variable(&var_decl.name, value)?;
+                match var_decl.slot {
+                    Some(slot) => self.set_local(slot, value),
+                    None => self.set_variable(&var_decl.name, value)?,
+                }
             }
             Statement::Assignment(assignment) => {
                 let value = self.evaluate_expression(&assignment.value)?;
                 match &assignment.target {
+                    Expression::Local(local) => {
+                        self.set_local(local.slot, value);
+                    }
                     Expression::Identifier(name) => {
                         self.set_variable(name, value)?;
                     }
@@ -165,23 +658,18 @@ impl Interpreter {
             Statement::If(if_stmt) => {
                 let condition = self.evaluate_expression(&if_stmt.condition)?;
                 if self.is_truthy(&condition) {
-                    self.execute_block(&if_stmt.then_block)?;
+                    return self.execute_block(&if_stmt.then_block);
                 } else if let Some(else_block) = &if_stmt.else_block {
-                    self.execute_block(else_block)?;
+                    return self.execute_block(else_block);
                 }
             }
             Statement::For(for_stmt) => {
-                // Create new scope for the for loop variables
-                self.locals.push(HashMap::new());
-                
-                // Execute initialization in the loop scope
+                // Loop variables are ordinary slots of the function's frame,
+                // so they stay visible after the loop
                 if let Some(init) = &for_stmt.init {
                     self.execute_statement(init)?;
                 }
                 
-                // Save the current state of the loop variables after initialization
-                let loop_scope_index = self.locals.len() - 1;
-                
                 loop {
                     if let Some(condition) = &for_stmt.condition {
                         let cond_value = self.evaluate_expression(condition)?;
@@ -191,55 +679,16 @@ impl Interpreter {
                     }
                     
                     // Execute the loop body
-                    match self.execute_block(&for_stmt.body) {
-                        Ok(()) => {},
-                        Err(ChifError::Break) => break,
-                        Err(ChifError::Continue) => {
-                            // Execute update and continue
-                            if let Some(update) = &for_stmt.update {
-                                self.execute_statement(update)?;
-                            }
-                            continue;
-                        },
-                        Err(e) => return Err(e),
+                    match self.execute_block(&for_stmt.body)? {
+                        ControlFlow::Normal | ControlFlow::Continue => {}
+                        ControlFlow::Break => break,
+                        flow @ ControlFlow::Return(_) => return Ok(flow),
                     }
+                    self.count_back_edge();
                     
                     if let Some(update) = &for_stmt.update {
-                        // Execute update statement
                         self.execute_statement(update)?;
                     }
-                    
-                    // Preserve any changes to loop variables for the next iteration
-                    // This ensures variables modified in the loop body remain modified
-                    if loop_scope_index < self.locals.len() {
-                        // We're still in the same scope structure
-                        // No need to do anything special
-                    } else {
-                        // Something changed the scope structure, this is unexpected
-                        // but we'll handle it gracefully
-                        break;
-                    }
-                }
-                
-                // Сохраняем переменные из области видимости цикла в родительскую область
-                if !self.locals.is_empty() {
-                    let loop_scope = self.locals.last().unwrap().clone();
-                    self.locals.pop();
-                    
-                    // Если есть родительская область видимости, копируем в неё измененные переменные
-                    if !self.locals.is_empty() {
-                        let parent_scope = self.locals.last_mut().unwrap();
-                        
-                        for (name, value) in loop_scope.iter() {
-                            // Обновляем переменные в родительской области видимости
-                            // Включая те, которые были объявлены до цикла
-                            parent_scope.insert(name.clone(), value.clone());
-                        }
-                    }
-                } else {
-                    // На всякий случай, если список областей видимости пуст
-                    // (не должно происходить, но для безопасности)
-                    self.locals.push(HashMap::new());
                 }
             }
             Statement::While(while_stmt) => {
@@ -249,33 +698,31 @@ impl Interpreter {
                         break;
                     }
                     
-                    match self.execute_block(&while_stmt.body) {
-                        Ok(()) => {},
-                        Err(ChifError::Break) => break,
-                        Err(ChifError::Continue) => continue,
-                        Err(e) => return Err(e),
+                    match self.execute_block(&while_stmt.body)? {
+                        ControlFlow::Normal | ControlFlow::Continue => {}
+                        ControlFlow::Break => break,
+                        flow @ ControlFlow::Return(_) => return Ok(flow),
                     }
+                    self.count_back_edge();
                 }
             }
             Statement::Switch(switch_stmt) => {
                 let switch_value = self.evaluate_expression(&switch_stmt.expr)?;
-                let mut matched = false;
                 
                 for case in &switch_stmt.cases {
                     let case_value = self.evaluate_expression(&case.value)?;
                     if self.values_equal(&switch_value, &case_value) {
-                        self.execute_block(&case.body)?;
-                        matched = true;
-                        break;
+                        return self.execute_block(&case.body);
                     }
                 }
                 
-                if !matched {
-                    if let Some(default_case) = &switch_stmt.default_case {
-                        self.execute_block(default_case)?;
-                    }
+                if let Some(default_case) = &switch_stmt.default_case {
+                    return self.execute_block(default_case);
                 }
             }
+            Statement::ParFor(par_for) => {
+                self.execute_par_for(par_for)?;
+            }
             Statement::Return(expr) => {
                 let value = if let Some(expr) = expr {
                     self.evaluate_expression(expr)?
@@ -283,26 +730,302 @@ impl Interpreter {
                     ChifValue::Nil
                 };
                 
-                return Err(ChifError::Return(value));
+                return Ok(ControlFlow::Return(value));
             }
             Statement::Break => {
-                return Err(ChifError::Break);
+                return Ok(ControlFlow::Break);
             }
             Statement::Continue => {
-                return Err(ChifError::Continue);
+                return Ok(ControlFlow::Continue);
+            }
+        }
+        Ok(ControlFlow::Normal)
+    }
+    
+    // `par for`: the range is split into chunks that worker threads, each
+    // with its own interpreter, claim from a shared counter until none are
+    // left. The workers read the loop frame's variables from one shared
+    // snapshot and run on program copies kept from earlier loops. Reduction
+    // targets start at their identity in every worker; the partial results
+    // are folded into the variables when all have finished.
+    fn execute_par_for(&mut self, par_for: &ParForStatement) -> Result<()> {
+        parallel::check_par_for(par_for).map_err(|message| ChifError::RuntimeError { message })?;
+        
+        let start = self.par_for_bound(&par_for.start)?;
+        let end = self.par_for_bound(&par_for.end)?;
+        let mut totals = Vec::with_capacity(par_for.reductions.len());
+        for reduction in &par_for.reductions {
+            match self.lookup_variable(&reduction.name) {
+                Some(value) => totals.push(Scalar::from_value(value).ok_or_else(|| ChifError::RuntimeError {
+                    message: format!("Reduction variable '{}' must be int or float", reduction.name),
+                })?),
+                None => return Err(ChifError::VariableNotFound { name: reduction.name.clone() }),
+            }
+        }
+        if end <= start {
+            return Ok(());
+        }
+        
+        let count = end.wrapping_sub(start) as u64;
+        let workers = parallel::thread_count().min(usize::try_from(count).unwrap_or(usize::MAX));
+        if workers <= 1 {
+            // Reduction targets are updated in place, which gives the same result
+            return self.run_par_chunk(par_for, start, end);
+        }
+        
+        // Lines already buffered go out before any worker's
+        self.flush_output();
+        let snapshot = Arc::new(self.par_snapshot());
+        while self.par_images.len() < workers {
+            let image = self.worker_image();
+            self.par_images.push(image);
+        }
+        let images = self.par_images.split_off(self.par_images.len() - workers);
+        let starts: Vec<Detached<WorkerStart>> = (0..workers).map(|_| self.worker_start(par_for, &snapshot)).collect();
+        let chunk = parallel::chunk_size(count, workers);
+        let next = AtomicU64::new(0);
+        let failed = AtomicBool::new(false);
+        let results: Vec<Result<Vec<Scalar>>> = std::thread::scope(|scope| {
+            let handles: Vec<_> = images
+                .into_iter()
+                .zip(starts)
+                .map(|(image, worker_start)| {
+                    let (next, failed) = (&next, &failed);
+                    scope.spawn(move || {
+                        Self::run_worker(image.into_inner(), worker_start.into_inner(), start, count, chunk, next, failed)
+                    })
+                })
+                .collect();
+            handles
+                .into_iter()
+                .map(|handle| match handle.join() {
+                    Ok((result, image)) => {
+                        self.par_images.push(image);
+                        result
+                    }
+                    Err(_) => Err(ChifError::RuntimeError { message: "par for worker thread panicked".to_string() }),
+                })
+                .collect()
+        });
+        
+        for partials in results {
+            for ((reduction, total), partial) in par_for.reductions.iter().zip(totals.iter_mut()).zip(partials?) {
+                *total = Scalar::combine(reduction.op, *total, partial);
+            }
+        }
+        for (reduction, total) in par_for.reductions.iter().zip(totals) {
+            if let Some(variable) = self.variable_mut(&reduction.name) {
+                *variable = total.into_value();
+            }
+        }
+        Ok(())
+    }
+    
+    fn par_for_bound(&mut self, expr: &Expression) -> Result<i64> {
+        match self.evaluate_expression(expr)? {
+            ChifValue::Int(value) => Ok(value),
+            other => Err(ChifError::TypeMismatch {
+                expected: "int".to_string(),
+                found: other.get_type().to_string(),
+            }),
+        }
+    }
+    
+    // Iterations lo..hi of a par for body on this interpreter
+    fn run_par_chunk(&mut self, par_for: &ParForStatement, lo: i64, hi: i64) -> Result<()> {
+        for i in lo..hi {
+            match par_for.slot {
+                Some(slot) => self.set_local(slot, ChifValue::Int(i)),
+                None => self.set_variable(&par_for.var, ChifValue::Int(i))?,
+            }
+            match self.execute_block(&par_for.body)? {
+                ControlFlow::Normal | ControlFlow::Continue => {}
+                // check_par_for rejects these
+                ControlFlow::Break | ControlFlow::Return(_) => {
+                    return Err(ChifError::RuntimeError {
+                        message: "ret and break are not allowed in a par for body".to_string(),
+                    });
+                }
             }
+            self.count_back_edge();
         }
         Ok(())
     }
     
-    fn evaluate_expression(&mut self, expr: &Expression) -> Result<ChifValue> {
+    // The variables of the loop's frame and the globals, frozen for the
+    // workers of one execution
+    fn par_snapshot(&self) -> Snapshot {
+        let mut layouts = HashMap::new();
+        let (frame_names, variables) = match self.locals.last() {
+            Some(frame) => {
+                let slots = frame.names.iter().zip(&frame.slots)
+                    .filter_map(|(name, slot)| slot.as_ref().map(|value| (name, value)));
+                let mut variables: Vec<(String, SharedValue)> = slots.chain(&frame.extra)
+                    .map(|(name, value)| (name.clone(), SharedValue::freeze(value, &mut layouts)))
+                    .collect();
+                // A par for nested in a worker's loop body also sees what
+                // that worker reads from its own snapshot
+                if let (Some(shared), 1) = (&self.shared, self.locals.len()) {
+                    for (name, _) in &shared.snapshot.variables {
+                        if variables.iter().all(|(variable, _)| variable != name) {
+                            if let Some(value) = shared.get(name, &self.struct_layouts) {
+                                variables.push((name.clone(), SharedValue::freeze(value, &mut layouts)));
+                            }
+                        }
+                    }
+                }
+                (frame.names.to_vec(), variables)
+            }
+            None => (Vec::new(), Vec::new()),
+        };
+        let globals = self.globals.iter()
+            .map(|(name, value)| (name.clone(), SharedValue::freeze(value, &mut layouts)))
+            .collect();
+        Snapshot { frame_names, variables, globals }
+    }
+    
+    // Unshared copies of the program for one worker
+    fn worker_image(&self) -> Detached<WorkerImage> {
+        let unshare_functions = |functions: &HashMap<String, Rc<Function>>| -> HashMap<String, Rc<Function>> {
+            functions.iter().map(|(name, func)| (name.clone(), Rc::new(parallel::unshare_function(func)))).collect()
+        };
+        let image = WorkerImage {
+            functions: unshare_functions(&self.functions),
+            structs: self.structs.clone(),
+            struct_layouts: self.struct_layouts.iter()
+                .map(|(name, layout)| (name.clone(), StructLayout::new(layout.name.clone(), layout.fields.clone())))
+                .collect(),
+            struct_methods: self.struct_methods.iter()
+                .map(|(name, methods)| {
+                    (name.clone(), methods.iter().map(|method| Rc::new(parallel::unshare_function(method))).collect())
+                })
+                .collect(),
+            modules: self.modules.iter()
+                .map(|(name, module)| {
+                    (name.clone(), Module { functions: unshare_functions(&module.functions), structs: module.structs.clone() })
+                })
+                .collect(),
+        };
+        // Safety: every Rc in the image was just allocated by the copies above
+        unsafe { Detached::new(image) }
+    }
+    
+    // Each worker's PRNG is seeded from this one, so randseed before the
+    // loop still makes a run reproducible when the iterations don't depend
+    // on which worker ran them
+    fn worker_start(&mut self, par_for: &ParForStatement, snapshot: &Arc<Snapshot>) -> Detached<WorkerStart> {
+        let mut par_for = par_for.clone();
+        parallel::unshare_par_for(&mut par_for);
+        let worker_start = WorkerStart {
+            snapshot: Arc::clone(snapshot),
+            par_for,
+            http_client: self.http_client.clone(),
+            http_pool_size: self.http_pool_size,
+            http_idle_timeout: self.http_idle_timeout,
+            out_line_flush: self.out_line_flush,
+            seed: self.rng.next_u64(),
+        };
+        // Safety: the loop's Rcs were all copied by unshare_par_for
+        unsafe { Detached::new(worker_start) }
+    }
+    
+    // Body of a worker thread; returns its reduction partials in order and
+    // the image for the next loop
+    fn run_worker(
+        image: WorkerImage,
+        worker_start: WorkerStart,
+        start: i64,
+        count: u64,
+        chunk: u64,
+        next: &AtomicU64,
+        failed: &AtomicBool,
+    ) -> (Result<Vec<Scalar>>, Detached<WorkerImage>) {
+        let mut worker = Interpreter::new();
+        worker.functions = image.functions;
+        worker.structs = image.structs;
+        worker.struct_layouts = image.struct_layouts;
+        worker.struct_methods = image.struct_methods;
+        worker.modules = image.modules;
+        worker.http_client = worker_start.http_client;
+        worker.http_pool_size = worker_start.http_pool_size;
+        worker.http_idle_timeout = worker_start.http_idle_timeout;
+        worker.out_line_flush = worker_start.out_line_flush;
+        worker.rng = RonoRng::from_seed(worker_start.seed);
+        
+        let snapshot = worker_start.snapshot;
+        for (name, value) in &snapshot.globals {
+            let value = value.thaw(&worker.struct_layouts);
+            worker.globals.insert(name.clone(), value);
+        }
+        let names = Rc::new(snapshot.frame_names.clone());
+        worker.enter_frame(names, snapshot.frame_names.len());
+        worker.shared = Some(SharedFrame::new(snapshot));
+        
+        let par_for = worker_start.par_for;
+        let result = worker.run_par_worker(&par_for, start, count, chunk, next, failed);
+        worker.flush_output();
+        
+        let image = WorkerImage {
+            functions: std::mem::take(&mut worker.functions),
+            structs: std::mem::take(&mut worker.structs),
+            struct_layouts: std::mem::take(&mut worker.struct_layouts),
+            struct_methods: std::mem::take(&mut worker.struct_methods),
+            modules: std::mem::take(&mut worker.modules),
+        };
+        drop(worker);
+        drop(par_for);
+        // Safety: the worker and the loop, which shared Rcs with the image,
+        // were dropped above
+        (result, unsafe { Detached::new(image) })
+    }
+    
+    fn run_par_worker(
+        &mut self,
+        par_for: &ParForStatement,
+        start: i64,
+        count: u64,
+        chunk: u64,
+        next: &AtomicU64,
+        failed: &AtomicBool,
+    ) -> Result<Vec<Scalar>> {
+        for reduction in &par_for.reductions {
+            let like = self.lookup_variable(&reduction.name).and_then(Scalar::from_value).unwrap_or(Scalar::Int(0));
+            self.set_variable(&reduction.name, Scalar::identity(reduction.op, like).into_value())?;
+        }
+        
+        while !failed.load(Ordering::Relaxed) {
+            let offset = next.fetch_add(chunk, Ordering::Relaxed);
+            if offset >= count {
+                break;
+            }
+            let lo = start.wrapping_add(offset as i64);
+            let hi = lo.wrapping_add(chunk.min(count - offset) as i64);
+            if let Err(error) = self.run_par_chunk(par_for, lo, hi) {
+                failed.store(true, Ordering::Relaxed);
+                return Err(error);
+            }
+        }
+        
+        par_for.reductions.iter()
+            .map(|reduction| {
+                self.lookup_variable(&reduction.name).and_then(Scalar::from_value).ok_or_else(|| {
+                    ChifError::RuntimeError {
+                        message: format!("Reduction variable '{}' must stay int or float", reduction.name),
+                    }
+                })
+            })
+            .collect()
+    }
+    
+    pub(crate) fn evaluate_expression(&mut self, expr: &Expression) -> Result<ChifValue> {
         match expr {
             Expression::Literal(value) => {
                 match value {
-                    ChifValue::Str(s) => {
-                        // Apply string interpolation to all string literals
+                    // The parser turns literals with holes into templates; braces
+                    // left in a literal are an unclosed hole, which this reports
+                    ChifValue::Str(s) if s.contains(['{', '}']) => {
                         let interpolated = self.interpolate_string(s)?;
-                        Ok(ChifValue::Str(interpolated))
+                        Ok(ChifValue::Str(interpolated.into()))
                     }
                     _ => Ok(value.clone()),
                 }
@@ -310,12 +1033,20 @@ impl Interpreter {
             Expression::Identifier(name) => {
                 // Special built-in functions
                 match name.as_str() {
-                    "randi" => Ok(ChifValue::Str("randi".to_string())), // Placeholder
-                    "randf" => Ok(ChifValue::Str("randf".to_string())), // Placeholder
-                    "rands" => Ok(ChifValue::Str("rands".to_string())), // Placeholder
+                    "randi" => Ok(ChifValue::Str("randi".into())), // Placeholder
+                    "randf" => Ok(ChifValue::Str("randf".into())), // Placeholder
+                    "rands" => Ok(ChifValue::Str("rands".into())), // Placeholder
+                    "randseed" => Ok(ChifValue::Str("randseed".into())), // Placeholder
                     _ => self.get_variable(name),
                 }
             }
+            Expression::Local(local) => {
+                match self.locals.last().and_then(|frame| frame.slots[local.slot].as_ref()) {
+                    Some(value) => Ok(value.clone()),
+                    // Not assigned in this call yet: look further out by name
+                    None => self.get_variable(&local.name),
+                }
+            }
             Expression::Binary(binary_op) => {
                 let left = self.evaluate_expression(&binary_op.left)?;
                 let right = self.evaluate_expression(&binary_op.right)?;
@@ -390,11 +1121,11 @@ impl Interpreter {
                         
                         match value {
                             ChifValue::Str(s) => Ok(ChifValue::Str(s)), // Уже строка
-                            ChifValue::Int(i) => Ok(ChifValue::Str(i.to_string())), // Преобразование из int
-                            ChifValue::Float(f) => Ok(ChifValue::Str(f.to_string())), // Преобразование из float
-                            ChifValue::Bool(b) => Ok(ChifValue::Str(b.to_string())), // Преобразование из bool
-                            ChifValue::Nil => Ok(ChifValue::Str("nil".to_string())), // Преобразование из nil
-                            _ => Ok(ChifValue::Str(format!("{:?}", value))), // Для остальных типов используем Debug
+                            ChifValue::Int(i) => Ok(ChifValue::Str(i.to_string().into())), // Преобразование из int
+                            ChifValue::Float(f) => Ok(ChifValue::Str(f.to_string().into())), // Преобразование из float
+                            ChifValue::Bool(b) => Ok(ChifValue::Str(b.to_string().into())), // Преобразование из bool
+                            ChifValue::Nil => Ok(ChifValue::Str("nil".into())), // Преобразование из nil
+                            _ => Ok(ChifValue::Str(format!("{:?}", value).into())), // Для остальных типов используем Debug
                         }
                     }
                     "randi" => {
@@ -412,8 +1143,8 @@ impl Interpreter {
                                     message: "randi: min cannot be greater than max".to_string(),
                                 });
                             }
-                            let mut rng = rand::thread_rng();
-                            let result = rng.gen_range(min_val..=max_val);
+                            let range = (max_val as u64).wrapping_sub(min_val as u64).wrapping_add(1);
+                            let result = (min_val as u64).wrapping_add(self.rng.below(range)) as i64;
                             Ok(ChifValue::Int(result))
                         } else {
                             Err(ChifError::RuntimeError {
@@ -436,8 +1167,7 @@ impl Interpreter {
                                     message: "randf: min cannot be greater than max".to_string(),
                                 });
                             }
-                            let mut rng = rand::thread_rng();
-                            let result = rng.gen_range(min_val..=max_val);
+                            let result = min_val + self.rng.unit() * (max_val - min_val);
                             Ok(ChifValue::Float(result))
                         } else {
                             Err(ChifError::RuntimeError {
@@ -469,27 +1199,82 @@ impl Interpreter {
                                 });
                             }
                             
-                            let mut rng = rand::thread_rng();
-                            let result_char = rng.gen_range(from_char..=to_char) as char;
-                            Ok(ChifValue::Str(result_char.to_string()))
+                            let range = (to_char - from_char) as u64 + 1;
+                            let result_char = (from_char + self.rng.below(range) as u8) as char;
+                            Ok(ChifValue::Str(result_char.to_string().into()))
                         } else {
                             Err(ChifError::RuntimeError {
                                 message: "rands expects string arguments".to_string(),
                             })
                         }
                     }
-                    "http_get" => {
-                        if call.args.len() != 1 {
+                    "randfill" => {
+                        if call.args.len() != 3 {
                             return Err(ChifError::RuntimeError {
-                                message: "http_get expects 1 argument".to_string(),
+                                message: "randfill expects 3 arguments".to_string(),
                             });
                         }
-                        let url = self.evaluate_expression(&call.args[0])?;
-                        if let ChifValue::Str(url_str) = url {
-                            self.http_get_request(&url_str)
-                        } else {
-                            Err(ChifError::RuntimeError {
-                                message: "http_get expects string URL".to_string(),
+                        let array = self.evaluate_expression(&call.args[0])?;
+                        let min = self.evaluate_expression(&call.args[1])?;
+                        let max = self.evaluate_expression(&call.args[2])?;
+                        if !matches!(array, ChifValue::Array(_)) {
+                            return Err(ChifError::RuntimeError {
+                                message: "randfill expects an array".to_string(),
+                            });
+                        }
+                        
+                        let count = Self::array_leaf_count(&array);
+                        let values: Vec<ChifValue> = match (min, max) {
+                            (ChifValue::Int(min_val), ChifValue::Int(max_val)) if min_val <= max_val => {
+                                self.rng.fill_int(count, min_val, max_val).into_iter().map(ChifValue::Int).collect()
+                            }
+                            (ChifValue::Float(min_val), ChifValue::Float(max_val)) if min_val <= max_val => {
+                                self.rng.fill_float(count, min_val, max_val).into_iter().map(ChifValue::Float).collect()
+                            }
+                            (ChifValue::Int(_), ChifValue::Int(_)) | (ChifValue::Float(_), ChifValue::Float(_)) => {
+                                return Err(ChifError::RuntimeError {
+                                    message: "randfill: min cannot be greater than max".to_string(),
+                                });
+                            }
+                            _ => {
+                                return Err(ChifError::RuntimeError {
+                                    message: "randfill expects two integer or two float bounds".to_string(),
+                                });
+                            }
+                        };
+                        let filled = Self::refill_array(&array, &mut values.into_iter());
+                        self.assign_argument(&call.args[0], filled)?;
+                        Ok(ChifValue::Nil)
+                    }
+                    "randseed" => {
+                        if call.args.len() != 1 {
+                            return Err(ChifError::RuntimeError {
+                                message: "randseed expects 1 argument".to_string(),
+                            });
+                        }
+                        let seed = self.evaluate_expression(&call.args[0])?;
+                        
+                        if let ChifValue::Int(seed_val) = seed {
+                            self.rng = RonoRng::from_seed(seed_val as u64);
+                            Ok(ChifValue::Nil)
+                        } else {
+                            Err(ChifError::RuntimeError {
+                                message: "randseed expects an integer argument".to_string(),
+                            })
+                        }
+                    }
+                    "http_get" => {
+                        if call.args.len() != 1 {
+                            return Err(ChifError::RuntimeError {
+                                message: "http_get expects 1 argument".to_string(),
+                            });
+                        }
+                        let url = self.evaluate_expression(&call.args[0])?;
+                        if let ChifValue::Str(url_str) = url {
+                            self.http_get_request(&url_str)
+                        } else {
+                            Err(ChifError::RuntimeError {
+                                message: "http_get expects string URL".to_string(),
                             })
                         }
                     }
@@ -540,6 +1325,177 @@ impl Interpreter {
                             })
                         }
                     }
+                    "http_get_many" | "http_request_many" => {
+                        // http_get_many(urls, max_concurrency)
+                        // http_request_many(methods, urls, bodies, max_concurrency)
+                        let array_args = if call.name == "http_get_many" { 1 } else { 3 };
+                        if call.args.len() != array_args + 1 {
+                            return Err(ChifError::RuntimeError {
+                                message: format!("{} expects {} arguments", call.name, array_args + 1),
+                            });
+                        }
+                        let mut columns = Vec::new();
+                        for arg in &call.args[..array_args] {
+                            match self.evaluate_expression(arg)? {
+                                ChifValue::Array(items) | ChifValue::List(items) => {
+                                    let strings: Option<Vec<String>> = items.iter().map(|item| match item {
+                                        ChifValue::Str(s) => Some(s.to_string()),
+                                        _ => None,
+                                    }).collect();
+                                    columns.push(strings.ok_or_else(|| ChifError::RuntimeError {
+                                        message: format!("{} expects arrays of strings", call.name),
+                                    })?);
+                                }
+                                _ => return Err(ChifError::RuntimeError {
+                                    message: format!("{} expects arrays of strings", call.name),
+                                }),
+                            }
+                        }
+                        let max_concurrency = match self.evaluate_expression(&call.args[array_args])? {
+                            ChifValue::Int(n) => n,
+                            _ => return Err(ChifError::RuntimeError {
+                                message: format!("{} expects integer max_concurrency", call.name),
+                            }),
+                        };
+                        
+                        let requests: Vec<(String, String, Option<String>)> = if array_args == 1 {
+                            columns.remove(0).into_iter().map(|url| ("GET".to_string(), url, None)).collect()
+                        } else {
+                            if columns[0].len() != columns[1].len() || columns[1].len() != columns[2].len() {
+                                return Err(ChifError::RuntimeError {
+                                    message: "http_request_many expects methods, urls and bodies of equal length".to_string(),
+                                });
+                            }
+                            let bodies = columns.pop().unwrap();
+                            let urls = columns.pop().unwrap();
+                            let methods = columns.pop().unwrap();
+                            methods.into_iter().zip(urls).zip(bodies)
+                                .map(|((method, url), body)| (method, url, if body.is_empty() { None } else { Some(body) }))
+                                .collect()
+                        };
+                        Ok(self.http_request_many(requests, max_concurrency))
+                    }
+                    "http_stream" => {
+                        // http_stream(url, handler): handler(chunk, len) is called per
+                        // chunk and stops the transfer by returning non-zero
+                        if call.args.len() != 2 {
+                            return Err(ChifError::RuntimeError {
+                                message: "http_stream expects 2 arguments".to_string(),
+                            });
+                        }
+                        let url = self.evaluate_expression(&call.args[0])?;
+                        let handler = match &call.args[1] {
+                            Expression::Identifier(name) => self.functions.get(name).cloned(),
+                            _ => None,
+                        };
+                        match (url, handler) {
+                            (ChifValue::Str(url_str), Some(handler)) => self.http_stream_request(&url_str, &handler),
+                            _ => Err(ChifError::RuntimeError {
+                                message: "http_stream expects string URL and a function name".to_string(),
+                            }),
+                        }
+                    }
+                    "http_download" => {
+                        if call.args.len() != 2 {
+                            return Err(ChifError::RuntimeError {
+                                message: "http_download expects 2 arguments".to_string(),
+                            });
+                        }
+                        let url = self.evaluate_expression(&call.args[0])?;
+                        let path = self.evaluate_expression(&call.args[1])?;
+                        if let (ChifValue::Str(url_str), ChifValue::Str(path_str)) = (url, path) {
+                            Ok(ChifValue::Int(self.http_download_request(&url_str, &path_str)))
+                        } else {
+                            Err(ChifError::RuntimeError {
+                                message: "http_download expects string arguments".to_string(),
+                            })
+                        }
+                    }
+                    "http_open" => {
+                        if call.args.len() != 1 {
+                            return Err(ChifError::RuntimeError {
+                                message: "http_open expects 1 argument".to_string(),
+                            });
+                        }
+                        let url = self.evaluate_expression(&call.args[0])?;
+                        if let ChifValue::Str(url_str) = url {
+                            let client = self.http_client();
+                            match client.get(&*url_str).send() {
+                                Ok(response) => {
+                                    let id = self.next_http_stream;
+                                    self.next_http_stream += 1;
+                                    self.http_streams.insert(id, HttpStream { response, chunk: Vec::new() });
+                                    Ok(ChifValue::Int(id))
+                                }
+                                // 0 is never a valid stream, same as a NULL stream in the runtime
+                                Err(_) => Ok(ChifValue::Int(0)),
+                            }
+                        } else {
+                            Err(ChifError::RuntimeError {
+                                message: "http_open expects string URL".to_string(),
+                            })
+                        }
+                    }
+                    "http_next_chunk" | "http_chunk" | "http_stream_status" | "http_close" => {
+                        if call.args.len() != 1 {
+                            return Err(ChifError::RuntimeError {
+                                message: format!("{} expects 1 argument", call.name),
+                            });
+                        }
+                        let id = match self.evaluate_expression(&call.args[0])? {
+                            ChifValue::Int(id) => id,
+                            _ => return Err(ChifError::RuntimeError {
+                                message: format!("{} expects a stream handle", call.name),
+                            }),
+                        };
+                        if call.name == "http_close" {
+                            self.http_streams.remove(&id);
+                            return Ok(ChifValue::Nil);
+                        }
+                        let stream = match self.http_streams.get_mut(&id) {
+                            Some(stream) => stream,
+                            None => return Ok(match call.name.as_str() {
+                                "http_chunk" => ChifValue::Str("".into()),
+                                _ => ChifValue::Int(0),
+                            }),
+                        };
+                        match call.name.as_str() {
+                            "http_next_chunk" => {
+                                use std::io::Read;
+                                stream.chunk.resize(HTTP_CHUNK_SIZE, 0);
+                                let read = stream.response.read(&mut stream.chunk).unwrap_or(0);
+                                stream.chunk.truncate(read);
+                                Ok(ChifValue::Int(read as i64))
+                            }
+                            "http_chunk" => Ok(ChifValue::Str(String::from_utf8_lossy(&stream.chunk).into_owned().into())),
+                            _ => Ok(ChifValue::Int(stream.response.status().as_u16() as i64)),
+                        }
+                    }
+                    "http_configure" => {
+                        if call.args.len() != 2 {
+                            return Err(ChifError::RuntimeError {
+                                message: "http_configure expects 2 arguments".to_string(),
+                            });
+                        }
+                        let pool_size = self.evaluate_expression(&call.args[0])?;
+                        let idle_timeout = self.evaluate_expression(&call.args[1])?;
+                        if let (ChifValue::Int(pool_size), ChifValue::Int(idle_timeout)) = (pool_size, idle_timeout) {
+                            // Values <= 0 keep the current setting, same as rono_http_configure
+                            if pool_size > 0 {
+                                self.http_pool_size = pool_size as usize;
+                            }
+                            if idle_timeout > 0 {
+                                self.http_idle_timeout = idle_timeout as u64;
+                            }
+                            // Rebuilt with the new settings on the next request
+                            self.http_client = None;
+                            Ok(ChifValue::Nil)
+                        } else {
+                            Err(ChifError::RuntimeError {
+                                message: "http_configure expects integer arguments".to_string(),
+                            })
+                        }
+                    }
                     _ => {
                         // Regular function call
                         let mut args = Vec::new();
@@ -591,13 +1547,9 @@ impl Interpreter {
                     
                     // Check if this is a struct method that might mutate self
                     let object = self.get_variable(module_name)?;
-                    if let ChifValue::Struct(struct_name, _) = &object {
-                        if let Some(methods) = self.struct_methods.get(struct_name).cloned() {
-                            for method in &methods {
-                                if method.name == method_call.method {
-                                    return self.call_mutable_struct_method(module_name, &method_call.method, &method_call.args);
-                                }
-                            }
+                    if let ChifValue::Struct(layout, _) = &object {
+                        if self.struct_method(&layout.name, &method_call.method).is_some() {
+                            return self.call_mutable_struct_method(module_name, &method_call.method, &method_call.args);
                         }
                     }
                 }
@@ -606,6 +1558,9 @@ impl Interpreter {
                 self.call_method(&object, &method_call.method, &method_call.args)
             }
             Expression::Index(index_access) => {
+                if let Some(element) = self.index_shared(index_access)? {
+                    return Ok(element);
+                }
                 let object = self.evaluate_expression(&index_access.object)?;
                 let mut current = object;
                 
@@ -627,7 +1582,7 @@ impl Interpreter {
                 }
                 // Check if this should be a list or array based on context
                 // For now, we'll create arrays by default
-                Ok(ChifValue::Array(values))
+                Ok(ChifValue::Array(values.into()))
             }
             Expression::MapLiteral(pairs) => {
                 let mut map = HashMap::new();
@@ -636,22 +1591,35 @@ impl Interpreter {
                     let value = self.evaluate_expression(value_expr)?;
                     
                     if let ChifValue::Str(key_str) = key {
-                        map.insert(key_str, value);
+                        map.insert(key_str.to_string(), value);
                     } else {
                         return Err(ChifError::RuntimeError {
                             message: "Map keys must be strings".to_string(),
                         });
                     }
                 }
-                Ok(ChifValue::Map(map))
+                Ok(ChifValue::Map(map.into()))
             }
             Expression::StructLiteral(struct_literal) => {
-                let mut fields = HashMap::new();
+                let layout = self.struct_layout(struct_literal);
+                // Fields the literal leaves out are nil
+                let mut fields = vec![ChifValue::Nil; layout.fields.len()];
                 for (field_name, field_expr) in &struct_literal.fields {
                     let field_value = self.evaluate_expression(field_expr)?;
-                    fields.insert(field_name.clone(), field_value);
+                    match layout.field_index(field_name) {
+                        Some(index) => fields[index] = field_value,
+                        None => {
+                            return Err(ChifError::RuntimeError {
+                                message: format!("Field '{}' not found in struct '{}'", field_name, layout.name),
+                            });
+                        }
+                    }
                 }
-                Ok(ChifValue::Struct(struct_literal.struct_name.clone(), fields))
+                Ok(ChifValue::Struct(layout, fields.into()))
+            }
+            Expression::Template(template) => {
+                let rendered = self.render_template(&template.parts, template.source.len());
+                Ok(ChifValue::Str(rendered.into()))
             }
             Expression::Reference(expr) => {
                 // Create a reference to a variable
@@ -728,6 +1696,7 @@ impl Interpreter {
                     }),
                 }
             }
+            ChifValue::Map(map) if method_name == "len" => Ok(ChifValue::Int(map.len() as i64)),
             ChifValue::Str(s) => {
                 match method_name {
                     "len" => Ok(ChifValue::Int(s.len() as i64)),
@@ -736,23 +1705,48 @@ impl Interpreter {
                     }),
                 }
             }
-            ChifValue::Struct(struct_name, _) if struct_name == "Console" => {
+            ChifValue::Struct(layout, _) if layout.name == "Console" => {
                 // Handle console methods
                 if method_name == "out" && args.len() == 1 {
                     let arg = self.evaluate_expression(&args[0])?;
-                    let output = self.format_output(&arg)?;
-                    println!("{}", output);
+                    // A template is rendered already, "{{" in it must stay a brace
+                    let output = match (&args[0], &arg) {
+                        (Expression::Template(_), ChifValue::Str(s)) => s.to_string(),
+                        _ => self.format_output(&arg)?,
+                    };
+                    self.write_line(&output);
+                    Ok(ChifValue::Nil)
+                } else if method_name == "flush" && args.is_empty() {
+                    self.flush_output();
                     Ok(ChifValue::Nil)
+                } else if method_name == "buffer" && args.len() == 2 {
+                    // con.buffer(size, line_flush): line_flush < 0 means only on a TTY
+                    let size = self.evaluate_expression(&args[0])?;
+                    let line_flush = self.evaluate_expression(&args[1])?;
+                    if let (ChifValue::Int(size), ChifValue::Int(line_flush)) = (size, line_flush) {
+                        self.flush_output();
+                        if size >= 0 {
+                            self.out = io::BufWriter::with_capacity(size as usize, io::stdout());
+                        }
+                        self.out_line_flush = if line_flush < 0 { io::stdout().is_terminal() } else { line_flush > 0 };
+                        Ok(ChifValue::Nil)
+                    } else {
+                        Err(ChifError::RuntimeError {
+                            message: "con.buffer expects integer arguments".to_string(),
+                        })
+                    }
                 } else if method_name == "in" && args.len() == 1 {
                     // Handle console input with pointer
                     if let Expression::Dereference(ref inner) = &args[0] {
                         if let Expression::Identifier(var_name) = &**inner {
+                            // Make a pending prompt visible before blocking on input
+                            self.flush_output();
                             let mut input = String::new();
                             io::stdin().read_line(&mut input).unwrap();
                             let input = input.trim().to_string();
                             
                             // Update the variable
-                            self.set_variable(var_name, ChifValue::Str(input))?;
+                            self.set_variable(var_name, ChifValue::Str(input.into()))?;
                             Ok(ChifValue::Nil)
                         } else {
                             Err(ChifError::RuntimeError {
@@ -770,7 +1764,8 @@ impl Interpreter {
                     })
                 }
             }
-            ChifValue::Struct(struct_name, _) => {
+            ChifValue::Struct(layout, _) => {
+                let struct_name = &layout.name;
                 // Проверяем, является ли вызов метода на переменной
                 if let Expression::MethodCall(method_call) = args[0].clone() {
                     if let Expression::Identifier(var_name) = *method_call.object {
@@ -780,17 +1775,12 @@ impl Interpreter {
                 }
                 
                 // Handle struct methods
-                let methods = self.struct_methods.get(struct_name).cloned();
-                if let Some(methods) = methods {
-                    for method in methods {
-                        if method.name == method_name {
-                            let mut method_args = vec![object.clone()]; // self parameter
-                            for arg_expr in args {
-                                method_args.push(self.evaluate_expression(arg_expr)?);
-                            }
-                            return self.call_function(&method, method_args);
-                        }
+                if let Some(method) = self.struct_method(struct_name, method_name) {
+                    let mut method_args = vec![object.clone()]; // self parameter
+                    for arg_expr in args {
+                        method_args.push(self.evaluate_expression(arg_expr)?);
                     }
+                    return self.call_function(&method, method_args);
                 }
                 Err(ChifError::RuntimeError {
                     message: format!("Unknown method '{}' for struct '{}'", method_name, struct_name),
@@ -814,167 +1804,46 @@ impl Interpreter {
         }
     }
     
-    fn interpolate_string(&mut self, s: &str) -> Result<String> {
-        let mut result = String::new();
-        let mut chars = s.chars().peekable();
-        
-        while let Some(ch) = chars.next() {
-            if ch == '{' {
-                // Check if this is an escaped brace
-                if chars.peek() == Some(&'{') {
-                    chars.next(); // consume second '{'
-                    result.push('{');
-                    continue;
-                }
-                
-                // Parse variable name
-                let mut var_name = String::new();
-                let mut found_closing = false;
-                
-                while let Some(ch) = chars.next() {
-                    if ch == '}' {
-                        found_closing = true;
-                        break;
-                    }
-                    var_name.push(ch);
-                }
-                
-                if !found_closing {
-                    return Err(ChifError::RuntimeError {
-                        message: "Unclosed interpolation bracket '{'".to_string(),
-                    });
-                }
-                
-                if var_name.is_empty() {
-                    result.push_str("{}");
-                } else {
-                    // Evaluate the complex expression
-                    match self.evaluate_interpolation_expression(&var_name) {
-                        Ok(value) => {
-                            result.push_str(&value.to_string());
-                        }
-                        Err(_) => {
-                            // If expression evaluation failed, keep the placeholder
-                            result.push_str(&format!("{{{}}}", var_name));
-                        }
-                    }
-                }
-            } else if ch == '}' && chars.peek() == Some(&'}') {
-                // Escaped closing brace
-                chars.next(); // consume second '}'
-                result.push('}');
-            } else {
-                result.push(ch);
-            }
+    // Interpolates a string built at run time; literals are split into
+    // templates by the parser and go straight to render_template
+    pub(crate) fn interpolate_string(&mut self, s: &str) -> Result<String> {
+        if !s.contains(['{', '}']) {
+            return Ok(s.to_string());
+        }
+        match Parser::parse_template(s) {
+            Some(parts) => Ok(self.render_template(&parts, s.len())),
+            None => Err(ChifError::RuntimeError {
+                message: "Unclosed interpolation bracket '{'".to_string(),
+            }),
         }
-        
-        Ok(result)
     }
     
-    // New helper method to evaluate complex interpolation expressions
-    fn evaluate_interpolation_expression(&mut self, expr: &str) -> Result<ChifValue> {
-        // Handle method calls like names.len()
-        if expr.contains('.') && expr.ends_with("()") {
-            let method_call = &expr[..expr.len()-2]; // Remove ()
-            let parts: Vec<&str> = method_call.split('.').collect();
-            if parts.len() == 2 {
-                let obj = self.get_variable(parts[0])?;
-                return self.call_method(&obj, parts[1], &[]);
-            }
-            return Err(ChifError::RuntimeError {
-                message: format!("Invalid method call expression: {}", expr),
-            });
-        }
+    fn render_template(&mut self, parts: &[TemplatePart], size_hint: usize) -> String {
+        use std::fmt::Write;
         
-        // Handle combined indexing and field access like users[0].name
-        if expr.contains('[') && expr.contains(']') && expr.contains('.') {
-            // First, get the base variable
-            let base_end = expr.find('[').unwrap_or(expr.len());
-            let base_name = &expr[..base_end];
-            let mut current_value = self.get_variable(base_name)?;
-            
-            // Parse the rest of the expression
-            let mut pos = base_end;
-            let chars: Vec<char> = expr.chars().collect();
-            
-            while pos < chars.len() {
-                if chars[pos] == '[' {
-                    // Handle array indexing
-                    let start_idx = pos + 1;
-                    let mut end_idx = start_idx;
-                    while end_idx < chars.len() && chars[end_idx] != ']' {
-                        end_idx += 1;
-                    }
-                    
-                    if end_idx >= chars.len() {
-                        return Err(ChifError::RuntimeError {
-                            message: format!("Unclosed bracket in expression: {}", expr),
-                        });
+        let mut result = String::with_capacity(size_hint);
+        for part in parts {
+            match part {
+                TemplatePart::Literal(text) => result.push_str(text),
+                TemplatePart::Hole { expr, text } => match self.evaluate_expression(expr) {
+                    Ok(ChifValue::Str(value)) => result.push_str(&value),
+                    Ok(value) => {
+                        let _ = write!(result, "{}", value);
                     }
-                    
-                    let index_str = &expr[start_idx..end_idx];
-                    let index = index_str.parse::<i64>().map_err(|_| ChifError::RuntimeError {
-                        message: format!("Invalid array index: {}", index_str),
-                    })?;
-                    
-                    current_value = self.get_index(&current_value, &ChifValue::Int(index))?;
-                    pos = end_idx + 1;
-                } else if chars[pos] == '.' {
-                    // Handle field access
-                    let start_field = pos + 1;
-                    let mut end_field = start_field;
-                    while end_field < chars.len() && chars[end_field] != '.' && chars[end_field] != '[' {
-                        end_field += 1;
+                    // If expression evaluation failed, keep the placeholder
+                    Err(_) => {
+                        result.push('{');
+                        result.push_str(text);
+                        result.push('}');
                     }
-                    
-                    let field_name = &expr[start_field..end_field];
-                    current_value = self.get_field(&current_value, field_name)?;
-                    pos = end_field;
-                } else {
-                    pos += 1;
-                }
-            }
-            
-            return Ok(current_value);
-        }
-        
-        // Handle simple field access like person.name
-        if expr.contains('.') {
-            let parts: Vec<&str> = expr.split('.').collect();
-            if parts.len() >= 2 {
-                let mut obj = self.get_variable(parts[0])?;
-                
-                // Navigate through the chain of fields
-                for field_name in &parts[1..] {
-                    obj = self.get_field(&obj, field_name)?;
-                }
-                
-                return Ok(obj);
+                },
+                TemplatePart::Positional => result.push_str("{}"),
             }
         }
-        
-        // Handle simple indexing like numbers[0]
-        if expr.contains('[') && expr.contains(']') {
-            if let Some(bracket_pos) = expr.find('[') {
-                let var_part = &expr[..bracket_pos];
-                let index_part = &expr[bracket_pos+1..];
-                if let Some(close_pos) = index_part.find(']') {
-                    let index_str = &index_part[..close_pos];
-                    let index = index_str.parse::<i64>().map_err(|_| ChifError::RuntimeError {
-                        message: format!("Invalid array index: {}", index_str),
-                    })?;
-                    
-                    let obj = self.get_variable(var_part)?;
-                    return self.get_index(&obj, &ChifValue::Int(index));
-                }
-            }
-        }
-        
-        // Simple variable lookup
-        self.get_variable(expr)
+        result
     }
     
-    fn apply_binary_op(&self, op: &BinaryOperator, left: &ChifValue, right: &ChifValue) -> Result<ChifValue> {
+    pub(crate) fn apply_binary_op(&self, op: &BinaryOperator, left: &ChifValue, right: &ChifValue) -> Result<ChifValue> {
         match (left, right) {
             (ChifValue::Int(l), ChifValue::Int(r)) => {
                 match op {
@@ -1021,7 +1890,7 @@ impl Interpreter {
             }
             (ChifValue::Str(l), ChifValue::Str(r)) => {
                 match op {
-                    BinaryOperator::Add => Ok(ChifValue::Str(format!("{}{}", l, r))),
+                    BinaryOperator::Add => Ok(ChifValue::Str(format!("{}{}", l, r).into())),
                     BinaryOperator::Equal => Ok(ChifValue::Bool(l == r)),
                     BinaryOperator::NotEqual => Ok(ChifValue::Bool(l != r)),
                     BinaryOperator::Less => Ok(ChifValue::Bool(l < r)),
@@ -1050,7 +1919,7 @@ impl Interpreter {
         }
     }
     
-    fn apply_unary_op(&self, op: &UnaryOperator, operand: &ChifValue) -> Result<ChifValue> {
+    pub(crate) fn apply_unary_op(&self, op: &UnaryOperator, operand: &ChifValue) -> Result<ChifValue> {
         match (op, operand) {
             (UnaryOperator::Not, ChifValue::Bool(b)) => Ok(ChifValue::Bool(!b)),
             (UnaryOperator::Minus, ChifValue::Int(i)) => Ok(ChifValue::Int(-i)),
@@ -1061,34 +1930,148 @@ impl Interpreter {
         }
     }
     
-    fn get_variable(&self, name: &str) -> Result<ChifValue> {
-        // Check locals first (from innermost to outermost)
-        for scope in self.locals.iter().rev() {
-            if let Some(value) = scope.get(name) {
-                return Ok(value.clone());
+    pub(crate) fn get_variable(&self, name: &str) -> Result<ChifValue> {
+        match self.lookup_variable(name) {
+            Some(value) => Ok(value.clone()),
+            None => Err(ChifError::VariableNotFound {
+                name: name.to_string(),
+            }),
+        }
+    }
+    
+    fn lookup_variable(&self, name: &str) -> Option<&ChifValue> {
+        // Check locals first (from innermost to outermost frame), then what
+        // a par for worker shares with the loop's frame, then globals
+        for frame in self.locals.iter().rev() {
+            if let Some(value) = frame.get(name) {
+                return Some(value);
             }
         }
-        
-        // Check globals
-        if let Some(value) = self.globals.get(name) {
-            Ok(value.clone())
-        } else {
-            Err(ChifError::VariableNotFound {
-                name: name.to_string(),
-            })
+        if let Some(value) = self.shared.as_ref().and_then(|shared| shared.get(name, &self.struct_layouts)) {
+            return Some(value);
+        }
+        self.globals.get(name)
+    }
+    
+    // The variable's storage where get_variable would find it, for in-place updates
+    fn variable_mut(&mut self, name: &str) -> Option<&mut ChifValue> {
+        // A worker updates its own copy of a shared variable, in the frame
+        // that held it in the parent
+        if self.shared.is_some() && self.locals.iter().all(|frame| frame.get(name).is_none()) {
+            let value = self.shared.as_ref().and_then(|shared| shared.get(name, &self.struct_layouts)).cloned();
+            if let (Some(value), Some(frame)) = (value, self.locals.first_mut()) {
+                frame.set(name, value);
+            }
+        }
+        for frame in self.locals.iter_mut().rev() {
+            if let Some(value) = frame.get_mut(name) {
+                return Some(value);
+            }
         }
+        self.globals.get_mut(name)
     }
     
     fn set_variable(&mut self, name: &str, value: ChifValue) -> Result<()> {
-        if let Some(scope) = self.locals.last_mut() {
-            scope.insert(name.to_string(), value);
+        if let Some(frame) = self.locals.last_mut() {
+            frame.set(name, value);
         } else {
             self.globals.insert(name.to_string(), value);
         }
         Ok(())
     }
     
-    fn get_index(&self, object: &ChifValue, index: &ChifValue) -> Result<ChifValue> {
+    // Stores value into the variable passed as a call argument, for
+    // builtins that update their argument (randfill)
+    fn assign_argument(&mut self, argument: &Expression, value: ChifValue) -> Result<()> {
+        let name = match argument {
+            Expression::Local(local) if self.locals.last().map_or(false, |frame| frame.slots[local.slot].is_some()) => {
+                self.set_local(local.slot, value);
+                return Ok(());
+            }
+            Expression::Local(local) => &local.name,
+            Expression::Identifier(name) => name,
+            _ => {
+                return Err(ChifError::RuntimeError {
+                    message: "Expected a variable".to_string(),
+                });
+            }
+        };
+        match self.variable_mut(name) {
+            Some(slot) => {
+                *slot = value;
+                Ok(())
+            }
+            None => Err(ChifError::VariableNotFound { name: name.clone() }),
+        }
+    }
+    
+    // Elements of an array that aren't arrays themselves, over all dimensions
+    fn array_leaf_count(value: &ChifValue) -> usize {
+        match value {
+            ChifValue::Array(elements) => elements.iter().map(Self::array_leaf_count).sum(),
+            _ => 1,
+        }
+    }
+    
+    // An array of the same shape with the leaves taken from values in
+    // row-major order
+    fn refill_array(value: &ChifValue, values: &mut impl Iterator<Item = ChifValue>) -> ChifValue {
+        match value {
+            ChifValue::Array(elements) => {
+                ChifValue::Array(Rc::new(elements.iter().map(|element| Self::refill_array(element, values)).collect()))
+            }
+            _ => values.next().unwrap_or(ChifValue::Nil),
+        }
+    }
+    
+    // xs[i] in a par for worker on a variable it reads from the snapshot:
+    // the element is copied, not the whole collection. None when the
+    // object is anything else.
+    fn index_shared(&mut self, index_access: &IndexAccess) -> Result<Option<ChifValue>> {
+        if self.shared.is_none() {
+            return Ok(None);
+        }
+        let name = match &*index_access.object {
+            Expression::Local(local) => &local.name,
+            Expression::Identifier(name) => name,
+            _ => return Ok(None),
+        };
+        let visible = self.locals.iter().any(|frame| frame.get(name).is_some()) || self.globals.contains_key(name);
+        if visible || self.shared.as_ref().and_then(|shared| shared.frozen(name)).is_none() {
+            return Ok(None);
+        }
+        let indices = index_access.indices.iter()
+            .map(|index_expr| self.evaluate_expression(index_expr))
+            .collect::<Result<Vec<_>>>()?;
+        
+        let mut indices = indices.iter();
+        let mut value = match self.shared.as_ref().and_then(|shared| shared.frozen(name)) {
+            Some(mut current) => loop {
+                match indices.next() {
+                    Some(index) => match current.element(index) {
+                        Some(element) => current = element,
+                        // Whatever get_index reports for it
+                        None => break self.get_index(&current.thaw(&self.struct_layouts), index)?,
+                    },
+                    None => break current.thaw(&self.struct_layouts),
+                }
+            },
+            // An index expression has read the whole variable meanwhile
+            None => self.get_variable(name)?,
+        };
+        for index in indices {
+            value = self.get_index(&value, index)?;
+        }
+        Ok(Some(value))
+    }
+    
+    fn set_local(&mut self, slot: usize, value: ChifValue) {
+        if let Some(frame) = self.locals.last_mut() {
+            frame.slots[slot] = Some(value);
+        }
+    }
+    
+    pub(crate) fn get_index(&self, object: &ChifValue, index: &ChifValue) -> Result<ChifValue> {
         match (object, index) {
             (ChifValue::Array(arr), ChifValue::Int(i)) => {
                 let idx = *i as usize;
@@ -1107,7 +2090,7 @@ impl Interpreter {
                 }
             }
             (ChifValue::Map(map), ChifValue::Str(key)) => {
-                if let Some(value) = map.get(key) {
+                if let Some(value) = map.get(&**key) {
                     Ok(value.clone())
                 } else {
                     Ok(ChifValue::Nil)
@@ -1119,11 +2102,11 @@ impl Interpreter {
         }
     }
     
-    fn get_field(&self, object: &ChifValue, field: &str) -> Result<ChifValue> {
+    pub(crate) fn get_field(&self, object: &ChifValue, field: &str) -> Result<ChifValue> {
         match object {
-            ChifValue::Struct(_, fields) => {
-                if let Some(value) = fields.get(field) {
-                    Ok(value.clone())
+            ChifValue::Struct(layout, fields) => {
+                if let Some(index) = layout.field_index(field) {
+                    Ok(fields[index].clone())
                 } else {
                     Err(ChifError::RuntimeError {
                         message: format!("Field '{}' not found", field),
@@ -1141,10 +2124,38 @@ impl Interpreter {
         }
     }
     
-    fn assign_to_index(&mut self, _index_access: &IndexAccess, _value: ChifValue) -> Result<()> {
-        // This is a simplified implementation
-        // In a real implementation, we'd need to handle mutable references properly
-        Ok(())
+    fn assign_to_index(&mut self, index_access: &IndexAccess, value: ChifValue) -> Result<()> {
+        let var_name = match (&*index_access.object, index_access.indices.as_slice()) {
+            (Expression::Identifier(var_name), [_]) => var_name,
+            _ => {
+                return Err(ChifError::RuntimeError {
+                    message: "Only a single index of an array, list or map variable can be assigned".to_string(),
+                });
+            }
+        };
+        let index = self.evaluate_expression(&index_access.indices[0])?;
+        
+        // The element is replaced in place; the collection is copied only if it is shared
+        match (self.variable_mut(var_name), index) {
+            (Some(ChifValue::Array(list) | ChifValue::List(list)), ChifValue::Int(i)) => {
+                let idx = i as usize;
+                match Rc::make_mut(list).get_mut(idx) {
+                    Some(slot) => {
+                        *slot = value;
+                        Ok(())
+                    }
+                    None => Err(ChifError::IndexOutOfBounds { index: idx }),
+                }
+            }
+            (Some(ChifValue::Map(map)), ChifValue::Str(key)) => {
+                Rc::make_mut(map).insert(key.to_string(), value);
+                Ok(())
+            }
+            (Some(_), _) => Err(ChifError::RuntimeError {
+                message: "Invalid index assignment".to_string(),
+            }),
+            (None, _) => Err(ChifError::VariableNotFound { name: var_name.clone() }),
+        }
     }
     
     fn assign_to_field(&mut self, field_access: &FieldAccess, value: ChifValue) -> Result<()> {
@@ -1153,20 +2164,24 @@ impl Interpreter {
         
         // Обрабатываем случай, когда объект - это идентификатор
         if let Expression::Identifier(var_name) = object_expr {
-            let mut object = self.get_variable(var_name)?;
+            // Если объект - ссылка (например, self в методе), меняем переменную, на которую она указывает
+            let target = match self.lookup_variable(var_name) {
+                Some(ChifValue::Reference(ref_var_name)) => ref_var_name.clone(),
+                Some(_) => var_name.clone(),
+                None => return Err(ChifError::VariableNotFound { name: var_name.clone() }),
+            };
             
-            if let ChifValue::Struct(struct_name, mut fields) = object {
-                fields.insert(field_access.field.clone(), value);
-                self.set_variable(var_name, ChifValue::Struct(struct_name, fields))?;
-                return Ok(());
-            } else if let ChifValue::Reference(ref_var_name) = object {
-                // Если объект - ссылка, получаем реальный объект
-                let mut ref_object = self.get_variable(&ref_var_name)?;
-                if let ChifValue::Struct(struct_name, mut fields) = ref_object {
-                    fields.insert(field_access.field.clone(), value);
-                    self.set_variable(&ref_var_name, ChifValue::Struct(struct_name, fields))?;
-                    return Ok(());
-                }
+            // Поле меняется на месте; структура копируется, только если она разделяется с другим значением
+            if let Some(ChifValue::Struct(layout, fields)) = self.variable_mut(&target) {
+                return match layout.field_index(&field_access.field) {
+                    Some(index) => {
+                        Rc::make_mut(fields)[index] = value;
+                        Ok(())
+                    }
+                    None => Err(ChifError::RuntimeError {
+                        message: format!("Field '{}' not found", field_access.field),
+                    }),
+                };
             }
         }
         
@@ -1175,7 +2190,7 @@ impl Interpreter {
         })
     }
     
-    fn is_truthy(&self, value: &ChifValue) -> bool {
+    pub(crate) fn is_truthy(&self, value: &ChifValue) -> bool {
         match value {
             ChifValue::Bool(b) => *b,
             ChifValue::Nil => false,
@@ -1187,53 +2202,43 @@ impl Interpreter {
     }
     
     fn process_import(&mut self, import: &ImportStatement) -> Result<()> {
-        use std::fs;
-        use crate::{lexer::Lexer, parser::Parser};
-        
-        // Add .rono extension if not present
-        let file_path = if import.path.ends_with(".rono") {
-            import.path.clone()
-        } else {
-            format!("{}.rono", import.path)
-        };
+        // A module reached again through another import is already loaded
+        let module_name = modules::module_name(import);
+        if self.modules.contains_key(&module_name) {
+            return Ok(());
+        }
         
-        // Read the imported file
-        let source = fs::read_to_string(&file_path).map_err(|_| {
+        let imported_program = modules::load(import).map_err(|e| {
             ChifError::RuntimeError {
-                message: format!("Cannot read file: {}", file_path),
+                message: e.to_string(),
             }
         })?;
         
-        // Parse the imported file
-        let mut lexer = Lexer::new(&source);
-        let tokens = lexer.tokenize()?;
-        let mut parser = Parser::new(tokens);
-        let imported_program = parser.parse()?;
-        
         // Extract functions and structs from imported module
         let mut module_functions = HashMap::new();
         let mut module_structs = HashMap::new();
         
         for item in &imported_program.items {
             match item {
-                Item::Function(func) => {
-                    module_functions.insert(func.name.clone(), func.clone());
+                Item::Function(source) => {
+                    let func = Self::resolved(source);
+                    self.tier_register(source, &func);
+                    let func = Rc::new(func);
+                    self.profile_name(&func, || format!("{}.{}", module_name, source.name));
+                    module_functions.insert(func.name.clone(), Rc::clone(&func));
                     // Also add to global functions for recursive calls
-                    self.functions.insert(func.name.clone(), func.clone());
+                    self.functions.insert(func.name.clone(), func);
                 }
                 Item::Struct(struct_def) => {
                     module_structs.insert(struct_def.name.clone(), struct_def.clone());
                     // Also add to global structs so they can be used
-                    self.structs.insert(struct_def.name.clone(), struct_def.clone());
+                    self.register_struct(struct_def);
                 }
                 Item::StructImpl(impl_block) => {
                     // Add struct methods to global struct_methods
-                    self.struct_methods
-                        .entry(impl_block.struct_name.clone())
-                        .or_insert_with(Vec::new)
-                        .extend(impl_block.methods.clone());
+                    self.register_methods(impl_block);
                 }
-                _ => {} // Ignore nested imports for now
+                Item::Import(_) => {} // Loaded below, once this module is registered
             }
         }
         
@@ -1243,132 +2248,239 @@ impl Interpreter {
         };
         
         // Store module with alias or filename
-        let module_name = import.alias.clone().unwrap_or_else(|| {
-            // Extract filename without extension
-            std::path::Path::new(&import.path)
-                .file_stem()
-                .unwrap()
-                .to_string_lossy()
-                .to_string()
-        });
-        
         self.modules.insert(module_name, module);
+        
+        for item in &imported_program.items {
+            if let Item::Import(nested) = item {
+                self.process_import(nested)?;
+            }
+        }
         Ok(())
     }
     
-    fn http_get_request(&self, url: &str) -> Result<ChifValue> {
-        use reqwest::blocking::Client;
-        use std::collections::HashMap;
+    fn output_buffer_size() -> usize {
+        std::env::var("RONO_OUTPUT_BUFFER")
+            .ok()
+            .and_then(|value| value.parse().ok())
+            .unwrap_or(OUTPUT_DEFAULT_BUFFER)
+    }
+    
+    // Buffered con.out; write errors (e.g. closed pipe) are ignored like in the runtime.
+    // Only whole lines reach stdout, so lines of par for workers never interleave.
+    pub(crate) fn write_line(&mut self, text: &str) {
+        #[cfg(test)]
+        if let Some(captured) = &mut self.captured {
+            captured.push_str(text);
+            captured.push('\n');
+            return;
+        }
+        let needed = text.len() + 1;
+        if needed > self.out.capacity() - self.out.buffer().len() {
+            let _ = self.out.flush();
+        }
+        if needed > self.out.capacity() {
+            let mut stdout = io::stdout().lock();
+            let _ = stdout.write_all(text.as_bytes()).and_then(|_| stdout.write_all(b"\n"));
+        } else {
+            let _ = self.out.write_all(text.as_bytes());
+            let _ = self.out.write_all(b"\n");
+        }
+        if self.out_line_flush {
+            let _ = self.out.flush();
+        }
+    }
+    
+    pub(crate) fn flush_output(&mut self) {
+        let _ = self.out.flush();
+    }
+    
+    #[cfg(test)]
+    pub(crate) fn capture_output(&mut self) {
+        self.captured = Some(String::new());
+    }
+    
+    #[cfg(test)]
+    pub(crate) fn captured_output(&self) -> &str {
+        self.captured.as_deref().unwrap_or("")
+    }
+    
+    // Shared client so keep-alive connections, DNS and TLS sessions are reused
+    // across requests instead of being rebuilt for every call
+    fn http_client(&mut self) -> reqwest::blocking::Client {
+        if self.http_client.is_none() {
+            let client = reqwest::blocking::Client::builder()
+                .pool_max_idle_per_host(self.http_pool_size)
+                .pool_idle_timeout(std::time::Duration::from_secs(self.http_idle_timeout))
+                .tcp_keepalive(std::time::Duration::from_secs(self.http_idle_timeout))
+                .build()
+                .unwrap_or_else(|_| reqwest::blocking::Client::new());
+            self.http_client = Some(client);
+        }
+        self.http_client.clone().unwrap()
+    }
+    
+    // Send every request on a bounded set of worker threads sharing one client.
+    // Results keep the order of the input; max_concurrency <= 0 means no cap.
+    fn http_request_many(&mut self, requests: Vec<(String, String, Option<String>)>, max_concurrency: i64) -> ChifValue {
+        use std::sync::atomic::{AtomicUsize, Ordering};
+        use std::sync::Mutex;
+        
+        let client = self.http_client();
+        let count = requests.len();
+        let workers = if max_concurrency <= 0 { count } else { (max_concurrency as usize).min(count) };
+        let next = AtomicUsize::new(0);
+        // Workers collect plain (status, body, content_type) tuples; values are
+        // reference-counted and stay on this thread
+        let results: Mutex<Vec<(i64, String, String)>> = Mutex::new(vec![(0, String::new(), String::new()); count]);
+        
+        std::thread::scope(|scope| {
+            for _ in 0..workers {
+                scope.spawn(|| loop {
+                    let index = next.fetch_add(1, Ordering::Relaxed);
+                    if index >= count {
+                        break;
+                    }
+                    let (method, url, body) = &requests[index];
+                    let method = reqwest::Method::from_bytes(method.to_uppercase().as_bytes())
+                        .unwrap_or(reqwest::Method::GET);
+                    let mut request = client.request(method, url.as_str());
+                    if let Some(body) = body {
+                        request = request.body(body.clone()).header("Content-Type", "application/json");
+                    }
+                    
+                    let result = match request.send() {
+                        Ok(response) => {
+                            let status = response.status().as_u16() as i64;
+                            let content_type = response.headers().get("content-type")
+                                .and_then(|value| value.to_str().ok())
+                                .unwrap_or("text/plain")
+                                .to_string();
+                            let body = response.text().unwrap_or_else(|_| "Error reading response".to_string());
+                            (status, body, content_type)
+                        }
+                        Err(e) => (0, format!("Request failed: {}", e), "text/plain".to_string()),
+                    };
+                    results.lock().unwrap()[index] = result;
+                });
+            }
+        });
+        
+        let responses = results.into_inner().unwrap().into_iter()
+            .map(|(status, body, content_type)| self.http_response(status, body, &content_type))
+            .collect::<Vec<_>>();
+        ChifValue::Array(responses.into())
+    }
+    
+    fn http_response(&self, status: i64, body: String, content_type: &str) -> ChifValue {
+        let fields = vec![ChifValue::Int(status), ChifValue::Str(body.into()), ChifValue::Str(content_type.into())];
+        ChifValue::Struct(Rc::clone(&self.http_response_layout), fields.into())
+    }
+    
+    // GET url and hand the body to handler chunk by chunk; returns the status
+    fn http_stream_request(&mut self, url: &str, handler: &Function) -> Result<ChifValue> {
+        use std::io::Read;
+        
+        let client = self.http_client();
+        let mut response = match client.get(url).send() {
+            Ok(response) => response,
+            Err(_) => return Ok(ChifValue::Int(0)),
+        };
+        let status = response.status().as_u16() as i64;
+        
+        let mut buffer = vec![0u8; HTTP_CHUNK_SIZE];
+        loop {
+            let read = match response.read(&mut buffer) {
+                Ok(0) | Err(_) => break,
+                Ok(read) => read,
+            };
+            let chunk = String::from_utf8_lossy(&buffer[..read]).into_owned();
+            let result = self.call_function(handler, vec![ChifValue::Str(chunk.into()), ChifValue::Int(read as i64)])?;
+            if !matches!(result, ChifValue::Int(0) | ChifValue::Nil) {
+                break;
+            }
+        }
         
-        let client = Client::new();
+        Ok(ChifValue::Int(status))
+    }
+    
+    // Stream the body of url into the file at path; bytes written or -1
+    fn http_download_request(&mut self, url: &str, path: &str) -> i64 {
+        let client = self.http_client();
+        let mut response = match client.get(url).send() {
+            Ok(response) => response,
+            Err(_) => return -1,
+        };
+        let mut file = match std::fs::File::create(path) {
+            Ok(file) => file,
+            Err(_) => return -1,
+        };
+        match std::io::copy(&mut response, &mut file) {
+            Ok(written) => written as i64,
+            Err(_) => -1,
+        }
+    }
+    
+    fn http_get_request(&mut self, url: &str) -> Result<ChifValue> {
+        let client = self.http_client();
         match client.get(url).send() {
             Ok(response) => {
                 let status = response.status().as_u16() as i64;
                 let body = response.text().unwrap_or_else(|_| "Error reading response".to_string());
                 
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(status));
-                fields.insert("body".to_string(), ChifValue::Str(body));
-                fields.insert("content_type".to_string(), ChifValue::Str("application/json".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(status, body, "application/json"))
             }
             Err(e) => {
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(0));
-                fields.insert("body".to_string(), ChifValue::Str(format!("Request failed: {}", e)));
-                fields.insert("content_type".to_string(), ChifValue::Str("text/plain".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(0, format!("Request failed: {}", e), "text/plain"))
             }
         }
     }
     
-    fn http_post_request(&self, url: &str, body: &str) -> Result<ChifValue> {
-        use reqwest::blocking::Client;
-        use std::collections::HashMap;
-        
-        let client = Client::new();
+    fn http_post_request(&mut self, url: &str, body: &str) -> Result<ChifValue> {
+        let client = self.http_client();
         match client.post(url).body(body.to_string()).header("Content-Type", "application/json").send() {
             Ok(response) => {
                 let status = response.status().as_u16() as i64;
                 let response_body = response.text().unwrap_or_else(|_| "Error reading response".to_string());
                 
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(status));
-                fields.insert("body".to_string(), ChifValue::Str(response_body));
-                fields.insert("content_type".to_string(), ChifValue::Str("application/json".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(status, response_body, "application/json"))
             }
             Err(e) => {
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(0));
-                fields.insert("body".to_string(), ChifValue::Str(format!("Request failed: {}", e)));
-                fields.insert("content_type".to_string(), ChifValue::Str("text/plain".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(0, format!("Request failed: {}", e), "text/plain"))
             }
         }
     }
     
-    fn http_put_request(&self, url: &str, body: &str) -> Result<ChifValue> {
-        use reqwest::blocking::Client;
-        use std::collections::HashMap;
-        
-        let client = Client::new();
+    fn http_put_request(&mut self, url: &str, body: &str) -> Result<ChifValue> {
+        let client = self.http_client();
         match client.put(url).body(body.to_string()).header("Content-Type", "application/json").send() {
             Ok(response) => {
                 let status = response.status().as_u16() as i64;
                 let response_body = response.text().unwrap_or_else(|_| "Error reading response".to_string());
                 
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(status));
-                fields.insert("body".to_string(), ChifValue::Str(response_body));
-                fields.insert("content_type".to_string(), ChifValue::Str("application/json".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(status, response_body, "application/json"))
             }
             Err(e) => {
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(0));
-                fields.insert("body".to_string(), ChifValue::Str(format!("Request failed: {}", e)));
-                fields.insert("content_type".to_string(), ChifValue::Str("text/plain".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(0, format!("Request failed: {}", e), "text/plain"))
             }
         }
     }
     
-    fn http_delete_request(&self, url: &str) -> Result<ChifValue> {
-        use reqwest::blocking::Client;
-        use std::collections::HashMap;
-        
-        let client = Client::new();
+    fn http_delete_request(&mut self, url: &str) -> Result<ChifValue> {
+        let client = self.http_client();
         match client.delete(url).send() {
             Ok(response) => {
                 let status = response.status().as_u16() as i64;
                 let response_body = response.text().unwrap_or_else(|_| "Error reading response".to_string());
                 
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(status));
-                fields.insert("body".to_string(), ChifValue::Str(response_body));
-                fields.insert("content_type".to_string(), ChifValue::Str("text/plain".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(status, response_body, "text/plain"))
             }
             Err(e) => {
-                let mut fields = HashMap::new();
-                fields.insert("status".to_string(), ChifValue::Int(0));
-                fields.insert("body".to_string(), ChifValue::Str(format!("Request failed: {}", e)));
-                fields.insert("content_type".to_string(), ChifValue::Str("text/plain".to_string()));
-                
-                Ok(ChifValue::Struct("HttpResponse".to_string(), fields))
+                Ok(self.http_response(0, format!("Request failed: {}", e), "text/plain"))
             }
         }
     }
     
-    fn values_equal(&self, left: &ChifValue, right: &ChifValue) -> bool {
+    pub(crate) fn values_equal(&self, left: &ChifValue, right: &ChifValue) -> bool {
         match (left, right) {
             (ChifValue::Int(l), ChifValue::Int(r)) => l == r,
             (ChifValue::Float(l), ChifValue::Float(r)) => (l - r).abs() < f64::EPSILON,
@@ -1380,6 +2492,13 @@ impl Interpreter {
     }
     
     fn call_function_with_references(&mut self, func: &Function, args: Vec<ChifValue>, arg_exprs: &[Expression]) -> Result<ChifValue> {
+        if self.profiler.is_some() {
+            return self.profiled_call(func, |interpreter| interpreter.run_function_with_references(func, args, arg_exprs));
+        }
+        self.run_function_with_references(func, args, arg_exprs)
+    }
+    
+    fn run_function_with_references(&mut self, func: &Function, args: Vec<ChifValue>, arg_exprs: &[Expression]) -> Result<ChifValue> {
         if args.len() != func.params.len() {
             return Err(ChifError::RuntimeError {
                 message: format!(
@@ -1401,23 +2520,15 @@ impl Interpreter {
             }
         }
         
-        // Create new scope
-        let mut scope = HashMap::new();
-        
-        // Bind parameters
-        for (param, arg) in func.params.iter().zip(args.iter()) {
-            scope.insert(param.name.clone(), arg.clone());
-        }
-        
-        self.locals.push(scope);
+        self.enter_call(func, args);
         
         let result = self.execute_block(&func.body);
         
         // Update referenced variables after function execution
-        let updates: Vec<(String, ChifValue)> = if let Some(local_scope) = self.locals.last() {
+        let updates: Vec<(String, ChifValue)> = if let Some(frame) = self.locals.last() {
             var_refs.iter().filter_map(|(param_idx, var_name)| {
                 func.params.get(*param_idx).and_then(|param| {
-                    local_scope.get(&param.name).map(|updated_value| {
+                    frame.get(&param.name).map(|updated_value| {
                         (var_name.clone(), updated_value.clone())
                     })
                 })
@@ -1426,47 +2537,36 @@ impl Interpreter {
             Vec::new()
         };
         
-        self.locals.pop();
+        self.leave_frame();
         
         // Apply updates after popping the scope
         for (var_name, updated_value) in updates {
             self.set_variable(&var_name, updated_value)?;
         }
         
-        match result {
-            Ok(_) => Ok(ChifValue::Nil),
-            Err(ChifError::Return(value)) => Ok(value),
-            Err(e) => Err(e),
-        }
+        Self::call_result(result?)
     }
     
     fn call_mutable_struct_method(&mut self, var_name: &str, method_name: &str, args: &[Expression]) -> Result<ChifValue> {
         // Получаем объект
         let object = self.get_variable(var_name)?;
         
-        if let ChifValue::Struct(struct_name, _) = &object {
-            let struct_name = struct_name.clone();
-            let methods = self.struct_methods.get(&struct_name).cloned();
-            
-            if let Some(methods) = methods {
-                for method in methods {
-                    if method.name == method_name {
-                        // Создаем аргументы для вызова функции
-                        let mut method_args = Vec::new();
-                        
-                        // Передаем первый аргумент (self) как ссылку
-                        method_args.push(ChifValue::Reference(var_name.to_string()));
-                        
-                        // Добавляем остальные аргументы
-                        for arg_expr in args {
-                            method_args.push(self.evaluate_expression(arg_expr)?);
-                        }
-                        
-                        // Вызываем функцию
-                        let result = self.call_function(&method, method_args)?;
-                        return Ok(result);
-                    }
+        if let ChifValue::Struct(layout, _) = &object {
+            if let Some(method) = self.struct_method(&layout.name, method_name) {
+                // Создаем аргументы для вызова функции
+                let mut method_args = Vec::new();
+                
+                // Передаем первый аргумент (self) как ссылку
+                method_args.push(ChifValue::Reference(var_name.to_string()));
+                
+                // Добавляем остальные аргументы
+                for arg_expr in args {
+                    method_args.push(self.evaluate_expression(arg_expr)?);
                 }
+                
+                // Вызываем функцию
+                let result = self.call_function(&method, method_args)?;
+                return Ok(result);
             }
         }
         
@@ -1476,81 +2576,82 @@ impl Interpreter {
     }
     
     fn call_mutable_method(&mut self, var_name: &str, method_name: &str, args: &[Expression]) -> Result<ChifValue> {
-        let mut object = self.get_variable(var_name)?;
+        match self.lookup_variable(var_name) {
+            Some(ChifValue::List(_)) => {}
+            Some(_) => {
+                return Err(ChifError::RuntimeError {
+                    message: format!("Method '{}' not supported for this type", method_name),
+                });
+            }
+            None => {
+                return Err(ChifError::VariableNotFound {
+                    name: var_name.to_string(),
+                });
+            }
+        }
         
-        match &mut object {
-            ChifValue::List(list) => {
-                match method_name {
-                    "add" => {
-                        if args.len() != 1 {
-                            return Err(ChifError::RuntimeError {
-                                message: "add method expects 1 argument".to_string(),
-                            });
-                        }
-                        let value = self.evaluate_expression(&args[0])?;
-                        list.push(value);
-                        self.set_variable(var_name, object)?;
-                        Ok(ChifValue::Nil)
-                    }
-                    "addAt" => {
-                        if args.len() != 2 {
-                            return Err(ChifError::RuntimeError {
-                                message: "addAt method expects 2 arguments".to_string(),
-                            });
-                        }
-                        let value = self.evaluate_expression(&args[0])?;
-                        let index = self.evaluate_expression(&args[1])?;
-                        
-                        if let ChifValue::Int(idx) = index {
-                            if idx >= 0 && (idx as usize) <= list.len() {
-                                list.insert(idx as usize, value);
-                                self.set_variable(var_name, object)?;
-                                Ok(ChifValue::Nil)
-                            } else {
-                                Err(ChifError::RuntimeError {
-                                    message: format!("Index {} out of bounds for list of length {}", idx, list.len()),
-                                })
-                            }
-                        } else {
-                            Err(ChifError::RuntimeError {
-                                message: "addAt index must be an integer".to_string(),
-                            })
-                        }
-                    }
-                    "del" => {
-                        if args.len() != 1 {
-                            return Err(ChifError::RuntimeError {
-                                message: "del method expects 1 argument".to_string(),
-                            });
-                        }
-                        let index = self.evaluate_expression(&args[0])?;
-                        
-                        if let ChifValue::Int(idx) = index {
-                            if idx >= 0 && (idx as usize) < list.len() {
-                                list.remove(idx as usize);
-                                self.set_variable(var_name, object)?;
-                                Ok(ChifValue::Nil)
-                            } else {
-                                Err(ChifError::RuntimeError {
-                                    message: format!("Index {} out of bounds for list of length {}", idx, list.len()),
-                                })
-                            }
-                        } else {
-                            Err(ChifError::RuntimeError {
-                                message: "del index must be an integer".to_string(),
-                            })
-                        }
-                    }
-                    _ => Err(ChifError::RuntimeError {
-                        message: format!("Unknown mutable method '{}' for list", method_name),
-                    }),
-                }
+        let expected_args = match method_name {
+            "add" | "del" => 1,
+            "addAt" => 2,
+            _ => {
+                return Err(ChifError::RuntimeError {
+                    message: format!("Unknown mutable method '{}' for list", method_name),
+                });
             }
-            _ => Err(ChifError::RuntimeError {
-                message: format!("Method '{}' not supported for this type", method_name),
-            }),
+        };
+        if args.len() != expected_args {
+            return Err(ChifError::RuntimeError {
+                message: format!("{} method expects {} argument{}", method_name, expected_args, if expected_args == 1 { "" } else { "s" }),
+            });
+        }
+        let mut values = Vec::with_capacity(args.len());
+        for arg in args {
+            values.push(self.evaluate_expression(arg)?);
+        }
+        
+        // The list is updated where it lives, copied only if another value shares it
+        let list = match self.variable_mut(var_name) {
+            Some(ChifValue::List(list)) => Rc::make_mut(list),
+            _ => {
+                return Err(ChifError::RuntimeError {
+                    message: format!("Method '{}' not supported for this type", method_name),
+                });
+            }
+        };
+        
+        match (method_name, values.as_slice()) {
+            ("add", [value]) => {
+                list.push(value.clone());
+                Ok(ChifValue::Nil)
+            }
+            ("addAt", [value, index]) => match index {
+                ChifValue::Int(idx) if *idx >= 0 && (*idx as usize) <= list.len() => {
+                    list.insert(*idx as usize, value.clone());
+                    Ok(ChifValue::Nil)
+                }
+                ChifValue::Int(idx) => Err(ChifError::RuntimeError {
+                    message: format!("Index {} out of bounds for list of length {}", idx, list.len()),
+                }),
+                _ => Err(ChifError::RuntimeError {
+                    message: "addAt index must be an integer".to_string(),
+                }),
+            },
+            ("del", [index]) => match index {
+                ChifValue::Int(idx) if *idx >= 0 && (*idx as usize) < list.len() => {
+                    list.remove(*idx as usize);
+                    Ok(ChifValue::Nil)
+                }
+                ChifValue::Int(idx) => Err(ChifError::RuntimeError {
+                    message: format!("Index {} out of bounds for list of length {}", idx, list.len()),
+                }),
+                _ => Err(ChifError::RuntimeError {
+                    message: "del index must be an integer".to_string(),
+                }),
+            },
+            _ => unreachable!("argument count checked above"),
         }
     }
+
     
 
 }
\ No newline at end of file
@@ -1,11 +1,18 @@
 use crate::ast::*;
+use crate::modules;
+use crate::parallel;
+use crate::parser::Parser;
 use crate::semantic::AnalyzedProgram;
 use crate::types::{ChifType, ChifValue};
 
+use cranelift::codegen::control::ControlPlane;
 use cranelift::prelude::*;
-use cranelift_module::{Linkage, Module};
-use cranelift_object::ObjectModule;
-use std::collections::HashMap;
+use cranelift_module::{DataDescription, Linkage, Module};
+use std::cell::RefCell;
+use std::collections::{HashMap, HashSet};
+use std::rc::Rc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
 use thiserror::Error;
 
 #[derive(Debug, Error)]
@@ -23,22 +30,90 @@ pub enum IRError {
     Module(#[from] cranelift_module::ModuleError),
 }
 
-pub struct IRGenerator {
-    pub module: ObjectModule,
+// Generic over the Cranelift module, so one code generator serves both the
+// object-file compiler (ObjectModule) and in-process runs (JITModule)
+pub struct IRGenerator<M: Module> {
+    pub module: M,
     pub builder_context: FunctionBuilderContext,
     pub ctx: codegen::Context,
     
     // Symbol tables for IR generation
     pub functions: HashMap<String, cranelift_module::FuncId>,
     pub variables: HashMap<String, Variable>,
+    // Source-level types of the variables above, for type-directed lowering
+    pub variable_types: HashMap<String, ChifType>,
     pub current_function: Option<cranelift_module::FuncId>,
     pub string_constants: HashMap<String, cranelift_module::DataId>,
     
     // Struct definitions for layout information
-    pub structs: HashMap<String, StructLayout>,
+    pub structs: HashMap<String, Rc<StructLayout>>,
     
     // Loop context for break/continue
     pub loop_stack: Vec<LoopContext>,
+    
+    // Names of the imported modules generated so far
+    pub imported_modules: HashSet<String>,
+    
+    // Bodies lowered to IR and waiting for compile_functions
+    lowered: Vec<LoweredFunction>,
+}
+
+struct LoweredFunction {
+    id: cranelift_module::FuncId,
+    name: String,
+    ctx: codegen::Context,
+}
+
+// Below this many bodies compiling on one thread is faster than starting workers
+const PARALLEL_COMPILE_MIN_FUNCTIONS: usize = 16;
+
+// Machine code for one lowered body, left in ctx. Only reads the ISA, so
+// bodies compile independently on any thread.
+fn compile_function(isa: &dyn isa::TargetIsa, ctx: &mut codegen::Context) -> Result<(), codegen::CodegenError> {
+    ctx.compile(isa, &mut ControlPlane::default())
+        .map(|_| ())
+        .map_err(|e| e.inner)
+}
+
+// Opcodes of the template byte program rendered by rono_print_template
+const TPL_END: u8 = 0;
+const TPL_LIT: u8 = 1;
+const TPL_INT: u8 = 2;
+const TPL_FLOAT: u8 = 3;
+const TPL_BOOL: u8 = 4;
+const TPL_STR: u8 = 5;
+
+// Size of the {len, cap} header in front of every string's characters
+// (RonoStrHeader in runtime.c)
+const STR_HEADER_SIZE: i32 = 16;
+
+// Layout of the list and map handles (RonoList, RonoMap in runtime.c):
+// both start with their length, a list's item array follows its capacity
+const COLLECTION_LEN_OFFSET: i32 = 0;
+const LIST_ITEMS_OFFSET: i32 = 16;
+
+// Largest array (header included) placed in a function's stack frame
+const ARRAY_STACK_LIMIT: u32 = 1024;
+
+// Element and key kinds of collections (RONO_ELEM_* in runtime.c). Strings
+// are copied out of the function's region when stored.
+const ELEM_VALUE: i64 = 0;
+const ELEM_STR: i64 = 1;
+
+// Variable caching the thread's RonoRandState pointer for inline randi/randf.
+// Starts out null and is fetched on the first draw in each call.
+const RAND_VAR: &str = "$rand";
+
+// Variable holding the handle of the function's string region. It is not a
+// valid identifier, so it can't clash with user variables; its entry in
+// variable_types records the function's return type so returns know
+// whether a string escapes to the caller.
+const REGION_VAR: &str = "$region";
+
+// What loop_needs_region found in a loop
+struct LoopScan {
+    scalar_only: bool,
+    allocates: bool,
 }
 
 #[derive(Debug, Clone)]
@@ -50,9 +125,12 @@ pub struct LoopContext {
 #[derive(Debug, Clone)]
 pub struct StructLayout {
     pub name: String,
+    // In memory order, which need not be the declaration order
     pub fields: Vec<StructFieldLayout>,
     pub size: u32,
     pub alignment: u32,
+    // Lists and arrays of the struct keep one column per field (`soa struct`)
+    pub soa: bool,
 }
 
 #[derive(Debug, Clone)]
@@ -61,20 +139,75 @@ pub struct StructFieldLayout {
     pub field_type: ChifType,
     pub offset: u32,
     pub size: u32,
+    // Bytes of the fields before this one, unpadded: in a struct-of-arrays
+    // array of n elements this field's column starts n * column bytes into
+    // the data
+    pub column: u32,
 }
 
-impl IRGenerator {
-    pub fn new(module: ObjectModule) -> Self {
+impl StructLayout {
+    pub fn field(&self, name: &str) -> Option<&StructFieldLayout> {
+        self.fields.iter().find(|field| field.name == name)
+    }
+    
+    // Position of a field, which is also its column in a struct-of-arrays list
+    fn field_index(&self, name: &str) -> Option<usize> {
+        self.fields.iter().position(|field| field.name == name)
+    }
+    
+    // Bytes one element takes in a struct-of-arrays array
+    fn row_size(&self) -> u32 {
+        self.fields.iter().map(|field| field.size).sum()
+    }
+}
+
+thread_local! {
+    // Layouts of the program being generated, installed by generate().
+    // Bodies are lowered by associated functions that only see the tables
+    // passed to them, so struct literals and field accesses look the
+    // layouts up here.
+    static STRUCT_LAYOUTS: RefCell<HashMap<String, Rc<StructLayout>>> = RefCell::new(HashMap::new());
+}
+
+// Where a field accessed by generate_field_ref is kept
+enum FieldPlace {
+    // At its own size, in a struct block or a struct-of-arrays array column
+    Packed,
+    // As an 8-byte collection slot, in a struct-of-arrays list column
+    Slot,
+}
+
+struct FieldRef {
+    addr: Value,
+    offset: i32,
+    field: StructFieldLayout,
+    place: FieldPlace,
+}
+
+// Element `flat` (row-major) of an array of `count` elements whose data
+// starts at `data`
+struct ArrayElement {
+    data: Value,
+    count: Value,
+    flat: Value,
+    element_type: ChifType,
+}
+
+impl<M: Module> IRGenerator<M> {
+    pub fn new(module: M) -> Self {
         Self {
             module,
             builder_context: FunctionBuilderContext::new(),
             ctx: codegen::Context::new(),
             functions: HashMap::new(),
             variables: HashMap::new(),
+            variable_types: HashMap::new(),
             current_function: None,
             string_constants: HashMap::new(),
             structs: HashMap::new(),
             loop_stack: Vec::new(),
+            imported_modules: HashSet::new(),
+            lowered: Vec::new(),
         }
     }
     
@@ -83,6 +216,7 @@ impl IRGenerator {
         self.declare_runtime_functions()?;
         
         // Second pass: process imports and their functions
+        modules::preload(&program.items);
         for item in &program.items {
             if let Item::Import(import) = item {
                 self.process_import(import)?;
@@ -90,46 +224,44 @@ impl IRGenerator {
         }
         
         // Third pass: process struct definitions
+        self.structs.insert("HttpResponse".to_string(), Rc::new(Self::http_response_layout()?));
         for item in &program.items {
             if let Item::Struct(struct_def) = item {
                 self.process_struct_definition(struct_def)?;
             }
         }
+        let layouts = self.structs.clone();
+        STRUCT_LAYOUTS.with(|table| *table.borrow_mut() = layouts);
         
         // Fourth pass: declare all user functions and struct methods
         for item in &program.items {
             if let Item::Function(func) = item {
-                self.declare_function(func)?;
+                self.declare_function(func, &func.name)?;
             } else if let Item::StructImpl(impl_block) = item {
                 // Declare methods with struct prefix
                 for method in &impl_block.methods {
-                    let method_name = format!("{}_{}", impl_block.struct_name, method.name);
-                    let mut method_with_new_name = method.clone();
-                    method_with_new_name.name = method_name;
-                    self.declare_function(&method_with_new_name)?;
+                    self.declare_function(method, &format!("{}_{}", impl_block.struct_name, method.name))?;
                 }
             }
         }
         
-        // Fifth pass: generate function bodies and struct methods
+        // Fifth pass: lower function bodies and struct methods to IR
         for item in &program.items {
             if let Item::Function(func) = item {
-                self.generate_function(func)?;
+                self.generate_function(func, &func.name)?;
             } else if let Item::StructImpl(impl_block) = item {
                 // Generate method bodies with struct prefix
                 for method in &impl_block.methods {
-                    let method_name = format!("{}_{}", impl_block.struct_name, method.name);
-                    let mut method_with_new_name = method.clone();
-                    method_with_new_name.name = method_name;
-                    self.generate_function(&method_with_new_name)?;
+                    self.generate_function(method, &format!("{}_{}", impl_block.struct_name, method.name))?;
                 }
             }
         }
         
-        Ok(())
+        // Sixth pass: compile the bodies to machine code
+        self.compile_functions()
     }
     
-    fn declare_function(&mut self, func: &Function) -> Result<(), IRError> {
+    fn declare_function(&mut self, func: &Function, name: &str) -> Result<(), IRError> {
         let mut sig = self.module.make_signature();
         
         // Use system calling convention for main function
@@ -154,30 +286,33 @@ impl IRGenerator {
             }
         }
         
-        let func_id = self.module.declare_function(&func.name, Linkage::Export, &sig)
+        let func_id = self.module.declare_function(name, Linkage::Export, &sig)
             .map_err(|e| IRError::Module(e))?;
         
-        self.functions.insert(func.name.clone(), func_id);
+        self.functions.insert(name.to_string(), func_id);
         
         Ok(())
     }
     
-    fn generate_function(&mut self, func: &Function) -> Result<(), IRError> {
-        let func_id = self.functions[&func.name];
+    // Lowers func to IR under the declared name; it is compiled with the
+    // other bodies by compile_functions
+    fn generate_function(&mut self, func: &Function, name: &str) -> Result<(), IRError> {
+        let func_id = self.functions[name];
         self.current_function = Some(func_id);
         
-        // Clear context for new function
-        self.ctx.clear();
+        // Each body gets its own context, so that they can be compiled in parallel
+        let mut ctx = codegen::Context::new();
         self.variables.clear();
+        self.variable_types.clear();
         
         // Get function signature
         let sig = self.module.declarations().get_function_decl(func_id).signature.clone();
         
         // Set the function signature in the context
-        self.ctx.func.signature = sig.clone();
+        ctx.func.signature = sig.clone();
         
         // Create function builder
-        let mut builder = FunctionBuilder::new(&mut self.ctx.func, &mut self.builder_context);
+        let mut builder = FunctionBuilder::new(&mut ctx.func, &mut self.builder_context);
         
         // Create entry block
         let entry_block = builder.create_block();
@@ -204,29 +339,56 @@ impl IRGenerator {
                     builder.declare_var(var, param_type);
                     builder.def_var(var, param_value);
                     self.variables.insert(param.name.clone(), var);
+                    self.variable_types.insert(param.name.clone(), param.param_type.clone());
                 }
             }
         }
         
+        if Self::inline_intrinsics(&self.module) {
+            let var = Variable::new(self.variables.len());
+            builder.declare_var(var, types::I64);
+            let null = builder.ins().iconst(types::I64, 0);
+            builder.def_var(var, null);
+            self.variables.insert(RAND_VAR.to_string(), var);
+        }
+        
+        // Open this call's region for runtime strings; every return leaves it
+        if let Some(&enter_func_id) = self.functions.get("rono_region_enter") {
+            let func_ref = self.module.declare_func_in_func(enter_func_id, builder.func);
+            let call = builder.ins().call(func_ref, &[]);
+            let region = builder.inst_results(call)[0];
+            let var = Variable::new(self.variables.len());
+            builder.declare_var(var, types::I64);
+            builder.def_var(var, region);
+            self.variables.insert(REGION_VAR.to_string(), var);
+            self.variable_types.insert(REGION_VAR.to_string(), func.return_type.clone().unwrap_or(ChifType::Nil));
+        }
+        
+        for name in Self::stack_arrays(&func.body.statements) {
+            self.variable_types.insert(Self::stack_array_key(&name), ChifType::Nil);
+        }
+        
         // Generate function body
         let has_return = Self::block_ends_with_return(&func.body);
         
         // Generate statements
-        let statements = func.body.statements.clone();
         let variables = &mut self.variables;
+        let variable_types = &mut self.variable_types;
         let is_main = func.is_main;
         
-        for statement in statements {
-            Self::generate_statement_static(&mut builder, &statement, variables, is_main, &self.functions, &mut self.module)?;
+        for statement in &func.body.statements {
+            Self::generate_statement_static(&mut builder, statement, variables, variable_types, is_main, &self.functions, &mut self.module)?;
         }
         
         // Add implicit return if needed
         if !has_return {
             if func.is_main {
                 // Main function should return 0 (success) by default
+                Self::generate_region_leave(&mut builder, None, variables, variable_types, &self.functions, &mut self.module)?;
                 let zero = builder.ins().iconst(types::I32, 0);
                 builder.ins().return_(&[zero]);
             } else if func.return_type.is_none() || func.return_type == Some(ChifType::Nil) {
+                Self::generate_region_leave(&mut builder, None, variables, variable_types, &self.functions, &mut self.module)?;
                 builder.ins().return_(&[]);
             } else {
                 // This should be caught by semantic analysis
@@ -238,17 +400,73 @@ impl IRGenerator {
         builder.finalize();
         
         // Print IR for debugging (commented out for now)
-        // println!("Generated IR for function '{}':", func.name);
-        // println!("{}", self.ctx.func.display());
+        // println!("Generated IR for function '{}':", name);
+        // println!("{}", ctx.func.display());
+        
+        self.lowered.push(LoweredFunction { id: func_id, name: name.to_string(), ctx });
+        Ok(())
+    }
+    
+    // Compiles the lowered bodies to machine code, on parallel::thread_count()
+    // threads for larger programs, and defines them in the module in the
+    // order they were lowered, so the output doesn't depend on scheduling
+    fn compile_functions(&mut self) -> Result<(), IRError> {
+        let mut lowered = std::mem::take(&mut self.lowered);
+        let isa = self.module.isa();
+        let workers = if lowered.len() < PARALLEL_COMPILE_MIN_FUNCTIONS {
+            1
+        } else {
+            parallel::thread_count().min(lowered.len())
+        };
         
-        // Define the function in the module
-        self.module.define_function(func_id, &mut self.ctx)
-            .map_err(|e| {
-                println!("Function '{}' IR:", func.name);
-                println!("{}", self.ctx.func.display());
-                IRError::Module(e)
-            })?;
+        let results: Vec<Result<(), codegen::CodegenError>> = if workers == 1 {
+            lowered.iter_mut().map(|function| compile_function(isa, &mut function.ctx)).collect()
+        } else {
+            let next = AtomicUsize::new(0);
+            let jobs: Vec<Mutex<&mut codegen::Context>> = lowered.iter_mut().map(|function| Mutex::new(&mut function.ctx)).collect();
+            let mut results: Vec<Option<Result<(), codegen::CodegenError>>> = jobs.iter().map(|_| None).collect();
+            std::thread::scope(|scope| {
+                let handles: Vec<_> = (0..workers)
+                    .map(|_| {
+                        scope.spawn(|| {
+                            let mut compiled = Vec::new();
+                            loop {
+                                let index = next.fetch_add(1, Ordering::Relaxed);
+                                let job = match jobs.get(index) {
+                                    Some(job) => job,
+                                    None => break,
+                                };
+                                let mut ctx = job.lock().unwrap();
+                                compiled.push((index, compile_function(isa, &mut ctx)));
+                            }
+                            compiled
+                        })
+                    })
+                    .collect();
+                for handle in handles {
+                    for (index, result) in handle.join().expect("code generation thread panicked") {
+                        results[index] = Some(result);
+                    }
+                }
+            });
+            results.into_iter().map(|result| result.expect("every function is compiled by a worker")).collect()
+        };
         
+        for (function, result) in lowered.iter().zip(results) {
+            if let Err(e) = result {
+                println!("Function '{}' IR:", function.name);
+                println!("{}", function.ctx.func.display());
+                return Err(IRError::Module(cranelift_module::ModuleError::Compilation(e)));
+            }
+            let compiled = function.ctx.compiled_code().expect("function was compiled");
+            self.module.define_function_bytes(
+                function.id,
+                &function.ctx.func,
+                compiled.buffer.alignment as u64,
+                compiled.code_buffer(),
+                compiled.buffer.relocs(),
+            )?;
+        }
         Ok(())
     }
     
@@ -256,9 +474,10 @@ impl IRGenerator {
         builder: &mut FunctionBuilder, 
         statement: &Statement, 
         variables: &mut HashMap<String, Variable>,
+        variable_types: &mut HashMap<String, ChifType>,
         is_main: bool,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<(), IRError> {
         match statement {
             Statement::VarDecl(var_decl) => {
@@ -266,8 +485,15 @@ impl IRGenerator {
                 let var = Variable::new(variables.len());
                 builder.declare_var(var, cranelift_type);
                 
-                let init_value = if let Some(init_expr) = &var_decl.value {
-                    Self::generate_expression_static(builder, init_expr, variables, functions, module)?
+                let init_value = if let ChifType::Array(..) = var_decl.var_type {
+                    let on_stack = variable_types.contains_key(&Self::stack_array_key(&var_decl.name));
+                    Self::generate_array_value(builder, &var_decl.var_type, var_decl.value.as_ref(), on_stack, variables, variable_types, functions, module)?
+                } else if let Some(init_expr) = &var_decl.value {
+                    Self::generate_typed_value(builder, &var_decl.var_type, init_expr, variables, variable_types, functions, module)?
+                } else if let ChifType::List(..) = var_decl.var_type {
+                    Self::generate_typed_value(builder, &var_decl.var_type, &Expression::ArrayLiteral(Vec::new()), variables, variable_types, functions, module)?
+                } else if let ChifType::Map(..) = var_decl.var_type {
+                    Self::generate_typed_value(builder, &var_decl.var_type, &Expression::MapLiteral(Vec::new()), variables, variable_types, functions, module)?
                 } else {
                     // Initialize with default value
                     Self::get_default_value(builder, cranelift_type)
@@ -275,16 +501,27 @@ impl IRGenerator {
                 
                 builder.def_var(var, init_value);
                 variables.insert(var_decl.name.clone(), var);
+                variable_types.insert(var_decl.name.clone(), var_decl.var_type.clone());
             }
             Statement::Assignment(assignment) => {
-                // For now, only handle simple variable assignments
                 if let Expression::Identifier(var_name) = &assignment.target {
-                    let value = Self::generate_expression_static(builder, &assignment.value, variables, functions, module)?;
+                    let value = match variable_types.get(var_name).cloned() {
+                        Some(var_type @ ChifType::Array(..)) => {
+                            let on_stack = variable_types.contains_key(&Self::stack_array_key(var_name));
+                            Self::generate_array_value(builder, &var_type, Some(&assignment.value), on_stack, variables, variable_types, functions, module)?
+                        }
+                        Some(var_type) => Self::generate_typed_value(builder, &var_type, &assignment.value, variables, variable_types, functions, module)?,
+                        None => Self::generate_expression_static(builder, &assignment.value, variables, variable_types, functions, module)?,
+                    };
                     if let Some(&var) = variables.get(var_name) {
                         builder.def_var(var, value);
                     } else {
                         return Err(IRError::Generation(format!("Undefined variable: {}", var_name)));
                     }
+                } else if let Expression::Index(index_access) = &assignment.target {
+                    Self::generate_index_assignment(builder, index_access, &assignment.value, variables, variable_types, functions, module)?;
+                } else if let Expression::FieldAccess(field_access) = &assignment.target {
+                    Self::generate_field_assignment(builder, field_access, &assignment.value, variables, variable_types, functions, module)?;
                 } else {
                     return Err(IRError::UnsupportedFeature("Complex assignment targets not yet supported".to_string()));
                 }
@@ -293,15 +530,19 @@ impl IRGenerator {
                 if let Some(expr) = expr {
                     if is_main {
                         // Main function should return int32
-                        let return_value = Self::generate_expression_static(builder, expr, variables, functions, module)?;
+                        let return_value = Self::generate_expression_static(builder, expr, variables, variable_types, functions, module)?;
+                        Self::generate_region_leave(builder, None, variables, variable_types, functions, module)?;
                         // Convert to i32 if needed
                         let return_i32 = builder.ins().ireduce(types::I32, return_value);
                         builder.ins().return_(&[return_i32]);
                     } else {
-                        let return_value = Self::generate_expression_static(builder, expr, variables, functions, module)?;
+                        let return_value = Self::generate_expression_static(builder, expr, variables, variable_types, functions, module)?;
+                        let return_value = Self::generate_region_leave(builder, Some(return_value), variables, variable_types, functions, module)?
+                            .unwrap_or(return_value);
                         builder.ins().return_(&[return_value]);
                     }
                 } else {
+                    Self::generate_region_leave(builder, None, variables, variable_types, functions, module)?;
                     if is_main {
                         // Main function returns 0 by default
                         let zero = builder.ins().iconst(types::I32, 0);
@@ -313,11 +554,11 @@ impl IRGenerator {
             }
             Statement::Expression(expr) => {
                 // Generate expression but ignore result
-                Self::generate_expression_static(builder, expr, variables, functions, module)?;
+                Self::generate_expression_static(builder, expr, variables, variable_types, functions, module)?;
             }
             Statement::If(if_stmt) => {
                 // Generate condition
-                let condition = Self::generate_expression_static(builder, &if_stmt.condition, variables, functions, module)?;
+                let condition = Self::generate_expression_static(builder, &if_stmt.condition, variables, variable_types, functions, module)?;
                 
                 // Create blocks for then, else (optional), and merge
                 let then_block = builder.create_block();
@@ -338,7 +579,7 @@ impl IRGenerator {
                 // Generate then block
                 builder.switch_to_block(then_block);
                 for stmt in &if_stmt.then_block.statements {
-                    Self::generate_statement_static(builder, stmt, variables, is_main, functions, module)?;
+                    Self::generate_statement_static(builder, stmt, variables, variable_types, is_main, functions, module)?;
                 }
                 // Jump to merge block if no return statement
                 if !Self::block_ends_with_return(&if_stmt.then_block) {
@@ -350,7 +591,7 @@ impl IRGenerator {
                 if let (Some(else_block), Some(else_body)) = (else_block, &if_stmt.else_block) {
                     builder.switch_to_block(else_block);
                     for stmt in &else_body.statements {
-                        Self::generate_statement_static(builder, stmt, variables, is_main, functions, module)?;
+                        Self::generate_statement_static(builder, stmt, variables, variable_types, is_main, functions, module)?;
                     }
                     // Jump to merge block if no return statement
                     if !Self::block_ends_with_return(else_body) {
@@ -369,12 +610,19 @@ impl IRGenerator {
                 let body_block = builder.create_block();
                 let exit_block = builder.create_block();
                 
+                let statements: Vec<&Statement> = while_stmt.body.statements.iter().collect();
+                let loop_region = if Self::loop_needs_region(&statements, &[&while_stmt.condition], variable_types, functions, module) {
+                    Self::call_runtime_value(builder, "rono_region_enter", &[], functions, module)?
+                } else {
+                    None
+                };
+                
                 // Jump to header block
                 builder.ins().jump(header_block, &[]);
                 
                 // Generate header block (condition check)
                 builder.switch_to_block(header_block);
-                let condition = Self::generate_expression_static(builder, &while_stmt.condition, variables, functions, module)?;
+                let condition = Self::generate_expression_static(builder, &while_stmt.condition, variables, variable_types, functions, module)?;
                 builder.ins().brif(condition, body_block, &[], exit_block, &[]);
                 
                 // Push loop context for break/continue
@@ -386,8 +634,9 @@ impl IRGenerator {
                 
                 // Generate body block
                 builder.switch_to_block(body_block);
+                Self::generate_loop_region_reset(builder, loop_region, functions, module)?;
                 for stmt in &while_stmt.body.statements {
-                    Self::generate_statement_static(builder, stmt, variables, is_main, functions, module)?;
+                    Self::generate_statement_static(builder, stmt, variables, variable_types, is_main, functions, module)?;
                 }
                 // Jump back to header for next iteration
                 builder.ins().jump(header_block, &[]);
@@ -399,6 +648,9 @@ impl IRGenerator {
                 // Continue with exit block
                 builder.switch_to_block(exit_block);
                 builder.seal_block(exit_block);
+                if let Some(region) = loop_region {
+                    Self::call_runtime_value(builder, "rono_region_leave", &[region], functions, module)?;
+                }
             }
             Statement::For(for_stmt) => {
                 // Create blocks for initialization, header, body, update, and exit
@@ -409,16 +661,24 @@ impl IRGenerator {
                 
                 // Generate initialization if present
                 if let Some(init_stmt) = &for_stmt.init {
-                    Self::generate_statement_static(builder, init_stmt, variables, is_main, functions, module)?;
+                    Self::generate_statement_static(builder, init_stmt, variables, variable_types, is_main, functions, module)?;
                 }
                 
+                let statements: Vec<&Statement> = for_stmt.body.statements.iter().chain(for_stmt.update.as_deref()).collect();
+                let conditions: Vec<&Expression> = for_stmt.condition.iter().collect();
+                let loop_region = if Self::loop_needs_region(&statements, &conditions, variable_types, functions, module) {
+                    Self::call_runtime_value(builder, "rono_region_enter", &[], functions, module)?
+                } else {
+                    None
+                };
+                
                 // Jump to header block
                 builder.ins().jump(header_block, &[]);
                 
                 // Generate header block (condition check)
                 builder.switch_to_block(header_block);
                 if let Some(condition_expr) = &for_stmt.condition {
-                    let condition = Self::generate_expression_static(builder, condition_expr, variables, functions, module)?;
+                    let condition = Self::generate_expression_static(builder, condition_expr, variables, variable_types, functions, module)?;
                     builder.ins().brif(condition, body_block, &[], exit_block, &[]);
                 } else {
                     // No condition means infinite loop (until break)
@@ -427,8 +687,9 @@ impl IRGenerator {
                 
                 // Generate body block
                 builder.switch_to_block(body_block);
+                Self::generate_loop_region_reset(builder, loop_region, functions, module)?;
                 for stmt in &for_stmt.body.statements {
-                    Self::generate_statement_static(builder, stmt, variables, is_main, functions, module)?;
+                    Self::generate_statement_static(builder, stmt, variables, variable_types, is_main, functions, module)?;
                 }
                 // Jump to update block
                 builder.ins().jump(update_block, &[]);
@@ -436,7 +697,7 @@ impl IRGenerator {
                 // Generate update block
                 builder.switch_to_block(update_block);
                 if let Some(update_stmt) = &for_stmt.update {
-                    Self::generate_statement_static(builder, update_stmt, variables, is_main, functions, module)?;
+                    Self::generate_statement_static(builder, update_stmt, variables, variable_types, is_main, functions, module)?;
                 }
                 // Jump back to header for next iteration
                 builder.ins().jump(header_block, &[]);
@@ -449,6 +710,12 @@ impl IRGenerator {
                 // Continue with exit block
                 builder.switch_to_block(exit_block);
                 builder.seal_block(exit_block);
+                if let Some(region) = loop_region {
+                    Self::call_runtime_value(builder, "rono_region_leave", &[region], functions, module)?;
+                }
+            }
+            Statement::ParFor(par_for) => {
+                Self::generate_par_for(builder, par_for, variables, variable_types, functions, module)?;
             }
             Statement::Break => {
                 // For now, we'll implement a simple version without loop context
@@ -470,26 +737,488 @@ impl IRGenerator {
         Ok(())
     }
     
-    fn is_float_expression(expression: &Expression) -> bool {
+    // Release what the previous iteration (and the condition since) put in
+    // the loop's region. Regions opened by calls are closed by now, so
+    // entering again gives back the same handle.
+    fn generate_loop_region_reset(
+        builder: &mut FunctionBuilder,
+        loop_region: Option<Value>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        if let Some(region) = loop_region {
+            Self::call_runtime_value(builder, "rono_region_leave", &[region], functions, module)?;
+            Self::call_runtime_value(builder, "rono_region_enter", &[], functions, module)?;
+        }
+        Ok(())
+    }
+    
+    // Leave the function's string region before a return. A returned string
+    // is copied into the caller's region; the copy is returned in its place.
+    // So is a returned struct, whose block would otherwise point into this
+    // function's stack frame, together with its string and struct fields.
+    fn generate_region_leave(
+        builder: &mut FunctionBuilder,
+        return_value: Option<Value>,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Option<Value>, IRError> {
+        let region_var = match variables.get(REGION_VAR) {
+            Some(&var) => var,
+            None => return Ok(None),
+        };
+        let region = builder.use_var(region_var);
+        
+        match (return_value, variable_types.get(REGION_VAR)) {
+            (Some(value), Some(ChifType::Str)) => {
+                let leave_func_id = functions.get("rono_region_leave_str")
+                    .ok_or_else(|| IRError::Generation("Runtime function rono_region_leave_str not found".to_string()))?;
+                let func_ref = module.declare_func_in_func(*leave_func_id, builder.func);
+                let call = builder.ins().call(func_ref, &[region, value]);
+                Ok(Some(builder.inst_results(call)[0]))
+            }
+            (Some(value), Some(ChifType::Struct(name))) => {
+                let layout = Self::struct_layout(name)
+                    .ok_or_else(|| IRError::Generation(format!("Unknown struct: {}", name)))?;
+                // The region's blocks stay readable until released, so the
+                // string fields can still be copied out of them
+                let released = Self::call_runtime_value(builder, "rono_region_pop", &[region], functions, module)?
+                    .ok_or_else(|| IRError::Generation("rono_region_pop returns no value".to_string()))?;
+                let copy = Self::generate_struct_copy(builder, &layout, value, &mut Vec::new(), functions, module)?;
+                Self::call_runtime_value(builder, "rono_region_release", &[released], functions, module)?;
+                Ok(Some(copy))
+            }
+            (Some(value), Some(return_type @ ChifType::Array(..))) if Self::struct_array_layout(return_type).is_some() => {
+                let (layout, dim_count) = Self::struct_array_layout(return_type)
+                    .ok_or_else(|| IRError::Generation("Returned array holds no structs".to_string()))?;
+                // Elements may point into the region (http.get_many results)
+                // or into the frame, so the structs are copied like above
+                let released = Self::call_runtime_value(builder, "rono_region_pop", &[region], functions, module)?
+                    .ok_or_else(|| IRError::Generation("rono_region_pop returns no value".to_string()))?;
+                let copy = Self::generate_struct_array_copy(builder, &layout, dim_count, value, functions, module)?;
+                Self::call_runtime_value(builder, "rono_region_release", &[released], functions, module)?;
+                Ok(Some(copy))
+            }
+            _ => {
+                let leave_func_id = functions.get("rono_region_leave")
+                    .ok_or_else(|| IRError::Generation("Runtime function rono_region_leave not found".to_string()))?;
+                let func_ref = module.declare_func_in_func(*leave_func_id, builder.func);
+                builder.ins().call(func_ref, &[region]);
+                Ok(None)
+            }
+        }
+    }
+    
+    // Copy of the struct at struct_ptr in the current region. String fields
+    // and struct fields are copied as well, except for a struct nested in
+    // itself (open lists the structs being copied), which keeps its pointer.
+    fn generate_struct_copy(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        struct_ptr: Value,
+        open: &mut Vec<String>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let size = builder.ins().iconst(types::I64, layout.size.max(8) as i64);
+        let copy = Self::call_runtime_value(builder, "rono_alloc", &[size], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_alloc returns no value".to_string()))?;
+        open.push(layout.name.clone());
+        for field in &layout.fields {
+            let value = Self::load_packed(builder, field, struct_ptr, field.offset as i32)?;
+            let value = match &field.field_type {
+                ChifType::Str => Self::call_runtime_value(builder, "rono_str_copy", &[value], functions, module)?
+                    .ok_or_else(|| IRError::Generation("rono_str_copy returns no value".to_string()))?,
+                ChifType::Struct(name) if !open.contains(name) => match Self::struct_layout(name) {
+                    Some(inner) => Self::generate_struct_copy(builder, &inner, value, open, functions, module)?,
+                    None => value,
+                },
+                _ => value,
+            };
+            Self::store_packed(builder, value, field, copy, field.offset as i32);
+        }
+        open.pop();
+        Ok(copy)
+    }
+    
+    // Layout and number of dimensions of an array whose elements are
+    // pointers to structs; struct-of-arrays arrays keep no pointers
+    fn struct_array_layout(array_type: &ChifType) -> Option<(Rc<StructLayout>, usize)> {
+        let (element_type, dims) = Self::array_shape(array_type)?;
+        match &element_type {
+            ChifType::Struct(name) if Self::soa_layout(&element_type).is_none() => {
+                Self::struct_layout(name).map(|layout| (layout, dims.len()))
+            }
+            _ => None,
+        }
+    }
+    
+    // Copy of an array of struct pointers in the current region, each
+    // element copied with generate_struct_copy
+    fn generate_struct_array_copy(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        dim_count: usize,
+        array: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let header_size = (dim_count * 8) as i64;
+        let mut count = builder.ins().iconst(types::I64, 1);
+        for i in 0..dim_count {
+            let len = builder.ins().load(types::I64, MemFlags::trusted(), array, (i * 8) as i32);
+            count = builder.ins().imul(count, len);
+        }
+        let elements_size = builder.ins().imul_imm(count, 8);
+        let size = builder.ins().iadd_imm(elements_size, header_size);
+        let copy = Self::call_runtime_value(builder, "rono_alloc", &[size], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_alloc returns no value".to_string()))?;
+        for i in 0..dim_count {
+            let len = builder.ins().load(types::I64, MemFlags::trusted(), array, (i * 8) as i32);
+            builder.ins().store(MemFlags::trusted(), len, copy, (i * 8) as i32);
+        }
+        
+        let loop_block = builder.create_block();
+        let body_block = builder.create_block();
+        let done_block = builder.create_block();
+        builder.append_block_param(loop_block, types::I64); // Element index
+        let zero = builder.ins().iconst(types::I64, 0);
+        builder.ins().jump(loop_block, &[zero]);
+        
+        builder.switch_to_block(loop_block);
+        let index = builder.block_params(loop_block)[0];
+        let more = builder.ins().icmp(IntCC::SignedLessThan, index, count);
+        builder.ins().brif(more, body_block, &[], done_block, &[]);
+        
+        builder.switch_to_block(body_block);
+        builder.seal_block(body_block);
+        let offset = builder.ins().imul_imm(index, 8);
+        let source = builder.ins().iadd(array, offset);
+        let target = builder.ins().iadd(copy, offset);
+        let element = builder.ins().load(types::I64, MemFlags::trusted(), source, header_size as i32);
+        let element = Self::generate_struct_copy(builder, layout, element, &mut Vec::new(), functions, module)?;
+        builder.ins().store(MemFlags::trusted(), element, target, header_size as i32);
+        let next = builder.ins().iadd_imm(index, 1);
+        builder.ins().jump(loop_block, &[next]);
+        builder.seal_block(loop_block);
+        
+        builder.switch_to_block(done_block);
+        builder.seal_block(done_block);
+        Ok(copy)
+    }
+    
+    // Heap copy of a string or struct stored where it can outlive the
+    // function's region and frame: an element of an array that escapes, or
+    // a list slot written directly (rono_list_push and rono_map_set copy
+    // strings on their own, see generate_element_persist). Values of other
+    // types are returned as they are.
+    fn generate_persist(
+        builder: &mut FunctionBuilder,
+        value: Value,
+        value_type: &ChifType,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        match value_type {
+            ChifType::Str => Self::call_runtime_value(builder, "rono_str_persist", &[value], functions, module)?
+                .ok_or_else(|| IRError::Generation("rono_str_persist returns no value".to_string())),
+            ChifType::Struct(name) => match Self::struct_layout(name) {
+                Some(layout) => Self::generate_struct_persist(builder, &layout, value, &mut Vec::new(), functions, module),
+                None => Ok(value),
+            },
+            _ => Ok(value),
+        }
+    }
+    
+    // Like generate_struct_copy, but the copy is allocated by rono_array_new
+    // and its strings by rono_str_persist, so it lives until the program
+    // exits like the collections holding it
+    fn generate_struct_persist(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        struct_ptr: Value,
+        open: &mut Vec<String>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let size = builder.ins().iconst(types::I64, layout.size.max(8) as i64);
+        let copy = Self::call_runtime_value(builder, "rono_array_new", &[size], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_array_new returns no value".to_string()))?;
+        open.push(layout.name.clone());
+        for field in &layout.fields {
+            let value = Self::load_packed(builder, field, struct_ptr, field.offset as i32)?;
+            let value = match &field.field_type {
+                ChifType::Str => Self::call_runtime_value(builder, "rono_str_persist", &[value], functions, module)?
+                    .ok_or_else(|| IRError::Generation("rono_str_persist returns no value".to_string()))?,
+                ChifType::Struct(name) if !open.contains(name) => match Self::struct_layout(name) {
+                    Some(inner) => Self::generate_struct_persist(builder, &inner, value, open, functions, module)?,
+                    None => value,
+                },
+                _ => value,
+            };
+            Self::store_packed(builder, value, field, copy, field.offset as i32);
+        }
+        open.pop();
+        Ok(copy)
+    }
+    
+    // Value to hand to rono_list_push, rono_list_insert or rono_map_set.
+    // Collections hold structs by pointer, and a struct literal's block is a
+    // stack slot shared by every pass through it and freed with the frame,
+    // so structs are copied with generate_persist; strings are copied by the
+    // runtime functions themselves.
+    fn generate_element_persist(
+        builder: &mut FunctionBuilder,
+        value: Value,
+        element_type: &ChifType,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        match element_type {
+            ChifType::Struct(_) => Self::generate_persist(builder, value, element_type, functions, module),
+            _ => Ok(value),
+        }
+    }
+    
+    // Best-effort source type of an expression; None when codegen has to
+    // fall back to the Cranelift type of the generated value
+    fn infer_expression_type(
+        expression: &Expression,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &M
+    ) -> Option<ChifType> {
         match expression {
-            Expression::Literal(ChifValue::Float(_)) => true,
-            Expression::Binary(binary_op) => {
-                Self::is_float_expression(&binary_op.left) || Self::is_float_expression(&binary_op.right)
+            Expression::Literal(value) => Some(value.get_type()),
+            Expression::Template(_) => Some(ChifType::Str),
+            Expression::Identifier(name) => variable_types.get(name).cloned(),
+            Expression::StructLiteral(struct_literal) => Some(ChifType::Struct(struct_literal.struct_name.clone())),
+            Expression::FieldAccess(field_access) => {
+                Self::resolve_field(&field_access.object, &field_access.field, variable_types, functions, module)
+                    .ok()
+                    .map(|field| field.field_type)
+            }
+            Expression::Binary(binary_op) => match binary_op.operator {
+                BinaryOperator::Equal | BinaryOperator::NotEqual |
+                BinaryOperator::Less | BinaryOperator::LessEqual |
+                BinaryOperator::Greater | BinaryOperator::GreaterEqual |
+                BinaryOperator::And | BinaryOperator::Or => Some(ChifType::Bool),
+                _ => {
+                    let left = Self::infer_expression_type(&binary_op.left, variable_types, functions, module);
+                    let right = Self::infer_expression_type(&binary_op.right, variable_types, functions, module);
+                    match (left, right) {
+                        (Some(ChifType::Str), _) | (_, Some(ChifType::Str)) => Some(ChifType::Str),
+                        (Some(ChifType::Float), _) | (_, Some(ChifType::Float)) => Some(ChifType::Float),
+                        (Some(ChifType::Int), Some(ChifType::Int)) => Some(ChifType::Int),
+                        _ => None,
+                    }
+                }
+            },
+            Expression::Unary(unary_op) => match unary_op.operator {
+                UnaryOperator::Not => Some(ChifType::Bool),
+                _ => Self::infer_expression_type(&unary_op.operand, variable_types, functions, module),
+            },
+            Expression::Call(func_call) => match func_call.name.as_str() {
+                "randi" | "toInt" => Some(ChifType::Int),
+                "randf" | "toFloat" => Some(ChifType::Float),
+                "rands" | "toStr" => Some(ChifType::Str),
+                name => {
+                    // User function: only the ABI type is known here
+                    let func_id = functions.get(name)?;
+                    let signature = &module.declarations().get_function_decl(*func_id).signature;
+                    match signature.returns.first()?.value_type {
+                        types::F64 => Some(ChifType::Float),
+                        types::I8 => Some(ChifType::Bool),
+                        _ => None,
+                    }
+                }
+            },
+            Expression::MethodCall(method_call) => match (&*method_call.object, method_call.method.as_str()) {
+                (Expression::Identifier(object), "get" | "post" | "put" | "delete" | "chunk") if object == "http" => Some(ChifType::Str),
+                (Expression::Identifier(object), "get_many" | "request_many") if object == "http" => {
+                    Some(ChifType::Array(Box::new(ChifType::Struct("HttpResponse".to_string())), vec![0]))
+                }
+                (object, "len") if method_call.args.is_empty() && matches!(
+                    Self::infer_expression_type(object, variable_types, functions, module),
+                    Some(ChifType::Str | ChifType::Array(..) | ChifType::List(..) | ChifType::Map(..))
+                ) => Some(ChifType::Int),
+                _ => None,
+            },
+            Expression::Index(index_access) => {
+                let object_type = Self::infer_expression_type(&index_access.object, variable_types, functions, module)?;
+                match object_type {
+                    ChifType::List(..) | ChifType::Map(..) => Self::indexed_type(&object_type, index_access.indices.len()),
+                    ChifType::Array(..) => Self::array_shape(&object_type)
+                        .filter(|(_, dims)| dims.len() == index_access.indices.len())
+                        .map(|(element_type, _)| element_type),
+                    _ => None,
+                }
             }
-            _ => false,
+            _ => None,
         }
     }
-
+    
+    // con.out(value), con.out("text {expr}") and con.out("a={} b={}", a, b).
+    // Interpolated strings are compiled once into a read-only template and
+    // printed with a single rono_print_template call.
+    fn generate_console_out(
+        builder: &mut FunctionBuilder,
+        args: &[Expression],
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let call_runtime = |builder: &mut FunctionBuilder, module: &mut M, name: &str, call_args: &[Value]| {
+            if let Some(&func_id) = functions.get(name) {
+                let func_ref = module.declare_func_in_func(func_id, builder.func);
+                builder.ins().call(func_ref, call_args);
+                // Return dummy value since con.out returns void
+                Ok(builder.ins().iconst(types::I64, 0))
+            } else {
+                Err(IRError::Generation(format!("Runtime function {} not found", name)))
+            }
+        };
+        
+        if args.is_empty() {
+            return Err(IRError::Generation("con.out expects at least one argument".to_string()));
+        }
+        
+        let unclosed;
+        let parts: &[TemplatePart] = match &args[0] {
+            Expression::Template(template) => &template.parts,
+            Expression::Literal(ChifValue::Str(format)) => {
+                unclosed = Parser::parse_template(format)
+                    .ok_or_else(|| IRError::Generation("Unclosed interpolation bracket '{'".to_string()))?;
+                &unclosed
+            }
+            _ if args.len() == 1 => {
+                // Simple output: con.out(value)
+                let value = Self::generate_expression_static(builder, &args[0], variables, variable_types, functions, module)?;
+                let value_type = Self::infer_expression_type(&args[0], variable_types, functions, module);
+                if let Some(ChifType::List(element_type, dimensions)) = &value_type {
+                    let element_tag = match **element_type {
+                        ChifType::Int if dimensions.len() <= 1 => TPL_INT,
+                        ChifType::Float if dimensions.len() <= 1 => TPL_FLOAT,
+                        ChifType::Bool if dimensions.len() <= 1 => TPL_BOOL,
+                        ChifType::Str if dimensions.len() <= 1 => TPL_STR,
+                        _ => return Err(IRError::UnsupportedFeature(format!("Printing {:?} values is not supported yet", value_type))),
+                    };
+                    let element_tag = builder.ins().iconst(types::I64, element_tag as i64);
+                    return call_runtime(builder, module, "rono_print_list", &[value, element_tag]);
+                }
+                let print_name = match value_type {
+                    Some(ChifType::Str) => "rono_print_string",
+                    Some(ChifType::Float) => "rono_print_float",
+                    Some(ChifType::Bool) => "rono_print_bool",
+                    _ => match builder.func.dfg.value_type(value) {
+                        types::F64 => "rono_print_float",
+                        types::I8 => "rono_print_bool",
+                        _ => "rono_print_int",
+                    },
+                };
+                if print_name == "rono_print_int" && Self::inline_intrinsics(module) {
+                    Self::generate_print_int_inline(builder, value, functions, module)?;
+                    return Ok(builder.ins().iconst(types::I64, 0));
+                }
+                return call_runtime(builder, module, print_name, &[value]);
+            }
+            _ => return Err(IRError::Generation("con.out with several arguments expects a format string first".to_string())),
+        };
+        
+        let has_holes = parts.iter().any(|part| !matches!(part, TemplatePart::Literal(_)));
+        if !has_holes && args.len() == 1 {
+            let text: String = parts.iter().map(|part| match part {
+                TemplatePart::Literal(text) => text.as_str(),
+                _ => "",
+            }).collect();
+            let text_ptr = Self::generate_string_literal(builder, &text, module)?;
+            return call_runtime(builder, module, "rono_print_string", &[text_ptr]);
+        }
+        
+        // Encode the template and evaluate the holes in order
+        let mut program = Vec::new();
+        let mut hole_values = Vec::new();
+        let mut positional = args[1..].iter();
+        for part in parts {
+            match part {
+                TemplatePart::Literal(text) => {
+                    program.push(TPL_LIT);
+                    program.extend_from_slice(&(text.len() as u32).to_le_bytes());
+                    program.extend_from_slice(text.as_bytes());
+                }
+                TemplatePart::Hole { .. } | TemplatePart::Positional => {
+                    let expression = match part {
+                        TemplatePart::Hole { expr, .. } => expr,
+                        _ => match positional.next() {
+                            Some(arg) => arg,
+                            None => {
+                                // Nothing to fill "{}" with, print it as is
+                                program.push(TPL_LIT);
+                                program.extend_from_slice(&2u32.to_le_bytes());
+                                program.extend_from_slice(b"{}");
+                                continue;
+                            }
+                        },
+                    };
+                    
+                    let value = Self::generate_expression_static(builder, expression, variables, variable_types, functions, module)?;
+                    let opcode = match Self::infer_expression_type(expression, variable_types, functions, module) {
+                        Some(ChifType::Str) => TPL_STR,
+                        Some(ChifType::Float) => TPL_FLOAT,
+                        Some(ChifType::Bool) => TPL_BOOL,
+                        Some(ChifType::Int) | None => match builder.func.dfg.value_type(value) {
+                            types::F64 => TPL_FLOAT,
+                            types::I8 => TPL_BOOL,
+                            _ => TPL_INT,
+                        },
+                        Some(other) => return Err(IRError::UnsupportedFeature(
+                            format!("Interpolation of {:?} values is not supported yet", other)
+                        )),
+                    };
+                    program.push(opcode);
+                    hole_values.push(value);
+                }
+            }
+        }
+        if positional.next().is_some() {
+            return Err(IRError::Generation("con.out has more arguments than '{}' placeholders".to_string()));
+        }
+        program.push(TPL_END);
+        
+        // Template bytes live in read-only data, shared by identical templates
+        let template_ptr = Self::generate_rodata(builder, "tpl", program, 1, module)?;
+        
+        // Hole values go into 8-byte stack slots in hole order
+        let slot = builder.create_sized_stack_slot(StackSlotData::new(
+            StackSlotKind::ExplicitSlot,
+            (hole_values.len().max(1) * 8) as u32,
+        ));
+        let args_ptr = builder.ins().stack_addr(types::I64, slot, 0);
+        for (i, value) in hole_values.iter().enumerate() {
+            builder.ins().store(MemFlags::new(), *value, args_ptr, (i * 8) as i32);
+        }
+        
+        call_runtime(builder, module, "rono_print_template", &[template_ptr, args_ptr])
+    }
+    
     fn generate_expression_static(
         builder: &mut FunctionBuilder, 
         expression: &Expression, 
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
         match expression {
             Expression::Literal(value) => {
-                Self::generate_literal(builder, value)
+                Self::generate_literal(builder, value, module)
+            }
+            // Outside con.out a template is its text as written
+            Expression::Template(template) => {
+                Self::generate_literal(builder, &ChifValue::Str(template.source.as_str().into()), module)
             }
             Expression::Identifier(name) => {
                 if let Some(&var) = variables.get(name) {
@@ -502,16 +1231,38 @@ impl IRGenerator {
                 // Check for constant folding opportunities
                 if let (Expression::Literal(left_val), Expression::Literal(right_val)) = 
                     (&*binary_op.left, &*binary_op.right) {
-                    if let Some(folded) = Self::fold_constants(left_val, &binary_op.operator, right_val) {
-                        return Self::generate_literal(builder, &folded);
+                    if let Some(folded) = crate::optimize::fold_binary(left_val, &binary_op.operator, right_val) {
+                        return Self::generate_literal(builder, &folded, module);
                     }
                 }
                 
-                let left = Self::generate_expression_static(builder, &binary_op.left, variables, functions, module)?;
-                let right = Self::generate_expression_static(builder, &binary_op.right, variables, functions, module)?;
+                // String concatenation and comparison are runtime calls
+                let is_string = Self::infer_expression_type(&binary_op.left, variable_types, functions, module) == Some(ChifType::Str)
+                    && Self::infer_expression_type(&binary_op.right, variable_types, functions, module) == Some(ChifType::Str);
+                if is_string && matches!(binary_op.operator, BinaryOperator::Add | BinaryOperator::Equal | BinaryOperator::NotEqual) {
+                    let left = Self::generate_expression_static(builder, &binary_op.left, variables, variable_types, functions, module)?;
+                    let right = Self::generate_expression_static(builder, &binary_op.right, variables, variable_types, functions, module)?;
+                    
+                    let runtime_name = if binary_op.operator == BinaryOperator::Add { "rono_str_concat" } else { "rono_str_eq" };
+                    let func_id = functions.get(runtime_name)
+                        .ok_or_else(|| IRError::Generation(format!("Runtime function {} not found", runtime_name)))?;
+                    let func_ref = module.declare_func_in_func(*func_id, builder.func);
+                    let call = builder.ins().call(func_ref, &[left, right]);
+                    let result = builder.inst_results(call)[0];
+                    
+                    return Ok(if binary_op.operator == BinaryOperator::NotEqual {
+                        builder.ins().bxor_imm(result, 1)
+                    } else {
+                        result
+                    });
+                }
+                
+                let left = Self::generate_expression_static(builder, &binary_op.left, variables, variable_types, functions, module)?;
+                let right = Self::generate_expression_static(builder, &binary_op.right, variables, variable_types, functions, module)?;
                 
-                // Determine if this is a float operation
-                let is_float = Self::is_float_expression(&binary_op.left) || Self::is_float_expression(&binary_op.right);
+                // Float operands are F64 values, whether literals, variables or calls
+                let is_float = builder.func.dfg.value_type(left) == types::F64
+                    || builder.func.dfg.value_type(right) == types::F64;
                 
                 match binary_op.operator {
                     BinaryOperator::Add => {
@@ -588,12 +1339,16 @@ impl IRGenerator {
                 }
             }
             Expression::Unary(unary_op) => {
-                let operand = Self::generate_expression_static(builder, &unary_op.operand, variables, functions, module)?;
+                let operand = Self::generate_expression_static(builder, &unary_op.operand, variables, variable_types, functions, module)?;
                 
                 match unary_op.operator {
                     UnaryOperator::Minus => {
-                        let zero = builder.ins().iconst(types::I64, 0);
-                        Ok(builder.ins().isub(zero, operand))
+                        if builder.func.dfg.value_type(operand) == types::F64 {
+                            Ok(builder.ins().fneg(operand))
+                        } else {
+                            let zero = builder.ins().iconst(types::I64, 0);
+                            Ok(builder.ins().isub(zero, operand))
+                        }
                     }
                     UnaryOperator::Not => {
                         // For boolean not, we assume the value is 0 or 1
@@ -605,48 +1360,19 @@ impl IRGenerator {
             Expression::Call(func_call) => {
                 // Special handling for console output
                 if func_call.name == "con.out" {
-                    if func_call.args.len() != 1 {
-                        return Err(IRError::Generation("con.out expects exactly one argument".to_string()));
-                    }
-                    
-                    let arg_value = Self::generate_expression_static(builder, &func_call.args[0], variables, functions, module)?;
-                    
-                    // Determine the type of the argument and call appropriate runtime function
-                    let (func_name, converted_arg) = match &func_call.args[0] {
-                        Expression::Literal(ChifValue::Int(_)) => ("rono_print_int", arg_value),
-                        Expression::Literal(ChifValue::Float(_)) => ("rono_print_float", arg_value),
-                        Expression::Literal(ChifValue::Bool(_)) => ("rono_print_bool", arg_value),
-                        Expression::Literal(ChifValue::Str(_)) => ("rono_print_string", arg_value),
-                        _ => {
-                            // For variables and complex expressions, we need to infer the type
-                            // This is a simplified approach - check if it's a float expression
-                            if Self::is_float_expression(&func_call.args[0]) {
-                                ("rono_print_float", arg_value)
-                            } else {
-                                // Default to int for now
-                                ("rono_print_int", arg_value)
-                            }
-                        }
-                    };
-                    
-                    if let Some(&print_func_id) = functions.get(func_name) {
-                        let func_ref = module.declare_func_in_func(print_func_id, builder.func);
-                        builder.ins().call(func_ref, &[converted_arg]);
-                        // Return dummy value since con.out returns void
-                        Ok(builder.ins().iconst(types::I64, 0))
-                    } else {
-                        Err(IRError::Generation("Runtime function rono_print_int not found".to_string()))
-                    }
+                    Self::generate_console_out(builder, &func_call.args, variables, variable_types, functions, module)
                 } else if func_call.name == "randi" {
                     // Handle randi(min, max) function call
                     if func_call.args.len() != 2 {
                         return Err(IRError::Generation("randi expects 2 arguments (min, max)".to_string()));
                     }
                     
-                    let min_value = Self::generate_expression_static(builder, &func_call.args[0], variables, functions, module)?;
-                    let max_value = Self::generate_expression_static(builder, &func_call.args[1], variables, functions, module)?;
+                    let min_value = Self::generate_expression_static(builder, &func_call.args[0], variables, variable_types, functions, module)?;
+                    let max_value = Self::generate_expression_static(builder, &func_call.args[1], variables, variable_types, functions, module)?;
                     
-                    if let Some(&rand_func_id) = functions.get("rono_rand_int") {
+                    if Self::inline_intrinsics(module) {
+                        Self::generate_rand_int_inline(builder, min_value, max_value, variables, functions, module)
+                    } else if let Some(&rand_func_id) = functions.get("rono_rand_int") {
                         let func_ref = module.declare_func_in_func(rand_func_id, builder.func);
                         let result = builder.ins().call(func_ref, &[min_value, max_value]);
                         Ok(builder.inst_results(result)[0])
@@ -659,10 +1385,12 @@ impl IRGenerator {
                         return Err(IRError::Generation("randf expects 2 arguments (min, max)".to_string()));
                     }
                     
-                    let min_value = Self::generate_expression_static(builder, &func_call.args[0], variables, functions, module)?;
-                    let max_value = Self::generate_expression_static(builder, &func_call.args[1], variables, functions, module)?;
+                    let min_value = Self::generate_expression_static(builder, &func_call.args[0], variables, variable_types, functions, module)?;
+                    let max_value = Self::generate_expression_static(builder, &func_call.args[1], variables, variable_types, functions, module)?;
                     
-                    if let Some(&rand_func_id) = functions.get("rono_rand_float") {
+                    if Self::inline_intrinsics(module) {
+                        Self::generate_rand_float_inline(builder, min_value, max_value, variables, functions, module)
+                    } else if let Some(&rand_func_id) = functions.get("rono_rand_float") {
                         let func_ref = module.declare_func_in_func(rand_func_id, builder.func);
                         let result = builder.ins().call(func_ref, &[min_value, max_value]);
                         Ok(builder.inst_results(result)[0])
@@ -675,8 +1403,8 @@ impl IRGenerator {
                         return Err(IRError::Generation("rands expects 2 arguments (from, to)".to_string()));
                     }
                     
-                    let from_value = Self::generate_expression_static(builder, &func_call.args[0], variables, functions, module)?;
-                    let to_value = Self::generate_expression_static(builder, &func_call.args[1], variables, functions, module)?;
+                    let from_value = Self::generate_expression_static(builder, &func_call.args[0], variables, variable_types, functions, module)?;
+                    let to_value = Self::generate_expression_static(builder, &func_call.args[1], variables, variable_types, functions, module)?;
                     
                     if let Some(&rand_func_id) = functions.get("rono_rand_char_range") {
                         let func_ref = module.declare_func_in_func(rand_func_id, builder.func);
@@ -685,13 +1413,30 @@ impl IRGenerator {
                     } else {
                         Err(IRError::Generation("Runtime function rono_rand_char_range not found".to_string()))
                     }
+                } else if func_call.name == "randfill" {
+                    Self::generate_rand_fill(builder, &func_call.args, variables, variable_types, functions, module)
+                } else if func_call.name == "randseed" {
+                    // Handle randseed(seed) function call
+                    if func_call.args.len() != 1 {
+                        return Err(IRError::Generation("randseed expects 1 argument (seed)".to_string()));
+                    }
+                    
+                    let seed_value = Self::generate_expression_static(builder, &func_call.args[0], variables, variable_types, functions, module)?;
+                    
+                    if let Some(&seed_func_id) = functions.get("rono_rand_seed") {
+                        let func_ref = module.declare_func_in_func(seed_func_id, builder.func);
+                        builder.ins().call(func_ref, &[seed_value]);
+                        Ok(builder.ins().iconst(types::I64, 0))
+                    } else {
+                        Err(IRError::Generation("Runtime function rono_rand_seed not found".to_string()))
+                    }
                 } else {
                     // Look up the function
                     if let Some(&func_id) = functions.get(&func_call.name) {
                         // Generate arguments
                         let mut args = Vec::new();
                         for arg in &func_call.args {
-                            let arg_value = Self::generate_expression_static(builder, arg, variables, functions, module)?;
+                            let arg_value = Self::generate_expression_static(builder, arg, variables, variable_types, functions, module)?;
                             args.push(arg_value);
                         }
                         
@@ -715,43 +1460,55 @@ impl IRGenerator {
                 }
             }
             Expression::MethodCall(method_call) => {
+                // String length is read from the rono_str header
+                if method_call.method == "len" && method_call.args.is_empty()
+                    && Self::infer_expression_type(&method_call.object, variable_types, functions, module) == Some(ChifType::Str) {
+                    let string_value = Self::generate_expression_static(builder, &method_call.object, variables, variable_types, functions, module)?;
+                    return Self::generate_string_len(builder, string_value, functions, module);
+                }
+                
+                match Self::infer_expression_type(&method_call.object, variable_types, functions, module) {
+                    Some(collection_type @ (ChifType::List(..) | ChifType::Map(..))) => {
+                        return Self::generate_collection_method(builder, method_call, &collection_type, variables, variable_types, functions, module);
+                    }
+                    // Length of the first dimension, from the array header
+                    Some(ChifType::Array(..)) if method_call.method == "len" && method_call.args.is_empty() => {
+                        let array = Self::generate_expression_static(builder, &method_call.object, variables, variable_types, functions, module)?;
+                        return Ok(builder.ins().load(types::I64, MemFlags::trusted().with_readonly(), array, 0));
+                    }
+                    _ => {}
+                }
+                
                 // Special handling for console output
                 if let Expression::Identifier(object_name) = &*method_call.object {
                     if object_name == "con" && method_call.method == "out" {
-                        if method_call.args.is_empty() {
-                            return Err(IRError::Generation("con.out expects at least one argument".to_string()));
+                        Self::generate_console_out(builder, &method_call.args, variables, variable_types, functions, module)
+                    } else if object_name == "con" && method_call.method == "flush" {
+                        if !method_call.args.is_empty() {
+                            return Err(IRError::Generation("con.flush expects no arguments".to_string()));
                         }
                         
-                        if method_call.args.len() == 1 {
-                            // Simple output: con.out(value)
-                            let arg_value = Self::generate_expression_static(builder, &method_call.args[0], variables, functions, module)?;
-                            
-                            // Call runtime print function
-                            if let Some(&print_func_id) = functions.get("rono_print_int") {
-                                let func_ref = module.declare_func_in_func(print_func_id, builder.func);
-                                builder.ins().call(func_ref, &[arg_value]);
-                                // Return dummy value since con.out returns void
-                                Ok(builder.ins().iconst(types::I64, 0))
-                            } else {
-                                Err(IRError::Generation("Runtime function rono_print_int not found".to_string()))
-                            }
-                        } else if method_call.args.len() == 2 {
-                            // Formatted output: con.out("Value: {}", value)
-                            // For now, we'll ignore the format string and just use a default format
-                            let arg_value = Self::generate_expression_static(builder, &method_call.args[1], variables, functions, module)?;
-                            
-                            // Call runtime format function with null format (uses default)
-                            if let Some(&format_func_id) = functions.get("rono_print_format_int") {
-                                let func_ref = module.declare_func_in_func(format_func_id, builder.func);
-                                let null_ptr = builder.ins().iconst(types::I64, 0); // NULL format string
-                                builder.ins().call(func_ref, &[null_ptr, arg_value]);
-                                // Return dummy value since con.out returns void
-                                Ok(builder.ins().iconst(types::I64, 0))
-                            } else {
-                                Err(IRError::Generation("Runtime function rono_print_format_int not found".to_string()))
-                            }
+                        if let Some(&flush_func_id) = functions.get("rono_flush") {
+                            let func_ref = module.declare_func_in_func(flush_func_id, builder.func);
+                            builder.ins().call(func_ref, &[]);
+                            Ok(builder.ins().iconst(types::I64, 0))
+                        } else {
+                            Err(IRError::Generation("Runtime function rono_flush not found".to_string()))
+                        }
+                    } else if object_name == "con" && method_call.method == "buffer" {
+                        if method_call.args.len() != 2 {
+                            return Err(IRError::Generation("con.buffer expects 2 arguments (size, line_flush)".to_string()));
+                        }
+                        
+                        let size_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
+                        let line_flush_value = Self::generate_expression_static(builder, &method_call.args[1], variables, variable_types, functions, module)?;
+                        
+                        if let Some(&configure_func_id) = functions.get("rono_output_configure") {
+                            let func_ref = module.declare_func_in_func(configure_func_id, builder.func);
+                            builder.ins().call(func_ref, &[size_value, line_flush_value]);
+                            Ok(builder.ins().iconst(types::I64, 0))
                         } else {
-                            Err(IRError::Generation("con.out supports maximum 2 arguments (format string and value)".to_string()))
+                            Err(IRError::Generation("Runtime function rono_output_configure not found".to_string()))
                         }
                     } else if object_name == "con" && method_call.method == "in" {
                         if !method_call.args.is_empty() {
@@ -772,7 +1529,7 @@ impl IRGenerator {
                             return Err(IRError::Generation("http.get expects 1 argument (url)".to_string()));
                         }
                         
-                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, functions, module)?;
+                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
                         
                         if let Some(&http_func_id) = functions.get("rono_http_get") {
                             let func_ref = module.declare_func_in_func(http_func_id, builder.func);
@@ -786,8 +1543,8 @@ impl IRGenerator {
                             return Err(IRError::Generation("http.post expects 2 arguments (url, data)".to_string()));
                         }
                         
-                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, functions, module)?;
-                        let data_value = Self::generate_expression_static(builder, &method_call.args[1], variables, functions, module)?;
+                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
+                        let data_value = Self::generate_expression_static(builder, &method_call.args[1], variables, variable_types, functions, module)?;
                         
                         if let Some(&http_func_id) = functions.get("rono_http_post") {
                             let func_ref = module.declare_func_in_func(http_func_id, builder.func);
@@ -801,8 +1558,8 @@ impl IRGenerator {
                             return Err(IRError::Generation("http.put expects 2 arguments (url, data)".to_string()));
                         }
                         
-                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, functions, module)?;
-                        let data_value = Self::generate_expression_static(builder, &method_call.args[1], variables, functions, module)?;
+                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
+                        let data_value = Self::generate_expression_static(builder, &method_call.args[1], variables, variable_types, functions, module)?;
                         
                         if let Some(&http_func_id) = functions.get("rono_http_put") {
                             let func_ref = module.declare_func_in_func(http_func_id, builder.func);
@@ -816,7 +1573,7 @@ impl IRGenerator {
                             return Err(IRError::Generation("http.delete expects 1 argument (url)".to_string()));
                         }
                         
-                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, functions, module)?;
+                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
                         
                         if let Some(&http_func_id) = functions.get("rono_http_delete") {
                             let func_ref = module.declare_func_in_func(http_func_id, builder.func);
@@ -825,57 +1582,189 @@ impl IRGenerator {
                         } else {
                             Err(IRError::Generation("Runtime function rono_http_delete not found".to_string()))
                         }
-                    } else {
-                        // Handle struct method calls
-                        Self::generate_struct_method_call(builder, method_call, variables, functions, module)
-                    }
-                } else {
-                    // Handle struct method calls on complex expressions
-                    Self::generate_struct_method_call(builder, method_call, variables, functions, module)
-                }
-            }
-            Expression::StructLiteral(struct_literal) => {
-                // Allocate memory for the struct
-                Self::generate_struct_instantiation(builder, struct_literal, variables, functions, module)
-            }
-            Expression::FieldAccess(field_access) => {
-                // Generate field access
-                Self::generate_field_access(builder, field_access, variables, functions, module)
-            }
-            Expression::ArrayLiteral(elements) => {
-                // Generate array literal
-                Self::generate_array_literal(builder, elements, variables, functions, module)
-            }
-            Expression::Index(index_access) => {
-                // Generate array indexing
-                Self::generate_array_index(builder, index_access, variables, functions, module)
-            }
-            Expression::Reference(expr) => {
-                // Generate address-of operation (&expr)
-                Self::generate_address_of(builder, expr, variables, functions, module)
-            }
-            Expression::Dereference(expr) => {
-                // Generate dereference operation (*expr)
-                Self::generate_dereference(builder, expr, variables, functions, module)
-            }
-            _ => {
-                Err(IRError::UnsupportedFeature(format!("Expression type not yet supported: {:?}", expression)))
-            }
-        }
-    }
-    
-    fn generate_literal(builder: &mut FunctionBuilder, value: &ChifValue) -> Result<Value, IRError> {
-        match value {
-            ChifValue::Int(i) => Ok(builder.ins().iconst(types::I64, *i)),
-            ChifValue::Float(f) => Ok(builder.ins().f64const(*f)),
-            ChifValue::Bool(b) => Ok(builder.ins().iconst(types::I8, if *b { 1 } else { 0 })),
-            ChifValue::Nil => Ok(builder.ins().iconst(types::I64, 0)), // Represent nil as 0
-            ChifValue::Str(s) => {
-                // Create string constant in memory
-                // For now, we need to handle this differently since we can't access self.module here
-                // Let's use a simpler approach - create string on stack
-                Self::generate_string_on_stack(builder, s)
+                    } else if object_name == "http" && (method_call.method == "get_many" || method_call.method == "request_many") {
+                        // Leading string arrays: urls, or methods/urls/bodies
+                        let array_args = if method_call.method == "get_many" { 1 } else { 3 };
+                        let arg_count = method_call.args.len();
+                        
+                        if arg_count != array_args + 1 && arg_count != array_args + 2 {
+                            return Err(IRError::Generation(format!(
+                                "http.{} expects {} or {} arguments", method_call.method, array_args + 1, array_args + 2
+                            )));
+                        }
+                        
+                        // The runtime takes plain string pointers: the elements
+                        // after an array's dimensions, or a list's items
+                        let mut args = Vec::new();
+                        let mut lengths = Vec::new();
+                        for arg in &method_call.args[..array_args] {
+                            let arg_type = Self::infer_expression_type(arg, variable_types, functions, module);
+                            let value = Self::generate_expression_static(builder, arg, variables, variable_types, functions, module)?;
+                            match arg_type.as_ref() {
+                                Some(list_type @ ChifType::List(..)) if Self::soa_list_layout(list_type).is_none() => {
+                                    lengths.push(builder.ins().load(types::I64, MemFlags::trusted(), value, COLLECTION_LEN_OFFSET));
+                                    args.push(builder.ins().load(types::I64, MemFlags::trusted(), value, LIST_ITEMS_OFFSET));
+                                }
+                                Some(array_type @ ChifType::Array(..)) => {
+                                    let dim_count = Self::array_shape(array_type).map(|(_, dims)| dims.len()).unwrap_or(1);
+                                    let mut len = builder.ins().iconst(types::I64, 1);
+                                    for i in 0..dim_count {
+                                        let dim = builder.ins().load(types::I64, MemFlags::trusted(), value, (i * 8) as i32);
+                                        len = builder.ins().imul(len, dim);
+                                    }
+                                    lengths.push(len);
+                                    args.push(builder.ins().iadd_imm(value, (dim_count * 8) as i64));
+                                }
+                                _ => return Err(IRError::Generation(format!(
+                                    "http.{} expects string arrays or lists, got {:?}", method_call.method, arg_type
+                                ))),
+                            }
+                        }
+                        // Without an explicit count every request is sent; either
+                        // way the shortest argument bounds it
+                        let mut count_value = lengths[0];
+                        for &len in &lengths[1..] {
+                            count_value = builder.ins().smin(count_value, len);
+                        }
+                        if arg_count == array_args + 2 {
+                            let count = Self::generate_expression_static(builder, &method_call.args[array_args], variables, variable_types, functions, module)?;
+                            count_value = builder.ins().smin(count_value, count);
+                        }
+                        args.push(count_value);
+                        args.push(Self::generate_expression_static(builder, &method_call.args[arg_count - 1], variables, variable_types, functions, module)?);
+                        
+                        let runtime_name = format!("rono_http_{}", method_call.method);
+                        if let Some(&http_func_id) = functions.get(&runtime_name) {
+                            let func_ref = module.declare_func_in_func(http_func_id, builder.func);
+                            let result = builder.ins().call(func_ref, &args);
+                            Ok(builder.inst_results(result)[0])
+                        } else {
+                            Err(IRError::Generation(format!("Runtime function {} not found", runtime_name)))
+                        }
+                    } else if object_name == "http" && method_call.method == "stream" {
+                        if method_call.args.len() != 2 {
+                            return Err(IRError::Generation("http.stream expects 2 arguments (url, handler)".to_string()));
+                        }
+                        
+                        let url_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
+                        
+                        // The handler is passed to the runtime as a function pointer
+                        let handler_id = match &method_call.args[1] {
+                            Expression::Identifier(handler_name) => functions.get(handler_name).copied()
+                                .ok_or_else(|| IRError::Generation(format!("Unknown chunk handler: {}", handler_name)))?,
+                            _ => return Err(IRError::Generation("http.stream handler must be a function name".to_string())),
+                        };
+                        let handler_ref = module.declare_func_in_func(handler_id, builder.func);
+                        let handler_value = builder.ins().func_addr(types::I64, handler_ref);
+                        
+                        if let Some(&http_func_id) = functions.get("rono_http_get_stream") {
+                            let func_ref = module.declare_func_in_func(http_func_id, builder.func);
+                            let result = builder.ins().call(func_ref, &[url_value, handler_value]);
+                            Ok(builder.inst_results(result)[0])
+                        } else {
+                            Err(IRError::Generation("Runtime function rono_http_get_stream not found".to_string()))
+                        }
+                    } else if let Some((runtime_name, arity)) = match (object_name.as_str(), method_call.method.as_str()) {
+                        ("http", "download") => Some(("rono_http_download", 2)),
+                        ("http", "open") => Some(("rono_http_open", 1)),
+                        ("http", "next_chunk") => Some(("rono_http_next_chunk", 1)),
+                        ("http", "chunk") => Some(("rono_http_chunk_data", 1)),
+                        ("http", "stream_status") => Some(("rono_http_stream_status", 1)),
+                        ("http", "close") => Some(("rono_http_close", 1)),
+                        _ => None,
+                    } {
+                        if method_call.args.len() != arity {
+                            return Err(IRError::Generation(format!("http.{} expects {} argument(s)", method_call.method, arity)));
+                        }
+                        
+                        let mut args = Vec::new();
+                        for arg in &method_call.args {
+                            args.push(Self::generate_expression_static(builder, arg, variables, variable_types, functions, module)?);
+                        }
+                        
+                        if let Some(&http_func_id) = functions.get(runtime_name) {
+                            let func_ref = module.declare_func_in_func(http_func_id, builder.func);
+                            let result = builder.ins().call(func_ref, &args);
+                            match builder.inst_results(result).first() {
+                                Some(&value) => Ok(value),
+                                // Void runtime call, return dummy value
+                                None => Ok(builder.ins().iconst(types::I64, 0)),
+                            }
+                        } else {
+                            Err(IRError::Generation(format!("Runtime function {} not found", runtime_name)))
+                        }
+                    } else if object_name == "http" && method_call.method == "configure" {
+                        if method_call.args.len() != 2 {
+                            return Err(IRError::Generation("http.configure expects 2 arguments (pool_size, idle_timeout)".to_string()));
+                        }
+                        
+                        let pool_value = Self::generate_expression_static(builder, &method_call.args[0], variables, variable_types, functions, module)?;
+                        let timeout_value = Self::generate_expression_static(builder, &method_call.args[1], variables, variable_types, functions, module)?;
+                        
+                        if let Some(&http_func_id) = functions.get("rono_http_configure") {
+                            let func_ref = module.declare_func_in_func(http_func_id, builder.func);
+                            builder.ins().call(func_ref, &[pool_value, timeout_value]);
+                            Ok(builder.ins().iconst(types::I64, 0))
+                        } else {
+                            Err(IRError::Generation("Runtime function rono_http_configure not found".to_string()))
+                        }
+                    } else {
+                        // Handle struct method calls
+                        Self::generate_struct_method_call(builder, method_call, variables, variable_types, functions, module)
+                    }
+                } else {
+                    // Handle struct method calls on complex expressions
+                    Self::generate_struct_method_call(builder, method_call, variables, variable_types, functions, module)
+                }
+            }
+            Expression::StructLiteral(struct_literal) => {
+                // Allocate memory for the struct
+                Self::generate_struct_instantiation(builder, struct_literal, variables, variable_types, functions, module)
+            }
+            Expression::FieldAccess(field_access) => {
+                // Generate field access
+                Self::generate_field_access(builder, field_access, variables, variable_types, functions, module)
+            }
+            Expression::ArrayLiteral(elements) => {
+                // Generate array literal
+                Self::generate_array_literal(builder, elements, variables, variable_types, functions, module)
+            }
+            Expression::Index(index_access) => {
+                match Self::infer_expression_type(&index_access.object, variable_types, functions, module) {
+                    Some(collection_type @ (ChifType::List(..) | ChifType::Map(..))) => {
+                        let collection = Self::generate_expression_static(builder, &index_access.object, variables, variable_types, functions, module)?;
+                        let (slot, element_type) = Self::generate_collection_path(
+                            builder, collection, collection_type, &index_access.indices, variables, variable_types, functions, module,
+                        )?;
+                        Ok(Self::from_slot(builder, slot, &element_type))
+                    }
+                    Some(array_type @ ChifType::Array(..)) => {
+                        Self::generate_array_index(builder, index_access, &array_type, variables, variable_types, functions, module)
+                    }
+                    other => Err(IRError::Generation(format!("Cannot index value of type {:?}", other))),
+                }
+            }
+            Expression::Reference(expr) => {
+                // Generate address-of operation (&expr)
+                Self::generate_address_of(builder, expr, variables, variable_types, functions, module)
+            }
+            Expression::Dereference(expr) => {
+                // Generate dereference operation (*expr)
+                Self::generate_dereference(builder, expr, variables, variable_types, functions, module)
+            }
+            _ => {
+                Err(IRError::UnsupportedFeature(format!("Expression type not yet supported: {:?}", expression)))
             }
+        }
+    }
+    
+    fn generate_literal(builder: &mut FunctionBuilder, value: &ChifValue, module: &mut M) -> Result<Value, IRError> {
+        match value {
+            ChifValue::Int(i) => Ok(builder.ins().iconst(types::I64, *i)),
+            ChifValue::Float(f) => Ok(builder.ins().f64const(*f)),
+            ChifValue::Bool(b) => Ok(builder.ins().iconst(types::I8, if *b { 1 } else { 0 })),
+            ChifValue::Nil => Ok(builder.ins().iconst(types::I64, 0)), // Represent nil as 0
+            ChifValue::Str(s) => Self::generate_string_literal(builder, s, module),
             ChifValue::Array(_) => {
                 // TODO: Implement array literal support
                 Err(IRError::UnsupportedFeature("Array literals not yet supported".to_string()))
@@ -928,60 +1817,6 @@ impl IRGenerator {
         }
     }
     
-    fn fold_constants(left: &ChifValue, op: &BinaryOperator, right: &ChifValue) -> Option<ChifValue> {
-        match (left, op, right) {
-            // Integer arithmetic
-            (ChifValue::Int(a), BinaryOperator::Add, ChifValue::Int(b)) => Some(ChifValue::Int(a + b)),
-            (ChifValue::Int(a), BinaryOperator::Subtract, ChifValue::Int(b)) => Some(ChifValue::Int(a - b)),
-            (ChifValue::Int(a), BinaryOperator::Multiply, ChifValue::Int(b)) => Some(ChifValue::Int(a * b)),
-            (ChifValue::Int(a), BinaryOperator::Divide, ChifValue::Int(b)) if *b != 0 => Some(ChifValue::Int(a / b)),
-            (ChifValue::Int(a), BinaryOperator::Modulo, ChifValue::Int(b)) if *b != 0 => Some(ChifValue::Int(a % b)),
-            
-            // Integer comparisons
-            (ChifValue::Int(a), BinaryOperator::Equal, ChifValue::Int(b)) => Some(ChifValue::Bool(a == b)),
-            (ChifValue::Int(a), BinaryOperator::NotEqual, ChifValue::Int(b)) => Some(ChifValue::Bool(a != b)),
-            (ChifValue::Int(a), BinaryOperator::Less, ChifValue::Int(b)) => Some(ChifValue::Bool(a < b)),
-            (ChifValue::Int(a), BinaryOperator::Greater, ChifValue::Int(b)) => Some(ChifValue::Bool(a > b)),
-            (ChifValue::Int(a), BinaryOperator::LessEqual, ChifValue::Int(b)) => Some(ChifValue::Bool(a <= b)),
-            (ChifValue::Int(a), BinaryOperator::GreaterEqual, ChifValue::Int(b)) => Some(ChifValue::Bool(a >= b)),
-            
-            // Float arithmetic
-            (ChifValue::Float(a), BinaryOperator::Add, ChifValue::Float(b)) => Some(ChifValue::Float(a + b)),
-            (ChifValue::Float(a), BinaryOperator::Subtract, ChifValue::Float(b)) => Some(ChifValue::Float(a - b)),
-            (ChifValue::Float(a), BinaryOperator::Multiply, ChifValue::Float(b)) => Some(ChifValue::Float(a * b)),
-            (ChifValue::Float(a), BinaryOperator::Divide, ChifValue::Float(b)) if *b != 0.0 => Some(ChifValue::Float(a / b)),
-            
-            // Float comparisons
-            (ChifValue::Float(a), BinaryOperator::Equal, ChifValue::Float(b)) => Some(ChifValue::Bool((a - b).abs() < f64::EPSILON)),
-            (ChifValue::Float(a), BinaryOperator::NotEqual, ChifValue::Float(b)) => Some(ChifValue::Bool((a - b).abs() >= f64::EPSILON)),
-            (ChifValue::Float(a), BinaryOperator::Less, ChifValue::Float(b)) => Some(ChifValue::Bool(a < b)),
-            (ChifValue::Float(a), BinaryOperator::Greater, ChifValue::Float(b)) => Some(ChifValue::Bool(a > b)),
-            (ChifValue::Float(a), BinaryOperator::LessEqual, ChifValue::Float(b)) => Some(ChifValue::Bool(a <= b)),
-            (ChifValue::Float(a), BinaryOperator::GreaterEqual, ChifValue::Float(b)) => Some(ChifValue::Bool(a >= b)),
-            
-            // Mixed int/float arithmetic (promote int to float)
-            (ChifValue::Int(a), BinaryOperator::Add, ChifValue::Float(b)) => Some(ChifValue::Float(*a as f64 + b)),
-            (ChifValue::Float(a), BinaryOperator::Add, ChifValue::Int(b)) => Some(ChifValue::Float(a + *b as f64)),
-            (ChifValue::Int(a), BinaryOperator::Subtract, ChifValue::Float(b)) => Some(ChifValue::Float(*a as f64 - b)),
-            (ChifValue::Float(a), BinaryOperator::Subtract, ChifValue::Int(b)) => Some(ChifValue::Float(a - *b as f64)),
-            (ChifValue::Int(a), BinaryOperator::Multiply, ChifValue::Float(b)) => Some(ChifValue::Float(*a as f64 * b)),
-            (ChifValue::Float(a), BinaryOperator::Multiply, ChifValue::Int(b)) => Some(ChifValue::Float(a * *b as f64)),
-            (ChifValue::Int(a), BinaryOperator::Divide, ChifValue::Float(b)) if *b != 0.0 => Some(ChifValue::Float(*a as f64 / b)),
-            (ChifValue::Float(a), BinaryOperator::Divide, ChifValue::Int(b)) if *b != 0 => Some(ChifValue::Float(a / *b as f64)),
-            
-            // Boolean operations
-            (ChifValue::Bool(a), BinaryOperator::And, ChifValue::Bool(b)) => Some(ChifValue::Bool(*a && *b)),
-            (ChifValue::Bool(a), BinaryOperator::Or, ChifValue::Bool(b)) => Some(ChifValue::Bool(*a || *b)),
-            (ChifValue::Bool(a), BinaryOperator::Equal, ChifValue::Bool(b)) => Some(ChifValue::Bool(a == b)),
-            (ChifValue::Bool(a), BinaryOperator::NotEqual, ChifValue::Bool(b)) => Some(ChifValue::Bool(a != b)),
-            
-            // String concatenation
-            (ChifValue::Str(a), BinaryOperator::Add, ChifValue::Str(b)) => Some(ChifValue::Str(format!("{}{}", a, b))),
-            
-            _ => None, // No folding possible
-        }
-    }
-    
     fn block_ends_with_return(block: &crate::ast::Block) -> bool {
         for stmt in &block.statements {
             match stmt {
@@ -1002,6 +1837,131 @@ impl IRGenerator {
         false
     }
     
+    // Whether a loop gets a region of its own that is released at the start
+    // of every iteration, so strings and struct copies made by one iteration
+    // don't pile up in the function's region until it returns. Only loops
+    // that assign and declare nothing but int, float and bool variables
+    // qualify: anything else set in an iteration may be read after it. Loops
+    // that allocate nothing keep running without the two runtime calls.
+    fn loop_needs_region(
+        statements: &[&Statement],
+        expressions: &[&Expression],
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &M
+    ) -> bool {
+        if !functions.contains_key("rono_region_enter") {
+            return false;
+        }
+        let mut scan = LoopScan { scalar_only: true, allocates: false };
+        for statement in statements {
+            Self::scan_loop_statement(statement, &mut scan, variable_types, functions, module);
+        }
+        for expression in expressions {
+            Self::scan_loop_expression(expression, &mut scan, variable_types, functions, module);
+        }
+        scan.scalar_only && scan.allocates
+    }
+    
+    fn scan_loop_statement(
+        statement: &Statement,
+        scan: &mut LoopScan,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &M
+    ) {
+        let is_scalar = |var_type: &ChifType| matches!(var_type, ChifType::Int | ChifType::Float | ChifType::Bool);
+        let block = |block: &crate::ast::Block, scan: &mut LoopScan| {
+            for statement in &block.statements {
+                Self::scan_loop_statement(statement, scan, variable_types, functions, module);
+            }
+        };
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                scan.scalar_only &= is_scalar(&var_decl.var_type);
+                if let Some(value) = &var_decl.value {
+                    Self::scan_loop_expression(value, scan, variable_types, functions, module);
+                }
+            }
+            Statement::Assignment(assignment) => {
+                // Variables declared in the loop are scalars once we get here
+                scan.scalar_only &= match &assignment.target {
+                    Expression::Identifier(name) | Expression::Local(LocalVar { name, .. }) => {
+                        variable_types.get(name).map_or(true, is_scalar)
+                    }
+                    _ => false,
+                };
+                Self::scan_loop_expression(&assignment.value, scan, variable_types, functions, module);
+            }
+            Statement::Expression(expr) => Self::scan_loop_expression(expr, scan, variable_types, functions, module),
+            Statement::Return(expr) => {
+                if let Some(expr) = expr {
+                    Self::scan_loop_expression(expr, scan, variable_types, functions, module);
+                }
+            }
+            Statement::If(if_stmt) => {
+                Self::scan_loop_expression(&if_stmt.condition, scan, variable_types, functions, module);
+                block(&if_stmt.then_block, scan);
+                if let Some(else_block) = &if_stmt.else_block {
+                    block(else_block, scan);
+                }
+            }
+            Statement::For(for_stmt) => {
+                for statement in for_stmt.init.iter().chain(&for_stmt.update) {
+                    Self::scan_loop_statement(statement, scan, variable_types, functions, module);
+                }
+                if let Some(condition) = &for_stmt.condition {
+                    Self::scan_loop_expression(condition, scan, variable_types, functions, module);
+                }
+                block(&for_stmt.body, scan);
+            }
+            Statement::While(while_stmt) => {
+                Self::scan_loop_expression(&while_stmt.condition, scan, variable_types, functions, module);
+                block(&while_stmt.body, scan);
+            }
+            Statement::Switch(switch) => {
+                Self::scan_loop_expression(&switch.expr, scan, variable_types, functions, module);
+                for case in &switch.cases {
+                    Self::scan_loop_expression(&case.value, scan, variable_types, functions, module);
+                    block(&case.body, scan);
+                }
+                if let Some(default_case) = &switch.default_case {
+                    block(default_case, scan);
+                }
+            }
+            Statement::ParFor(_) => scan.scalar_only = false,
+            Statement::Break | Statement::Continue => {}
+        }
+    }
+    
+    fn scan_loop_expression(
+        expression: &Expression,
+        scan: &mut LoopScan,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &M
+    ) {
+        match expression {
+            // The callee may store through the reference
+            Expression::Reference(_) => scan.scalar_only = false,
+            Expression::Template(_) => scan.allocates = true,
+            Expression::Binary(_) | Expression::Call(_) => {
+                scan.allocates |= !matches!(
+                    Self::infer_expression_type(expression, variable_types, functions, module),
+                    Some(ChifType::Int | ChifType::Float | ChifType::Bool)
+                );
+            }
+            Expression::MethodCall(method_call) => {
+                let prints = matches!(&*method_call.object, Expression::Identifier(object) if object == "con");
+                scan.allocates |= !prints && method_call.method != "len";
+            }
+            _ => {}
+        }
+        crate::optimize::for_each_child(expression, &mut |child| {
+            Self::scan_loop_expression(child, scan, variable_types, functions, module)
+        });
+    }
+    
     fn declare_runtime_functions(&mut self) -> Result<(), IRError> {
         // Declare rono_print_int(i64) -> void
         let mut print_int_sig = self.module.make_signature();
@@ -1039,7 +1999,91 @@ impl IRGenerator {
             .map_err(|e| IRError::Module(e))?;
         self.functions.insert("rono_print_format_int".to_string(), print_format_id);
         
+        // Declare rono_print_template(const uint8_t* template, const int64_t* args) -> void
+        let mut print_template_sig = self.module.make_signature();
+        print_template_sig.params.push(AbiParam::new(types::I64)); // Template program as pointer
+        print_template_sig.params.push(AbiParam::new(types::I64)); // Hole values as pointer
+        let print_template_id = self.module.declare_function("rono_print_template", Linkage::Import, &print_template_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_print_template".to_string(), print_template_id);
+        
+        // Declare rono_flush() -> void, writes out the runtime output buffer
+        let flush_sig = self.module.make_signature();
+        let flush_id = self.module.declare_function("rono_flush", Linkage::Import, &flush_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_flush".to_string(), flush_id);
+        
+        // Declare rono_output_configure(buffer_size, line_flush) -> void
+        let mut output_configure_sig = self.module.make_signature();
+        output_configure_sig.params.push(AbiParam::new(types::I64)); // Buffer size in bytes, 0 = unbuffered
+        output_configure_sig.params.push(AbiParam::new(types::I64)); // Line flush: -1 TTY only, 0 off, 1 on
+        let output_configure_id = self.module.declare_function("rono_output_configure", Linkage::Import, &output_configure_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_output_configure".to_string(), output_configure_id);
+        
         // Declare console input functions
+        // Runtime entry points used by inline intrinsics
+        let intrinsic_functions: [(&str, &[Type], Option<Type>); 4] = [
+            ("rono_str_len", &[types::I64], Some(types::I64)),                           // (str) -> len
+            ("rono_out_line", &[types::I64, types::I64], None),                          // (text, len)
+            ("rono_rand_state", &[], Some(types::I64)),                                  // () -> state
+            ("rono_rand_reduce", &[types::I64, types::I64, types::I64], Some(types::I64)), // (state, x, range) -> offset
+        ];
+        for (name, params, ret) in intrinsic_functions {
+            let mut sig = self.module.make_signature();
+            for &param in params {
+                sig.params.push(AbiParam::new(param));
+            }
+            if let Some(ret) = ret {
+                sig.returns.push(AbiParam::new(ret));
+            }
+            let func_id = self.module.declare_function(name, Linkage::Import, &sig)
+                .map_err(|e| IRError::Module(e))?;
+            self.functions.insert(name.to_string(), func_id);
+        }
+        
+        // rono_str_concat(const char*, const char*) -> char*
+        let mut str_concat_sig = self.module.make_signature();
+        str_concat_sig.params.push(AbiParam::new(types::I64)); // Left string
+        str_concat_sig.params.push(AbiParam::new(types::I64)); // Right string
+        str_concat_sig.returns.push(AbiParam::new(types::I64)); // New string
+        let str_concat_id = self.module.declare_function("rono_str_concat", Linkage::Import, &str_concat_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_str_concat".to_string(), str_concat_id);
+        
+        // rono_str_eq(const char*, const char*) -> i8
+        let mut str_eq_sig = self.module.make_signature();
+        str_eq_sig.params.push(AbiParam::new(types::I64)); // Left string
+        str_eq_sig.params.push(AbiParam::new(types::I64)); // Right string
+        str_eq_sig.returns.push(AbiParam::new(types::I8)); // Equal
+        let str_eq_id = self.module.declare_function("rono_str_eq", Linkage::Import, &str_eq_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_str_eq".to_string(), str_eq_id);
+        
+        // Region allocator for runtime strings
+        // rono_region_enter() -> i64
+        let mut region_enter_sig = self.module.make_signature();
+        region_enter_sig.returns.push(AbiParam::new(types::I64)); // Region handle
+        let region_enter_id = self.module.declare_function("rono_region_enter", Linkage::Import, &region_enter_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_region_enter".to_string(), region_enter_id);
+        
+        // rono_region_leave(i64)
+        let mut region_leave_sig = self.module.make_signature();
+        region_leave_sig.params.push(AbiParam::new(types::I64)); // Region handle
+        let region_leave_id = self.module.declare_function("rono_region_leave", Linkage::Import, &region_leave_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_region_leave".to_string(), region_leave_id);
+        
+        // rono_region_leave_str(i64, const char*) -> char*
+        let mut region_leave_str_sig = self.module.make_signature();
+        region_leave_str_sig.params.push(AbiParam::new(types::I64)); // Region handle
+        region_leave_str_sig.params.push(AbiParam::new(types::I64)); // Returned string
+        region_leave_str_sig.returns.push(AbiParam::new(types::I64)); // Copy in the caller's region
+        let region_leave_str_id = self.module.declare_function("rono_region_leave_str", Linkage::Import, &region_leave_str_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_region_leave_str".to_string(), region_leave_str_id);
+        
         // rono_input_string() -> char*
         let mut input_string_sig = self.module.make_signature();
         input_string_sig.returns.push(AbiParam::new(types::I64)); // String as pointer
@@ -1104,6 +2148,33 @@ impl IRGenerator {
             .map_err(|e| IRError::Module(e))?;
         self.functions.insert("rono_rand_char_range".to_string(), rand_char_range_id);
         
+        // rono_rand_seed(i64)
+        let mut rand_seed_sig = self.module.make_signature();
+        rand_seed_sig.params.push(AbiParam::new(types::I64)); // seed
+        let rand_seed_id = self.module.declare_function("rono_rand_seed", Linkage::Import, &rand_seed_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_rand_seed".to_string(), rand_seed_id);
+        
+        // rono_rand_fill_int(i64*, i64, i64, i64)
+        let mut rand_fill_int_sig = self.module.make_signature();
+        rand_fill_int_sig.params.push(AbiParam::new(types::I64)); // out
+        rand_fill_int_sig.params.push(AbiParam::new(types::I64)); // count
+        rand_fill_int_sig.params.push(AbiParam::new(types::I64)); // min
+        rand_fill_int_sig.params.push(AbiParam::new(types::I64)); // max
+        let rand_fill_int_id = self.module.declare_function("rono_rand_fill_int", Linkage::Import, &rand_fill_int_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_rand_fill_int".to_string(), rand_fill_int_id);
+        
+        // rono_rand_fill_float(f64*, i64, f64, f64)
+        let mut rand_fill_float_sig = self.module.make_signature();
+        rand_fill_float_sig.params.push(AbiParam::new(types::I64)); // out
+        rand_fill_float_sig.params.push(AbiParam::new(types::I64)); // count
+        rand_fill_float_sig.params.push(AbiParam::new(types::F64)); // min
+        rand_fill_float_sig.params.push(AbiParam::new(types::F64)); // max
+        let rand_fill_float_id = self.module.declare_function("rono_rand_fill_float", Linkage::Import, &rand_fill_float_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_rand_fill_float".to_string(), rand_fill_float_id);
+        
         // Declare HTTP functions
         // rono_http_get(const char*) -> char*
         let mut http_get_sig = self.module.make_signature();
@@ -1139,49 +2210,157 @@ impl IRGenerator {
             .map_err(|e| IRError::Module(e))?;
         self.functions.insert("rono_http_delete".to_string(), http_delete_id);
 
+        // rono_http_configure(pool_size, idle_timeout)
+        let mut http_configure_sig = self.module.make_signature();
+        http_configure_sig.params.push(AbiParam::new(types::I64)); // Pool size
+        http_configure_sig.params.push(AbiParam::new(types::I64)); // Idle timeout in seconds
+        let http_configure_id = self.module.declare_function("rono_http_configure", Linkage::Import, &http_configure_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_http_configure".to_string(), http_configure_id);
+
+        // rono_http_get_many(const char** urls, count, max_concurrency) -> array of HttpResponse
+        let mut http_get_many_sig = self.module.make_signature();
+        http_get_many_sig.params.push(AbiParam::new(types::I64)); // URL array as pointer
+        http_get_many_sig.params.push(AbiParam::new(types::I64)); // Number of URLs
+        http_get_many_sig.params.push(AbiParam::new(types::I64)); // Max transfers in flight
+        http_get_many_sig.returns.push(AbiParam::new(types::I64)); // Response array as pointer
+        let http_get_many_id = self.module.declare_function("rono_http_get_many", Linkage::Import, &http_get_many_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_http_get_many".to_string(), http_get_many_id);
+
+        // rono_http_request_many(methods, urls, bodies, count, max_concurrency) -> array of HttpResponse
+        let mut http_request_many_sig = self.module.make_signature();
+        http_request_many_sig.params.push(AbiParam::new(types::I64)); // Method array as pointer
+        http_request_many_sig.params.push(AbiParam::new(types::I64)); // URL array as pointer
+        http_request_many_sig.params.push(AbiParam::new(types::I64)); // Body array as pointer
+        http_request_many_sig.params.push(AbiParam::new(types::I64)); // Number of requests
+        http_request_many_sig.params.push(AbiParam::new(types::I64)); // Max transfers in flight
+        http_request_many_sig.returns.push(AbiParam::new(types::I64)); // Response array as pointer
+        let http_request_many_id = self.module.declare_function("rono_http_request_many", Linkage::Import, &http_request_many_sig)
+            .map_err(|e| IRError::Module(e))?;
+        self.functions.insert("rono_http_request_many".to_string(), http_request_many_id);
+
+        // Streaming HTTP: (name, parameter count, returns a value). Every
+        // parameter and result is a 64-bit integer or pointer.
+        let http_stream_functions = [
+            ("rono_http_get_stream", 2, true),   // (url, handler) -> status
+            ("rono_http_download", 2, true),     // (url, path) -> bytes written
+            ("rono_http_open", 1, true),         // (url) -> stream
+            ("rono_http_next_chunk", 1, true),   // (stream) -> chunk length, 0 at end
+            ("rono_http_chunk_data", 1, true),   // (stream) -> chunk
+            ("rono_http_stream_status", 1, true),// (stream) -> status
+            ("rono_http_close", 1, false),       // (stream)
+        ];
+        // Collections behind list and map values: (name, parameter count,
+        // returns a value), all parameters and results 64-bit slots
+        let collection_functions = [
+            ("rono_list_new", 2, true),          // (element kind, capacity) -> list
+            ("rono_list_push", 2, false),        // (list, value)
+            ("rono_list_insert", 3, false),      // (list, value, index)
+            ("rono_list_remove", 2, false),      // (list, index)
+            ("rono_index_error", 2, false),      // (index, len), exits
+            ("rono_array_new", 1, true),         // (size in bytes) -> zeroed array
+            ("rono_print_list", 2, false),       // (list, TPL_* element type)
+            ("rono_map_new", 3, true),           // (key kind, value kind, capacity) -> map
+            ("rono_map_set", 3, false),          // (map, key, value)
+            ("rono_map_get", 2, true),           // (map, key) -> value, 0 if missing
+        ];
+        // Copying values out of a region (see generate_region_leave)
+        let region_functions = [
+            ("rono_region_pop", 1, true),        // (region) -> released blocks
+            ("rono_region_release", 1, false),   // (released blocks)
+            ("rono_alloc", 1, true),             // (size) -> memory in the current region
+            ("rono_str_copy", 1, true),          // (str) -> copy in the current region
+            ("rono_str_persist", 1, true),       // (str) -> heap copy, literals as they are
+        ];
+        // par for worker pool (see generate_par_for)
+        let par_functions = [
+            ("rono_par_for", 4, false),          // (body, env, start, end)
+            ("rono_par_next", 2, true),          // (ctx, range out) -> 0 when done
+            ("rono_par_lock", 1, false),         // (ctx)
+            ("rono_par_unlock", 1, false),       // (ctx)
+        ];
+        for (name, param_count, has_return) in http_stream_functions.into_iter().chain(collection_functions).chain(region_functions).chain(par_functions) {
+            let mut sig = self.module.make_signature();
+            for _ in 0..param_count {
+                sig.params.push(AbiParam::new(types::I64));
+            }
+            if has_return {
+                sig.returns.push(AbiParam::new(types::I64));
+            }
+            let func_id = self.module.declare_function(name, Linkage::Import, &sig)
+                .map_err(|e| IRError::Module(e))?;
+            self.functions.insert(name.to_string(), func_id);
+        }
         
         Ok(())
     }
 
+    // Fields are laid out by decreasing alignment rather than in declaration
+    // order, so padding is only left at the end: `bool, int, bool, int`
+    // takes 24 bytes instead of 32. Rono makes no promise about the order of
+    // fields in memory; fields of equal alignment keep their declared order.
     fn process_struct_definition(&mut self, struct_def: &StructDef) -> Result<(), IRError> {
-        // Calculate struct layout and field offsets
-        let mut fields = Vec::new();
+        let mut fields = Vec::with_capacity(struct_def.fields.len());
+        for field in &struct_def.fields {
+            let alignment = Self::get_type_alignment(&field.field_type)?;
+            fields.push((alignment, field.name.clone(), field.field_type.clone()));
+        }
+        fields.sort_by(|a, b| b.0.cmp(&a.0));
+        let fields: Vec<(String, ChifType)> = fields.into_iter().map(|(_, name, field_type)| (name, field_type)).collect();
+        
+        // A struct without fields has no columns to split into
+        let soa = struct_def.soa && !fields.is_empty();
+        let layout = Self::sequential_layout(&struct_def.name, &fields, soa)?;
+        self.structs.insert(struct_def.name.clone(), Rc::new(layout));
+        
+        Ok(())
+    }
+    
+    // Layout with the fields in the given order, each at the next offset
+    // aligned for it
+    fn sequential_layout(name: &str, fields: &[(String, ChifType)], soa: bool) -> Result<StructLayout, IRError> {
+        let mut layout_fields = Vec::with_capacity(fields.len());
         let mut current_offset = 0u32;
+        let mut column = 0u32;
         let mut max_alignment = 1u32;
         
-        for field in &struct_def.fields {
-            let field_size = Self::get_type_size(&field.field_type)?;
-            let field_alignment = Self::get_type_alignment(&field.field_type)?;
-            
-            // Update maximum alignment
+        for (field_name, field_type) in fields {
+            let field_size = Self::get_type_size(field_type)?;
+            let field_alignment = Self::get_type_alignment(field_type)?;
             max_alignment = max_alignment.max(field_alignment);
-            
-            // Align current offset to field alignment
             current_offset = Self::align_to(current_offset, field_alignment);
             
-            fields.push(StructFieldLayout {
-                name: field.name.clone(),
-                field_type: field.field_type.clone(),
+            layout_fields.push(StructFieldLayout {
+                name: field_name.clone(),
+                field_type: field_type.clone(),
                 offset: current_offset,
                 size: field_size,
+                column,
             });
             
             current_offset += field_size;
+            column += field_size;
         }
         
-        // Align total size to struct alignment
-        let total_size = Self::align_to(current_offset, max_alignment);
-        
-        let layout = StructLayout {
-            name: struct_def.name.clone(),
-            fields,
-            size: total_size,
+        Ok(StructLayout {
+            name: name.to_string(),
+            fields: layout_fields,
+            size: Self::align_to(current_offset, max_alignment),
             alignment: max_alignment,
-        };
-        
-        self.structs.insert(struct_def.name.clone(), layout);
-        
-        Ok(())
+            soa,
+        })
+    }
+    
+    // RonoHttpResponse in runtime.c, the elements of the http.get_many and
+    // http.request_many results; its fields stay in the C declaration order
+    fn http_response_layout() -> Result<StructLayout, IRError> {
+        let fields = [
+            ("status".to_string(), ChifType::Int),
+            ("body".to_string(), ChifType::Str),
+            ("content_type".to_string(), ChifType::Str),
+        ];
+        Self::sequential_layout("HttpResponse", &fields, false)
     }
 
     fn get_type_size(chif_type: &ChifType) -> Result<u32, IRError> {
@@ -1192,11 +2371,8 @@ impl IRGenerator {
             ChifType::Str => Ok(8),      // pointer
             ChifType::Nil => Ok(0),
             ChifType::Pointer(_) => Ok(8), // pointer size
-            ChifType::Struct(name) => {
-                // For now, return a placeholder size
-                // In a full implementation, we would look up the struct size
-                Ok(16) // placeholder
-            }
+            ChifType::Array(..) | ChifType::List(..) | ChifType::Map(..) => Ok(8), // handle
+            ChifType::Struct(_) => Ok(8), // struct values are held by pointer
             _ => Err(IRError::UnsupportedFeature(format!("Type size calculation not implemented for: {:?}", chif_type))),
         }
     }
@@ -1209,7 +2385,8 @@ impl IRGenerator {
             ChifType::Str => Ok(8),      // pointer alignment
             ChifType::Nil => Ok(1),
             ChifType::Pointer(_) => Ok(8), // pointer alignment
-            ChifType::Struct(_) => Ok(8),  // struct alignment (max field alignment)
+            ChifType::Array(..) | ChifType::List(..) | ChifType::Map(..) => Ok(8), // handle alignment
+            ChifType::Struct(_) => Ok(8),  // pointer alignment
             _ => Err(IRError::UnsupportedFeature(format!("Type alignment calculation not implemented for: {:?}", chif_type))),
         }
     }
@@ -1217,45 +2394,107 @@ impl IRGenerator {
     fn align_to(value: u32, alignment: u32) -> u32 {
         (value + alignment - 1) & !(alignment - 1)
     }
+    
+    fn struct_layout(name: &str) -> Option<Rc<StructLayout>> {
+        STRUCT_LAYOUTS.with(|layouts| layouts.borrow().get(name).cloned())
+    }
+    
+    // Layout of element_type if it is a `soa struct`
+    fn soa_layout(element_type: &ChifType) -> Option<Rc<StructLayout>> {
+        match element_type {
+            ChifType::Struct(name) => Self::struct_layout(name).filter(|layout| layout.soa),
+            _ => None,
+        }
+    }
+    
+    // Layout of the `soa struct` a list holds directly; lists of lists of
+    // it hold ordinary list handles, and only the innermost lists are split
+    fn soa_list_layout(list_type: &ChifType) -> Option<Rc<StructLayout>> {
+        match list_type {
+            ChifType::List(..) => Self::soa_layout(&Self::collection_element_type(list_type)?),
+            _ => None,
+        }
+    }
+    
+    // The field obj.field refers to: found through the struct type of obj,
+    // or, where that isn't known (results of calls, dereferences), by name
+    // if every struct with such a field has it at the same offset and type
+    fn resolve_field(
+        object: &Expression,
+        field_name: &str,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &M
+    ) -> Result<StructFieldLayout, IRError> {
+        if let Some(ChifType::Struct(struct_name)) = Self::infer_expression_type(object, variable_types, functions, module) {
+            let layout = Self::struct_layout(&struct_name)
+                .ok_or_else(|| IRError::Generation(format!("Unknown struct: {}", struct_name)))?;
+            return layout.field(field_name).cloned()
+                .ok_or_else(|| IRError::Generation(format!("Struct '{}' has no field '{}'", struct_name, field_name)));
+        }
+        
+        STRUCT_LAYOUTS.with(|layouts| {
+            let layouts = layouts.borrow();
+            let mut candidates = layouts.values().filter_map(|layout| layout.field(field_name));
+            let first = candidates.next()
+                .ok_or_else(|| IRError::Generation(format!("Unknown field: {}", field_name)))?;
+            if candidates.all(|other| other.offset == first.offset && other.field_type == first.field_type) {
+                Ok(first.clone())
+            } else {
+                Err(IRError::Generation(format!(
+                    "Field '{}' is laid out differently in several structs; give the object a struct type", field_name
+                )))
+            }
+        })
+    }
+    
+    // A new struct block in the stack frame, uninitialized
+    fn generate_struct_block(builder: &mut FunctionBuilder, layout: &StructLayout) -> Value {
+        let stack_slot = builder.create_sized_stack_slot(StackSlotData::new(
+            StackSlotKind::ExplicitSlot,
+            layout.size.max(8),
+        ));
+        builder.ins().stack_addr(types::I64, stack_slot, 0)
+    }
+    
+    // A field at its own size; `nil` fields take no space and read as 0
+    fn load_packed(builder: &mut FunctionBuilder, field: &StructFieldLayout, addr: Value, offset: i32) -> Result<Value, IRError> {
+        if field.size == 0 {
+            return Ok(builder.ins().iconst(types::I64, 0));
+        }
+        let field_type = Self::chif_type_to_cranelift(&field.field_type)?;
+        Ok(builder.ins().load(field_type, MemFlags::trusted(), addr, offset))
+    }
+    
+    fn store_packed(builder: &mut FunctionBuilder, value: Value, field: &StructFieldLayout, addr: Value, offset: i32) {
+        if field.size > 0 {
+            Self::store_array_element(builder, value, &field.field_type, addr, offset);
+        }
+    }
 
+    // Struct values are held by pointer to a block in the stack frame with
+    // the fields at their StructLayout offsets. Field values are evaluated
+    // in the order they are written.
     fn generate_struct_instantiation(
         builder: &mut FunctionBuilder,
         struct_literal: &StructLiteral,
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
-        // For now, we'll implement a simple version that allocates memory on the stack
-        // In a full implementation, we would:
-        // 1. Look up the struct layout
-        // 2. Allocate memory (stack or heap)
-        // 3. Initialize fields with provided values
-        // 4. Return pointer to the struct
-        
-        // For this implementation, we'll create a simple struct representation
-        // We'll allocate space for each field and store them sequentially
-        
-        // Calculate total size needed (simplified - assume each field is 8 bytes)
-        let field_count = struct_literal.fields.len() as i64;
-        let total_size = field_count * 8; // 8 bytes per field
-        
-        // Allocate stack space (simplified approach)
-        let stack_slot = builder.create_sized_stack_slot(StackSlotData::new(
-            StackSlotKind::ExplicitSlot,
-            total_size as u32,
-        ));
-        
-        // Get pointer to the allocated memory
-        let struct_ptr = builder.ins().stack_addr(types::I64, stack_slot, 0);
+        let layout = Self::struct_layout(&struct_literal.struct_name)
+            .ok_or_else(|| IRError::Generation(format!("Unknown struct: {}", struct_literal.struct_name)))?;
+        let struct_ptr = Self::generate_struct_block(builder, &layout);
         
-        // Initialize fields
-        for (i, (field_name, field_expr)) in struct_literal.fields.iter().enumerate() {
-            let field_value = Self::generate_expression_static(builder, field_expr, variables, functions, module)?;
-            let offset = (i * 8) as i32; // 8 bytes per field
-            builder.ins().store(MemFlags::new(), field_value, struct_ptr, offset);
+        for (field_name, field_expr) in &struct_literal.fields {
+            let field = layout.field(field_name).ok_or_else(|| IRError::Generation(format!(
+                "Struct '{}' has no field '{}'", struct_literal.struct_name, field_name
+            )))?;
+            let field_value = Self::generate_typed_value(builder, &field.field_type, field_expr, variables, variable_types, functions, module)?;
+            Self::store_packed(builder, field_value, field, struct_ptr, field.offset as i32);
         }
         
-        // Return pointer to the struct
         Ok(struct_ptr)
     }
     
@@ -1263,60 +2502,144 @@ impl IRGenerator {
         builder: &mut FunctionBuilder,
         field_access: &FieldAccess,
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
-        // Generate the object expression (should be a struct pointer)
-        let struct_ptr = Self::generate_expression_static(builder, &field_access.object, variables, functions, module)?;
-        
-        // For now, we'll use a simple field offset calculation
-        // In a full implementation, we would:
-        // 1. Look up the struct type from the object expression
-        // 2. Find the field offset from the struct layout
-        // 3. Load the value from memory at struct_ptr + offset
-        
-        // For this simplified implementation, we'll assume fields are stored sequentially
-        // and each field is 8 bytes. We'll need to know the field index.
-        
-        // This is a simplified approach - in reality we'd need struct layout information
-        let field_offset = match field_access.field.as_str() {
-            "x" => 0,  // First field
-            "y" => 8,  // Second field  
-            "width" => 0,  // First field for Rectangle
-            "height" => 8, // Second field for Rectangle
-            _ => return Err(IRError::Generation(format!("Unknown field: {}", field_access.field))),
-        };
+        let field_ref = Self::generate_field_ref(builder, field_access, variables, variable_types, functions, module)?;
+        match field_ref.place {
+            FieldPlace::Packed => Self::load_packed(builder, &field_ref.field, field_ref.addr, field_ref.offset),
+            FieldPlace::Slot => {
+                let slot = builder.ins().load(types::I64, MemFlags::trusted(), field_ref.addr, field_ref.offset);
+                Ok(Self::from_slot(builder, slot, &field_ref.field.field_type))
+            }
+        }
+    }
+    
+    // obj.field = value; the value is evaluated before the target, as in
+    // the interpreter
+    fn generate_field_assignment(
+        builder: &mut FunctionBuilder,
+        field_access: &FieldAccess,
+        value: &Expression,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        let field = Self::resolve_field(&field_access.object, &field_access.field, variable_types, functions, module)?;
+        let value = Self::generate_typed_value(builder, &field.field_type, value, variables, variable_types, functions, module)?;
+        let field_ref = Self::generate_field_ref(builder, field_access, variables, variable_types, functions, module)?;
+        match field_ref.place {
+            FieldPlace::Packed => Self::store_packed(builder, value, &field_ref.field, field_ref.addr, field_ref.offset),
+            FieldPlace::Slot => {
+                let slot = Self::to_slot(builder, value, &field_ref.field.field_type);
+                builder.ins().store(MemFlags::trusted(), slot, field_ref.addr, field_ref.offset);
+            }
+        }
+        Ok(())
+    }
+    
+    // Where obj.field is kept. A field of an element of a struct-of-arrays
+    // list or array is addressed in its column, without gathering the
+    // element into a struct first.
+    fn generate_field_ref(
+        builder: &mut FunctionBuilder,
+        field_access: &FieldAccess,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<FieldRef, IRError> {
+        if let Expression::Index(index_access) = &*field_access.object {
+            if let Some(field_ref) = Self::generate_soa_field_ref(
+                builder, index_access, &field_access.field, variables, variable_types, functions, module,
+            )? {
+                return Ok(field_ref);
+            }
+        }
         
-        // Load the field value from memory
-        let field_value = builder.ins().load(types::I64, MemFlags::new(), struct_ptr, field_offset);
-        Ok(field_value)
+        let field = Self::resolve_field(&field_access.object, &field_access.field, variable_types, functions, module)?;
+        let struct_ptr = Self::generate_expression_static(builder, &field_access.object, variables, variable_types, functions, module)?;
+        Ok(FieldRef { addr: struct_ptr, offset: field.offset as i32, field, place: FieldPlace::Packed })
     }
     
-    fn generate_struct_method_call(
+    // collection[...][i].field for a collection of a `soa struct`; None when
+    // the element is stored any other way
+    fn generate_soa_field_ref(
         builder: &mut FunctionBuilder,
-        method_call: &MethodCall,
+        index_access: &IndexAccess,
+        field_name: &str,
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
-    ) -> Result<Value, IRError> {
-        // Generate the object (self parameter)
-        let self_value = Self::generate_expression_static(builder, &method_call.object, variables, functions, module)?;
-        
-        // For now, we'll assume the method name follows the pattern StructName_methodName
-        // In a real implementation, we would need to determine the struct type from the object
-        // For this simplified version, we'll try common struct names
-        let possible_method_names = vec![
-            format!("Point_{}", method_call.method),
-            format!("Rectangle_{}", method_call.method),
-            // Add more struct names as needed
-        ];
+        module: &mut M
+    ) -> Result<Option<FieldRef>, IRError> {
+        let object_type = match Self::infer_expression_type(&index_access.object, variable_types, functions, module) {
+            Some(object_type) => object_type,
+            None => return Ok(None),
+        };
+        let no_field = |layout: &StructLayout| IRError::Generation(format!("Struct '{}' has no field '{}'", layout.name, field_name));
         
-        for method_name in possible_method_names {
-            if let Some(&func_id) = functions.get(&method_name) {
+        if let ChifType::Array(..) = object_type {
+            let layout = match Self::array_shape(&object_type).and_then(|(element_type, _)| Self::soa_layout(&element_type)) {
+                Some(layout) => layout,
+                None => return Ok(None),
+            };
+            let field = layout.field(field_name).cloned().ok_or_else(|| no_field(&layout))?;
+            let array = Self::generate_expression_static(builder, &index_access.object, variables, variable_types, functions, module)?;
+            let element = Self::generate_array_flat_index(
+                builder, array, &object_type, &index_access.indices, variables, variable_types, functions, module,
+            )?;
+            let addr = Self::soa_column_addr(builder, &field, &element);
+            return Ok(Some(FieldRef { addr, offset: 0, field, place: FieldPlace::Packed }));
+        }
+        
+        let (last, path) = match index_access.indices.split_last() {
+            Some(split) => split,
+            None => return Ok(None),
+        };
+        let layout = match Self::indexed_type(&object_type, path.len()).and_then(|list_type| Self::soa_list_layout(&list_type)) {
+            Some(layout) => layout,
+            None => return Ok(None),
+        };
+        let column_index = layout.field_index(field_name).ok_or_else(|| no_field(&layout))?;
+        let object = Self::generate_expression_static(builder, &index_access.object, variables, variable_types, functions, module)?;
+        let (list, _) = Self::generate_collection_path(
+            builder, object, object_type, path, variables, variable_types, functions, module,
+        )?;
+        let index = Self::generate_expression_static(builder, last, variables, variable_types, functions, module)?;
+        let column = builder.ins().load(types::I64, MemFlags::trusted(), list, (column_index * 8) as i32);
+        let addr = Self::generate_list_element_addr(builder, column, index, functions, module)?;
+        Ok(Some(FieldRef { addr, offset: 0, field: layout.fields[column_index].clone(), place: FieldPlace::Slot }))
+    }
+    
+    fn generate_struct_method_call(
+        builder: &mut FunctionBuilder,
+        method_call: &MethodCall,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        // Generate the object (self parameter)
+        let self_value = Self::generate_expression_static(builder, &method_call.object, variables, variable_types, functions, module)?;
+        
+        // Methods are named StructName_methodName: the struct type of the
+        // object when it is known, otherwise we try common struct names
+        let mut possible_method_names = Vec::new();
+        if let Some(ChifType::Struct(struct_name)) = Self::infer_expression_type(&method_call.object, variable_types, functions, module) {
+            possible_method_names.push(format!("{}_{}", struct_name, method_call.method));
+        }
+        possible_method_names.push(format!("Point_{}", method_call.method));
+        possible_method_names.push(format!("Rectangle_{}", method_call.method));
+        
+        for method_name in possible_method_names {
+            if let Some(&func_id) = functions.get(&method_name) {
                 // Generate arguments (self + other arguments)
                 let mut args = vec![self_value];
                 for arg in &method_call.args {
-                    let arg_value = Self::generate_expression_static(builder, arg, variables, functions, module)?;
+                    let arg_value = Self::generate_expression_static(builder, arg, variables, variable_types, functions, module)?;
                     args.push(arg_value);
                 }
                 
@@ -1338,127 +2661,1157 @@ impl IRGenerator {
         Err(IRError::Generation(format!("Method '{}' not found", method_call.method)))
     }
     
+    // Fixed-size arrays are one block: a header with the length of every
+    // dimension (one i64 each), then the elements packed in row-major order
+    // at their natural size (bool 1 byte, int and float 8, strings and other
+    // values by pointer). `array int[N][M]` and nested literals of
+    // `array[array[T]]` share this layout, so element (i, j) sits at
+    // header + (i * M + j) * size. Arrays of a `soa struct` store one column
+    // per field instead, each field's column packed at its own size (see
+    // soa_column_addr). Arrays that never leave their function and fit in
+    // ARRAY_STACK_LIMIT live in its stack frame; the rest are allocated by
+    // rono_array_new and live until the program exits, like lists.
+    fn generate_array_value(
+        builder: &mut FunctionBuilder,
+        array_type: &ChifType,
+        value: Option<&Expression>,
+        on_stack: bool,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let (element_type, mut dims) = Self::array_shape(array_type)
+            .ok_or_else(|| IRError::Generation(format!("Not an array type: {:?}", array_type)))?;
+        let mut leaves = Vec::new();
+        match value {
+            Some(Expression::ArrayLiteral(elements)) => {
+                let mut shape: Vec<Option<usize>> = dims.iter().map(|&dim| Some(dim).filter(|&dim| dim > 0)).collect();
+                Self::flatten_array_literal(elements, &mut shape, &mut leaves)?;
+                dims = shape.into_iter().map(|dim| dim.unwrap_or(0)).collect();
+            }
+            Some(other) => return Self::generate_expression_static(builder, other, variables, variable_types, functions, module),
+            None => {}
+        }
+        
+        let element_size = Self::array_element_size(&element_type)?;
+        let count: usize = dims.iter().product();
+        let header_size = dims.len() * 8;
+        let total_size = Self::align_to((header_size + count * element_size as usize) as u32, 8);
+        // Strings in an array that doesn't escape (on_stack as passed in,
+        // whatever its size) can stay in the function's region
+        let escapes = !on_stack;
+        let on_stack = on_stack && total_size <= ARRAY_STACK_LIMIT;
+        let array = if on_stack {
+            let slot = builder.create_sized_stack_slot(StackSlotData::new(StackSlotKind::ExplicitSlot, total_size));
+            builder.ins().stack_addr(types::I64, slot, 0)
+        } else {
+            let size = builder.ins().iconst(types::I64, total_size as i64);
+            Self::call_runtime_value(builder, "rono_array_new", &[size], functions, module)?
+                .ok_or_else(|| IRError::Generation("rono_array_new returns no value".to_string()))?
+        };
+        
+        for (i, &dim) in dims.iter().enumerate() {
+            let dim = builder.ins().iconst(types::I64, dim as i64);
+            builder.ins().store(MemFlags::trusted(), dim, array, (i * 8) as i32);
+        }
+        if leaves.is_empty() {
+            // Stack memory is not zeroed like rono_array_new's
+            if on_stack {
+                let zero = builder.ins().iconst(types::I64, 0);
+                for offset in (header_size as u32..total_size).step_by(8) {
+                    builder.ins().store(MemFlags::trusted(), zero, array, offset as i32);
+                }
+            }
+        } else if let Some(layout) = Self::soa_layout(&element_type) {
+            let data = builder.ins().iadd_imm(array, header_size as i64);
+            let count = builder.ins().iconst(types::I64, count as i64);
+            for (i, leaf) in leaves.into_iter().enumerate() {
+                let struct_ptr = Self::generate_typed_value(builder, &element_type, leaf, variables, variable_types, functions, module)?;
+                let flat = builder.ins().iconst(types::I64, i as i64);
+                let element = ArrayElement { data, count, flat, element_type: element_type.clone() };
+                Self::generate_soa_array_store(builder, &layout, &element, struct_ptr, escapes, functions, module)?;
+            }
+        } else {
+            for (i, leaf) in leaves.into_iter().enumerate() {
+                let value = Self::generate_typed_value(builder, &element_type, leaf, variables, variable_types, functions, module)?;
+                let value = if escapes { Self::generate_persist(builder, value, &element_type, functions, module)? } else { value };
+                let offset = header_size + i * element_size as usize;
+                Self::store_array_element(builder, value, &element_type, array, offset as i32);
+            }
+        }
+        Ok(array)
+    }
+    
+    // Array literal outside a typed declaration; the element type is taken
+    // from the first element
     fn generate_array_literal(
         builder: &mut FunctionBuilder,
         elements: &[Expression],
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
-        if elements.is_empty() {
-            // Empty array - return null pointer
-            return Ok(builder.ins().iconst(types::I64, 0));
+        let mut depth = 1;
+        let mut first = elements.first();
+        while let Some(Expression::ArrayLiteral(inner)) = first {
+            depth += 1;
+            first = inner.first();
+        }
+        let element_type = first
+            .and_then(|element| Self::infer_expression_type(element, variable_types, functions, module))
+            .unwrap_or(ChifType::Int);
+        let array_type = ChifType::Array(Box::new(element_type), vec![0; depth]);
+        let literal = Expression::ArrayLiteral(elements.to_vec());
+        Self::generate_array_value(builder, &array_type, Some(&literal), false, variables, variable_types, functions, module)
+    }
+    
+    // Element type and dimensions of an array type, nested array types
+    // flattened into one list of dimensions; 0 is a length not known
+    // from the type
+    fn array_shape(array_type: &ChifType) -> Option<(ChifType, Vec<usize>)> {
+        match array_type {
+            ChifType::Array(element_type, dims) => {
+                let mut shape = if dims.is_empty() { vec![0] } else { dims.clone() };
+                let element_type = match Self::array_shape(element_type) {
+                    Some((inner_type, inner_dims)) => {
+                        shape.extend(inner_dims);
+                        inner_type
+                    }
+                    None => (**element_type).clone(),
+                };
+                Some((element_type, shape))
+            }
+            _ => None,
+        }
+    }
+    
+    // Collects the elements of a (nested) literal in row-major order,
+    // filling in and checking the dimensions
+    fn flatten_array_literal<'e>(elements: &'e [Expression], shape: &mut [Option<usize>], leaves: &mut Vec<&'e Expression>) -> Result<(), IRError> {
+        let (dim, inner_dims) = shape.split_first_mut()
+            .ok_or_else(|| IRError::Generation("Array literal has more dimensions than its type".to_string()))?;
+        match *dim {
+            None => *dim = Some(elements.len()),
+            Some(expected) if expected != elements.len() => {
+                return Err(IRError::Generation(format!(
+                    "Array literal has {} elements where {} are expected; rows of an array must have the same length",
+                    elements.len(), expected
+                )));
+            }
+            Some(_) => {}
+        }
+        for element in elements {
+            if inner_dims.is_empty() {
+                leaves.push(element);
+            } else if let Expression::ArrayLiteral(row) = element {
+                Self::flatten_array_literal(row, inner_dims, leaves)?;
+            } else {
+                return Err(IRError::UnsupportedFeature("Rows of a multidimensional array must be array literals".to_string()));
+            }
+        }
+        Ok(())
+    }
+    
+    fn array_element_size(element_type: &ChifType) -> Result<u32, IRError> {
+        match element_type {
+            // Struct values are held by pointer, except that an element of a
+            // struct-of-arrays array is spread over the columns
+            ChifType::Struct(_) => Ok(Self::soa_layout(element_type).map_or(8, |layout| layout.row_size())),
+            ChifType::Nil => Ok(8),
+            other => Self::get_type_size(other),
+        }
+    }
+    
+    fn store_array_element(builder: &mut FunctionBuilder, value: Value, element_type: &ChifType, array: Value, offset: i32) {
+        let value = match (element_type, builder.func.dfg.value_type(value)) {
+            (ChifType::Float, types::I64) => builder.ins().fcvt_from_sint(types::F64, value),
+            (ChifType::Bool, types::I64) => builder.ins().ireduce(types::I8, value),
+            (ChifType::Float | ChifType::Bool, _) => value,
+            (_, types::I64) => value,
+            _ => builder.ins().uextend(types::I64, value),
+        };
+        builder.ins().store(MemFlags::trusted(), value, array, offset);
+    }
+    
+    // Address of an element stored whole (not in struct-of-arrays columns)
+    fn array_element_addr(builder: &mut FunctionBuilder, element: &ArrayElement) -> Result<Value, IRError> {
+        let element_size = Self::array_element_size(&element.element_type)?;
+        let offset = builder.ins().imul_imm(element.flat, element_size as i64);
+        Ok(builder.ins().iadd(element.data, offset))
+    }
+    
+    // Row-major position of array[i][j]... Each index is checked against
+    // its dimension in the header; those loads are marked readonly (the
+    // header never changes after allocation), so Cranelift hoists them out
+    // of loops together with the rest of the address arithmetic that does
+    // not depend on the loop.
+    fn generate_array_flat_index(
+        builder: &mut FunctionBuilder,
+        array: Value,
+        array_type: &ChifType,
+        indices: &[Expression],
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<ArrayElement, IRError> {
+        let (element_type, dims) = Self::array_shape(array_type)
+            .ok_or_else(|| IRError::Generation(format!("Cannot index value of type {:?}", array_type)))?;
+        if indices.len() != dims.len() {
+            return Err(IRError::UnsupportedFeature(format!(
+                "Array with {} dimensions indexed with {} indices; compiled code only reads single elements",
+                dims.len(), indices.len()
+            )));
         }
         
-        // Calculate total size needed (assume each element is 8 bytes for now)
-        let element_count = elements.len() as i64;
-        let total_size = element_count * 8; // 8 bytes per element
+        let header_flags = MemFlags::trusted().with_readonly();
+        let mut flat = builder.ins().iconst(types::I64, 0);
+        let mut count = builder.ins().iconst(types::I64, 1);
+        for (i, index_expr) in indices.iter().enumerate() {
+            let index = Self::generate_expression_static(builder, index_expr, variables, variable_types, functions, module)?;
+            let len = builder.ins().load(types::I64, header_flags, array, (i * 8) as i32);
+            
+            let error_block = builder.create_block();
+            let ok_block = builder.create_block();
+            builder.set_cold_block(error_block);
+            // Unsigned, so negative indices fail the same check
+            let in_bounds = builder.ins().icmp(IntCC::UnsignedLessThan, index, len);
+            builder.ins().brif(in_bounds, ok_block, &[], error_block, &[]);
+            
+            builder.switch_to_block(error_block);
+            builder.seal_block(error_block);
+            Self::call_runtime_value(builder, "rono_index_error", &[index, len], functions, module)?;
+            builder.ins().trap(TrapCode::UnreachableCodeReached);
+            
+            builder.switch_to_block(ok_block);
+            builder.seal_block(ok_block);
+            let scaled = builder.ins().imul(flat, len);
+            flat = builder.ins().iadd(scaled, index);
+            count = builder.ins().imul(count, len);
+        }
         
-        // Allocate stack space
-        let stack_slot = builder.create_sized_stack_slot(StackSlotData::new(
-            StackSlotKind::ExplicitSlot,
-            total_size as u32,
-        ));
+        let data = builder.ins().iadd_imm(array, (dims.len() * 8) as i64);
+        Ok(ArrayElement { data, count, flat, element_type })
+    }
+    
+    fn generate_array_index(
+        builder: &mut FunctionBuilder,
+        index_access: &IndexAccess,
+        array_type: &ChifType,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let array = Self::generate_expression_static(builder, &index_access.object, variables, variable_types, functions, module)?;
+        let element = Self::generate_array_flat_index(
+            builder, array, array_type, &index_access.indices, variables, variable_types, functions, module,
+        )?;
+        if let Some(layout) = Self::soa_layout(&element.element_type) {
+            return Self::generate_soa_array_load(builder, &layout, &element);
+        }
+        let addr = Self::array_element_addr(builder, &element)?;
+        let element_type = Self::chif_type_to_cranelift(&element.element_type)?;
+        Ok(builder.ins().load(element_type, MemFlags::trusted(), addr, 0))
+    }
+    
+    // Start of a field's column plus the element's position in it: the
+    // columns follow each other in layout order, each `count` elements of
+    // the field's size long
+    fn soa_column_addr(builder: &mut FunctionBuilder, field: &StructFieldLayout, element: &ArrayElement) -> Value {
+        let column = builder.ins().imul_imm(element.count, field.column as i64);
+        let offset = builder.ins().imul_imm(element.flat, field.size as i64);
+        let column_start = builder.ins().iadd(element.data, column);
+        builder.ins().iadd(column_start, offset)
+    }
+    
+    // Gathers an element of a struct-of-arrays array into a new struct
+    fn generate_soa_array_load(builder: &mut FunctionBuilder, layout: &StructLayout, element: &ArrayElement) -> Result<Value, IRError> {
+        let struct_ptr = Self::generate_struct_block(builder, layout);
+        for field in &layout.fields {
+            let addr = Self::soa_column_addr(builder, field, element);
+            let value = Self::load_packed(builder, field, addr, 0)?;
+            Self::store_packed(builder, value, field, struct_ptr, field.offset as i32);
+        }
+        Ok(struct_ptr)
+    }
+    
+    // Scatters the struct at struct_ptr into an element of a struct-of-arrays
+    // array; string fields are copied to the heap when the array escapes
+    fn generate_soa_array_store(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        element: &ArrayElement,
+        struct_ptr: Value,
+        escapes: bool,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        for field in &layout.fields {
+            let value = Self::load_packed(builder, field, struct_ptr, field.offset as i32)?;
+            let value = if escapes { Self::generate_persist(builder, value, &field.field_type, functions, module)? } else { value };
+            let addr = Self::soa_column_addr(builder, field, element);
+            Self::store_packed(builder, value, field, addr, 0);
+        }
+        Ok(())
+    }
+    
+    // Key marking a local array variable that can live in the stack frame
+    // (see stack_arrays); `$` keeps it apart from user variables
+    fn stack_array_key(name: &str) -> String {
+        format!("$stack:{}", name)
+    }
+    
+    // Array variables declared in a function body whose value is only
+    // indexed, measured with len() or assigned a new literal. Any other use
+    // (returning it, passing it to a function, storing it in a collection or
+    // another variable) may outlive the frame, so those arrays go on the heap.
+    fn stack_arrays(statements: &[Statement]) -> HashSet<String> {
+        let mut declared = HashSet::new();
+        let mut escaped = HashSet::new();
+        for statement in statements {
+            Self::note_array_uses_in_statement(statement, &mut declared, &mut escaped);
+        }
+        declared.retain(|name| !escaped.contains(name));
+        declared
+    }
+    
+    fn note_array_uses_in_statement(statement: &Statement, declared: &mut HashSet<String>, escaped: &mut HashSet<String>) {
+        let block = |block: &crate::ast::Block, declared: &mut HashSet<String>, escaped: &mut HashSet<String>| {
+            for statement in &block.statements {
+                Self::note_array_uses_in_statement(statement, declared, escaped);
+            }
+        };
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                if let ChifType::Array(..) = var_decl.var_type {
+                    declared.insert(var_decl.name.clone());
+                }
+                if let Some(value) = &var_decl.value {
+                    Self::note_array_uses(value, escaped);
+                }
+            }
+            Statement::Assignment(assignment) => {
+                match &assignment.target {
+                    Expression::Identifier(_) => {}
+                    Expression::Index(index_access) => Self::note_indexed_uses(index_access, escaped),
+                    other => Self::note_array_uses(other, escaped),
+                }
+                Self::note_array_uses(&assignment.value, escaped);
+            }
+            Statement::Expression(expr) => Self::note_array_uses(expr, escaped),
+            Statement::If(if_stmt) => {
+                Self::note_array_uses(&if_stmt.condition, escaped);
+                block(&if_stmt.then_block, declared, escaped);
+                if let Some(else_block) = &if_stmt.else_block {
+                    block(else_block, declared, escaped);
+                }
+            }
+            Statement::For(for_stmt) => {
+                if let Some(init) = &for_stmt.init {
+                    Self::note_array_uses_in_statement(init, declared, escaped);
+                }
+                if let Some(condition) = &for_stmt.condition {
+                    Self::note_array_uses(condition, escaped);
+                }
+                if let Some(update) = &for_stmt.update {
+                    Self::note_array_uses_in_statement(update, declared, escaped);
+                }
+                block(&for_stmt.body, declared, escaped);
+            }
+            Statement::While(while_stmt) => {
+                Self::note_array_uses(&while_stmt.condition, escaped);
+                block(&while_stmt.body, declared, escaped);
+            }
+            Statement::Switch(switch) => {
+                Self::note_array_uses(&switch.expr, escaped);
+                for case in &switch.cases {
+                    Self::note_array_uses(&case.value, escaped);
+                    block(&case.body, declared, escaped);
+                }
+                if let Some(default_case) = &switch.default_case {
+                    block(default_case, declared, escaped);
+                }
+            }
+            Statement::ParFor(par_for) => {
+                Self::note_array_uses(&par_for.start, escaped);
+                Self::note_array_uses(&par_for.end, escaped);
+                block(&par_for.body, declared, escaped);
+            }
+            Statement::Return(Some(expr)) => Self::note_array_uses(expr, escaped),
+            Statement::Return(None) | Statement::Break | Statement::Continue => {}
+        }
+    }
+    
+    // Marks every variable used as a value in expr as escaped
+    fn note_array_uses(expr: &Expression, escaped: &mut HashSet<String>) {
+        match expr {
+            Expression::Identifier(name) | Expression::Local(LocalVar { name, .. }) => {
+                escaped.insert(name.clone());
+            }
+            Expression::Literal(_) => {}
+            Expression::Binary(binary_op) => {
+                Self::note_array_uses(&binary_op.left, escaped);
+                Self::note_array_uses(&binary_op.right, escaped);
+            }
+            Expression::Unary(unary_op) => Self::note_array_uses(&unary_op.operand, escaped),
+            Expression::Call(func_call) => {
+                for arg in &func_call.args {
+                    Self::note_array_uses(arg, escaped);
+                }
+            }
+            Expression::MethodCall(method_call) => {
+                let measured = method_call.method == "len" && method_call.args.is_empty()
+                    && matches!(*method_call.object, Expression::Identifier(_));
+                if !measured {
+                    Self::note_array_uses(&method_call.object, escaped);
+                }
+                for arg in &method_call.args {
+                    Self::note_array_uses(arg, escaped);
+                }
+            }
+            Expression::Index(index_access) => Self::note_indexed_uses(index_access, escaped),
+            Expression::FieldAccess(field_access) => Self::note_array_uses(&field_access.object, escaped),
+            Expression::ArrayLiteral(elements) => {
+                for element in elements {
+                    Self::note_array_uses(element, escaped);
+                }
+            }
+            Expression::MapLiteral(pairs) => {
+                for (key, value) in pairs {
+                    Self::note_array_uses(key, escaped);
+                    Self::note_array_uses(value, escaped);
+                }
+            }
+            Expression::StructLiteral(struct_literal) => {
+                for (_, value) in &struct_literal.fields {
+                    Self::note_array_uses(value, escaped);
+                }
+            }
+            Expression::Reference(inner) | Expression::Dereference(inner) => Self::note_array_uses(inner, escaped),
+            Expression::Template(template) => {
+                for part in &template.parts {
+                    if let TemplatePart::Hole { expr, .. } = part {
+                        Self::note_array_uses(expr, escaped);
+                    }
+                }
+            }
+        }
+    }
+    
+    // Indexing a variable reads (or writes) one element; the array itself
+    // stays put
+    fn note_indexed_uses(index_access: &IndexAccess, escaped: &mut HashSet<String>) {
+        if !matches!(*index_access.object, Expression::Identifier(_)) {
+            Self::note_array_uses(&index_access.object, escaped);
+        }
+        for index in &index_access.indices {
+            Self::note_array_uses(index, escaped);
+        }
+    }
+
+    // Element type of a list or map: one dimension less for nested lists,
+    // the value type for maps
+    fn collection_element_type(collection_type: &ChifType) -> Option<ChifType> {
+        match collection_type {
+            ChifType::List(element_type, dimensions) if dimensions.len() > 1 => {
+                Some(ChifType::List(element_type.clone(), dimensions[1..].to_vec()))
+            }
+            ChifType::List(element_type, _) => Some((**element_type).clone()),
+            ChifType::Map(_, value_type) => Some((**value_type).clone()),
+            _ => None,
+        }
+    }
+    
+    // Type reached by indexing a collection depth times
+    fn indexed_type(collection_type: &ChifType, depth: usize) -> Option<ChifType> {
+        let mut current = collection_type.clone();
+        for _ in 0..depth {
+            current = Self::collection_element_type(&current)?;
+        }
+        Some(current)
+    }
+    
+    fn collection_kind(element_type: &ChifType) -> i64 {
+        if *element_type == ChifType::Str { ELEM_STR } else { ELEM_VALUE }
+    }
+    
+    // Collections hold 8-byte slots: floats by their bits, bools as 0/1
+    fn to_slot(builder: &mut FunctionBuilder, value: Value, element_type: &ChifType) -> Value {
+        match builder.func.dfg.value_type(value) {
+            types::F64 => builder.ins().bitcast(types::I64, MemFlags::new(), value),
+            types::I64 if *element_type == ChifType::Float => {
+                let float = builder.ins().fcvt_from_sint(types::F64, value);
+                builder.ins().bitcast(types::I64, MemFlags::new(), float)
+            }
+            types::I64 => value,
+            _ => builder.ins().uextend(types::I64, value),
+        }
+    }
+    
+    fn from_slot(builder: &mut FunctionBuilder, slot: Value, element_type: &ChifType) -> Value {
+        match element_type {
+            ChifType::Float => builder.ins().bitcast(types::F64, MemFlags::new(), slot),
+            ChifType::Bool => builder.ins().ireduce(types::I8, slot),
+            _ => slot,
+        }
+    }
+    
+    // Value of expression for a variable, parameter or element of type
+    // value_type. List and map literals build a runtime collection there;
+    // anything else is generated as usual.
+    fn generate_typed_value(
+        builder: &mut FunctionBuilder,
+        value_type: &ChifType,
+        expression: &Expression,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        match (value_type, expression) {
+            (ChifType::List(..), Expression::ArrayLiteral(elements)) => {
+                let capacity = builder.ins().iconst(types::I64, elements.len() as i64);
+                if let Some(layout) = Self::soa_list_layout(value_type) {
+                    let element_type = ChifType::Struct(layout.name.clone());
+                    let list = Self::generate_soa_list_new(builder, &layout, capacity, functions, module)?;
+                    for element in elements {
+                        let struct_ptr = Self::generate_typed_value(builder, &element_type, element, variables, variable_types, functions, module)?;
+                        Self::generate_soa_list_call(builder, &layout, list, "rono_list_push", Some(struct_ptr), &[], functions, module)?;
+                    }
+                    return Ok(list);
+                }
+                let element_type = Self::collection_element_type(value_type).unwrap_or(ChifType::Int);
+                let kind = builder.ins().iconst(types::I64, Self::collection_kind(&element_type));
+                let list = Self::call_runtime_value(builder, "rono_list_new", &[kind, capacity], functions, module)?
+                    .ok_or_else(|| IRError::Generation("rono_list_new returns no value".to_string()))?;
+                for element in elements {
+                    let value = Self::generate_typed_value(builder, &element_type, element, variables, variable_types, functions, module)?;
+                    let value = Self::generate_element_persist(builder, value, &element_type, functions, module)?;
+                    let slot = Self::to_slot(builder, value, &element_type);
+                    Self::call_runtime_value(builder, "rono_list_push", &[list, slot], functions, module)?;
+                }
+                Ok(list)
+            }
+            (ChifType::Map(key_type, element_type), Expression::MapLiteral(pairs)) => {
+                let key_kind = builder.ins().iconst(types::I64, Self::collection_kind(key_type));
+                let value_kind = builder.ins().iconst(types::I64, Self::collection_kind(element_type));
+                let capacity = builder.ins().iconst(types::I64, pairs.len() as i64);
+                let map = Self::call_runtime_value(builder, "rono_map_new", &[key_kind, value_kind, capacity], functions, module)?
+                    .ok_or_else(|| IRError::Generation("rono_map_new returns no value".to_string()))?;
+                for (key_expr, value_expr) in pairs {
+                    let key = Self::generate_typed_value(builder, key_type, key_expr, variables, variable_types, functions, module)?;
+                    let key = Self::to_slot(builder, key, key_type);
+                    let value = Self::generate_typed_value(builder, element_type, value_expr, variables, variable_types, functions, module)?;
+                    let value = Self::generate_element_persist(builder, value, element_type, functions, module)?;
+                    let value = Self::to_slot(builder, value, element_type);
+                    Self::call_runtime_value(builder, "rono_map_set", &[map, key, value], functions, module)?;
+                }
+                Ok(map)
+            }
+            (ChifType::Array(..), Expression::ArrayLiteral(_)) => {
+                Self::generate_array_value(builder, value_type, Some(expression), false, variables, variable_types, functions, module)
+            }
+            _ => Self::generate_expression_static(builder, expression, variables, variable_types, functions, module),
+        }
+    }
+    
+    // Address of list[index] after an inline bounds check; an index out of
+    // range is reported by rono_index_error, which exits
+    fn generate_list_element_addr(
+        builder: &mut FunctionBuilder,
+        list: Value,
+        index: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let error_block = builder.create_block();
+        let ok_block = builder.create_block();
+        builder.set_cold_block(error_block);
         
-        // Get pointer to the allocated memory
-        let array_ptr = builder.ins().stack_addr(types::I64, stack_slot, 0);
+        let len = builder.ins().load(types::I64, MemFlags::trusted(), list, COLLECTION_LEN_OFFSET);
+        // Unsigned, so negative indices fail the same check
+        let in_bounds = builder.ins().icmp(IntCC::UnsignedLessThan, index, len);
+        builder.ins().brif(in_bounds, ok_block, &[], error_block, &[]);
         
-        // Initialize elements
-        for (i, element_expr) in elements.iter().enumerate() {
-            let element_value = Self::generate_expression_static(builder, element_expr, variables, functions, module)?;
-            let offset = (i * 8) as i32; // 8 bytes per element
-            builder.ins().store(MemFlags::new(), element_value, array_ptr, offset);
-        }
+        builder.switch_to_block(error_block);
+        builder.seal_block(error_block);
+        Self::call_runtime_value(builder, "rono_index_error", &[index, len], functions, module)?;
+        builder.ins().trap(TrapCode::UnreachableCodeReached);
         
-        // Return pointer to the array
-        Ok(array_ptr)
+        builder.switch_to_block(ok_block);
+        builder.seal_block(ok_block);
+        let items = builder.ins().load(types::I64, MemFlags::trusted(), list, LIST_ITEMS_OFFSET);
+        let offset = builder.ins().ishl_imm(index, 3);
+        Ok(builder.ins().iadd(items, offset))
     }
     
-    fn generate_array_index(
+    // A list of a `soa struct` is a block with one runtime list per field,
+    // in layout order. Column i holds field i of every element as 8-byte
+    // slots (see to_slot), so all columns have the length of the list, and
+    // a loop reading one field walks one contiguous array.
+    fn generate_soa_list_new(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        capacity: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let size = builder.ins().iconst(types::I64, (layout.fields.len() * 8) as i64);
+        let list = Self::call_runtime_value(builder, "rono_array_new", &[size], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_array_new returns no value".to_string()))?;
+        for (i, field) in layout.fields.iter().enumerate() {
+            let kind = builder.ins().iconst(types::I64, Self::collection_kind(&field.field_type));
+            let column = Self::call_runtime_value(builder, "rono_list_new", &[kind, capacity], functions, module)?
+                .ok_or_else(|| IRError::Generation("rono_list_new returns no value".to_string()))?;
+            builder.ins().store(MemFlags::trusted(), column, list, (i * 8) as i32);
+        }
+        Ok(list)
+    }
+    
+    // Calls a rono_list_* function on every column of a struct-of-arrays
+    // list: (column, [field of element,] extra...)
+    fn generate_soa_list_call(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        list: Value,
+        runtime_name: &str,
+        element: Option<Value>,
+        extra: &[Value],
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        for (i, field) in layout.fields.iter().enumerate() {
+            let mut args = vec![builder.ins().load(types::I64, MemFlags::trusted(), list, (i * 8) as i32)];
+            if let Some(struct_ptr) = element {
+                let value = Self::load_packed(builder, field, struct_ptr, field.offset as i32)?;
+                args.push(Self::to_slot(builder, value, &field.field_type));
+            }
+            args.extend_from_slice(extra);
+            Self::call_runtime_value(builder, runtime_name, &args, functions, module)?;
+        }
+        Ok(())
+    }
+    
+    // Gathers list[index] of a struct-of-arrays list into a new struct
+    fn generate_soa_list_load(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        list: Value,
+        index: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let struct_ptr = Self::generate_struct_block(builder, layout);
+        for (i, field) in layout.fields.iter().enumerate() {
+            let column = builder.ins().load(types::I64, MemFlags::trusted(), list, (i * 8) as i32);
+            let addr = Self::generate_list_element_addr(builder, column, index, functions, module)?;
+            let slot = builder.ins().load(types::I64, MemFlags::trusted(), addr, 0);
+            let value = Self::from_slot(builder, slot, &field.field_type);
+            Self::store_packed(builder, value, field, struct_ptr, field.offset as i32);
+        }
+        Ok(struct_ptr)
+    }
+    
+    // Scatters the struct at struct_ptr into list[index]
+    fn generate_soa_list_store(
+        builder: &mut FunctionBuilder,
+        layout: &StructLayout,
+        list: Value,
+        index: Value,
+        struct_ptr: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        for (i, field) in layout.fields.iter().enumerate() {
+            let value = Self::load_packed(builder, field, struct_ptr, field.offset as i32)?;
+            let value = Self::generate_persist(builder, value, &field.field_type, functions, module)?;
+            let slot = Self::to_slot(builder, value, &field.field_type);
+            let column = builder.ins().load(types::I64, MemFlags::trusted(), list, (i * 8) as i32);
+            let addr = Self::generate_list_element_addr(builder, column, index, functions, module)?;
+            builder.ins().store(MemFlags::trusted(), slot, addr, 0);
+        }
+        Ok(())
+    }
+    
+    // Follows indices into nested lists and maps starting at collection;
+    // returns the slot reached and its element type
+    fn generate_collection_path(
+        builder: &mut FunctionBuilder,
+        mut collection: Value,
+        mut collection_type: ChifType,
+        indices: &[Expression],
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(Value, ChifType), IRError> {
+        for index_expr in indices {
+            let element_type = Self::collection_element_type(&collection_type)
+                .ok_or_else(|| IRError::Generation(format!("Cannot index value of type {:?}", collection_type)))?;
+            collection = match &collection_type {
+                ChifType::Map(key_type, _) => {
+                    let key = Self::generate_expression_static(builder, index_expr, variables, variable_types, functions, module)?;
+                    let key = Self::to_slot(builder, key, key_type);
+                    Self::call_runtime_value(builder, "rono_map_get", &[collection, key], functions, module)?
+                        .ok_or_else(|| IRError::Generation("rono_map_get returns no value".to_string()))?
+                }
+                _ => {
+                    let index = Self::generate_expression_static(builder, index_expr, variables, variable_types, functions, module)?;
+                    match Self::soa_list_layout(&collection_type) {
+                        // A struct is not indexed further, so this is the last step
+                        Some(layout) => Self::generate_soa_list_load(builder, &layout, collection, index, functions, module)?,
+                        None => {
+                            let addr = Self::generate_list_element_addr(builder, collection, index, functions, module)?;
+                            builder.ins().load(types::I64, MemFlags::trusted(), addr, 0)
+                        }
+                    }
+                }
+            };
+            collection_type = element_type;
+        }
+        Ok((collection, collection_type))
+    }
+    
+    // list[i] = value and map[key] = value, also through nested collections
+    fn generate_index_assignment(
         builder: &mut FunctionBuilder,
         index_access: &IndexAccess,
+        value: &Expression,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        let object_type = Self::infer_expression_type(&index_access.object, variable_types, functions, module)
+            .filter(|object_type| matches!(object_type, ChifType::Array(..) | ChifType::List(..) | ChifType::Map(..)))
+            .ok_or_else(|| IRError::UnsupportedFeature("Index assignment is only supported on arrays, lists and maps".to_string()))?;
+        if let ChifType::Array(..) = object_type {
+            let (element_type, _) = Self::array_shape(&object_type)
+                .ok_or_else(|| IRError::Generation(format!("Not an array type: {:?}", object_type)))?;
+            let value = Self::generate_typed_value(builder, &element_type, value, variables, variable_types, functions, module)?;
+            let escapes = match &*index_access.object {
+                Expression::Identifier(name) => !variable_types.contains_key(&Self::stack_array_key(name)),
+                _ => true,
+            };
+            let array = Self::generate_expression_static(builder, &index_access.object, variables, variable_types, functions, module)?;
+            let element = Self::generate_array_flat_index(
+                builder, array, &object_type, &index_access.indices, variables, variable_types, functions, module,
+            )?;
+            if let Some(layout) = Self::soa_layout(&element_type) {
+                return Self::generate_soa_array_store(builder, &layout, &element, value, escapes, functions, module);
+            }
+            let value = if escapes { Self::generate_persist(builder, value, &element_type, functions, module)? } else { value };
+            let addr = Self::array_element_addr(builder, &element)?;
+            Self::store_array_element(builder, value, &element_type, addr, 0);
+            return Ok(());
+        }
+        let (last, path) = index_access.indices.split_last()
+            .ok_or_else(|| IRError::Generation("Index assignment without an index".to_string()))?;
+        
+        // The value is evaluated before the target, as in the interpreter
+        let target_type = Self::indexed_type(&object_type, index_access.indices.len())
+            .ok_or_else(|| IRError::Generation(format!("Too many indices for {:?}", object_type)))?;
+        let value = Self::generate_typed_value(builder, &target_type, value, variables, variable_types, functions, module)?;
+        let value = Self::to_slot(builder, value, &target_type);
+        
+        let object = Self::generate_expression_static(builder, &index_access.object, variables, variable_types, functions, module)?;
+        let (collection, collection_type) = Self::generate_collection_path(
+            builder, object, object_type, path, variables, variable_types, functions, module,
+        )?;
+        match &collection_type {
+            ChifType::Map(key_type, _) => {
+                let key = Self::generate_expression_static(builder, last, variables, variable_types, functions, module)?;
+                let key = Self::to_slot(builder, key, key_type);
+                let value = Self::generate_element_persist(builder, value, &target_type, functions, module)?;
+                Self::call_runtime_value(builder, "rono_map_set", &[collection, key, value], functions, module)?;
+            }
+            ChifType::List(..) => {
+                let index = Self::generate_expression_static(builder, last, variables, variable_types, functions, module)?;
+                if let Some(layout) = Self::soa_list_layout(&collection_type) {
+                    // value is the struct pointer, which to_slot left as it was
+                    return Self::generate_soa_list_store(builder, &layout, collection, index, value, functions, module);
+                }
+                let value = Self::generate_persist(builder, value, &target_type, functions, module)?;
+                let addr = Self::generate_list_element_addr(builder, collection, index, functions, module)?;
+                builder.ins().store(MemFlags::trusted(), value, addr, 0);
+            }
+            other => return Err(IRError::Generation(format!("Cannot index value of type {:?}", other))),
+        }
+        Ok(())
+    }
+    
+    // add / addAt / del on lists and len on lists and maps
+    fn generate_collection_method(
+        builder: &mut FunctionBuilder,
+        method_call: &MethodCall,
+        collection_type: &ChifType,
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
-        // Generate the array pointer
-        let mut current_ptr = Self::generate_expression_static(builder, &index_access.object, variables, functions, module)?;
+        let collection = Self::generate_expression_static(builder, &method_call.object, variables, variable_types, functions, module)?;
+        let element_type = Self::collection_element_type(collection_type).unwrap_or(ChifType::Int);
+        let is_list = matches!(collection_type, ChifType::List(..));
         
-        // Handle multiple indices for multidimensional arrays
-        for index_expr in &index_access.indices {
-            // Generate the index
-            let index_value = Self::generate_expression_static(builder, index_expr, variables, functions, module)?;
-            
-            // Calculate offset: index * element_size (8 bytes)
-            let element_size = builder.ins().iconst(types::I64, 8);
-            let offset = builder.ins().imul(index_value, element_size);
-            
-            // Calculate final address: current_ptr + offset
-            let element_ptr = builder.ins().iadd(current_ptr, offset);
-            
-            // Load the element value (which might be another array pointer)
-            current_ptr = builder.ins().load(types::I64, MemFlags::new(), element_ptr, 0);
+        if let Some(layout) = Self::soa_list_layout(collection_type) {
+            return Self::generate_soa_list_method(builder, method_call, &layout, collection, variables, variable_types, functions, module);
         }
         
-        Ok(current_ptr)
+        let (runtime_name, args) = match (method_call.method.as_str(), method_call.args.as_slice()) {
+            ("len", []) => {
+                return Ok(builder.ins().load(types::I64, MemFlags::trusted(), collection, COLLECTION_LEN_OFFSET));
+            }
+            ("add", [value]) if is_list => {
+                let value = Self::generate_typed_value(builder, &element_type, value, variables, variable_types, functions, module)?;
+                let value = Self::generate_element_persist(builder, value, &element_type, functions, module)?;
+                ("rono_list_push", vec![collection, Self::to_slot(builder, value, &element_type)])
+            }
+            ("addAt", [value, index]) if is_list => {
+                let value = Self::generate_typed_value(builder, &element_type, value, variables, variable_types, functions, module)?;
+                let value = Self::generate_element_persist(builder, value, &element_type, functions, module)?;
+                let value = Self::to_slot(builder, value, &element_type);
+                let index = Self::generate_expression_static(builder, index, variables, variable_types, functions, module)?;
+                ("rono_list_insert", vec![collection, value, index])
+            }
+            ("del", [index]) if is_list => {
+                let index = Self::generate_expression_static(builder, index, variables, variable_types, functions, module)?;
+                ("rono_list_remove", vec![collection, index])
+            }
+            (method, _) => {
+                return Err(IRError::Generation(format!(
+                    "Unknown method '{}' for {} or wrong number of arguments", method, if is_list { "list" } else { "map" }
+                )));
+            }
+        };
+        Self::call_runtime_value(builder, runtime_name, &args, functions, module)?;
+        Ok(builder.ins().iconst(types::I64, 0))
     }
-
-
-
-    pub fn finalize(self) -> ObjectModule {
+    
+    // The list methods on a struct-of-arrays list apply to every column
+    fn generate_soa_list_method(
+        builder: &mut FunctionBuilder,
+        method_call: &MethodCall,
+        layout: &StructLayout,
+        list: Value,
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        let element_type = ChifType::Struct(layout.name.clone());
+        match (method_call.method.as_str(), method_call.args.as_slice()) {
+            ("len", []) => {
+                let column = builder.ins().load(types::I64, MemFlags::trusted(), list, 0);
+                return Ok(builder.ins().load(types::I64, MemFlags::trusted(), column, COLLECTION_LEN_OFFSET));
+            }
+            ("add", [value]) => {
+                let struct_ptr = Self::generate_typed_value(builder, &element_type, value, variables, variable_types, functions, module)?;
+                Self::generate_soa_list_call(builder, layout, list, "rono_list_push", Some(struct_ptr), &[], functions, module)?;
+            }
+            ("addAt", [value, index]) => {
+                let struct_ptr = Self::generate_typed_value(builder, &element_type, value, variables, variable_types, functions, module)?;
+                let index = Self::generate_expression_static(builder, index, variables, variable_types, functions, module)?;
+                Self::generate_soa_list_call(builder, layout, list, "rono_list_insert", Some(struct_ptr), &[index], functions, module)?;
+            }
+            ("del", [index]) => {
+                let index = Self::generate_expression_static(builder, index, variables, variable_types, functions, module)?;
+                Self::generate_soa_list_call(builder, layout, list, "rono_list_remove", None, &[index], functions, module)?;
+            }
+            (method, _) => {
+                return Err(IRError::Generation(format!("Unknown method '{}' for list or wrong number of arguments", method)));
+            }
+        }
+        Ok(builder.ins().iconst(types::I64, 0))
+    }
+    
+    // `par for`: the body is outlined into a function that rono_par_for runs
+    // on every worker (RonoParBody in runtime.c). The variables in scope are
+    // passed by value in an env block on the stack, followed by one slot per
+    // reduction target that the workers fold their partial results into;
+    // the targets are reloaded from their slots after the loop.
+    fn generate_par_for(
+        builder: &mut FunctionBuilder,
+        par_for: &ParForStatement,
+        variables: &mut HashMap<String, Variable>,
+        variable_types: &mut HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<(), IRError> {
+        let mut captured: Vec<(&String, Variable)> = variables.iter()
+            .filter(|(name, _)| !name.starts_with('$'))
+            .map(|(name, &var)| (name, var))
+            .collect();
+        captured.sort_by(|a, b| a.0.cmp(b.0));
+        let mut reductions = Vec::with_capacity(par_for.reductions.len());
+        for reduction in &par_for.reductions {
+            let var = *variables.get(&reduction.name)
+                .ok_or_else(|| IRError::Generation(format!("Undefined variable: {}", reduction.name)))?;
+            reductions.push((reduction.op, var));
+        }
+        
+        let env_slot = builder.create_sized_stack_slot(StackSlotData::new(
+            StackSlotKind::ExplicitSlot,
+            ((captured.len() + reductions.len()).max(1) * 8) as u32,
+        ));
+        let env = builder.ins().stack_addr(types::I64, env_slot, 0);
+        let mut env_layout = Vec::with_capacity(captured.len());
+        for (i, (name, var)) in captured.iter().enumerate() {
+            let value = builder.use_var(*var);
+            builder.ins().store(MemFlags::trusted(), value, env, (i * 8) as i32);
+            env_layout.push(((*name).clone(), builder.func.dfg.value_type(value), variable_types.get(*name).cloned()));
+        }
+        let mut reduction_layout = Vec::with_capacity(reductions.len());
+        for (i, &(op, var)) in reductions.iter().enumerate() {
+            let value = builder.use_var(var);
+            let value_type = builder.func.dfg.value_type(value);
+            if value_type != types::I64 && value_type != types::F64 {
+                return Err(IRError::Generation("Reduction variables must be int or float".to_string()));
+            }
+            builder.ins().store(MemFlags::trusted(), value, env, ((captured.len() + i) * 8) as i32);
+            reduction_layout.push((op, value_type));
+        }
+        
+        let start = Self::generate_expression_static(builder, &par_for.start, variables, variable_types, functions, module)?;
+        let end = Self::generate_expression_static(builder, &par_for.end, variables, variable_types, functions, module)?;
+        let body_id = Self::generate_par_body(par_for, &env_layout, &reduction_layout, functions, module)?;
+        let body_ref = module.declare_func_in_func(body_id, builder.func);
+        let body = builder.ins().func_addr(types::I64, body_ref);
+        Self::call_runtime_value(builder, "rono_par_for", &[body, env, start, end], functions, module)?;
+        
+        for (i, (&(_, var), &(_, value_type))) in reductions.iter().zip(&reduction_layout).enumerate() {
+            let value = builder.ins().load(value_type, MemFlags::trusted(), env, ((captured.len() + i) * 8) as i32);
+            builder.def_var(var, value);
+        }
+        Ok(())
+    }
+    
+    // RonoParBody for a par for: fn(env, ctx). Copies the captured variables
+    // out of env, runs the chunks it claims with reduction targets starting
+    // at their identity, then folds them into env under the loop's lock.
+    fn generate_par_body(
+        par_for: &ParForStatement,
+        env_layout: &[(String, Type, Option<ChifType>)],
+        reduction_layout: &[(ReductionOp, Type)],
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<cranelift_module::FuncId, IRError> {
+        let mut sig = module.make_signature();
+        sig.params.push(AbiParam::new(types::I64)); // env
+        sig.params.push(AbiParam::new(types::I64)); // RonoParCtx*
+        let func_id = module.declare_anonymous_function(&sig)
+            .map_err(|e| IRError::Module(e))?;
+        
+        let mut ctx = module.make_context();
+        ctx.func.signature = sig;
+        let mut builder_context = FunctionBuilderContext::new();
+        let mut builder = FunctionBuilder::new(&mut ctx.func, &mut builder_context);
+        let mut variables = HashMap::new();
+        let mut variable_types = HashMap::new();
+        
+        let entry_block = builder.create_block();
+        builder.append_block_params_for_function_params(entry_block);
+        builder.switch_to_block(entry_block);
+        let env = builder.block_params(entry_block)[0];
+        let par_ctx = builder.block_params(entry_block)[1];
+        
+        let declare = |builder: &mut FunctionBuilder, variables: &mut HashMap<String, Variable>, name: &str, var_type: Type, value: Value| {
+            let var = Variable::new(variables.len());
+            builder.declare_var(var, var_type);
+            builder.def_var(var, value);
+            variables.insert(name.to_string(), var);
+            var
+        };
+        if Self::inline_intrinsics(module) {
+            let null = builder.ins().iconst(types::I64, 0);
+            declare(&mut builder, &mut variables, RAND_VAR, types::I64, null);
+        }
+        // Strings made by the body live until this worker is done
+        let region = Self::call_runtime_value(&mut builder, "rono_region_enter", &[], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_region_enter returns no value".to_string()))?;
+        declare(&mut builder, &mut variables, REGION_VAR, types::I64, region);
+        variable_types.insert(REGION_VAR.to_string(), ChifType::Nil);
+        
+        for (i, (name, value_type, var_type)) in env_layout.iter().enumerate() {
+            let value = builder.ins().load(*value_type, MemFlags::trusted(), env, (i * 8) as i32);
+            declare(&mut builder, &mut variables, name, *value_type, value);
+            if let Some(var_type) = var_type {
+                variable_types.insert(name.clone(), var_type.clone());
+            }
+        }
+        let mut partials = Vec::with_capacity(reduction_layout.len());
+        for (reduction, &(op, value_type)) in par_for.reductions.iter().zip(reduction_layout) {
+            let identity = match (op, value_type) {
+                (ReductionOp::Sum, types::F64) => builder.ins().f64const(0.0),
+                (ReductionOp::Min, types::F64) => builder.ins().f64const(f64::INFINITY),
+                (ReductionOp::Max, types::F64) => builder.ins().f64const(f64::NEG_INFINITY),
+                (ReductionOp::Sum, _) => builder.ins().iconst(types::I64, 0),
+                (ReductionOp::Min, _) => builder.ins().iconst(types::I64, i64::MAX),
+                (ReductionOp::Max, _) => builder.ins().iconst(types::I64, i64::MIN),
+            };
+            let var = variables[&reduction.name];
+            builder.def_var(var, identity);
+            partials.push(var);
+        }
+        
+        let zero = builder.ins().iconst(types::I64, 0);
+        let index_var = declare(&mut builder, &mut variables, &par_for.var, types::I64, zero);
+        variable_types.insert(par_for.var.clone(), ChifType::Int);
+        let chunk_end_var = declare(&mut builder, &mut variables, "$par_end", types::I64, zero);
+        let range_slot = builder.create_sized_stack_slot(StackSlotData::new(StackSlotKind::ExplicitSlot, 16));
+        let range = builder.ins().stack_addr(types::I64, range_slot, 0);
+        
+        let claim_block = builder.create_block();
+        let chunk_block = builder.create_block();
+        let header_block = builder.create_block();
+        let body_block = builder.create_block();
+        let done_block = builder.create_block();
+        builder.ins().jump(claim_block, &[]);
+        
+        builder.switch_to_block(claim_block);
+        let claimed = Self::call_runtime_value(&mut builder, "rono_par_next", &[par_ctx, range], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_par_next returns no value".to_string()))?;
+        builder.ins().brif(claimed, chunk_block, &[], done_block, &[]);
+        
+        builder.switch_to_block(chunk_block);
+        let lo = builder.ins().load(types::I64, MemFlags::trusted(), range, 0);
+        let hi = builder.ins().load(types::I64, MemFlags::trusted(), range, 8);
+        builder.def_var(index_var, lo);
+        builder.def_var(chunk_end_var, hi);
+        builder.ins().jump(header_block, &[]);
+        
+        builder.switch_to_block(header_block);
+        let index = builder.use_var(index_var);
+        let chunk_end = builder.use_var(chunk_end_var);
+        let in_chunk = builder.ins().icmp(IntCC::SignedLessThan, index, chunk_end);
+        builder.ins().brif(in_chunk, body_block, &[], claim_block, &[]);
+        
+        builder.switch_to_block(body_block);
+        for statement in &par_for.body.statements {
+            Self::generate_statement_static(&mut builder, statement, &mut variables, &mut variable_types, false, functions, module)?;
+        }
+        let index = builder.use_var(index_var);
+        let next = builder.ins().iadd_imm(index, 1);
+        builder.def_var(index_var, next);
+        builder.ins().jump(header_block, &[]);
+        
+        builder.switch_to_block(done_block);
+        Self::call_runtime_value(&mut builder, "rono_par_lock", &[par_ctx], functions, module)?;
+        for (i, (&(op, value_type), &var)) in reduction_layout.iter().zip(&partials).enumerate() {
+            let offset = ((env_layout.len() + i) * 8) as i32;
+            let total = builder.ins().load(value_type, MemFlags::trusted(), env, offset);
+            let partial = builder.use_var(var);
+            let combined = match (op, value_type == types::F64) {
+                (ReductionOp::Sum, true) => builder.ins().fadd(total, partial),
+                (ReductionOp::Min, true) => builder.ins().fmin(total, partial),
+                (ReductionOp::Max, true) => builder.ins().fmax(total, partial),
+                (ReductionOp::Sum, false) => builder.ins().iadd(total, partial),
+                (ReductionOp::Min, false) => builder.ins().smin(total, partial),
+                (ReductionOp::Max, false) => builder.ins().smax(total, partial),
+            };
+            builder.ins().store(MemFlags::trusted(), combined, env, offset);
+        }
+        Self::call_runtime_value(&mut builder, "rono_par_unlock", &[par_ctx], functions, module)?;
+        Self::generate_region_leave(&mut builder, None, &variables, &variable_types, functions, module)?;
+        builder.ins().return_(&[]);
+        
+        builder.seal_all_blocks();
+        builder.finalize();
+        module.define_function(func_id, &mut ctx)
+            .map_err(|e| IRError::Module(e))?;
+        Ok(func_id)
+    }
+    
+    // `name$entry(args: *const u64, ret: *mut u64)`: calls `name` with its
+    // arguments loaded from one 64-bit slot each (floats as bits, bools as
+    // 0/1) and stores the result into `ret`. Lets Rust call functions of
+    // any signature through a single function pointer type.
+    pub fn generate_entry_trampoline(&mut self, name: &str) -> Result<cranelift_module::FuncId, IRError> {
+        let target_id = *self.functions.get(name)
+            .ok_or_else(|| IRError::Generation(format!("Function not found: {}", name)))?;
+        let target_sig = self.module.declarations().get_function_decl(target_id).signature.clone();
+        let pointer_type = self.module.target_config().pointer_type();
+        
+        let mut sig = self.module.make_signature();
+        sig.params.push(AbiParam::new(pointer_type));
+        sig.params.push(AbiParam::new(pointer_type));
+        let entry_id = self.module.declare_function(&format!("{}$entry", name), Linkage::Local, &sig)?;
+        
+        self.ctx.clear();
+        self.ctx.func.signature = sig;
+        let mut builder = FunctionBuilder::new(&mut self.ctx.func, &mut self.builder_context);
+        let entry_block = builder.create_block();
+        builder.append_block_params_for_function_params(entry_block);
+        builder.switch_to_block(entry_block);
+        builder.seal_block(entry_block);
+        let args_ptr = builder.block_params(entry_block)[0];
+        let ret_ptr = builder.block_params(entry_block)[1];
+        
+        let mut args = Vec::with_capacity(target_sig.params.len());
+        for (i, param) in target_sig.params.iter().enumerate() {
+            let offset = (i * 8) as i32;
+            let arg = if param.value_type == types::F64 {
+                builder.ins().load(types::F64, MemFlags::trusted(), args_ptr, offset)
+            } else {
+                let raw = builder.ins().load(types::I64, MemFlags::trusted(), args_ptr, offset);
+                if param.value_type == types::I64 { raw } else { builder.ins().ireduce(param.value_type, raw) }
+            };
+            args.push(arg);
+        }
+        
+        let callee = self.module.declare_func_in_func(target_id, builder.func);
+        let call = builder.ins().call(callee, &args);
+        if let Some(result) = builder.inst_results(call).first().copied() {
+            let result = match builder.func.dfg.value_type(result) {
+                types::I64 | types::F64 => result,
+                _ => builder.ins().uextend(types::I64, result),
+            };
+            builder.ins().store(MemFlags::trusted(), result, ret_ptr, 0);
+        }
+        builder.ins().return_(&[]);
+        builder.finalize();
+        
+        self.module.define_function(entry_id, &mut self.ctx)?;
+        Ok(entry_id)
+    }
+    
+    pub fn finalize(self) -> M {
         self.module
     }
     
     fn process_import(&mut self, import: &ImportStatement) -> Result<(), IRError> {
-        // Add .rono extension if not present
-        let file_path = if import.path.ends_with(".rono") {
-            import.path.clone()
-        } else {
-            format!("{}.rono", import.path)
-        };
+        // Get module name for prefixing; a module reached again through
+        // another import is already generated
+        let module_name = modules::module_name(import);
+        if !self.imported_modules.insert(module_name.clone()) {
+            return Ok(());
+        }
         
-        // Read the imported file
-        let source = std::fs::read_to_string(&file_path).map_err(|_| {
-            IRError::Generation(format!("Could not read module file: {}", file_path))
-        })?;
-        
-        // Parse the imported file
-        use crate::{lexer::Lexer, parser::Parser};
-        let mut lexer = Lexer::new(&source);
-        let tokens = lexer.tokenize().map_err(|e| {
-            IRError::Generation(format!("Failed to tokenize module {}: {}", file_path, e))
-        })?;
-        
-        let mut parser = Parser::new(tokens);
-        let imported_program = parser.parse().map_err(|e| {
-            IRError::Generation(format!("Failed to parse module {}: {}", file_path, e))
-        })?;
-        
-        // Get module name for prefixing
-        let module_name = import.alias.clone().unwrap_or_else(|| {
-            std::path::Path::new(&import.path)
-                .file_stem()
-                .unwrap()
-                .to_string_lossy()
-                .to_string()
-        });
+        let imported_program = modules::load(import)
+            .map_err(|e| IRError::Generation(e.to_string()))?;
+        
+        // Nested imports first: the module's functions call into them
+        for item in &imported_program.items {
+            if let Item::Import(nested) = item {
+                self.process_import(nested)?;
+            }
+        }
         
         // Declare imported functions with module prefix
         for item in &imported_program.items {
             match item {
                 Item::Function(func) => {
                     let qualified_name = format!("{}_{}", module_name, func.name);
-                    let mut qualified_func = func.clone();
-                    qualified_func.name = qualified_name;
-                    self.declare_function(&qualified_func)?;
+                    self.declare_function(func, &qualified_name)?;
                 }
                 Item::StructImpl(impl_block) => {
                     // Declare methods with module and struct prefix
                     for method in &impl_block.methods {
                         let method_name = format!("{}_{}_{}", module_name, impl_block.struct_name, method.name);
-                        let mut method_with_new_name = method.clone();
-                        method_with_new_name.name = method_name;
-                        self.declare_function(&method_with_new_name)?;
+                        self.declare_function(method, &method_name)?;
                     }
                 }
                 _ => {} // Other items handled elsewhere
@@ -1470,17 +3823,13 @@ impl IRGenerator {
             match item {
                 Item::Function(func) => {
                     let qualified_name = format!("{}_{}", module_name, func.name);
-                    let mut qualified_func = func.clone();
-                    qualified_func.name = qualified_name;
-                    self.generate_function(&qualified_func)?;
+                    self.generate_function(func, &qualified_name)?;
                 }
                 Item::StructImpl(impl_block) => {
                     // Generate method bodies with module and struct prefix
                     for method in &impl_block.methods {
                         let method_name = format!("{}_{}_{}", module_name, impl_block.struct_name, method.name);
-                        let mut method_with_new_name = method.clone();
-                        method_with_new_name.name = method_name;
-                        self.generate_function(&method_with_new_name)?;
+                        self.generate_function(method, &method_name)?;
                     }
                 }
                 _ => {} // Other items handled elsewhere
@@ -1494,8 +3843,9 @@ impl IRGenerator {
         builder: &mut FunctionBuilder,
         expr: &Expression,
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
         match expr {
             Expression::Identifier(var_name) => {
@@ -1524,7 +3874,7 @@ impl IRGenerator {
             }
             _ => {
                 // For other expressions, we need to evaluate them and create a temporary
-                let value = Self::generate_expression_static(builder, expr, variables, functions, module)?;
+                let value = Self::generate_expression_static(builder, expr, variables, variable_types, functions, module)?;
                 
                 // Create a stack slot to store the temporary value
                 let stack_slot = builder.create_sized_stack_slot(cranelift::prelude::StackSlotData::new(
@@ -1545,11 +3895,12 @@ impl IRGenerator {
         builder: &mut FunctionBuilder,
         expr: &Expression,
         variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
         functions: &HashMap<String, cranelift_module::FuncId>,
-        module: &mut ObjectModule
+        module: &mut M
     ) -> Result<Value, IRError> {
         // Generate the pointer expression
-        let pointer = Self::generate_expression_static(builder, expr, variables, functions, module)?;
+        let pointer = Self::generate_expression_static(builder, expr, variables, variable_types, functions, module)?;
         
         // For now, we need to determine what type to load
         // This is a simplified approach - we'll try to infer from context
@@ -1562,33 +3913,333 @@ impl IRGenerator {
         Ok(builder.ins().load(types::I64, cranelift::prelude::MemFlags::new(), pointer, 0))
     }
     
-    fn generate_string_on_stack(
+    // Intrinsics: small runtime operations emitted as IR in the caller so
+    // Cranelift can optimize them in context. Only used at opt_level=speed;
+    // other levels call the equivalent runtime functions.
+    fn inline_intrinsics(module: &M) -> bool {
+        module.isa().flags().opt_level() == settings::OptLevel::Speed
+    }
+    
+    fn call_runtime_value(
         builder: &mut FunctionBuilder,
-        s: &str,
+        name: &str,
+        args: &[Value],
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Option<Value>, IRError> {
+        let func_id = functions.get(name)
+            .ok_or_else(|| IRError::Generation(format!("Runtime function {} not found", name)))?;
+        let func_ref = module.declare_func_in_func(*func_id, builder.func);
+        let call = builder.ins().call(func_ref, args);
+        Ok(builder.inst_results(call).first().copied())
+    }
+    
+    // Length of a rono_str: the i64 in front of the characters, 0 for null
+    fn generate_string_len(
+        builder: &mut FunctionBuilder,
+        string_value: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
     ) -> Result<Value, IRError> {
-        // Create string on stack (simplified approach)
-        let string_bytes = s.as_bytes();
-        let string_len = string_bytes.len() + 1; // +1 for null terminator
+        if !Self::inline_intrinsics(module) {
+            return Self::call_runtime_value(builder, "rono_str_len", &[string_value], functions, module)?
+                .ok_or_else(|| IRError::Generation("rono_str_len returns no value".to_string()));
+        }
         
-        // Create stack slot for the string
-        let stack_slot = builder.create_sized_stack_slot(StackSlotData::new(
-            StackSlotKind::ExplicitSlot,
-            string_len as u32,
-        ));
+        let load_block = builder.create_block();
+        let done_block = builder.create_block();
+        builder.append_block_param(done_block, types::I64);
         
-        // Get pointer to stack slot
-        let string_ptr = builder.ins().stack_addr(types::I64, stack_slot, 0);
+        let zero = builder.ins().iconst(types::I64, 0);
+        builder.ins().brif(string_value, load_block, &[], done_block, &[zero]);
+        
+        builder.switch_to_block(load_block);
+        builder.seal_block(load_block);
+        let len = builder.ins().load(types::I64, MemFlags::trusted(), string_value, -STR_HEADER_SIZE);
+        builder.ins().jump(done_block, &[len]);
+        
+        builder.switch_to_block(done_block);
+        builder.seal_block(done_block);
+        Ok(builder.block_params(done_block)[0])
+    }
+    
+    // randfill(a, min, max): every element of an int or float array, all
+    // dimensions included, drawn in one rono_rand_fill_* call
+    fn generate_rand_fill(
+        builder: &mut FunctionBuilder,
+        args: &[Expression],
+        variables: &HashMap<String, Variable>,
+        variable_types: &HashMap<String, ChifType>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M
+    ) -> Result<Value, IRError> {
+        if args.len() != 3 {
+            return Err(IRError::Generation("randfill expects 3 arguments (array, min, max)".to_string()));
+        }
+        let array_type = Self::infer_expression_type(&args[0], variable_types, functions, module);
+        let (element_type, dims) = array_type.as_ref()
+            .and_then(Self::array_shape)
+            .ok_or_else(|| IRError::Generation(format!("randfill expects an array, got {:?}", array_type)))?;
+        let runtime_name = match element_type {
+            ChifType::Int => "rono_rand_fill_int",
+            ChifType::Float => "rono_rand_fill_float",
+            other => return Err(IRError::Generation(format!("randfill expects an int or float array, got array of {:?}", other))),
+        };
         
-        // Store each byte of the string
-        for (i, &byte) in string_bytes.iter().enumerate() {
-            let byte_val = builder.ins().iconst(types::I8, byte as i64);
-            builder.ins().store(MemFlags::new(), byte_val, string_ptr, i as i32);
+        let mut bounds = Vec::new();
+        for bound in &args[1..] {
+            let value = Self::generate_expression_static(builder, bound, variables, variable_types, functions, module)?;
+            bounds.push(match (&element_type, builder.func.dfg.value_type(value)) {
+                (ChifType::Float, types::I64) => builder.ins().fcvt_from_sint(types::F64, value),
+                _ => value,
+            });
+        }
+        let array = Self::generate_expression_static(builder, &args[0], variables, variable_types, functions, module)?;
+        // The element count is the product of the dimensions in the header
+        let mut count = builder.ins().iconst(types::I64, 1);
+        for i in 0..dims.len() {
+            let len = builder.ins().load(types::I64, MemFlags::trusted().with_readonly(), array, (i * 8) as i32);
+            count = builder.ins().imul(count, len);
         }
+        let data = builder.ins().iadd_imm(array, (dims.len() * 8) as i64);
+        Self::call_runtime_value(builder, runtime_name, &[data, count, bounds[0], bounds[1]], functions, module)?;
+        Ok(builder.ins().iconst(types::I64, 0))
+    }
+    
+    // Pointer to this thread's generator state, fetched from the runtime on
+    // the first draw of the call and cached in RAND_VAR afterwards
+    fn generate_rand_state(
+        builder: &mut FunctionBuilder,
+        variables: &HashMap<String, Variable>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let var = *variables.get(RAND_VAR)
+            .ok_or_else(|| IRError::Generation("Generator state variable not declared".to_string()))?;
+        let cached = builder.use_var(var);
+        
+        let fetch_block = builder.create_block();
+        let done_block = builder.create_block();
+        builder.append_block_param(done_block, types::I64);
+        builder.ins().brif(cached, done_block, &[cached], fetch_block, &[]);
+        
+        builder.switch_to_block(fetch_block);
+        builder.seal_block(fetch_block);
+        let state = Self::call_runtime_value(builder, "rono_rand_state", &[], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_rand_state returns no value".to_string()))?;
+        builder.ins().jump(done_block, &[state]);
+        
+        builder.switch_to_block(done_block);
+        builder.seal_block(done_block);
+        let state = builder.block_params(done_block)[0];
+        builder.def_var(var, state);
+        Ok(state)
+    }
+    
+    // One xoshiro256** step, same as rono_rand_next in runtime.c
+    fn generate_rand_next(builder: &mut FunctionBuilder, state: Value) -> Value {
+        let flags = MemFlags::trusted();
+        let s0 = builder.ins().load(types::I64, flags, state, 0);
+        let s1 = builder.ins().load(types::I64, flags, state, 8);
+        let s2 = builder.ins().load(types::I64, flags, state, 16);
+        let s3 = builder.ins().load(types::I64, flags, state, 24);
+        
+        let scaled = builder.ins().imul_imm(s1, 5);
+        let rotated = builder.ins().rotl_imm(scaled, 7);
+        let result = builder.ins().imul_imm(rotated, 9);
+        
+        let t = builder.ins().ishl_imm(s1, 17);
+        let s2 = builder.ins().bxor(s2, s0);
+        let s3 = builder.ins().bxor(s3, s1);
+        let s1 = builder.ins().bxor(s1, s2);
+        let s0 = builder.ins().bxor(s0, s3);
+        let s2 = builder.ins().bxor(s2, t);
+        let s3 = builder.ins().rotl_imm(s3, 45);
+        
+        builder.ins().store(flags, s0, state, 0);
+        builder.ins().store(flags, s1, state, 8);
+        builder.ins().store(flags, s2, state, 16);
+        builder.ins().store(flags, s3, state, 24);
+        result
+    }
+    
+    // randi(min, max): multiply-shift range reduction. Draws that might be
+    // rejected (and the full 64-bit range) go to rono_rand_reduce, so the
+    // sequence matches rono_rand_int exactly.
+    fn generate_rand_int_inline(
+        builder: &mut FunctionBuilder,
+        min_value: Value,
+        max_value: Value,
+        variables: &HashMap<String, Variable>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let swapped = builder.ins().icmp(IntCC::SignedGreaterThan, min_value, max_value);
+        let low_bound = builder.ins().select(swapped, max_value, min_value);
+        let high_bound = builder.ins().select(swapped, min_value, max_value);
+        let span = builder.ins().isub(high_bound, low_bound);
+        let range = builder.ins().iadd_imm(span, 1);
+        
+        let state = Self::generate_rand_state(builder, variables, functions, module)?;
+        let x = Self::generate_rand_next(builder, state);
+        let low = builder.ins().imul(x, range);
+        let high = builder.ins().umulhi(x, range);
+        
+        let maybe_biased = builder.ins().icmp(IntCC::UnsignedLessThan, low, range);
+        let full_range = builder.ins().icmp_imm(IntCC::Equal, range, 0);
+        let slow = builder.ins().bor(maybe_biased, full_range);
+        
+        let slow_block = builder.create_block();
+        let done_block = builder.create_block();
+        builder.append_block_param(done_block, types::I64);
+        builder.ins().brif(slow, slow_block, &[], done_block, &[high]);
+        
+        builder.switch_to_block(slow_block);
+        builder.seal_block(slow_block);
+        let reduced = Self::call_runtime_value(builder, "rono_rand_reduce", &[state, x, range], functions, module)?
+            .ok_or_else(|| IRError::Generation("rono_rand_reduce returns no value".to_string()))?;
+        builder.ins().jump(done_block, &[reduced]);
+        
+        builder.switch_to_block(done_block);
+        builder.seal_block(done_block);
+        let offset = builder.block_params(done_block)[0];
+        Ok(builder.ins().iadd(low_bound, offset))
+    }
+    
+    // randf(min, max): top 53 bits of a draw scaled into [min, max)
+    fn generate_rand_float_inline(
+        builder: &mut FunctionBuilder,
+        min_value: Value,
+        max_value: Value,
+        variables: &HashMap<String, Variable>,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let swapped = builder.ins().fcmp(FloatCC::GreaterThan, min_value, max_value);
+        let low_bound = builder.ins().select(swapped, max_value, min_value);
+        let high_bound = builder.ins().select(swapped, min_value, max_value);
         
-        // Store null terminator
-        let null_byte = builder.ins().iconst(types::I8, 0);
-        builder.ins().store(MemFlags::new(), null_byte, string_ptr, string_bytes.len() as i32);
+        let state = Self::generate_rand_state(builder, variables, functions, module)?;
+        let x = Self::generate_rand_next(builder, state);
+        let bits = builder.ins().ushr_imm(x, 11);
+        let unit = builder.ins().fcvt_from_uint(types::F64, bits);
+        let scale = builder.ins().f64const(1.0 / (1u64 << 53) as f64);
+        let unit = builder.ins().fmul(unit, scale);
         
-        Ok(string_ptr)
+        let span = builder.ins().fsub(high_bound, low_bound);
+        let offset = builder.ins().fmul(unit, span);
+        Ok(builder.ins().fadd(low_bound, offset))
+    }
+    
+    // con.out(int): decimal digits are produced right to left into a stack
+    // buffer and the finished line is appended with rono_out_line
+    fn generate_print_int_inline(
+        builder: &mut FunctionBuilder,
+        value: Value,
+        functions: &HashMap<String, cranelift_module::FuncId>,
+        module: &mut M,
+    ) -> Result<(), IRError> {
+        // 20 digits of u64::MAX plus the sign fit in 24 bytes
+        const DIGITS_SIZE: i64 = 24;
+        let slot = builder.create_sized_stack_slot(StackSlotData::new(StackSlotKind::ExplicitSlot, DIGITS_SIZE as u32));
+        let base = builder.ins().stack_addr(types::I64, slot, 0);
+        
+        // The magnitude as unsigned, which also covers i64::MIN
+        let negative = builder.ins().icmp_imm(IntCC::SignedLessThan, value, 0);
+        let negated = builder.ins().ineg(value);
+        let magnitude = builder.ins().select(negative, negated, value);
+        
+        let loop_block = builder.create_block();
+        let done_block = builder.create_block();
+        builder.append_block_param(loop_block, types::I64); // Write position
+        builder.append_block_param(loop_block, types::I64); // Remaining value
+        builder.append_block_param(done_block, types::I64); // First digit position
+        let end = builder.ins().iconst(types::I64, DIGITS_SIZE);
+        builder.ins().jump(loop_block, &[end, magnitude]);
+        
+        builder.switch_to_block(loop_block);
+        let position = builder.block_params(loop_block)[0];
+        let remaining = builder.block_params(loop_block)[1];
+        let position = builder.ins().iadd_imm(position, -1);
+        let quotient = builder.ins().udiv_imm(remaining, 10);
+        let tens = builder.ins().imul_imm(quotient, 10);
+        let digit = builder.ins().isub(remaining, tens);
+        let digit_char = builder.ins().iadd_imm(digit, b'0' as i64);
+        let digit_addr = builder.ins().iadd(base, position);
+        builder.ins().istore8(MemFlags::trusted(), digit_char, digit_addr, 0);
+        builder.ins().brif(quotient, loop_block, &[position, quotient], done_block, &[position]);
+        builder.seal_block(loop_block);
+        
+        builder.switch_to_block(done_block);
+        builder.seal_block(done_block);
+        let position = builder.block_params(done_block)[0];
+        // The sign byte is always written, it's only included when negative
+        let sign_addr = builder.ins().iadd(base, position);
+        let minus = builder.ins().iconst(types::I64, b'-' as i64);
+        builder.ins().istore8(MemFlags::trusted(), minus, sign_addr, -1);
+        let sign_len = builder.ins().uextend(types::I64, negative);
+        let start = builder.ins().isub(position, sign_len);
+        let text = builder.ins().iadd(base, start);
+        let len = builder.ins().isub(end, start);
+        
+        Self::call_runtime_value(builder, "rono_out_line", &[text, len], functions, module)?;
+        Ok(())
+    }
+    
+    // A string literal as a rono_str in read-only data: header {len,
+    // cap = 0} followed by the NUL-terminated bytes. cap 0 tells the
+    // runtime the string lives for the whole program, so it is never copied
+    // out of a region.
+    fn generate_string_literal(
+        builder: &mut FunctionBuilder,
+        s: &str,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        let mut bytes = Vec::with_capacity(STR_HEADER_SIZE as usize + s.len() + 1);
+        bytes.extend_from_slice(&(s.len() as i64).to_le_bytes());
+        bytes.extend_from_slice(&0i64.to_le_bytes());
+        bytes.extend_from_slice(s.as_bytes());
+        bytes.push(0);
+        
+        let header = Self::generate_rodata(builder, "str", bytes, 8, module)?;
+        // Strings are passed around as a pointer to their first character
+        Ok(builder.ins().iadd_imm(header, STR_HEADER_SIZE as i64))
+    }
+    
+    // Address of a read-only data object holding bytes. Objects are named
+    // after their contents, so every function (imported modules included)
+    // that emits the same bytes refers to the one copy defined first.
+    fn generate_rodata(
+        builder: &mut FunctionBuilder,
+        kind: &str,
+        bytes: Vec<u8>,
+        align: u64,
+        module: &mut M,
+    ) -> Result<Value, IRError> {
+        use std::hash::{Hash, Hasher};
+        let mut hashes = [0u64; 2];
+        for (seed, hash) in hashes.iter_mut().enumerate() {
+            let mut hasher = std::collections::hash_map::DefaultHasher::new();
+            seed.hash(&mut hasher);
+            bytes.hash(&mut hasher);
+            *hash = hasher.finish();
+        }
+        let name = format!("__rono_{}_{}_{:016x}{:016x}", kind, bytes.len(), hashes[0], hashes[1]);
+        
+        let data_id = match module.get_name(&name) {
+            Some(cranelift_module::FuncOrDataId::Data(data_id)) => data_id,
+            _ => {
+                let data_id = module.declare_data(&name, Linkage::Local, false, false)
+                    .map_err(|e| IRError::Module(e))?;
+                let mut description = DataDescription::new();
+                description.define(bytes.into_boxed_slice());
+                description.set_align(align);
+                module.define_data(data_id, &description)
+                    .map_err(|e| IRError::Module(e))?;
+                data_id
+            }
+        };
+        let data_gv = module.declare_data_in_func(data_id, builder.func);
+        Ok(builder.ins().symbol_value(types::I64, data_gv))
     }
 }
\ No newline at end of file
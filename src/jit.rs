@@ -0,0 +1,82 @@
+use crate::ast::Program;
+use crate::compiler::{make_isa, CompilerError, OptLevel};
+use crate::ir_gen::IRGenerator;
+use crate::optimize;
+use crate::semantic::SemanticAnalyzer;
+
+use cranelift_jit::{JITBuilder, JITModule};
+use target_lexicon::Triple;
+
+// Every runtime function IRGenerator imports. build.rs links src/runtime.c
+// into rono, and the JIT resolves these names to it instead of a linker.
+// Only the addresses are taken here, so the declared signature doesn't
+// matter; generated code calls them with their real C signatures.
+macro_rules! runtime_symbols {
+    ($($name:ident),* $(,)?) => {
+        extern "C" {
+            $(fn $name();)*
+        }
+        
+        fn runtime_symbols() -> Vec<(&'static str, *const u8)> {
+            vec![$((stringify!($name), $name as *const u8)),*]
+        }
+    };
+}
+
+runtime_symbols![
+    rono_print_int, rono_print_float, rono_print_bool, rono_print_string,
+    rono_print_format_int, rono_print_template, rono_out_line, rono_flush, rono_output_configure,
+    rono_str_len, rono_str_concat, rono_str_eq,
+    rono_region_enter, rono_region_leave, rono_region_leave_str, rono_region_pop, rono_region_release,
+    rono_alloc, rono_str_copy, rono_str_persist,
+    rono_input_string, rono_input_int, rono_input_float, rono_input_bool,
+    rono_rand_int, rono_rand_float, rono_rand_string, rono_rand_char_range, rono_rand_seed,
+    rono_rand_state, rono_rand_reduce, rono_rand_fill_int, rono_rand_fill_float,
+    rono_http_get, rono_http_post, rono_http_put, rono_http_delete, rono_http_configure,
+    rono_http_get_many, rono_http_request_many,
+    rono_http_get_stream, rono_http_download, rono_http_open, rono_http_next_chunk,
+    rono_http_chunk_data, rono_http_stream_status, rono_http_close,
+    rono_list_new, rono_list_push, rono_list_insert, rono_list_remove, rono_index_error, rono_array_new, rono_print_list,
+    rono_map_new, rono_map_set, rono_map_get,
+    rono_par_for, rono_par_next, rono_par_lock, rono_par_unlock,
+];
+
+// Code generator for the host whose output is placed in memory and calls
+// the runtime linked into rono by absolute address
+pub(crate) fn new_generator(opt_level: &OptLevel) -> Result<IRGenerator<JITModule>, CompilerError> {
+    let isa = make_isa(Triple::host(), opt_level, &[("is_pic", "false"), ("use_colocated_libcalls", "false")])?;
+    let mut builder = JITBuilder::with_isa(isa, cranelift_module::default_libcall_names());
+    builder.symbols(runtime_symbols());
+    Ok(IRGenerator::new(JITModule::new(builder)))
+}
+
+// `rono run --jit`: compiles the program in memory with the same code
+// generator as `rono compile` and calls its main in this process, without
+// writing an object file or running a linker. Returns main's exit status.
+pub fn run(ast: &Program, opt_level: &OptLevel) -> Result<i32, CompilerError> {
+    let mut analyzer = SemanticAnalyzer::new();
+    let mut analyzed_program = analyzer.analyze(ast)
+        .map_err(|e| CompilerError::SemanticAnalysis(e.to_string()))?;
+    optimize::optimize(&mut analyzed_program, opt_level);
+    
+    let mut ir_generator = new_generator(opt_level)?;
+    ir_generator.generate(&analyzed_program)
+        .map_err(|e| CompilerError::IRGeneration(e.to_string()))?;
+    let main_id = *ir_generator.functions.get("main")
+        .ok_or_else(|| CompilerError::IRGeneration("No main function found".to_string()))?;
+    
+    let mut module = ir_generator.finalize();
+    module.finalize_definitions()
+        .map_err(|e| CompilerError::CodeGeneration(e.to_string()))?;
+    
+    // main is generated as int main(void) with the system calling convention
+    let main: extern "C" fn() -> i32 = unsafe { std::mem::transmute(module.get_finalized_function(main_id)) };
+    let status = main();
+    unsafe {
+        // Buffered output would otherwise only be written at process exit
+        rono_flush();
+        module.free_memory();
+    }
+    
+    Ok(status)
+}
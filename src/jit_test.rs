@@ -0,0 +1,357 @@
+#[cfg(test)]
+mod tests {
+    use crate::compiler::OptLevel;
+    use crate::jit;
+    use crate::lexer::Lexer;
+    use crate::parser::Parser;
+    use crate::semantic::AnalyzedProgram;
+
+    // Compiles source in memory and runs its main, returning the exit status
+    fn run(source: &str) -> i32 {
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        let program = Parser::new(tokens).parse().expect("source should parse");
+        jit::run(&program, &OptLevel::Speed).expect("program should compile")
+    }
+
+    #[test]
+    fn test_returned_struct_keeps_callee_strings() {
+        // make's region and stack frame are reused by churn before the
+        // fields are read, so a field left pointing into either reads garbage
+        let source = r#"
+            struct Label {
+                id: int,
+                name: str,
+            }
+
+            fn make(id: int) Label {
+                var name: str = "item-{id}";
+                var label: Label = Label { id = id, name = name };
+                ret label;
+            }
+
+            fn churn(n: int) int {
+                var text: str = "";
+                for (i = 0; i < n; i = i + 1) {
+                    text = text + "overwrite";
+                }
+                ret text.len();
+            }
+
+            chif main() {
+                var first: Label = make(7);
+                var second: Label = make(42);
+                var noise: int = churn(100);
+                if (first.name != "item-7") {
+                    ret 1;
+                }
+                if (second.name != "item-42") {
+                    ret 2;
+                }
+                if (second.id != 42) {
+                    ret 3;
+                }
+                ret 0;
+            }
+        "#;
+        assert_eq!(run(source), 0, "Struct fields should survive the callee's region");
+    }
+
+    #[test]
+    fn test_array_keeps_callee_strings() {
+        let source = r#"
+            fn names(n: int) array str[3] {
+                array result: str[3] = ["", "", ""];
+                for (i = 0; i < n; i = i + 1) {
+                    result[i] = "name-{i}";
+                }
+                ret result;
+            }
+
+            fn churn(n: int) int {
+                var text: str = "";
+                for (i = 0; i < n; i = i + 1) {
+                    text = text + "overwrite";
+                }
+                ret text.len();
+            }
+
+            chif main() {
+                array result: str[3] = names(3);
+                var noise: int = churn(100);
+                if (result[2] != "name-2") {
+                    ret 1;
+                }
+                ret 0;
+            }
+        "#;
+        assert_eq!(run(source), 0, "Array elements should survive the callee's region");
+    }
+
+    #[test]
+    fn test_collections_keep_their_own_structs() {
+        // Every pass through a struct literal reuses its stack block, and
+        // points' frame is gone once it returns, so each element has to be
+        // a copy of its own
+        let source = r#"
+            struct Point {
+                x: int,
+                name: str,
+            }
+
+            fn points(n: int) list[Point] {
+                list result: Point[] = [];
+                for (i = 0; i < n; i = i + 1) {
+                    result.add(Point { x = i, name = "p-{i}" });
+                }
+                result.addAt(Point { x = 100, name = "first" }, 0);
+                result[1] = Point { x = -1, name = "replaced" };
+                ret result;
+            }
+
+            fn by_id(n: int) map[int:Point] {
+                var result: map[int:Point] = {};
+                for (i = 0; i < n; i = i + 1) {
+                    result[i] = Point { x = i * 10, name = "id-{i}" };
+                }
+                ret result;
+            }
+
+            fn churn(n: int) int {
+                var text: str = "";
+                for (i = 0; i < n; i = i + 1) {
+                    text = text + "overwrite";
+                }
+                ret text.len();
+            }
+
+            chif main() {
+                list ps: Point[] = points(4);
+                var ids: map[int:Point] = by_id(3);
+                var noise: int = churn(100);
+                if (ps.len() != 5) {
+                    ret 1;
+                }
+                var first: Point = ps[0];
+                if (first.x != 100) {
+                    ret 2;
+                }
+                if (first.name != "first") {
+                    ret 3;
+                }
+                var replaced: Point = ps[1];
+                if (replaced.name != "replaced") {
+                    ret 4;
+                }
+                for (i = 2; i < 5; i = i + 1) {
+                    var p: Point = ps[i];
+                    var expected: int = i - 1;
+                    if (p.x != expected) {
+                        ret 5;
+                    }
+                    if (p.name != "p-{expected}") {
+                        ret 6;
+                    }
+                }
+                var second: Point = ids[1];
+                if (second.x != 10) {
+                    ret 7;
+                }
+                if (second.name != "id-1") {
+                    ret 8;
+                }
+                ret 0;
+            }
+        "#;
+        assert_eq!(run(source), 0, "List and map elements should not share one struct block");
+    }
+
+    #[test]
+    fn test_loops_release_iteration_strings() {
+        // The first loop and the one in find assign only ints, so they get
+        // a region that is reset every iteration; find returns a string made
+        // in its loop's region. The loop assigning kept keeps the function's.
+        let source = r#"
+            fn label(i: int) str {
+                var name: str = "item-{i}";
+                ret name;
+            }
+
+            fn find(n: int) str {
+                for (i = 0; i < n; i = i + 1) {
+                    if ("{i}" == "7") {
+                        ret "item-{i}";
+                    }
+                }
+                ret "none";
+            }
+
+            chif main() {
+                var hits: int = 0;
+                for (i = 0; i < 20000; i = i + 1) {
+                    var digit: int = i % 10;
+                    if ("{digit}!" == "3!") {
+                        hits = hits + 1;
+                    }
+                }
+                var kept: str = "start";
+                var j: int = 0;
+                while (j < 3) {
+                    kept = label(j);
+                    j = j + 1;
+                }
+                var found: str = find(100);
+                var noise: int = hits;
+                while (noise > 0) {
+                    if ("{noise}" == "") {
+                        noise = 0;
+                    }
+                    noise = noise - 1;
+                }
+                if (hits != 2000) {
+                    ret 1;
+                }
+                if (kept != "item-2") {
+                    ret 2;
+                }
+                if (found != "item-7") {
+                    ret 3;
+                }
+                ret 0;
+            }
+        "#;
+        assert_eq!(run(source), 0, "Loop regions should only release what an iteration left behind");
+    }
+
+    #[test]
+    fn test_struct_fields_are_reordered_by_alignment() {
+        let source = r#"
+            struct Flags {
+                a: bool,
+                n: int,
+                b: bool,
+                m: int,
+            }
+
+            chif main() {
+                var f: Flags = Flags { a = true, n = 7, b = false, m = -3 };
+                f.b = true;
+                f.n = f.n + f.m;
+                f.a = false;
+                list fs: Flags[] = [f];
+                var g: Flags = fs[0];
+                if (g.a) {
+                    ret 1;
+                }
+                if (!g.b) {
+                    ret 2;
+                }
+                if (g.n != 4) {
+                    ret 3;
+                }
+                if (g.m != -3) {
+                    ret 4;
+                }
+                ret 0;
+            }
+        "#;
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        let program = Parser::new(tokens).parse().expect("source should parse");
+        let mut generator = jit::new_generator(&OptLevel::Speed).expect("JIT should be available");
+        generator.generate(&AnalyzedProgram { items: program.items }).expect("program should generate");
+        let layout = &generator.structs["Flags"];
+        assert_eq!(layout.size, 24, "bool, int, bool, int should pack into 24 bytes");
+        let offsets: Vec<(&str, u32)> = layout.fields.iter().map(|field| (field.name.as_str(), field.offset)).collect();
+        assert_eq!(offsets, [("n", 0), ("m", 8), ("a", 16), ("b", 17)]);
+
+        assert_eq!(run(source), 0, "Fields should read back what was written after reordering");
+    }
+
+    #[test]
+    fn test_soa_columns_stay_in_step() {
+        // alive is a 1-byte column between 8-byte ones in the array; the
+        // list's add, addAt and del have to move every column together
+        let source = r#"
+            soa struct Particle {
+                x: float,
+                alive: bool,
+                id: int,
+                name: str,
+            }
+
+            chif main() {
+                array ps: Particle[3] = [
+                    Particle { x = 1.5, alive = true, id = 1, name = "a" },
+                    Particle { x = 2.5, alive = true, id = 2, name = "b" },
+                    Particle { x = 3.5, alive = true, id = 3, name = "c" }
+                ];
+                ps[1].x = ps[1].x + 2.0;
+                ps[2].alive = false;
+                if (ps[1].x != 4.5) {
+                    ret 1;
+                }
+                if (ps[0].x != 1.5) {
+                    ret 2;
+                }
+                if (ps[2].alive) {
+                    ret 3;
+                }
+                if (!ps[1].alive) {
+                    ret 4;
+                }
+                if (ps[2].id != 3) {
+                    ret 5;
+                }
+                if (ps[2].name != "c") {
+                    ret 6;
+                }
+
+                list qs: Particle[] = [];
+                var fx: float = 0.0;
+                for (i = 0; i < 4; i = i + 1) {
+                    qs.add(Particle { x = fx, alive = i % 2 == 0, id = i, name = "q-{i}" });
+                    fx = fx + 1.0;
+                }
+                qs.addAt(Particle { x = -1.0, alive = false, id = 100, name = "head" }, 0);
+                qs.del(2);
+                qs[3].id = qs[3].id * 10;
+                // head, 0, 2, 3 (id 30), with 1 deleted
+                if (qs.len() != 4) {
+                    ret 7;
+                }
+                var head: Particle = qs[0];
+                if (head.id != 100) {
+                    ret 8;
+                }
+                if (head.name != "head") {
+                    ret 9;
+                }
+                if (head.alive) {
+                    ret 10;
+                }
+                if (qs[1].id != 0) {
+                    ret 11;
+                }
+                if (qs[2].id != 2) {
+                    ret 12;
+                }
+                if (qs[2].x != 2.0) {
+                    ret 13;
+                }
+                if (!qs[2].alive) {
+                    ret 14;
+                }
+                if (qs[2].name != "q-2") {
+                    ret 15;
+                }
+                if (qs[3].id != 30) {
+                    ret 16;
+                }
+                if (qs[3].name != "q-3") {
+                    ret 17;
+                }
+                ret 0;
+            }
+        "#;
+        assert_eq!(run(source), 0, "soa columns should stay in step");
+    }
+}
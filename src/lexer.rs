@@ -1,6 +1,11 @@
 use crate::error::{ChifError, Result};
 
-#[derive(Debug, Clone, PartialEq)]
+use std::borrow::Cow;
+use std::collections::HashMap;
+
+// Tokens are plain values: identifiers are interned symbols and string
+// literals are spans into the source, so lexing and peeking never allocate
+#[derive(Debug, Clone, Copy, PartialEq)]
 pub enum Token {
     // Keywords
     Chif,
@@ -35,10 +40,11 @@ pub enum Token {
     Pointer,
     
     // Identifiers and literals
-    Identifier(String),
+    Identifier(Symbol),
     IntLiteral(i64),
     FloatLiteral(f64),
-    StringLiteral(String),
+    // Text between the quotes, escapes not yet decoded
+    StringLiteral(Span),
     BoolLiteral(bool),
     
     // Operators
@@ -71,30 +77,145 @@ pub enum Token {
     Colon,
     Comma,
     Dot,
+    DotDot,
     
     // Special
     Eof,
 }
 
-pub struct Lexer {
-    input: Vec<char>,
+// Byte range of a token in the source
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct Span {
+    pub start: usize,
+    pub end: usize,
+}
+
+// Interned identifier: equal names have equal symbols
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct Symbol(u32);
+
+impl Symbol {
+    // Contextual keywords, interned first so the parser can match them
+    // without looking at the text
+    pub const PAR: Symbol = Symbol(0);
+    pub const IN: Symbol = Symbol(1);
+    pub const SUM: Symbol = Symbol(2);
+    pub const MIN: Symbol = Symbol(3);
+    pub const MAX: Symbol = Symbol(4);
+    pub const SOA: Symbol = Symbol(5);
+}
+
+const PREDEFINED_SYMBOLS: [&str; 6] = ["par", "in", "sum", "min", "max", "soa"];
+
+// Names of the identifiers in one source, borrowed from it
+pub struct Interner<'a> {
+    symbols: HashMap<&'a str, Symbol>,
+    names: Vec<&'a str>,
+}
+
+impl<'a> Interner<'a> {
+    fn new() -> Self {
+        let mut interner = Self { symbols: HashMap::new(), names: Vec::new() };
+        for name in PREDEFINED_SYMBOLS {
+            interner.intern(name);
+        }
+        interner
+    }
+    
+    fn intern(&mut self, name: &'a str) -> Symbol {
+        if let Some(&symbol) = self.symbols.get(name) {
+            return symbol;
+        }
+        let symbol = Symbol(self.names.len() as u32);
+        self.names.push(name);
+        self.symbols.insert(name, symbol);
+        symbol
+    }
+    
+    pub fn name(&self, symbol: Symbol) -> &'a str {
+        self.names[symbol.0 as usize]
+    }
+}
+
+// Output of the lexer: the tokens, the span of each, and what their
+// symbols and spans refer to
+pub struct Tokens<'a> {
+    pub tokens: Vec<Token>,
+    pub spans: Vec<Span>,
+    pub symbols: Interner<'a>,
+    source: &'a str,
+}
+
+impl<'a> Tokens<'a> {
+    pub fn name(&self, symbol: Symbol) -> &'a str {
+        self.symbols.name(symbol)
+    }
+    
+    // Byte offset where each line of the source starts, the first line at 0
+    pub fn line_starts(&self) -> Vec<usize> {
+        std::iter::once(0)
+            .chain(self.source.bytes().enumerate().filter(|&(_, byte)| byte == b'\n').map(|(offset, _)| offset + 1))
+            .collect()
+    }
+    
+    pub fn text(&self, span: Span) -> &'a str {
+        &self.source[span.start..span.end]
+    }
+    
+    // Value of a string literal; borrowed from the source unless it has
+    // escapes (the lexer has already checked them)
+    pub fn string(&self, span: Span) -> Cow<'a, str> {
+        let raw = self.text(span);
+        if !raw.contains('\\') {
+            return Cow::Borrowed(raw);
+        }
+        let mut value = String::with_capacity(raw.len());
+        let mut chars = raw.chars();
+        while let Some(ch) = chars.next() {
+            if ch != '\\' {
+                value.push(ch);
+                continue;
+            }
+            match chars.next() {
+                Some('n') => value.push('\n'),
+                Some('t') => value.push('\t'),
+                Some('r') => value.push('\r'),
+                Some(other) => value.push(other), // '\\' and '"'
+                None => {}
+            }
+        }
+        Cow::Owned(value)
+    }
+}
+
+// Scans the source bytes in place. Everything outside string literals and
+// comments is ASCII, so multi-byte characters only need care for columns
+// and error messages.
+pub struct Lexer<'a> {
+    source: &'a str,
+    input: &'a [u8],
     position: usize,
     line: usize,
     column: usize,
+    symbols: Interner<'a>,
 }
 
-impl Lexer {
-    pub fn new(input: &str) -> Self {
+impl<'a> Lexer<'a> {
+    pub fn new(input: &'a str) -> Self {
         Self {
-            input: input.chars().collect(),
+            source: input,
+            input: input.as_bytes(),
             position: 0,
             line: 1,
             column: 1,
+            symbols: Interner::new(),
         }
     }
     
-    pub fn tokenize(&mut self) -> Result<Vec<Token>> {
-        let mut tokens = Vec::new();
+    pub fn tokenize(&mut self) -> Result<Tokens<'a>> {
+        // About one token per five bytes of typical source
+        let mut tokens = Vec::with_capacity(self.input.len() / 5 + 1);
+        let mut spans = Vec::with_capacity(self.input.len() / 5 + 1);
         
         while !self.is_at_end() {
             self.skip_whitespace();
@@ -102,47 +223,63 @@ impl Lexer {
                 break;
             }
             
+            let start = self.position;
             let token = self.next_token()?;
             tokens.push(token);
+            spans.push(Span { start, end: self.position });
         }
         
         tokens.push(Token::Eof);
-        Ok(tokens)
+        spans.push(Span { start: self.position, end: self.position });
+        Ok(Tokens {
+            tokens,
+            spans,
+            symbols: std::mem::replace(&mut self.symbols, Interner::new()),
+            source: self.source,
+        })
     }
     
     fn next_token(&mut self) -> Result<Token> {
+        let start = self.position;
         let ch = self.advance();
         
         match ch {
-            '(' => Ok(Token::LeftParen),
-            ')' => Ok(Token::RightParen),
-            '{' => Ok(Token::LeftBrace),
-            '}' => Ok(Token::RightBrace),
-            '[' => Ok(Token::LeftBracket),
-            ']' => Ok(Token::RightBracket),
-            ';' => Ok(Token::Semicolon),
-            ':' => Ok(Token::Colon),
-            ',' => Ok(Token::Comma),
-            '.' => Ok(Token::Dot),
-            '+' => Ok(Token::Plus),
-            '-' => Ok(Token::Minus),
-            '*' => {
+            b'(' => Ok(Token::LeftParen),
+            b')' => Ok(Token::RightParen),
+            b'{' => Ok(Token::LeftBrace),
+            b'}' => Ok(Token::RightBrace),
+            b'[' => Ok(Token::LeftBracket),
+            b']' => Ok(Token::RightBracket),
+            b';' => Ok(Token::Semicolon),
+            b':' => Ok(Token::Colon),
+            b',' => Ok(Token::Comma),
+            b'.' => {
+                if self.peek() == Some(b'.') {
+                    self.advance();
+                    Ok(Token::DotDot)
+                } else {
+                    Ok(Token::Dot)
+                }
+            },
+            b'+' => Ok(Token::Plus),
+            b'-' => Ok(Token::Minus),
+            b'*' => {
                 // In this simple implementation, we'll treat * as multiply by default
                 // The parser will need to determine context for dereference
                 Ok(Token::Multiply)
             },
-            '/' => Ok(Token::Divide),
-            '%' => Ok(Token::Modulo),
-            '&' => {
-                if self.peek() == Some('&') {
+            b'/' => Ok(Token::Divide),
+            b'%' => Ok(Token::Modulo),
+            b'&' => {
+                if self.peek() == Some(b'&') {
                     self.advance();
                     Ok(Token::And)
                 } else {
                     Ok(Token::Reference)
                 }
             },
-            '|' => {
-                if self.peek() == Some('|') {
+            b'|' => {
+                if self.peek() == Some(b'|') {
                     self.advance();
                     Ok(Token::Or)
                 } else {
@@ -153,79 +290,66 @@ impl Lexer {
                     })
                 }
             },
-            '!' => {
-                if self.peek() == Some('=') {
+            b'!' => {
+                if self.peek() == Some(b'=') {
                     self.advance();
                     Ok(Token::NotEqual)
                 } else {
                     Ok(Token::Not)
                 }
             },
-            '=' => {
-                if self.peek() == Some('=') {
+            b'=' => {
+                if self.peek() == Some(b'=') {
                     self.advance();
                     Ok(Token::Equal)
                 } else {
                     Ok(Token::Assign)
                 }
             },
-            '<' => {
-                if self.peek() == Some('=') {
+            b'<' => {
+                if self.peek() == Some(b'=') {
                     self.advance();
                     Ok(Token::LessEqual)
                 } else {
                     Ok(Token::Less)
                 }
             },
-            '>' => {
-                if self.peek() == Some('=') {
+            b'>' => {
+                if self.peek() == Some(b'=') {
                     self.advance();
                     Ok(Token::GreaterEqual)
                 } else {
                     Ok(Token::Greater)
                 }
             },
-            '"' => self.string_literal(),
-            _ if ch.is_ascii_digit() => self.number_literal(ch),
-            _ if ch.is_ascii_alphabetic() || ch == '_' => self.identifier_or_keyword(ch),
-            _ => Err(ChifError::LexerError {
-                line: self.line,
-                column: self.column,
-                message: format!("Unexpected character '{}'", ch),
-            }),
+            b'"' => self.string_literal(),
+            _ if ch.is_ascii_digit() => self.number_literal(start),
+            _ if ch.is_ascii_alphabetic() || ch == b'_' => self.identifier_or_keyword(start),
+            _ => {
+                let ch = self.source[start..].chars().next().unwrap_or('\u{FFFD}');
+                Err(ChifError::LexerError {
+                    line: self.line,
+                    column: self.column,
+                    message: format!("Unexpected character '{}'", ch),
+                })
+            }
         }
     }
     
     fn string_literal(&mut self) -> Result<Token> {
-        let mut value = String::new();
+        let start = self.position;
         
         while let Some(ch) = self.peek() {
-            if ch == '"' {
+            if ch == b'"' {
+                let span = Span { start, end: self.position };
                 self.advance(); // consume closing quote
-                return Ok(Token::StringLiteral(value));
+                return Ok(Token::StringLiteral(span));
             }
             
-            if ch == '\\' {
+            if ch == b'\\' {
                 self.advance(); // consume backslash
                 match self.peek() {
-                    Some('n') => {
-                        value.push('\n');
-                        self.advance();
-                    },
-                    Some('t') => {
-                        value.push('\t');
-                        self.advance();
-                    },
-                    Some('r') => {
-                        value.push('\r');
-                        self.advance();
-                    },
-                    Some('\\') => {
-                        value.push('\\');
-                        self.advance();
-                    },
-                    Some('"') => {
-                        value.push('"');
+                    Some(b'n' | b't' | b'r' | b'\\' | b'"') => {
                         self.advance();
                     },
                     _ => {
@@ -237,7 +361,7 @@ impl Lexer {
                     }
                 }
             } else {
-                value.push(self.advance());
+                self.advance();
             }
         }
         
@@ -248,31 +372,15 @@ impl Lexer {
         })
     }
     
-    fn number_literal(&mut self, first_digit: char) -> Result<Token> {
-        let mut value = String::new();
-        value.push(first_digit);
-        
-        while let Some(ch) = self.peek() {
-            if ch.is_ascii_digit() {
-                value.push(self.advance());
-            } else {
-                break;
-            }
-        }
+    fn number_literal(&mut self, start: usize) -> Result<Token> {
+        self.skip_digits();
         
         // Check for float
-        if self.peek() == Some('.') && self.peek_next().map_or(false, |c| c.is_ascii_digit()) {
-            value.push(self.advance()); // consume '.'
-            
-            while let Some(ch) = self.peek() {
-                if ch.is_ascii_digit() {
-                    value.push(self.advance());
-                } else {
-                    break;
-                }
-            }
+        if self.peek() == Some(b'.') && self.peek_next().map_or(false, |c| c.is_ascii_digit()) {
+            self.advance(); // consume '.'
+            self.skip_digits();
             
-            let float_val = value.parse::<f64>().map_err(|_| ChifError::LexerError {
+            let float_val = self.source[start..self.position].parse::<f64>().map_err(|_| ChifError::LexerError {
                 line: self.line,
                 column: self.column,
                 message: "Invalid float literal".to_string(),
@@ -280,7 +388,7 @@ impl Lexer {
             
             Ok(Token::FloatLiteral(float_val))
         } else {
-            let int_val = value.parse::<i64>().map_err(|_| ChifError::LexerError {
+            let int_val = self.source[start..self.position].parse::<i64>().map_err(|_| ChifError::LexerError {
                 line: self.line,
                 column: self.column,
                 message: "Invalid integer literal".to_string(),
@@ -290,19 +398,19 @@ impl Lexer {
         }
     }
     
-    fn identifier_or_keyword(&mut self, first_char: char) -> Result<Token> {
-        let mut value = String::new();
-        value.push(first_char);
-        
-        while let Some(ch) = self.peek() {
-            if ch.is_ascii_alphanumeric() || ch == '_' {
-                value.push(self.advance());
-            } else {
-                break;
-            }
+    fn skip_digits(&mut self) {
+        while self.peek().map_or(false, |ch| ch.is_ascii_digit()) {
+            self.advance();
+        }
+    }
+    
+    fn identifier_or_keyword(&mut self, start: usize) -> Result<Token> {
+        while self.peek().map_or(false, |ch| ch.is_ascii_alphanumeric() || ch == b'_') {
+            self.advance();
         }
         
-        let token = match value.as_str() {
+        let value = &self.source[start..self.position];
+        let token = match value {
             "chif" => Token::Chif,
             "let" => Token::Let,
             "var" => Token::Var,
@@ -333,7 +441,7 @@ impl Lexer {
             "pointer" => Token::Pointer,
             "true" => Token::BoolLiteral(true),
             "false" => Token::BoolLiteral(false),
-            _ => Token::Identifier(value),
+            _ => Token::Identifier(self.symbols.intern(value)),
         };
         
         Ok(token)
@@ -341,19 +449,30 @@ impl Lexer {
     
     fn skip_whitespace(&mut self) {
         while let Some(ch) = self.peek() {
-            if ch.is_whitespace() {
-                if ch == '\n' {
-                    self.line += 1;
-                    self.column = 1;
-                } else {
-                    self.column += 1;
+            let width = if ch.is_ascii_whitespace() {
+                1
+            } else if ch >= 0x80 {
+                // Unicode whitespace, e.g. a no-break space
+                match self.source[self.position..].chars().next() {
+                    Some(ch) if ch.is_whitespace() => ch.len_utf8(),
+                    _ => break,
                 }
-                self.advance();
-            } else if ch == '/' && self.peek_next() == Some('/') {
+            } else if ch == b'/' && self.peek_next() == Some(b'/') {
                 // Skip line comment
                 self.skip_line_comment();
+                continue;
             } else {
                 break;
+            };
+            
+            if ch == b'\n' {
+                self.line += 1;
+                self.column = 1;
+            } else {
+                self.column += 1;
+            }
+            for _ in 0..width {
+                self.advance();
             }
         }
     }
@@ -365,37 +484,33 @@ impl Lexer {
         
         // Skip until end of line or end of file
         while let Some(ch) = self.peek() {
-            if ch == '\n' {
+            if ch == b'\n' {
                 break;
             }
             self.advance();
         }
     }
     
-    fn advance(&mut self) -> char {
+    // Columns count characters: continuation bytes of a UTF-8 sequence
+    // don't move the column
+    fn advance(&mut self) -> u8 {
         let ch = self.input[self.position];
         self.position += 1;
-        self.column += 1;
+        if ch & 0xC0 != 0x80 {
+            self.column += 1;
+        }
         ch
     }
     
-    fn peek(&self) -> Option<char> {
-        if self.position < self.input.len() {
-            Some(self.input[self.position])
-        } else {
-            None
-        }
+    fn peek(&self) -> Option<u8> {
+        self.input.get(self.position).copied()
     }
     
-    fn peek_next(&self) -> Option<char> {
-        if self.position + 1 < self.input.len() {
-            Some(self.input[self.position + 1])
-        } else {
-            None
-        }
+    fn peek_next(&self) -> Option<u8> {
+        self.input.get(self.position + 1).copied()
     }
     
     fn is_at_end(&self) -> bool {
         self.position >= self.input.len()
     }
-}
\ No newline at end of file
+}
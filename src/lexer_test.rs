@@ -0,0 +1,124 @@
+#[cfg(test)]
+mod tests {
+    use crate::interpreter::Interpreter;
+    use crate::lexer::{Lexer, Symbol, Token, Tokens};
+    use crate::parser::Parser;
+
+    use std::borrow::Cow;
+
+    fn lex(source: &str) -> Tokens<'_> {
+        Lexer::new(source).tokenize().expect("source should lex")
+    }
+
+    // Decoded value of the only string literal in source
+    fn string_value(source: &str) -> String {
+        let tokens = lex(source);
+        let span = tokens.tokens.iter()
+            .find_map(|token| match token {
+                Token::StringLiteral(span) => Some(*span),
+                _ => None,
+            })
+            .expect("source should contain a string literal");
+        tokens.string(span).into_owned()
+    }
+
+    #[test]
+    fn test_string_escapes_are_decoded_from_spans() {
+        let source = r#"var s: str = "tab\tline\nquote\"back\\slash\r";"#;
+        assert_eq!(string_value(source), "tab\tline\nquote\"back\\slash\r");
+
+        // The span covers the text between the quotes, escapes undecoded
+        let tokens = lex(source);
+        let span = tokens.tokens.iter()
+            .find_map(|token| match token {
+                Token::StringLiteral(span) => Some(*span),
+                _ => None,
+            })
+            .unwrap();
+        assert_eq!(tokens.text(span), r#"tab\tline\nquote\"back\\slash\r"#);
+
+        // Without escapes the value is borrowed from the source
+        let tokens = lex(r#""plain""#);
+        match tokens.tokens[0] {
+            Token::StringLiteral(span) => assert!(matches!(tokens.string(span), Cow::Borrowed("plain"))),
+            other => panic!("Expected a string literal, got {:?}", other),
+        }
+
+        assert!(Lexer::new(r#""bad \q escape""#).tokenize().is_err(), "Unknown escapes should be rejected");
+        assert!(Lexer::new(r#""unterminated"#).tokenize().is_err(), "Unterminated strings should be rejected");
+    }
+
+    #[test]
+    fn test_ranges_and_floats() {
+        assert_eq!(lex("1..5").tokens, vec![Token::IntLiteral(1), Token::DotDot, Token::IntLiteral(5), Token::Eof]);
+        assert_eq!(lex("1.5").tokens, vec![Token::FloatLiteral(1.5), Token::Eof]);
+        assert_eq!(lex("1.5..2").tokens, vec![Token::FloatLiteral(1.5), Token::DotDot, Token::IntLiteral(2), Token::Eof]);
+        assert_eq!(lex("0 .. 10").tokens, vec![Token::IntLiteral(0), Token::DotDot, Token::IntLiteral(10), Token::Eof]);
+
+        let tokens = lex("0..n");
+        assert!(matches!(tokens.tokens.as_slice(), [Token::IntLiteral(0), Token::DotDot, Token::Identifier(_), Token::Eof]));
+        // A method call on a number literal is not a float
+        assert_eq!(lex("1.x").tokens[..2], [Token::IntLiteral(1), Token::Dot]);
+    }
+
+    #[test]
+    fn test_contextual_keywords_are_identifiers() {
+        let tokens = lex("par in sum min max soa");
+        assert_eq!(
+            tokens.tokens,
+            vec![
+                Token::Identifier(Symbol::PAR),
+                Token::Identifier(Symbol::IN),
+                Token::Identifier(Symbol::SUM),
+                Token::Identifier(Symbol::MIN),
+                Token::Identifier(Symbol::MAX),
+                Token::Identifier(Symbol::SOA),
+                Token::Eof,
+            ]
+        );
+        assert_eq!(tokens.name(Symbol::SOA), "soa");
+
+        // They stay usable as variable names next to a par for that uses
+        // them as keywords
+        let source = r#"
+            chif main() {
+                var par: int = 1;
+                var in: int = 2;
+                var sum: int = 3;
+                var min: int = 4;
+                var max: int = 5;
+                var soa: int = 6;
+                par = par + in;
+                par for (i in 0..4; sum sum, max max) {
+                    sum = sum + i;
+                    if (i > max) {
+                        max = i;
+                    }
+                }
+                con.out("{par} {in} {sum} {min} {max} {soa}");
+            }
+        "#;
+        let program = Parser::new(lex(source)).parse().expect("contextual keywords should parse as names");
+        let mut interpreter = Interpreter::new();
+        interpreter.capture_output();
+        interpreter.execute(&program).expect("program should run");
+        assert_eq!(interpreter.captured_output(), "3 2 9 4 5 6\n");
+    }
+
+    #[test]
+    fn test_utf8_in_string_literals() {
+        assert_eq!(string_value(r#"var s: str = "Привет, мир ✓";"#), "Привет, мир ✓");
+        assert_eq!(string_value(r#"var s: str = "строка\nс «escape» 🚀";"#), "строка\nс «escape» 🚀");
+
+        // Tokens after a multi-byte literal keep their byte spans
+        let source = "var s: str = \"日本語\"; // комментарий ✓\nvar n: int = 1;";
+        let tokens = lex(source);
+        let names = tokens.tokens.iter()
+            .zip(&tokens.spans)
+            .filter(|(token, _)| matches!(token, Token::Identifier(_)))
+            .map(|(_, span)| tokens.text(*span))
+            .collect::<Vec<_>>();
+        assert_eq!(names, ["s", "n"]);
+        assert!(tokens.tokens.contains(&Token::IntLiteral(1)));
+    }
+}
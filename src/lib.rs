@@ -7,14 +7,41 @@ pub mod error;
 pub mod compiler;
 pub mod semantic;
 pub mod ir_gen;
+pub mod optimize;
+pub mod resolver;
+pub mod bytecode;
+pub mod vm;
+pub mod parallel;
+pub mod modules;
+pub mod bench;
+pub mod profile;
+#[cfg(feature = "jit")]
+pub mod jit;
+#[cfg(feature = "jit")]
+pub mod tier;
 
 #[cfg(test)]
 mod semantic_test;
+#[cfg(test)]
+mod lexer_test;
+#[cfg(test)]
+mod optimize_test;
+#[cfg(test)]
+mod parallel_test;
+#[cfg(test)]
+mod resolver_test;
+#[cfg(test)]
+mod vm_test;
+#[cfg(all(test, feature = "jit"))]
+mod jit_test;
+#[cfg(all(test, feature = "jit"))]
+mod tier_test;
 
 pub use error::{ChifError, Result};
 pub use lexer::Lexer;
 pub use parser::Parser;
 pub use interpreter::Interpreter;
+pub use vm::Vm;
 pub use ast::Program;
 pub use types::{ChifType, ChifValue};
 pub use compiler::{Compiler, CompilerError, Target, OptLevel, detect_host_target};
@@ -3,6 +3,10 @@ use clap::{Arg, Command};
 use std::fs;
 use std::process;
 
+// Counts heap allocations for `rono bench`
+#[global_allocator]
+static ALLOCATOR: bench::CountingAllocator = bench::CountingAllocator;
+
 fn main() {
     let matches = Command::new("rono")
         .version("0.1.0")
@@ -18,6 +22,42 @@ fn main() {
                         .required(true)
                         .index(1),
                 )
+                .arg(
+                    Arg::new("engine")
+                        .long("engine")
+                        .help("Execution engine: the tree-walking interpreter or the bytecode VM")
+                        .value_name("ENGINE")
+                        .value_parser(["tree", "vm"])
+                        .default_value("tree"),
+                )
+                .arg(
+                    Arg::new("jit")
+                        .long("jit")
+                        .help("Compile to native code in memory and run it, without an executable")
+                        .action(clap::ArgAction::SetTrue)
+                        .conflicts_with("engine"),
+                )
+                .arg(
+                    Arg::new("tiered")
+                        .long("tiered")
+                        .help("Interpret the program and compile hot numeric functions to native code")
+                        .action(clap::ArgAction::SetTrue)
+                        .conflicts_with_all(["engine", "jit"]),
+                )
+                .arg(
+                    Arg::new("profile")
+                        .long("profile")
+                        .help("Time every function and line; print a table to stderr and write collapsed stacks for flamegraphs")
+                        .action(clap::ArgAction::SetTrue)
+                        .conflicts_with_all(["engine", "jit"]),
+                )
+                .arg(
+                    Arg::new("profile-output")
+                        .long("profile-output")
+                        .help("Collapsed stack file written by --profile (default: <program>.folded)")
+                        .value_name("FILE")
+                        .requires("profile"),
+                )
         )
         .subcommand(
             Command::new("compile")
@@ -59,6 +99,57 @@ fn main() {
                         .help("Include debug information")
                         .action(clap::ArgAction::SetTrue),
                 )
+                .arg(
+                    Arg::new("metrics")
+                        .long("metrics")
+                        .help("Count HTTP latency, I/O and runtime allocations; reported when run with RONO_METRICS set")
+                        .action(clap::ArgAction::SetTrue),
+                )
+        )
+        .subcommand(
+            Command::new("bench")
+                .about("Run a Rono program repeatedly in each execution mode and report timings as JSON")
+                .arg(
+                    Arg::new("file")
+                        .help("The program to benchmark")
+                        .required(true)
+                        .index(1),
+                )
+                .arg(
+                    Arg::new("runs")
+                        .short('n')
+                        .long("runs")
+                        .help("Runs per mode")
+                        .value_name("N")
+                        .value_parser(clap::value_parser!(usize))
+                        .default_value("10"),
+                )
+                .arg(
+                    Arg::new("modes")
+                        .short('m')
+                        .long("modes")
+                        .help("Execution modes to measure")
+                        .value_name("MODES")
+                        .value_delimiter(',')
+                        .value_parser(["interpreter", "vm", "tiered", "jit", "aot"])
+                        .default_value("interpreter,jit,aot"),
+                )
+                .arg(
+                    Arg::new("optimize")
+                        .short('O')
+                        .long("optimize")
+                        .help("Optimization level of the AOT executable")
+                        .value_name("LEVEL")
+                        .value_parser(["none", "speed", "size"])
+                        .default_value("speed"),
+                )
+                .arg(
+                    Arg::new("output")
+                        .short('o')
+                        .long("output")
+                        .help("Write the JSON report to a file instead of stdout")
+                        .value_name("FILE"),
+                )
         )
         // Legacy support for old CLI
         .arg(
@@ -78,7 +169,20 @@ fn main() {
     match matches.subcommand() {
         Some(("run", sub_matches)) => {
             let filename = sub_matches.get_one::<String>("file").unwrap();
-            run_program(filename);
+            let engine = if sub_matches.get_flag("jit") {
+                "jit"
+            } else if sub_matches.get_flag("tiered") {
+                "tiered"
+            } else {
+                sub_matches.get_one::<String>("engine").unwrap().as_str()
+            };
+            let profile = sub_matches.get_flag("profile").then(|| {
+                sub_matches.get_one::<String>("profile-output").cloned().unwrap_or_else(|| {
+                    let stem = std::path::Path::new(filename).file_stem().and_then(|s| s.to_str()).unwrap_or("program");
+                    format!("{}.folded", stem)
+                })
+            });
+            run_program(filename, engine, profile.as_deref());
         }
         Some(("compile", sub_matches)) => {
             let filename = sub_matches.get_one::<String>("file").unwrap();
@@ -86,18 +190,32 @@ fn main() {
             let target_str = sub_matches.get_one::<String>("target");
             let optimize_str = sub_matches.get_one::<String>("optimize").unwrap();
             let debug = sub_matches.get_flag("debug");
+            let metrics = sub_matches.get_flag("metrics");
             
-            compile_program(filename, output, target_str, optimize_str, debug);
+            compile_program(filename, output, target_str, optimize_str, debug, metrics);
+        }
+        Some(("bench", sub_matches)) => {
+            let filename = sub_matches.get_one::<String>("file").unwrap();
+            let options = bench::BenchOptions {
+                runs: *sub_matches.get_one::<usize>("runs").unwrap(),
+                modes: sub_matches
+                    .get_many::<String>("modes")
+                    .unwrap()
+                    .filter_map(|mode| bench::Mode::parse(mode))
+                    .collect(),
+                optimize: sub_matches.get_one::<String>("optimize").unwrap().clone(),
+            };
+            bench_program(filename, &options, sub_matches.get_one::<String>("output"));
         }
         _ => {
             // Legacy mode support
             if let Some(filename) = matches.get_one::<String>("file") {
                 let run_mode = matches.get_flag("run");
                 if run_mode {
-                    run_program(filename);
+                    run_program(filename, "tree", None);
                 } else {
                     // Default to interpretation for legacy mode
-                    run_program(filename);
+                    run_program(filename, "tree", None);
                 }
             } else {
                 eprintln!("No input file specified. Use 'rono --help' for usage information.");
@@ -107,7 +225,8 @@ fn main() {
     }
 }
 
-fn run_program(filename: &str) {
+// `profile` is where --profile writes collapsed stacks
+fn run_program(filename: &str, engine: &str, profile: Option<&str>) {
     let source = match fs::read_to_string(filename) {
         Ok(content) => content,
         Err(e) => {
@@ -136,15 +255,111 @@ fn run_program(filename: &str) {
         }
     };
 
+    if engine == "jit" {
+        run_jit(&ast);
+    }
+
     // Interpretation
-    let mut interpreter = interpreter::Interpreter::new();
-    if let Err(e) = interpreter.execute(&ast) {
+    let result = if engine == "vm" {
+        vm::Vm::new().execute(&ast)
+    } else {
+        let mut interpreter = if engine == "tiered" {
+            tiered_interpreter()
+        } else {
+            interpreter::Interpreter::new()
+        };
+        if profile.is_some() {
+            interpreter.enable_profiling();
+        }
+        let result = interpreter.execute(&ast);
+        if let (Some(profiler), Some(path)) = (interpreter.profiler(), profile) {
+            write_profile(profiler, path);
+        }
+        result
+    };
+    if let Err(e) = result {
         eprintln!("Runtime error: {}", e);
         process::exit(1);
     }
+    bench::report_allocations();
+}
+
+// Table to stderr, so it doesn't mix with the program's output
+fn write_profile(profiler: &profile::Profiler, path: &str) {
+    let mut stderr = std::io::stderr().lock();
+    let _ = profiler.write_report(&mut stderr);
+    
+    let written = fs::File::create(path).and_then(|file| {
+        let mut out = std::io::BufWriter::new(file);
+        profiler.write_collapsed(&mut out)?;
+        std::io::Write::flush(&mut out)
+    });
+    match written {
+        Ok(()) => eprintln!("\nCollapsed stacks written to {}", path),
+        Err(e) => eprintln!("Error writing '{}': {}", path, e),
+    }
+}
+
+#[cfg(feature = "jit")]
+fn run_jit(ast: &Program) -> ! {
+    match jit::run(ast, &OptLevel::Speed) {
+        Ok(status) => {
+            bench::report_allocations();
+            process::exit(status)
+        }
+        Err(e) => {
+            eprintln!("Compilation failed: {}", e);
+            process::exit(1);
+        }
+    }
 }
 
-fn compile_program(filename: &str, output: Option<&String>, target_str: Option<&String>, optimize_str: &str, debug: bool) {
+#[cfg(not(feature = "jit"))]
+fn run_jit(_ast: &Program) -> ! {
+    eprintln!("This build of rono has no JIT support (built without the `jit` feature)");
+    process::exit(1);
+}
+
+#[cfg(feature = "jit")]
+fn tiered_interpreter() -> interpreter::Interpreter {
+    let mut interpreter = interpreter::Interpreter::new();
+    interpreter.enable_tiering(OptLevel::Speed);
+    interpreter
+}
+
+#[cfg(not(feature = "jit"))]
+fn tiered_interpreter() -> interpreter::Interpreter {
+    eprintln!("This build of rono has no JIT support (built without the `jit` feature)");
+    process::exit(1);
+}
+
+fn bench_program(filename: &str, options: &bench::BenchOptions, output: Option<&String>) {
+    if let Err(e) = fs::metadata(filename) {
+        eprintln!("Error reading file '{}': {}", filename, e);
+        process::exit(1);
+    }
+    
+    let report = match bench::run(filename, options) {
+        Ok(report) => report,
+        Err(e) => {
+            eprintln!("Benchmark failed: {}", e);
+            process::exit(1);
+        }
+    };
+    let json = serde_json::to_string_pretty(&report).expect("bench report serializes");
+    
+    match output {
+        Some(path) => {
+            if let Err(e) = fs::write(path, json + "\n") {
+                eprintln!("Error writing '{}': {}", path, e);
+                process::exit(1);
+            }
+        }
+        None => println!("{}", json),
+    }
+}
+
+fn compile_program(filename: &str, output: Option<&String>, target_str: Option<&String>, optimize_str: &str, debug: bool, metrics: bool) {
     let source = match fs::read_to_string(filename) {
         Ok(content) => content,
         Err(e) => {
@@ -222,6 +437,9 @@ fn compile_program(filename: &str, output: Option<&String>, target_str: Option<&
             process::exit(1);
         }
     };
+    if metrics {
+        compiler.enable_metrics();
+    }
 
     match compiler.compile(&ast, &output_path) {
         Ok(()) => {
@@ -0,0 +1,151 @@
+use crate::ast::{ImportStatement, Item, Program};
+use crate::lexer::Lexer;
+use crate::parallel::{self, Detached};
+use crate::parser::Parser;
+
+use std::cell::RefCell;
+use std::collections::{HashMap, HashSet};
+use std::fmt;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::rc::Rc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+// Loading of imported `.rono` files, shared by the interpreter, the
+// semantic analyzer and the code generator. Each file is parsed at most
+// once per process however many of them (or how many modules of a diamond)
+// import it; `preload` walks the import graph first and parses the modules
+// of each level on worker threads. Nothing is kept on disk between runs.
+
+#[derive(Debug)]
+pub enum ModuleError {
+    Read(String),
+    Parse { path: String, message: String },
+}
+
+impl fmt::Display for ModuleError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            ModuleError::Read(path) => write!(f, "Could not read module file: {}", path),
+            ModuleError::Parse { path, message } => write!(f, "Failed to parse module {}: {}", path, message),
+        }
+    }
+}
+
+// File an import refers to; `.rono` may be left out
+pub fn module_path(import: &ImportStatement) -> String {
+    if import.path.ends_with(".rono") {
+        import.path.clone()
+    } else {
+        format!("{}.rono", import.path)
+    }
+}
+
+// Name the module's functions are called through: the alias, else the file name
+pub fn module_name(import: &ImportStatement) -> String {
+    import.alias.clone().unwrap_or_else(|| {
+        Path::new(&import.path)
+            .file_stem()
+            .unwrap()
+            .to_string_lossy()
+            .to_string()
+    })
+}
+
+thread_local! {
+    // Parsed modules by canonical path. Programs hold Rc, so each thread
+    // that loads modules has its own table.
+    static LOADED: RefCell<HashMap<PathBuf, Rc<Program>>> = RefCell::new(HashMap::new());
+}
+
+fn canonical(path: &str) -> PathBuf {
+    fs::canonicalize(path).unwrap_or_else(|_| PathBuf::from(path))
+}
+
+// The parsed module an import refers to
+pub fn load(import: &ImportStatement) -> Result<Rc<Program>, ModuleError> {
+    let path = module_path(import);
+    let key = canonical(&path);
+    if let Some(program) = LOADED.with(|loaded| loaded.borrow().get(&key).cloned()) {
+        return Ok(program);
+    }
+    let program = Rc::new(load_file(&path)?);
+    LOADED.with(|loaded| loaded.borrow_mut().insert(key, Rc::clone(&program)));
+    Ok(program)
+}
+
+// Loads every module reachable from items' imports, the modules of each
+// level of the import graph in parallel. Files that fail to load are left
+// for `load` to report when the import is processed.
+pub fn preload(items: &[Item]) {
+    let mut seen = HashSet::new();
+    let mut pending: Vec<String> = imports(items).collect();
+    while !pending.is_empty() {
+        let level: Vec<(String, PathBuf)> = pending
+            .drain(..)
+            .map(|path| {
+                let key = canonical(&path);
+                (path, key)
+            })
+            .filter(|(_, key)| seen.insert(key.clone()))
+            .filter(|(_, key)| !LOADED.with(|loaded| loaded.borrow().contains_key(key)))
+            .collect();
+
+        let paths: Vec<&str> = level.iter().map(|(path, _)| path.as_str()).collect();
+        for ((_, key), result) in level.iter().zip(load_files(&paths)) {
+            if let Ok(program) = result {
+                pending.extend(imports(&program.items));
+                LOADED.with(|loaded| loaded.borrow_mut().insert(key.clone(), Rc::new(program)));
+            }
+        }
+    }
+}
+
+fn imports(items: &[Item]) -> impl Iterator<Item = String> + '_ {
+    items.iter().filter_map(|item| match item {
+        Item::Import(import) => Some(module_path(import)),
+        _ => None,
+    })
+}
+
+fn load_files(paths: &[&str]) -> Vec<Result<Program, ModuleError>> {
+    let workers = parallel::thread_count().min(paths.len());
+    if workers <= 1 {
+        return paths.iter().map(|path| load_file(path)).collect();
+    }
+
+    let next = AtomicUsize::new(0);
+    let mut results: Vec<Option<Result<Program, ModuleError>>> = paths.iter().map(|_| None).collect();
+    std::thread::scope(|scope| {
+        let handles: Vec<_> = (0..workers)
+            .map(|_| {
+                scope.spawn(|| {
+                    let mut loaded = Vec::new();
+                    loop {
+                        let index = next.fetch_add(1, Ordering::Relaxed);
+                        if index >= paths.len() {
+                            break;
+                        }
+                        // Safety: the program is built on this thread from
+                        // the file alone, so nothing outside it shares its Rc
+                        loaded.push((index, unsafe { Detached::new(load_file(paths[index])) }));
+                    }
+                    loaded
+                })
+            })
+            .collect();
+        for handle in handles {
+            for (index, result) in handle.join().expect("module loader thread panicked") {
+                results[index] = Some(result.into_inner());
+            }
+        }
+    });
+    results.into_iter().map(|result| result.expect("every module is loaded by a worker")).collect()
+}
+
+fn load_file(path: &str) -> Result<Program, ModuleError> {
+    let source = fs::read_to_string(path).map_err(|_| ModuleError::Read(path.to_string()))?;
+    let parse_error = |e: crate::error::ChifError| ModuleError::Parse { path: path.to_string(), message: e.to_string() };
+    let tokens = Lexer::new(&source).tokenize().map_err(parse_error)?;
+    Parser::new(tokens).parse().map_err(parse_error)
+}
@@ -0,0 +1,1086 @@
+use crate::ast::*;
+use crate::compiler::OptLevel;
+use crate::semantic::AnalyzedProgram;
+use crate::types::{ChifType, ChifValue};
+
+use std::collections::{HashMap, HashSet};
+use std::fmt;
+
+// Mid-level optimizations on the analyzed program, run by `rono compile`
+// and `rono run --jit` between semantic analysis and code generation for
+// `-O speed` and `-O size`. Cranelift optimizes one function at a time, so
+// what needs the whole program or the source structure happens here:
+//
+// - constant propagation: `let` bindings of literals are substituted into
+//   their uses and literal operators are folded
+// - inlining: calls to functions and struct methods whose body is a single
+//   `ret expr` are replaced by the expression, with the (side-effect free)
+//   arguments substituted
+// - dead code elimination: constant `if` / `while` conditions, statements
+//   after `ret` / `break` / `continue`, unread variables with side-effect
+//   free values and functions that are never called
+// - loop-invariant code motion: declarations in a loop body whose value
+//   depends on nothing the loop changes move in front of the loop
+//
+// Every rewrite keeps what the compiled program prints and returns; the
+// passes only give up opportunities when in doubt (a value that could trap,
+// allocate differently or change type at a call boundary).
+
+// Largest inlined expression, in AST nodes, per optimization level
+const INLINE_LIMIT_SPEED: usize = 24;
+const INLINE_LIMIT_SIZE: usize = 8;
+// Inlined bodies are inlined into again up to this depth
+const INLINE_DEPTH: usize = 3;
+
+// What one pass changed, printed by `rono compile`
+#[derive(Debug, Clone)]
+pub struct PassStats {
+    pub pass: &'static str,
+    pub counts: Vec<(&'static str, usize)>,
+}
+
+impl PassStats {
+    fn new(pass: &'static str, labels: &[&'static str]) -> Self {
+        Self { pass, counts: labels.iter().map(|&label| (label, 0)).collect() }
+    }
+
+    fn add(&mut self, label: &'static str, n: usize) {
+        if let Some(count) = self.counts.iter_mut().find(|(name, _)| *name == label) {
+            count.1 += n;
+        }
+    }
+
+    fn merge(&mut self, other: PassStats) {
+        for (label, n) in other.counts {
+            self.add(label, n);
+        }
+    }
+}
+
+impl fmt::Display for PassStats {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "{}:", self.pass)?;
+        for (i, (label, n)) in self.counts.iter().enumerate() {
+            write!(f, "{} {} {}", if i == 0 { "" } else { "," }, n, label)?;
+        }
+        Ok(())
+    }
+}
+
+pub fn optimize(program: &mut AnalyzedProgram, level: &OptLevel) -> Vec<PassStats> {
+    let inline_limit = match level {
+        OptLevel::None => return Vec::new(),
+        OptLevel::Speed => INLINE_LIMIT_SPEED,
+        OptLevel::Size => INLINE_LIMIT_SIZE,
+    };
+
+    let mut constants = propagate_constants(program);
+    let inlining = inline_calls(program, inline_limit);
+    // Inlined bodies expose new literal operands
+    constants.merge(propagate_constants(program));
+    let dead_code = eliminate_dead_code(program);
+    let licm = hoist_loop_invariants(program);
+    vec![constants, inlining, dead_code, licm]
+}
+
+// Function bodies of the program: free functions and struct methods
+fn functions_mut(program: &mut AnalyzedProgram) -> impl Iterator<Item = &mut Function> {
+    program.items.iter_mut().flat_map(|item| -> Box<dyn Iterator<Item = &mut Function>> {
+        match item {
+            Item::Function(func) => Box::new(std::iter::once(func)),
+            Item::StructImpl(impl_block) => Box::new(impl_block.methods.iter_mut()),
+            _ => Box::new(std::iter::empty()),
+        }
+    })
+}
+
+// Literal operators evaluated at compile time the way the generated code
+// would evaluate them; None leaves the operation to run time (division by
+// zero, overflowing division)
+pub fn fold_binary(left: &ChifValue, op: &BinaryOperator, right: &ChifValue) -> Option<ChifValue> {
+    match (left, op, right) {
+        // Integer arithmetic wraps like the generated instructions
+        (ChifValue::Int(a), BinaryOperator::Add, ChifValue::Int(b)) => Some(ChifValue::Int(a.wrapping_add(*b))),
+        (ChifValue::Int(a), BinaryOperator::Subtract, ChifValue::Int(b)) => Some(ChifValue::Int(a.wrapping_sub(*b))),
+        (ChifValue::Int(a), BinaryOperator::Multiply, ChifValue::Int(b)) => Some(ChifValue::Int(a.wrapping_mul(*b))),
+        (ChifValue::Int(a), BinaryOperator::Divide, ChifValue::Int(b)) => a.checked_div(*b).map(ChifValue::Int),
+        (ChifValue::Int(a), BinaryOperator::Modulo, ChifValue::Int(b)) => a.checked_rem(*b).map(ChifValue::Int),
+
+        // Integer comparisons
+        (ChifValue::Int(a), BinaryOperator::Equal, ChifValue::Int(b)) => Some(ChifValue::Bool(a == b)),
+        (ChifValue::Int(a), BinaryOperator::NotEqual, ChifValue::Int(b)) => Some(ChifValue::Bool(a != b)),
+        (ChifValue::Int(a), BinaryOperator::Less, ChifValue::Int(b)) => Some(ChifValue::Bool(a < b)),
+        (ChifValue::Int(a), BinaryOperator::Greater, ChifValue::Int(b)) => Some(ChifValue::Bool(a > b)),
+        (ChifValue::Int(a), BinaryOperator::LessEqual, ChifValue::Int(b)) => Some(ChifValue::Bool(a <= b)),
+        (ChifValue::Int(a), BinaryOperator::GreaterEqual, ChifValue::Int(b)) => Some(ChifValue::Bool(a >= b)),
+
+        // Float arithmetic
+        (ChifValue::Float(a), BinaryOperator::Add, ChifValue::Float(b)) => Some(ChifValue::Float(a + b)),
+        (ChifValue::Float(a), BinaryOperator::Subtract, ChifValue::Float(b)) => Some(ChifValue::Float(a - b)),
+        (ChifValue::Float(a), BinaryOperator::Multiply, ChifValue::Float(b)) => Some(ChifValue::Float(a * b)),
+        (ChifValue::Float(a), BinaryOperator::Divide, ChifValue::Float(b)) if *b != 0.0 => Some(ChifValue::Float(a / b)),
+
+        // Float comparisons; == and != are left to run time, where the
+        // interpreter compares within f64::EPSILON and the generated code
+        // compares exactly
+        (ChifValue::Float(a), BinaryOperator::Less, ChifValue::Float(b)) => Some(ChifValue::Bool(a < b)),
+        (ChifValue::Float(a), BinaryOperator::Greater, ChifValue::Float(b)) => Some(ChifValue::Bool(a > b)),
+        (ChifValue::Float(a), BinaryOperator::LessEqual, ChifValue::Float(b)) => Some(ChifValue::Bool(a <= b)),
+        (ChifValue::Float(a), BinaryOperator::GreaterEqual, ChifValue::Float(b)) => Some(ChifValue::Bool(a >= b)),
+
+        // Mixed int/float arithmetic (promote int to float)
+        (ChifValue::Int(a), BinaryOperator::Add, ChifValue::Float(b)) => Some(ChifValue::Float(*a as f64 + b)),
+        (ChifValue::Float(a), BinaryOperator::Add, ChifValue::Int(b)) => Some(ChifValue::Float(a + *b as f64)),
+        (ChifValue::Int(a), BinaryOperator::Subtract, ChifValue::Float(b)) => Some(ChifValue::Float(*a as f64 - b)),
+        (ChifValue::Float(a), BinaryOperator::Subtract, ChifValue::Int(b)) => Some(ChifValue::Float(a - *b as f64)),
+        (ChifValue::Int(a), BinaryOperator::Multiply, ChifValue::Float(b)) => Some(ChifValue::Float(*a as f64 * b)),
+        (ChifValue::Float(a), BinaryOperator::Multiply, ChifValue::Int(b)) => Some(ChifValue::Float(a * *b as f64)),
+        (ChifValue::Int(a), BinaryOperator::Divide, ChifValue::Float(b)) if *b != 0.0 => Some(ChifValue::Float(*a as f64 / b)),
+        (ChifValue::Float(a), BinaryOperator::Divide, ChifValue::Int(b)) if *b != 0 => Some(ChifValue::Float(a / *b as f64)),
+
+        // Boolean operations
+        (ChifValue::Bool(a), BinaryOperator::And, ChifValue::Bool(b)) => Some(ChifValue::Bool(*a && *b)),
+        (ChifValue::Bool(a), BinaryOperator::Or, ChifValue::Bool(b)) => Some(ChifValue::Bool(*a || *b)),
+        (ChifValue::Bool(a), BinaryOperator::Equal, ChifValue::Bool(b)) => Some(ChifValue::Bool(a == b)),
+        (ChifValue::Bool(a), BinaryOperator::NotEqual, ChifValue::Bool(b)) => Some(ChifValue::Bool(a != b)),
+
+        // String concatenation
+        (ChifValue::Str(a), BinaryOperator::Add, ChifValue::Str(b)) => Some(ChifValue::Str(format!("{}{}", a, b).into())),
+
+        _ => None, // No folding possible
+    }
+}
+
+fn fold_unary(op: &UnaryOperator, operand: &ChifValue) -> Option<ChifValue> {
+    match (op, operand) {
+        (UnaryOperator::Minus, ChifValue::Int(i)) => Some(ChifValue::Int(i.wrapping_neg())),
+        (UnaryOperator::Minus, ChifValue::Float(f)) => Some(ChifValue::Float(-f)),
+        (UnaryOperator::Not, ChifValue::Bool(b)) => Some(ChifValue::Bool(!b)),
+        _ => None,
+    }
+}
+
+// A string literal as the first argument of con.out is parsed for `{...}`
+// holes by the code generator, so text with braces must not become one
+fn literal_is_movable(value: &ChifValue) -> bool {
+    match value {
+        ChifValue::Int(_) | ChifValue::Float(_) | ChifValue::Bool(_) => true,
+        ChifValue::Str(s) => !s.contains('{') && !s.contains('}'),
+        _ => false,
+    }
+}
+
+// ---- Expression helpers ----
+
+pub(crate) fn for_each_child(expr: &Expression, f: &mut dyn FnMut(&Expression)) {
+    match expr {
+        Expression::Literal(_) | Expression::Identifier(_) | Expression::Local(_) => {}
+        Expression::Binary(binary_op) => {
+            f(&binary_op.left);
+            f(&binary_op.right);
+        }
+        Expression::Unary(unary_op) => f(&unary_op.operand),
+        Expression::Call(func_call) => func_call.args.iter().for_each(|arg| f(arg)),
+        Expression::MethodCall(method_call) => {
+            f(&method_call.object);
+            method_call.args.iter().for_each(|arg| f(arg));
+        }
+        Expression::Index(index_access) => {
+            f(&index_access.object);
+            index_access.indices.iter().for_each(|index| f(index));
+        }
+        Expression::FieldAccess(field_access) => f(&field_access.object),
+        Expression::ArrayLiteral(elements) => elements.iter().for_each(|element| f(element)),
+        Expression::MapLiteral(pairs) => pairs.iter().for_each(|(key, value)| {
+            f(key);
+            f(value);
+        }),
+        Expression::StructLiteral(struct_literal) => struct_literal.fields.iter().for_each(|(_, value)| f(value)),
+        Expression::Reference(inner) | Expression::Dereference(inner) => f(inner),
+        Expression::Template(template) => template.parts.iter().for_each(|part| {
+            if let TemplatePart::Hole { expr, .. } = part {
+                f(expr);
+            }
+        }),
+    }
+}
+
+fn for_each_child_mut(expr: &mut Expression, f: &mut dyn FnMut(&mut Expression)) {
+    match expr {
+        Expression::Literal(_) | Expression::Identifier(_) | Expression::Local(_) => {}
+        Expression::Binary(binary_op) => {
+            f(&mut binary_op.left);
+            f(&mut binary_op.right);
+        }
+        Expression::Unary(unary_op) => f(&mut unary_op.operand),
+        Expression::Call(func_call) => func_call.args.iter_mut().for_each(|arg| f(arg)),
+        Expression::MethodCall(method_call) => {
+            f(&mut method_call.object);
+            method_call.args.iter_mut().for_each(|arg| f(arg));
+        }
+        Expression::Index(index_access) => {
+            f(&mut index_access.object);
+            index_access.indices.iter_mut().for_each(|index| f(index));
+        }
+        Expression::FieldAccess(field_access) => f(&mut field_access.object),
+        Expression::ArrayLiteral(elements) => elements.iter_mut().for_each(|element| f(element)),
+        Expression::MapLiteral(pairs) => pairs.iter_mut().for_each(|(key, value)| {
+            f(key);
+            f(value);
+        }),
+        Expression::StructLiteral(struct_literal) => struct_literal.fields.iter_mut().for_each(|(_, value)| f(value)),
+        Expression::Reference(inner) | Expression::Dereference(inner) => f(inner),
+        Expression::Template(template) => template.parts.iter_mut().for_each(|part| {
+            if let TemplatePart::Hole { expr, .. } = part {
+                f(expr);
+            }
+        }),
+    }
+}
+
+fn expression_size(expr: &Expression) -> usize {
+    let mut size = 1;
+    for_each_child(expr, &mut |child| size += expression_size(child));
+    size
+}
+
+// Names read by expr
+fn collect_reads(expr: &Expression, reads: &mut HashSet<String>) {
+    match expr {
+        Expression::Identifier(name) | Expression::Local(LocalVar { name, .. }) => {
+            reads.insert(name.clone());
+        }
+        _ => for_each_child(expr, &mut |child| collect_reads(child, reads)),
+    }
+}
+
+// Expressions that neither trap, nor call anything, nor write memory, so
+// evaluating them once more, once less or earlier is unobservable
+fn is_pure(expr: &Expression) -> bool {
+    let pure_here = match expr {
+        Expression::Literal(_) | Expression::Identifier(_) | Expression::Local(_) => true,
+        Expression::Binary(binary_op) => !matches!(binary_op.operator, BinaryOperator::Divide | BinaryOperator::Modulo),
+        Expression::Unary(_) | Expression::Template(_) => true,
+        Expression::ArrayLiteral(_) | Expression::MapLiteral(_) | Expression::StructLiteral(_) => true,
+        _ => false,
+    };
+    let mut children_pure = true;
+    for_each_child(expr, &mut |child| children_pure &= is_pure(child));
+    pure_here && children_pure
+}
+
+// ---- Statement helpers ----
+
+fn for_each_block_mut(statement: &mut Statement, f: &mut dyn FnMut(&mut Vec<Statement>)) {
+    match statement {
+        Statement::If(if_stmt) => {
+            f(&mut if_stmt.then_block.statements);
+            if let Some(else_block) = &mut if_stmt.else_block {
+                f(&mut else_block.statements);
+            }
+        }
+        Statement::For(for_stmt) => f(&mut for_stmt.body.statements),
+        Statement::While(while_stmt) => f(&mut while_stmt.body.statements),
+        Statement::Switch(switch) => {
+            for case in &mut switch.cases {
+                f(&mut case.body.statements);
+            }
+            if let Some(default_case) = &mut switch.default_case {
+                f(&mut default_case.statements);
+            }
+        }
+        Statement::ParFor(par_for) => f(&mut par_for.body.statements),
+        _ => {}
+    }
+}
+
+// Expressions evaluated by the statement itself (not by nested blocks),
+// except an assignment target that is a plain variable
+fn for_each_expression(statement: &Statement, f: &mut dyn FnMut(&Expression)) {
+    match statement {
+        Statement::VarDecl(var_decl) => {
+            if let Some(value) = &var_decl.value {
+                f(value);
+            }
+        }
+        Statement::Assignment(assignment) => {
+            if !matches!(assignment.target, Expression::Identifier(_)) {
+                f(&assignment.target);
+            }
+            f(&assignment.value);
+        }
+        Statement::Expression(expr) | Statement::Return(Some(expr)) => f(expr),
+        Statement::If(if_stmt) => f(&if_stmt.condition),
+        Statement::For(for_stmt) => {
+            if let Some(init) = &for_stmt.init {
+                for_each_expression(init, f);
+            }
+            if let Some(condition) = &for_stmt.condition {
+                f(condition);
+            }
+            if let Some(update) = &for_stmt.update {
+                for_each_expression(update, f);
+            }
+        }
+        Statement::While(while_stmt) => f(&while_stmt.condition),
+        Statement::Switch(switch) => {
+            f(&switch.expr);
+            for case in &switch.cases {
+                f(&case.value);
+            }
+        }
+        Statement::ParFor(par_for) => {
+            f(&par_for.start);
+            f(&par_for.end);
+        }
+        Statement::Return(None) | Statement::Break | Statement::Continue => {}
+    }
+}
+
+fn for_each_expression_mut(statement: &mut Statement, f: &mut dyn FnMut(&mut Expression)) {
+    match statement {
+        Statement::VarDecl(var_decl) => {
+            if let Some(value) = &mut var_decl.value {
+                f(value);
+            }
+        }
+        Statement::Assignment(assignment) => {
+            match &mut assignment.target {
+                Expression::Identifier(_) => {}
+                // The indexed variable stays a variable
+                Expression::Index(index_access) => index_access.indices.iter_mut().for_each(|index| f(index)),
+                Expression::FieldAccess(_) => {}
+                other => f(other),
+            }
+            f(&mut assignment.value);
+        }
+        Statement::Expression(expr) | Statement::Return(Some(expr)) => f(expr),
+        Statement::If(if_stmt) => f(&mut if_stmt.condition),
+        Statement::For(for_stmt) => {
+            if let Some(init) = &mut for_stmt.init {
+                for_each_expression_mut(init, f);
+            }
+            if let Some(condition) = &mut for_stmt.condition {
+                f(condition);
+            }
+            if let Some(update) = &mut for_stmt.update {
+                for_each_expression_mut(update, f);
+            }
+        }
+        Statement::While(while_stmt) => f(&mut while_stmt.condition),
+        Statement::Switch(switch) => {
+            f(&mut switch.expr);
+            for case in &mut switch.cases {
+                f(&mut case.value);
+            }
+        }
+        Statement::ParFor(par_for) => {
+            f(&mut par_for.start);
+            f(&mut par_for.end);
+        }
+        Statement::Return(None) | Statement::Break | Statement::Continue => {}
+    }
+}
+
+fn for_each_nested_block(statement: &Statement, f: &mut dyn FnMut(&[Statement])) {
+    match statement {
+        Statement::If(if_stmt) => {
+            f(&if_stmt.then_block.statements);
+            if let Some(else_block) = &if_stmt.else_block {
+                f(&else_block.statements);
+            }
+        }
+        Statement::For(for_stmt) => f(&for_stmt.body.statements),
+        Statement::While(while_stmt) => f(&while_stmt.body.statements),
+        Statement::Switch(switch) => {
+            for case in &switch.cases {
+                f(&case.body.statements);
+            }
+            if let Some(default_case) = &switch.default_case {
+                f(&default_case.statements);
+            }
+        }
+        Statement::ParFor(par_for) => f(&par_for.body.statements),
+        _ => {}
+    }
+}
+
+// Names declared or assigned anywhere in statement, nested blocks included
+fn collect_writes(statement: &Statement, declared: &mut HashSet<String>, assigned: &mut HashSet<String>) {
+    match statement {
+        Statement::VarDecl(var_decl) => {
+            declared.insert(var_decl.name.clone());
+        }
+        Statement::Assignment(assignment) => {
+            if let Expression::Identifier(name) = &assignment.target {
+                assigned.insert(name.clone());
+            }
+        }
+        Statement::For(for_stmt) => {
+            for part in for_stmt.init.iter().chain(for_stmt.update.iter()) {
+                collect_writes(part, declared, assigned);
+            }
+        }
+        Statement::ParFor(par_for) => {
+            declared.insert(par_for.var.clone());
+            assigned.extend(par_for.reductions.iter().map(|reduction| reduction.name.clone()));
+        }
+        _ => {}
+    }
+    for_each_nested_block(statement, &mut |block| {
+        for statement in block {
+            collect_writes(statement, declared, assigned);
+        }
+    });
+}
+
+fn written_names(statement: &Statement) -> HashSet<String> {
+    let mut declared = HashSet::new();
+    let mut assigned = HashSet::new();
+    collect_writes(statement, &mut declared, &mut assigned);
+    declared.extend(assigned);
+    declared
+}
+
+// Names read anywhere in statements; par for reduction targets count as
+// read, since the loop combines into them
+fn collect_statement_reads(statements: &[Statement], reads: &mut HashSet<String>) {
+    for statement in statements {
+        for_each_expression(statement, &mut |expr| collect_reads(expr, reads));
+        if let Statement::ParFor(par_for) = statement {
+            reads.extend(par_for.reductions.iter().map(|reduction| reduction.name.clone()));
+        }
+        for_each_nested_block(statement, &mut |block| collect_statement_reads(block, reads));
+    }
+}
+
+fn statement_ends_flow(statement: &Statement) -> bool {
+    matches!(statement, Statement::Return(_) | Statement::Break | Statement::Continue)
+}
+
+// ---- Constant propagation ----
+
+fn propagate_constants(program: &mut AnalyzedProgram) -> PassStats {
+    let mut stats = PassStats::new("constant propagation", &["uses replaced", "expressions folded"]);
+    for func in functions_mut(program) {
+        let mut env = HashMap::new();
+        propagate_in_block(&mut func.body.statements, &mut env, &mut stats);
+    }
+    stats
+}
+
+fn propagate_in_block(statements: &mut [Statement], env: &mut HashMap<String, ChifValue>, stats: &mut PassStats) {
+    for statement in statements {
+        let killed = match statement {
+            Statement::For(_) | Statement::While(_) | Statement::ParFor(_) => {
+                // Runs repeatedly: nothing the loop writes is constant in it
+                let killed = written_names(statement);
+                env.retain(|name, _| !killed.contains(name));
+                Some(killed)
+            }
+            _ => None,
+        };
+
+        for_each_expression_mut(statement, &mut |expr| propagate_in_expression(expr, env, stats));
+
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                env.remove(&var_decl.name);
+                if let (false, Some(Expression::Literal(value))) = (var_decl.is_mutable, &var_decl.value) {
+                    if let Some(value) = coerce_literal(value, &var_decl.var_type) {
+                        env.insert(var_decl.name.clone(), value);
+                    }
+                }
+            }
+            Statement::Assignment(assignment) => {
+                if let Expression::Identifier(name) = &assignment.target {
+                    env.remove(name);
+                }
+            }
+            Statement::If(_) | Statement::Switch(_) | Statement::For(_) | Statement::While(_) | Statement::ParFor(_) => {
+                // Branches and loop bodies see the bindings made before
+                // them; what they write is unknown afterwards
+                let killed = killed.unwrap_or_else(|| written_names(statement));
+                for_each_block_mut(statement, &mut |block| {
+                    let mut inner = env.clone();
+                    propagate_in_block(block, &mut inner, stats);
+                });
+                env.retain(|name, _| !killed.contains(name));
+            }
+            _ => {}
+        }
+    }
+}
+
+fn propagate_in_expression(expr: &mut Expression, env: &HashMap<String, ChifValue>, stats: &mut PassStats) {
+    match expr {
+        // &x needs the variable itself
+        Expression::Reference(_) => return,
+        Expression::Identifier(name) => {
+            if let Some(value) = env.get(name.as_str()) {
+                *expr = Expression::Literal(value.clone());
+                stats.add("uses replaced", 1);
+            }
+            return;
+        }
+        _ => {}
+    }
+
+    for_each_child_mut(expr, &mut |child| propagate_in_expression(child, env, stats));
+
+    let folded = match expr {
+        Expression::Binary(binary_op) => match (&*binary_op.left, &*binary_op.right) {
+            (Expression::Literal(left), Expression::Literal(right)) => fold_binary(left, &binary_op.operator, right),
+            _ => None,
+        },
+        Expression::Unary(unary_op) => match &*unary_op.operand {
+            Expression::Literal(operand) => fold_unary(&unary_op.operator, operand),
+            _ => None,
+        },
+        _ => None,
+    };
+    if let Some(value) = folded.filter(literal_is_movable) {
+        *expr = Expression::Literal(value);
+        stats.add("expressions folded", 1);
+    }
+}
+
+// The literal a `let` of declared_type holds, if it can stand in for the
+// variable without changing the type code is generated for
+fn coerce_literal(value: &ChifValue, declared_type: &ChifType) -> Option<ChifValue> {
+    if !literal_is_movable(value) {
+        return None;
+    }
+    match (value, declared_type) {
+        (ChifValue::Int(i), ChifType::Float) => Some(ChifValue::Float(*i as f64)),
+        (ChifValue::Int(_), ChifType::Int)
+        | (ChifValue::Float(_), ChifType::Float)
+        | (ChifValue::Bool(_), ChifType::Bool)
+        | (ChifValue::Str(_), ChifType::Str) => Some(value.clone()),
+        _ => None,
+    }
+}
+
+// ---- Inlining ----
+
+// A function whose whole body is `ret expr`
+struct InlineCandidate {
+    params: Vec<Parameter>,
+    expr: Expression,
+    // Times each parameter occurs in expr
+    uses: HashMap<String, usize>,
+}
+
+// What the pass knows about the program's types
+struct TypeInfo {
+    returns: HashMap<String, ChifType>,
+    fields: HashMap<String, HashMap<String, ChifType>>,
+}
+
+impl TypeInfo {
+    // Static type of a side-effect free expression, as the code generator
+    // will see it; None when unsure
+    fn type_of(&self, expr: &Expression, vars: &HashMap<String, ChifType>) -> Option<ChifType> {
+        match expr {
+            Expression::Literal(value) => match value {
+                ChifValue::Int(_) => Some(ChifType::Int),
+                ChifValue::Float(_) => Some(ChifType::Float),
+                ChifValue::Bool(_) => Some(ChifType::Bool),
+                ChifValue::Str(_) => Some(ChifType::Str),
+                _ => None,
+            },
+            Expression::Identifier(name) => vars.get(name).cloned(),
+            Expression::Binary(binary_op) => match binary_op.operator {
+                BinaryOperator::Equal | BinaryOperator::NotEqual | BinaryOperator::Less | BinaryOperator::Greater
+                | BinaryOperator::LessEqual | BinaryOperator::GreaterEqual | BinaryOperator::And | BinaryOperator::Or => Some(ChifType::Bool),
+                _ => match (self.type_of(&binary_op.left, vars)?, self.type_of(&binary_op.right, vars)?) {
+                    (ChifType::Int, ChifType::Int) => Some(ChifType::Int),
+                    (ChifType::Float | ChifType::Int, ChifType::Float | ChifType::Int) => Some(ChifType::Float),
+                    (ChifType::Str, ChifType::Str) if binary_op.operator == BinaryOperator::Add => Some(ChifType::Str),
+                    _ => None,
+                },
+            },
+            Expression::Unary(unary_op) => match unary_op.operator {
+                UnaryOperator::Not => Some(ChifType::Bool),
+                UnaryOperator::Minus => self.type_of(&unary_op.operand, vars),
+            },
+            Expression::Call(func_call) => match func_call.name.as_str() {
+                "toInt" | "randi" => Some(ChifType::Int),
+                "toFloat" | "randf" => Some(ChifType::Float),
+                "toStr" | "rands" => Some(ChifType::Str),
+                name => self.returns.get(name).cloned(),
+            },
+            Expression::FieldAccess(field_access) => match self.type_of(&field_access.object, vars)? {
+                ChifType::Struct(struct_name) => self.fields.get(&struct_name)?.get(&field_access.field).cloned(),
+                _ => None,
+            },
+            _ => None,
+        }
+    }
+}
+
+fn inline_calls(program: &mut AnalyzedProgram, size_limit: usize) -> PassStats {
+    let mut stats = PassStats::new("inlining", &["calls inlined"]);
+
+    let mut info = TypeInfo { returns: HashMap::new(), fields: HashMap::new() };
+    let mut sources: Vec<(String, Function)> = Vec::new();
+    for item in &program.items {
+        match item {
+            Item::Function(func) if !func.is_main => sources.push((func.name.clone(), func.clone())),
+            Item::StructImpl(impl_block) => {
+                for method in &impl_block.methods {
+                    sources.push((format!("{}_{}", impl_block.struct_name, method.name), method.clone()));
+                }
+            }
+            Item::Struct(struct_def) => {
+                let fields = struct_def.fields.iter().map(|field| (field.name.clone(), field.field_type.clone())).collect();
+                info.fields.insert(struct_def.name.clone(), fields);
+            }
+            _ => {}
+        }
+    }
+    for (name, func) in &sources {
+        if let Some(return_type) = &func.return_type {
+            info.returns.insert(name.clone(), return_type.clone());
+        }
+    }
+
+    let mut candidates = HashMap::new();
+    for (name, func) in sources {
+        if let Some(candidate) = inline_candidate(&name, func, size_limit, &info) {
+            candidates.insert(name, candidate);
+        }
+    }
+    if candidates.is_empty() {
+        return stats;
+    }
+
+    for func in functions_mut(program) {
+        let vars = declared_types(func);
+        let mut inliner = Inliner { candidates: &candidates, info: &info, vars: &vars, inlined: 0 };
+        inliner.inline_in_block(&mut func.body.statements);
+        stats.add("calls inlined", inliner.inlined);
+    }
+    stats
+}
+
+fn inline_candidate(name: &str, func: Function, size_limit: usize, info: &TypeInfo) -> Option<InlineCandidate> {
+    let return_type = func.return_type.clone()?;
+    if !matches!(return_type, ChifType::Int | ChifType::Float | ChifType::Bool | ChifType::Str) {
+        return None;
+    }
+    let expr = match func.body.statements.as_slice() {
+        [Statement::Return(Some(expr))] => expr.clone(),
+        _ => return None,
+    };
+    if expression_size(&expr) > size_limit || func.params.iter().any(|param| param.is_reference) {
+        return None;
+    }
+
+    // Everything the expression reads must be a parameter, and the call
+    // must not lead back to the function
+    let mut reads = HashSet::new();
+    collect_reads(&expr, &mut reads);
+    if reads.iter().any(|read| !func.params.iter().any(|param| &param.name == read)) {
+        return None;
+    }
+    let short_name = name.rsplit('_').next().unwrap_or(name);
+    let mut recursive = false;
+    visit_calls(&expr, &mut |callee| recursive |= callee == name || callee == short_name);
+    if recursive {
+        return None;
+    }
+
+    // No implicit conversion may happen at the return
+    let vars: HashMap<String, ChifType> = func.params.iter().map(|param| (param.name.clone(), param.param_type.clone())).collect();
+    if info.type_of(&expr, &vars) != Some(return_type) {
+        return None;
+    }
+
+    let mut uses = HashMap::new();
+    count_uses(&expr, &mut uses);
+    Some(InlineCandidate { params: func.params, expr, uses })
+}
+
+fn visit_calls(expr: &Expression, f: &mut dyn FnMut(&str)) {
+    match expr {
+        Expression::Call(func_call) => f(&func_call.name),
+        Expression::MethodCall(method_call) => f(&method_call.method),
+        _ => {}
+    }
+    for_each_child(expr, &mut |child| visit_calls(child, f));
+}
+
+fn count_uses(expr: &Expression, uses: &mut HashMap<String, usize>) {
+    match expr {
+        Expression::Identifier(name) => *uses.entry(name.clone()).or_insert(0) += 1,
+        _ => for_each_child(expr, &mut |child| count_uses(child, uses)),
+    }
+}
+
+// Declared types of a function's parameters and variables. A name declared
+// with different types is left out.
+fn declared_types(func: &Function) -> HashMap<String, ChifType> {
+    fn collect(statements: &[Statement], types: &mut HashMap<String, Option<ChifType>>) {
+        for statement in statements {
+            let mut declare = |name: &str, var_type: &ChifType| {
+                let entry = types.entry(name.to_string()).or_insert_with(|| Some(var_type.clone()));
+                if entry.as_ref() != Some(var_type) {
+                    *entry = None;
+                }
+            };
+            match statement {
+                Statement::VarDecl(var_decl) => declare(&var_decl.name, &var_decl.var_type),
+                Statement::For(for_stmt) => {
+                    if let Some(init) = &for_stmt.init {
+                        collect(std::slice::from_ref(&**init), types);
+                    }
+                }
+                Statement::ParFor(par_for) => declare(&par_for.var, &ChifType::Int),
+                _ => {}
+            }
+            for_each_nested_block(statement, &mut |block| collect(block, types));
+        }
+    }
+
+    let mut types = HashMap::new();
+    for param in &func.params {
+        types.insert(param.name.clone(), Some(param.param_type.clone()));
+    }
+    collect(&func.body.statements, &mut types);
+    types.into_iter().filter_map(|(name, var_type)| Some((name, var_type?))).collect()
+}
+
+struct Inliner<'a> {
+    candidates: &'a HashMap<String, InlineCandidate>,
+    info: &'a TypeInfo,
+    vars: &'a HashMap<String, ChifType>,
+    inlined: usize,
+}
+
+impl Inliner<'_> {
+    fn inline_in_block(&mut self, statements: &mut [Statement]) {
+        for statement in statements {
+            for_each_expression_mut(statement, &mut |expr| self.inline_in_expression(expr, INLINE_DEPTH));
+            for_each_block_mut(statement, &mut |block| self.inline_in_block(block));
+        }
+    }
+
+    fn inline_in_expression(&mut self, expr: &mut Expression, depth: usize) {
+        if depth == 0 {
+            return;
+        }
+        for_each_child_mut(expr, &mut |child| self.inline_in_expression(child, depth));
+
+        let (name, receiver, args) = match &*expr {
+            Expression::Call(func_call) => (func_call.name.clone(), None, &func_call.args),
+            Expression::MethodCall(method_call) => match &*method_call.object {
+                Expression::Identifier(object) => match self.vars.get(object) {
+                    Some(ChifType::Struct(struct_name)) => {
+                        (format!("{}_{}", struct_name, method_call.method), Some(&*method_call.object), &method_call.args)
+                    }
+                    _ => return,
+                },
+                _ => return,
+            },
+            _ => return,
+        };
+        let candidate = match self.candidates.get(&name) {
+            Some(candidate) => candidate,
+            None => return,
+        };
+
+        let mut bound: Vec<&Expression> = Vec::with_capacity(candidate.params.len());
+        bound.extend(receiver);
+        bound.extend(args.iter());
+        if bound.len() != candidate.params.len() {
+            return;
+        }
+        let mut substitution = HashMap::new();
+        for (param, arg) in candidate.params.iter().zip(bound) {
+            match self.bind_argument(param, arg, candidate.uses.get(&param.name).copied().unwrap_or(0)) {
+                Some(value) => substitution.insert(param.name.clone(), value),
+                None => return,
+            };
+        }
+
+        let mut body = candidate.expr.clone();
+        substitute(&mut body, &substitution);
+        *expr = body;
+        self.inlined += 1;
+        // The body may call further candidates
+        self.inline_in_expression(expr, depth - 1);
+    }
+
+    // The expression that replaces param in the body, if arg can be moved
+    // there: it must be free of side effects, of the parameter's type, and
+    // cheap to repeat if the parameter is used more than once
+    fn bind_argument(&self, param: &Parameter, arg: &Expression, uses: usize) -> Option<Expression> {
+        if !is_pure(arg) || (uses > 1 && !matches!(arg, Expression::Literal(_) | Expression::Identifier(_))) {
+            return None;
+        }
+        if param.name == "self" {
+            return Some(arg.clone());
+        }
+        match (self.info.type_of(arg, self.vars)?, &param.param_type) {
+            (ChifType::Int, ChifType::Float) => match arg {
+                Expression::Literal(ChifValue::Int(i)) => Some(Expression::Literal(ChifValue::Float(*i as f64))),
+                _ => None,
+            },
+            (arg_type, param_type) if arg_type == *param_type => Some(arg.clone()),
+            _ => None,
+        }
+    }
+}
+
+fn substitute(expr: &mut Expression, substitution: &HashMap<String, Expression>) {
+    if let Expression::Identifier(name) = expr {
+        if let Some(value) = substitution.get(name.as_str()) {
+            *expr = value.clone();
+        }
+        return;
+    }
+    for_each_child_mut(expr, &mut |child| substitute(child, substitution));
+}
+
+// ---- Dead code elimination ----
+
+fn eliminate_dead_code(program: &mut AnalyzedProgram) -> PassStats {
+    let mut stats = PassStats::new("dead code elimination", &["statements removed", "functions removed"]);
+    for func in functions_mut(program) {
+        let removed = simplify_block(&mut func.body.statements);
+        stats.add("statements removed", removed);
+
+        // Removing one unread variable can leave others unread
+        loop {
+            let mut reads = HashSet::new();
+            collect_statement_reads(&func.body.statements, &mut reads);
+            let removed = remove_unread(&mut func.body.statements, &reads);
+            if removed == 0 {
+                break;
+            }
+            stats.add("statements removed", removed);
+        }
+    }
+    stats.add("functions removed", remove_unused_functions(program));
+    stats
+}
+
+// Folds constant branches and drops unreachable statements; returns how
+// many statements went away
+fn simplify_block(statements: &mut Vec<Statement>) -> usize {
+    let mut removed = 0;
+    let mut result = Vec::with_capacity(statements.len());
+    for mut statement in statements.drain(..) {
+        for_each_block_mut(&mut statement, &mut |block| removed += simplify_block(block));
+
+        // Blocks share the function's namespace, so a taken branch can
+        // be spliced into the enclosing block
+        let replacement = match &mut statement {
+            Statement::If(if_stmt) => match if_stmt.condition {
+                Expression::Literal(ChifValue::Bool(true)) => Some(std::mem::take(&mut if_stmt.then_block.statements)),
+                Expression::Literal(ChifValue::Bool(false)) => {
+                    Some(if_stmt.else_block.take().map(|block| block.statements).unwrap_or_default())
+                }
+                _ => None,
+            },
+            Statement::While(while_stmt) if matches!(while_stmt.condition, Expression::Literal(ChifValue::Bool(false))) => Some(Vec::new()),
+            Statement::For(for_stmt) if matches!(for_stmt.condition, Some(Expression::Literal(ChifValue::Bool(false)))) => {
+                Some(for_stmt.init.take().map(|init| vec![*init]).unwrap_or_default())
+            }
+            _ => None,
+        };
+        let ends_flow = match replacement {
+            Some(statements) => {
+                removed += 1;
+                let ends_flow = statements.last().map_or(false, statement_ends_flow);
+                result.extend(statements);
+                ends_flow
+            }
+            None => {
+                let ends_flow = statement_ends_flow(&statement);
+                result.push(statement);
+                ends_flow
+            }
+        };
+        if ends_flow {
+            break;
+        }
+    }
+    removed += statements.len();
+    *statements = result;
+    removed
+}
+
+// Drops declarations of and assignments to variables nothing reads, when
+// their values have no side effects
+fn remove_unread(statements: &mut Vec<Statement>, reads: &HashSet<String>) -> usize {
+    let before = statements.len();
+    statements.retain(|statement| match statement {
+        Statement::VarDecl(var_decl) => {
+            reads.contains(&var_decl.name) || !var_decl.value.as_ref().map_or(true, is_pure)
+        }
+        Statement::Assignment(assignment) => match &assignment.target {
+            Expression::Identifier(name) => reads.contains(name) || !is_pure(&assignment.value),
+            _ => true,
+        },
+        _ => true,
+    });
+    let mut removed = before - statements.len();
+    for statement in statements.iter_mut() {
+        for_each_block_mut(statement, &mut |block| removed += remove_unread(block, reads));
+    }
+    removed
+}
+
+// Removes free functions that main can't reach. Struct methods stay, as
+// the code generator resolves them by name at call sites.
+fn remove_unused_functions(program: &mut AnalyzedProgram) -> usize {
+    let mut bodies: HashMap<String, &Function> = HashMap::new();
+    for item in &program.items {
+        match item {
+            Item::Function(func) => {
+                bodies.insert(func.name.clone(), func);
+            }
+            _ => {}
+        }
+    }
+    if !bodies.values().any(|func| func.is_main) {
+        return 0;
+    }
+
+    // Anything named in a live body is live: calls, and functions passed by
+    // name (http.stream handlers)
+    let mut live = HashSet::new();
+    let mut pending: Vec<&Function> = bodies.values().filter(|func| func.is_main).copied().collect();
+    pending.extend(program.items.iter().flat_map(|item| match item {
+        Item::StructImpl(impl_block) => impl_block.methods.iter().collect::<Vec<_>>(),
+        _ => Vec::new(),
+    }));
+    while let Some(func) = pending.pop() {
+        let mut names = HashSet::new();
+        collect_statement_reads(&func.body.statements, &mut names);
+        collect_called(&func.body.statements, &mut names);
+        for name in names {
+            if let Some(&callee) = bodies.get(&name) {
+                if live.insert(name) {
+                    pending.push(callee);
+                }
+            }
+        }
+    }
+
+    let before = program.items.len();
+    program.items.retain(|item| match item {
+        Item::Function(func) => func.is_main || live.contains(&func.name),
+        _ => true,
+    });
+    before - program.items.len()
+}
+
+fn collect_called(statements: &[Statement], names: &mut HashSet<String>) {
+    for statement in statements {
+        for_each_expression(statement, &mut |expr| visit_calls(expr, &mut |name| {
+            names.insert(name.to_string());
+        }));
+        for_each_nested_block(statement, &mut |block| collect_called(block, names));
+    }
+}
+
+// ---- Loop-invariant code motion ----
+
+fn hoist_loop_invariants(program: &mut AnalyzedProgram) -> PassStats {
+    let mut stats = PassStats::new("loop-invariant code motion", &["declarations hoisted"]);
+    for func in functions_mut(program) {
+        let mut declarations = HashMap::new();
+        count_declarations(&func.body.statements, &mut declarations);
+        for param in &func.params {
+            *declarations.entry(param.name.clone()).or_insert(0) += 1;
+        }
+        stats.add("declarations hoisted", hoist_in_block(&mut func.body.statements, &declarations));
+    }
+    stats
+}
+
+fn count_declarations(statements: &[Statement], counts: &mut HashMap<String, usize>) {
+    for statement in statements {
+        match statement {
+            Statement::VarDecl(var_decl) => *counts.entry(var_decl.name.clone()).or_insert(0) += 1,
+            Statement::For(for_stmt) => {
+                if let Some(init) = &for_stmt.init {
+                    count_declarations(std::slice::from_ref(&**init), counts);
+                }
+            }
+            Statement::ParFor(par_for) => *counts.entry(par_for.var.clone()).or_insert(0) += 1,
+            _ => {}
+        }
+        for_each_nested_block(statement, &mut |block| count_declarations(block, counts));
+    }
+}
+
+fn hoist_in_block(statements: &mut Vec<Statement>, declarations: &HashMap<String, usize>) -> usize {
+    let mut hoisted_count = 0;
+    let mut result = Vec::with_capacity(statements.len());
+    for mut statement in statements.drain(..) {
+        // Inner loops first, so their invariants can move out further
+        for_each_block_mut(&mut statement, &mut |block| hoisted_count += hoist_in_block(block, declarations));
+
+        let hoisted = match &mut statement {
+            Statement::While(_) | Statement::For(_) => {
+                let written = written_names(&statement);
+                let body = match &mut statement {
+                    Statement::While(while_stmt) => &mut while_stmt.body.statements,
+                    Statement::For(for_stmt) => &mut for_stmt.body.statements,
+                    _ => unreachable!(),
+                };
+                hoist_from_loop_body(body, &written, declarations)
+            }
+            // Workers must keep their own copies of par for locals
+            _ => Vec::new(),
+        };
+        hoisted_count += hoisted.len();
+        result.extend(hoisted);
+        result.push(statement);
+    }
+    *statements = result;
+    hoisted_count
+}
+
+// Takes the declarations at the top level of a loop body that compute the
+// same scalar on every iteration out of it, in order
+fn hoist_from_loop_body(body: &mut Vec<Statement>, written: &HashSet<String>, declarations: &HashMap<String, usize>) -> Vec<Statement> {
+    let mut assigned = HashSet::new();
+    let mut declared = HashSet::new();
+    for statement in body.iter() {
+        collect_writes(statement, &mut declared, &mut assigned);
+    }
+
+    let mut hoisted = Vec::new();
+    let mut moved = HashSet::new();
+    body.retain(|statement| {
+        let var_decl = match statement {
+            Statement::VarDecl(var_decl) => var_decl,
+            _ => return true,
+        };
+        let value = match &var_decl.value {
+            Some(value) => value,
+            None => return true,
+        };
+        if !matches!(var_decl.var_type, ChifType::Int | ChifType::Float | ChifType::Bool | ChifType::Str)
+            || declarations.get(&var_decl.name) != Some(&1)
+            || assigned.contains(&var_decl.name)
+            || !is_pure(value) {
+            return true;
+        }
+        // Reading only values fixed before the loop, or already hoisted
+        let mut reads = HashSet::new();
+        collect_reads(value, &mut reads);
+        if reads.iter().any(|read| written.contains(read) && !moved.contains(read)) {
+            return true;
+        }
+        moved.insert(var_decl.name.clone());
+        hoisted.push(statement.clone());
+        false
+    });
+    hoisted
+}
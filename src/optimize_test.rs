@@ -0,0 +1,231 @@
+#[cfg(test)]
+mod tests {
+    use crate::ast::*;
+    use crate::compiler::OptLevel;
+    use crate::interpreter::Interpreter;
+    use crate::lexer::Lexer;
+    use crate::optimize::optimize;
+    use crate::parser::Parser;
+    use crate::semantic::AnalyzedProgram;
+    use crate::types::ChifValue;
+
+    fn parse(source: &str) -> Program {
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        Parser::new(tokens).parse().expect("source should parse")
+    }
+
+    fn optimized(source: &str) -> Program {
+        let mut program = AnalyzedProgram { items: parse(source).items };
+        optimize(&mut program, &OptLevel::Speed);
+        Program { items: program.items }
+    }
+
+    // What the interpreter prints for the program
+    fn output(program: &Program) -> String {
+        let mut interpreter = Interpreter::new();
+        interpreter.capture_output();
+        interpreter.execute(program).expect("program should run");
+        interpreter.captured_output().to_string()
+    }
+
+    fn body<'a>(program: &'a Program, name: &str) -> &'a [Statement] {
+        program.items.iter()
+            .find_map(|item| match item {
+                Item::Function(func) if func.name == name => Some(func.body.statements.as_slice()),
+                _ => None,
+            })
+            .unwrap_or_else(|| panic!("function {} should be kept", name))
+    }
+
+    // Initializer of the variable declared as name directly in statements
+    fn initializer<'a>(statements: &'a [Statement], name: &str) -> Option<&'a Expression> {
+        statements.iter().find_map(|statement| match statement {
+            Statement::VarDecl(var_decl) if var_decl.name == name => var_decl.value.as_ref(),
+            _ => None,
+        })
+    }
+
+    #[test]
+    fn test_folds_literal_operators() {
+        let source = r#"
+            fn scaled() int {
+                let base: int = 2 + 3 * 4;
+                ret base * 2;
+            }
+
+            fn check() bool {
+                ret !(1 < 2) || 3.0 * 2.0 > 5.0;
+            }
+
+            chif main() {
+                var value: int = scaled();
+                var flag: bool = check();
+                con.out("{value} {flag}");
+            }
+        "#;
+        let program = optimized(source);
+
+        // base is substituted and its declaration is no longer read
+        assert!(
+            matches!(body(&program, "scaled"), [Statement::Return(Some(Expression::Literal(ChifValue::Int(28))))]),
+            "scaled should fold to ret 28, got {:?}", body(&program, "scaled")
+        );
+        // check folds to a literal and is inlined into main
+        assert!(
+            matches!(initializer(body(&program, "main"), "flag"), Some(Expression::Literal(ChifValue::Bool(true)))),
+            "check() should fold to true"
+        );
+        assert_eq!(output(&program), output(&parse(source)));
+    }
+
+    #[test]
+    fn test_division_by_zero_is_left_to_run_time() {
+        let source = r#"
+            fn quotient() int {
+                ret 7 / 0;
+            }
+
+            fn remainder() int {
+                ret 7 % 0;
+            }
+
+            fn unread() int {
+                var unused: int = 1 / 0;
+                ret 1;
+            }
+
+            chif main() {
+                var a: int = quotient();
+                var b: int = remainder();
+                var c: int = unread();
+            }
+        "#;
+        let program = optimized(source);
+        let main = body(&program, "main");
+
+        // Both functions are inlined, but the operators must not fold
+        for name in ["a", "b"] {
+            assert!(
+                matches!(initializer(main, name), Some(Expression::Binary(_))),
+                "{} should keep its operator for run time, got {:?}", name, initializer(main, name)
+            );
+        }
+        // The division may trap, so the unread declaration stays
+        assert!(initializer(body(&program, "unread"), "unused").is_some(), "1 / 0 should not be removed as dead code");
+    }
+
+    #[test]
+    fn test_float_equality_is_left_to_run_time() {
+        let source = r#"
+            fn close() bool {
+                ret 0.1 + 0.2 == 0.3;
+            }
+
+            fn apart() bool {
+                ret 1.0 != 1.0000000000000002;
+            }
+
+            chif main() {
+                var a: bool = close();
+                var b: bool = apart();
+                con.out("{a} {b}");
+            }
+        "#;
+        let program = optimized(source);
+        let main = body(&program, "main");
+
+        // The operands fold, the comparison doesn't
+        for name in ["a", "b"] {
+            assert!(
+                matches!(initializer(main, name), Some(Expression::Binary(_))),
+                "{} should keep its comparison for run time, got {:?}", name, initializer(main, name)
+            );
+        }
+        assert_eq!(output(&program), output(&parse(source)));
+    }
+
+    #[test]
+    fn test_dead_code_elimination_keeps_side_effects() {
+        let source = r#"
+            fn noisy(n: int) int {
+                con.out("noisy {n}");
+                ret n;
+            }
+
+            chif main() {
+                var unused: int = noisy(1);
+                var dead: int = 2 + 3;
+                unused = noisy(2);
+                if (false) {
+                    con.out("never");
+                }
+                if (true) {
+                    con.out("always");
+                }
+                while (false) {
+                    con.out("never");
+                }
+                con.out("done");
+                ret 0;
+                con.out("unreachable");
+            }
+        "#;
+        let program = optimized(source);
+        let main = body(&program, "main");
+
+        assert!(initializer(main, "unused").is_some(), "A call with output must survive even if its result is unread");
+        assert!(initializer(main, "dead").is_none(), "An unread pure declaration should be removed");
+        assert!(matches!(main.last(), Some(Statement::Return(_))), "Statements after ret should be removed");
+        assert_eq!(output(&program), "noisy 1\nnoisy 2\nalways\ndone\n");
+        assert_eq!(output(&program), output(&parse(source)));
+    }
+
+    #[test]
+    fn test_inlining_keeps_references_and_early_returns() {
+        let source = r#"
+            fn set(ref x: int) int {
+                x = 42;
+                ret 1;
+            }
+
+            fn double(x: int) int {
+                ret x * 2;
+            }
+
+            fn clamp(x: int) int {
+                if (x > 10) {
+                    ret 10;
+                }
+                ret x;
+            }
+
+            chif main() {
+                var n: int = 5;
+                var before: int = double(n);
+                var flag: int = set(&n);
+                var after: int = double(n);
+                var high: int = clamp(n);
+                var low: int = clamp(3);
+                con.out("{before} {flag} {n} {after} {high} {low}");
+            }
+        "#;
+        let program = optimized(source);
+        let main = body(&program, "main");
+
+        // double is a single `ret expr`; set writes through a reference and
+        // clamp returns early, so both stay calls
+        assert!(matches!(initializer(main, "before"), Some(Expression::Binary(_))), "double(n) should be inlined");
+        assert!(matches!(initializer(main, "after"), Some(Expression::Binary(_))), "double(n) should be inlined");
+        assert!(
+            matches!(initializer(main, "flag"), Some(Expression::Call(call)) if call.name == "set"),
+            "A call passing &n must not be inlined"
+        );
+        assert!(
+            matches!(initializer(main, "high"), Some(Expression::Call(call)) if call.name == "clamp"),
+            "A function with an early return must not be inlined"
+        );
+        // The inlined double(n) after set(&n) must read the updated n
+        assert_eq!(output(&program), "10 1 42 84 10 3\n");
+        assert_eq!(output(&program), output(&parse(source)));
+    }
+}
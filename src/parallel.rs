@@ -0,0 +1,623 @@
+use crate::ast::*;
+use crate::types::{ChifValue, StructLayout};
+use std::collections::{HashMap, HashSet};
+use std::rc::Rc;
+use std::sync::Arc;
+
+// Shared pieces of `par for`: the check that the body can run in parallel
+// (semantic analysis and the interpreter both run it, `rono run` skips the
+// analyzer), the scheduling parameters the C runtime mirrors, and the
+// copies that let interpreter workers run on their own threads.
+
+// Chunks handed out per worker: small enough that workers finishing early
+// pick up the remaining work, large enough that claiming stays cheap.
+// Kept in sync with RONO_PAR_CHUNKS_PER_WORKER in runtime.c.
+pub const CHUNKS_PER_WORKER: u64 = 8;
+
+// Threads running a `par for`: RONO_THREADS, else one per available core
+pub fn thread_count() -> usize {
+    std::env::var("RONO_THREADS")
+        .ok()
+        .and_then(|value| value.parse::<usize>().ok())
+        .filter(|&threads| threads > 0)
+        .unwrap_or_else(|| std::thread::available_parallelism().map_or(1, |threads| threads.get()))
+}
+
+// Iterations per claim when count iterations are shared by workers
+pub fn chunk_size(count: u64, workers: usize) -> u64 {
+    (count / (workers as u64 * CHUNKS_PER_WORKER)).max(1)
+}
+
+// Ok when the body only writes variables it declares itself and the
+// loop's reduction targets; otherwise why it can't run in parallel.
+// Variables the body declares, and counters of loops nested in it, are
+// private to each iteration; everything else is shared and read-only.
+pub fn check_par_for(par_for: &ParForStatement) -> Result<(), String> {
+    let mut private = HashSet::new();
+    private.insert(par_for.var.clone());
+    collect_private(&par_for.body, &mut private);
+
+    let mut reductions = HashSet::new();
+    for reduction in &par_for.reductions {
+        if reduction.name == par_for.var {
+            return Err(format!("par for loop variable '{}' can't be a reduction", par_for.var));
+        }
+        if !reductions.insert(reduction.name.as_str()) {
+            return Err(format!("'{}' is reduced more than once in par for", reduction.name));
+        }
+        if private.contains(&reduction.name) {
+            return Err(format!("Reduction variable '{}' must be declared before the par for", reduction.name));
+        }
+    }
+
+    let checker = Checker { var: &par_for.var, private: &private, reductions: &reductions, loop_depth: 0 };
+    checker.block(&par_for.body)
+}
+
+fn collect_private(block: &Block, private: &mut HashSet<String>) {
+    for statement in &block.statements {
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                private.insert(var_decl.name.clone());
+            }
+            Statement::If(if_stmt) => {
+                collect_private(&if_stmt.then_block, private);
+                if let Some(else_block) = &if_stmt.else_block {
+                    collect_private(else_block, private);
+                }
+            }
+            Statement::For(for_stmt) => {
+                match for_stmt.init.as_deref() {
+                    Some(Statement::VarDecl(var_decl)) => {
+                        private.insert(var_decl.name.clone());
+                    }
+                    Some(Statement::Assignment(assignment)) => {
+                        if let Some(name) = variable_name(&assignment.target) {
+                            private.insert(name.to_string());
+                        }
+                    }
+                    _ => {}
+                }
+                collect_private(&for_stmt.body, private);
+            }
+            Statement::While(while_stmt) => collect_private(&while_stmt.body, private),
+            Statement::Switch(switch_stmt) => {
+                for case in &switch_stmt.cases {
+                    collect_private(&case.body, private);
+                }
+                if let Some(default_case) = &switch_stmt.default_case {
+                    collect_private(default_case, private);
+                }
+            }
+            Statement::ParFor(par_for) => {
+                private.insert(par_for.var.clone());
+                collect_private(&par_for.body, private);
+            }
+            Statement::Assignment(_) | Statement::Expression(_) | Statement::Return(_) |
+            Statement::Break | Statement::Continue => {}
+        }
+    }
+}
+
+fn variable_name(expr: &Expression) -> Option<&str> {
+    match expr {
+        Expression::Identifier(name) => Some(name),
+        Expression::Local(local) => Some(&local.name),
+        _ => None,
+    }
+}
+
+// Variable an index or field assignment ends up writing to
+fn root_variable(expr: &Expression) -> Option<&str> {
+    match expr {
+        Expression::Index(index_access) => root_variable(&index_access.object),
+        Expression::FieldAccess(field_access) => root_variable(&field_access.object),
+        _ => variable_name(expr),
+    }
+}
+
+struct Checker<'a> {
+    var: &'a str,
+    private: &'a HashSet<String>,
+    reductions: &'a HashSet<&'a str>,
+    loop_depth: usize,
+}
+
+impl Checker<'_> {
+    fn nested(&self) -> Checker<'_> {
+        Checker { loop_depth: self.loop_depth + 1, ..*self }
+    }
+
+    fn block(&self, block: &Block) -> Result<(), String> {
+        for statement in &block.statements {
+            self.statement(statement)?;
+        }
+        Ok(())
+    }
+
+    fn statement(&self, statement: &Statement) -> Result<(), String> {
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                if var_decl.name == self.var {
+                    return Err(format!("par for body can't redeclare loop variable '{}'", self.var));
+                }
+                if let Some(value) = &var_decl.value {
+                    self.expression(value)?;
+                }
+            }
+            Statement::Assignment(assignment) => {
+                self.assignment_target(&assignment.target)?;
+                self.expression(&assignment.value)?;
+            }
+            Statement::Expression(expr) => self.expression(expr)?,
+            Statement::If(if_stmt) => {
+                self.expression(&if_stmt.condition)?;
+                self.block(&if_stmt.then_block)?;
+                if let Some(else_block) = &if_stmt.else_block {
+                    self.block(else_block)?;
+                }
+            }
+            Statement::For(for_stmt) => {
+                let nested = self.nested();
+                for clause in [&for_stmt.init, &for_stmt.update].into_iter().flatten() {
+                    nested.statement(clause)?;
+                }
+                if let Some(condition) = &for_stmt.condition {
+                    nested.expression(condition)?;
+                }
+                nested.block(&for_stmt.body)?;
+            }
+            Statement::While(while_stmt) => {
+                self.expression(&while_stmt.condition)?;
+                self.nested().block(&while_stmt.body)?;
+            }
+            Statement::Switch(switch_stmt) => {
+                self.expression(&switch_stmt.expr)?;
+                for case in &switch_stmt.cases {
+                    self.expression(&case.value)?;
+                    self.block(&case.body)?;
+                }
+                if let Some(default_case) = &switch_stmt.default_case {
+                    self.block(default_case)?;
+                }
+            }
+            // A nested par for writes its reduction targets
+            Statement::ParFor(par_for) => {
+                for reduction in &par_for.reductions {
+                    self.write(&reduction.name)?;
+                }
+                self.expression(&par_for.start)?;
+                self.expression(&par_for.end)?;
+                self.nested().block(&par_for.body)?;
+            }
+            Statement::Return(_) => return Err("ret is not allowed in a par for body".to_string()),
+            Statement::Break if self.loop_depth == 0 => {
+                return Err("break is not allowed in a par for body".to_string());
+            }
+            Statement::Break | Statement::Continue => {}
+        }
+        Ok(())
+    }
+
+    fn write(&self, name: &str) -> Result<(), String> {
+        if name == self.var {
+            Err(format!("par for body can't assign to loop variable '{}'", name))
+        } else if self.private.contains(name) || self.reductions.contains(name) {
+            Ok(())
+        } else {
+            Err(format!(
+                "par for body writes to shared variable '{}'; declare it in the body or make it a reduction",
+                name
+            ))
+        }
+    }
+
+    fn assignment_target(&self, target: &Expression) -> Result<(), String> {
+        if let Some(name) = variable_name(target) {
+            return self.write(name);
+        }
+        match root_variable(target) {
+            // Elements and fields of reduction targets are shared like any other variable
+            Some(name) if self.private.contains(name) && name != self.var => {}
+            Some(name) => {
+                return Err(format!("par for body writes into shared variable '{}'", name));
+            }
+            None => return Err("par for body can't assign through a pointer".to_string()),
+        }
+        if let Expression::Index(index_access) = target {
+            for index in &index_access.indices {
+                self.expression(index)?;
+            }
+        }
+        Ok(())
+    }
+
+    fn expression(&self, expr: &Expression) -> Result<(), String> {
+        match expr {
+            Expression::Literal(_) | Expression::Identifier(_) | Expression::Local(_) => {}
+            Expression::Binary(binary_op) => {
+                self.expression(&binary_op.left)?;
+                self.expression(&binary_op.right)?;
+            }
+            Expression::Unary(unary_op) => self.expression(&unary_op.operand)?,
+            Expression::Call(call) => {
+                // randfill writes into the array it is given
+                if call.name == "randfill" {
+                    if let Some(array) = call.args.first() {
+                        self.assignment_target(array)?;
+                    }
+                }
+                for arg in &call.args {
+                    self.expression(arg)?;
+                }
+            }
+            Expression::MethodCall(method_call) => {
+                if matches!(method_call.method.as_str(), "add" | "addAt" | "del") {
+                    if let Some(name) = variable_name(&method_call.object) {
+                        if !self.private.contains(name) {
+                            return Err(format!("par for body modifies shared list '{}'", name));
+                        }
+                    }
+                }
+                self.expression(&method_call.object)?;
+                for arg in &method_call.args {
+                    self.expression(arg)?;
+                }
+            }
+            Expression::Index(index_access) => {
+                self.expression(&index_access.object)?;
+                for index in &index_access.indices {
+                    self.expression(index)?;
+                }
+            }
+            Expression::FieldAccess(field_access) => self.expression(&field_access.object)?,
+            Expression::ArrayLiteral(elements) => {
+                for element in elements {
+                    self.expression(element)?;
+                }
+            }
+            Expression::MapLiteral(pairs) => {
+                for (key, value) in pairs {
+                    self.expression(key)?;
+                    self.expression(value)?;
+                }
+            }
+            Expression::StructLiteral(struct_literal) => {
+                for (_, value) in &struct_literal.fields {
+                    self.expression(value)?;
+                }
+            }
+            // A function taking `&x` can write to x
+            Expression::Reference(inner) => match variable_name(inner) {
+                Some(name) if self.private.contains(name) && name != self.var => {}
+                Some(name) => return Err(format!("par for body passes shared variable '{}' by reference", name)),
+                None => self.expression(inner)?,
+            },
+            Expression::Dereference(inner) => self.expression(inner)?,
+            Expression::Template(template) => {
+                for part in &template.parts {
+                    if let TemplatePart::Hole { expr, .. } = part {
+                        self.expression(expr)?;
+                    }
+                }
+            }
+        }
+        Ok(())
+    }
+}
+
+// Partial result of a reduction, the form in which interpreter workers
+// hand them back (values themselves can't cross threads)
+#[derive(Debug, Clone, Copy)]
+pub enum Scalar {
+    Int(i64),
+    Float(f64),
+}
+
+impl Scalar {
+    pub fn from_value(value: &ChifValue) -> Option<Self> {
+        match value {
+            ChifValue::Int(value) => Some(Scalar::Int(*value)),
+            ChifValue::Float(value) => Some(Scalar::Float(*value)),
+            _ => None,
+        }
+    }
+
+    pub fn into_value(self) -> ChifValue {
+        match self {
+            Scalar::Int(value) => ChifValue::Int(value),
+            Scalar::Float(value) => ChifValue::Float(value),
+        }
+    }
+
+    // Starting value of a worker's partial result, of the target's type
+    pub fn identity(op: ReductionOp, like: Scalar) -> Self {
+        match (op, like) {
+            (ReductionOp::Sum, Scalar::Int(_)) => Scalar::Int(0),
+            (ReductionOp::Sum, Scalar::Float(_)) => Scalar::Float(0.0),
+            (ReductionOp::Min, Scalar::Int(_)) => Scalar::Int(i64::MAX),
+            (ReductionOp::Min, Scalar::Float(_)) => Scalar::Float(f64::INFINITY),
+            (ReductionOp::Max, Scalar::Int(_)) => Scalar::Int(i64::MIN),
+            (ReductionOp::Max, Scalar::Float(_)) => Scalar::Float(f64::NEG_INFINITY),
+        }
+    }
+
+    // Integer sums wrap like `+` does in compiled code
+    pub fn combine(op: ReductionOp, left: Scalar, right: Scalar) -> Self {
+        match (left, right) {
+            (Scalar::Int(a), Scalar::Int(b)) => Scalar::Int(match op {
+                ReductionOp::Sum => a.wrapping_add(b),
+                ReductionOp::Min => a.min(b),
+                ReductionOp::Max => a.max(b),
+            }),
+            _ => {
+                let (a, b) = (left.as_f64(), right.as_f64());
+                Scalar::Float(match op {
+                    ReductionOp::Sum => a + b,
+                    ReductionOp::Min => a.min(b),
+                    ReductionOp::Max => a.max(b),
+                })
+            }
+        }
+    }
+
+    fn as_f64(self) -> f64 {
+        match self {
+            Scalar::Int(value) => value as f64,
+            Scalar::Float(value) => value,
+        }
+    }
+}
+
+// Values and code are Rc-shared and so tied to the thread that owns them.
+// An interpreter worker gets its own copy of the program in which every Rc
+// is freshly allocated; the copies are built on the parent thread and moved
+// to the worker as a whole inside Detached, and back when it finishes, so
+// the interpreter keeps them for later loops. The variables the body reads
+// are frozen into one Snapshot per execution that all workers share.
+pub(crate) struct Detached<T>(T);
+
+// Safety: Detached::new requires that no Rc reachable from the value is
+// referenced from outside it, so the whole graph moves to the new thread
+// and reference counts are only ever touched there.
+unsafe impl<T> Send for Detached<T> {}
+
+impl<T> Detached<T> {
+    // Safety: `value` must have been built from unshare_* copies that don't
+    // share any Rc with data staying behind
+    pub(crate) unsafe fn new(value: T) -> Self {
+        Detached(value)
+    }
+
+    pub(crate) fn into_inner(self) -> T {
+        self.0
+    }
+}
+
+// A value frozen for the workers of a par for: ChifValue without the Rc, so
+// it can be read from any thread. Workers copy out only what they read.
+#[derive(Debug)]
+pub(crate) enum SharedValue {
+    Int(i64),
+    Float(f64),
+    Str(Box<str>),
+    Bool(bool),
+    Nil,
+    Array(Vec<SharedValue>),
+    List(Vec<SharedValue>),
+    Map(HashMap<String, SharedValue>),
+    Struct(Arc<StructLayout>, Vec<SharedValue>),
+    Pointer(Box<SharedValue>),
+    Reference(String),
+}
+
+// What a missing map key reads as
+static SHARED_NIL: SharedValue = SharedValue::Nil;
+
+impl SharedValue {
+    // layouts maps the value's struct layouts to their frozen copies, so
+    // instances of one struct keep sharing a layout
+    pub(crate) fn freeze(value: &ChifValue, layouts: &mut HashMap<*const StructLayout, Arc<StructLayout>>) -> Self {
+        match value {
+            ChifValue::Int(value) => SharedValue::Int(*value),
+            ChifValue::Float(value) => SharedValue::Float(*value),
+            ChifValue::Str(s) => SharedValue::Str(Box::from(&**s)),
+            ChifValue::Bool(value) => SharedValue::Bool(*value),
+            ChifValue::Nil => SharedValue::Nil,
+            ChifValue::Array(items) => SharedValue::Array(items.iter().map(|item| Self::freeze(item, layouts)).collect()),
+            ChifValue::List(items) => SharedValue::List(items.iter().map(|item| Self::freeze(item, layouts)).collect()),
+            ChifValue::Map(map) => SharedValue::Map(
+                map.iter().map(|(key, value)| (key.clone(), Self::freeze(value, layouts))).collect(),
+            ),
+            ChifValue::Struct(layout, fields) => {
+                let shared = layouts
+                    .entry(Rc::as_ptr(layout))
+                    .or_insert_with(|| Arc::new(StructLayout { name: layout.name.clone(), fields: layout.fields.clone() }))
+                    .clone();
+                SharedValue::Struct(shared, fields.iter().map(|field| Self::freeze(field, layouts)).collect())
+            }
+            ChifValue::Pointer(inner) => SharedValue::Pointer(Box::new(Self::freeze(inner, layouts))),
+            ChifValue::Reference(name) => SharedValue::Reference(name.clone()),
+        }
+    }
+
+    // A copy owned by the calling thread. Structs take the layout of that
+    // name from layouts when it has the same fields.
+    pub(crate) fn thaw(&self, layouts: &HashMap<String, Rc<StructLayout>>) -> ChifValue {
+        match self {
+            SharedValue::Int(value) => ChifValue::Int(*value),
+            SharedValue::Float(value) => ChifValue::Float(*value),
+            SharedValue::Str(s) => ChifValue::Str(Rc::from(&**s)),
+            SharedValue::Bool(value) => ChifValue::Bool(*value),
+            SharedValue::Nil => ChifValue::Nil,
+            SharedValue::Array(items) => ChifValue::Array(Rc::new(items.iter().map(|item| item.thaw(layouts)).collect())),
+            SharedValue::List(items) => ChifValue::List(Rc::new(items.iter().map(|item| item.thaw(layouts)).collect())),
+            SharedValue::Map(map) => ChifValue::Map(Rc::new(
+                map.iter().map(|(key, value)| (key.clone(), value.thaw(layouts))).collect(),
+            )),
+            SharedValue::Struct(layout, fields) => {
+                let layout = match layouts.get(&layout.name) {
+                    Some(known) if known.fields == layout.fields => Rc::clone(known),
+                    _ => StructLayout::new(layout.name.clone(), layout.fields.clone()),
+                };
+                ChifValue::Struct(layout, Rc::new(fields.iter().map(|field| field.thaw(layouts)).collect()))
+            }
+            SharedValue::Pointer(inner) => ChifValue::Pointer(Box::new(inner.thaw(layouts))),
+            SharedValue::Reference(name) => ChifValue::Reference(name.clone()),
+        }
+    }
+
+    // The element Interpreter::get_index would return, without copying the
+    // collection; None where get_index fails
+    pub(crate) fn element(&self, index: &ChifValue) -> Option<&SharedValue> {
+        match (self, index) {
+            (SharedValue::Array(items) | SharedValue::List(items), ChifValue::Int(i)) => items.get(*i as usize),
+            (SharedValue::Map(map), ChifValue::Str(key)) => Some(map.get(&**key).unwrap_or(&SHARED_NIL)),
+            _ => None,
+        }
+    }
+}
+
+// The variables visible in the frame a par for runs in, frozen once per
+// execution of the loop and shared by all of its workers
+pub(crate) struct Snapshot {
+    // Slot names of the frame, which the body's resolved locals index
+    pub(crate) frame_names: Vec<String>,
+    // Assigned slots and the frame's other variables
+    pub(crate) variables: Vec<(String, SharedValue)>,
+    pub(crate) globals: Vec<(String, SharedValue)>,
+}
+
+pub(crate) fn unshare_value(value: &ChifValue) -> ChifValue {
+    match value {
+        ChifValue::Str(s) => ChifValue::Str(Rc::from(&**s)),
+        ChifValue::Array(items) => ChifValue::Array(Rc::new(items.iter().map(unshare_value).collect())),
+        ChifValue::List(items) => ChifValue::List(Rc::new(items.iter().map(unshare_value).collect())),
+        ChifValue::Map(map) => ChifValue::Map(Rc::new(
+            map.iter().map(|(key, value)| (key.clone(), unshare_value(value))).collect(),
+        )),
+        ChifValue::Struct(layout, fields) => ChifValue::Struct(
+            StructLayout::new(layout.name.clone(), layout.fields.clone()),
+            Rc::new(fields.iter().map(unshare_value).collect()),
+        ),
+        ChifValue::Pointer(inner) => ChifValue::Pointer(Box::new(unshare_value(inner))),
+        ChifValue::Int(_) | ChifValue::Float(_) | ChifValue::Bool(_) | ChifValue::Nil | ChifValue::Reference(_) => {
+            value.clone()
+        }
+    }
+}
+
+pub(crate) fn unshare_function(func: &Function) -> Function {
+    let mut func = func.clone();
+    func.locals = Rc::new(func.locals.to_vec());
+    unshare_block(&mut func.body);
+    func
+}
+
+// The AST holds Rc only in literal values; the matches below are
+// exhaustive so that new node types have to be handled here
+pub(crate) fn unshare_block(block: &mut Block) {
+    for statement in &mut block.statements {
+        unshare_statement(statement);
+    }
+}
+
+fn unshare_statement(statement: &mut Statement) {
+    match statement {
+        Statement::VarDecl(var_decl) => {
+            if let Some(value) = &mut var_decl.value {
+                unshare_expression(value);
+            }
+        }
+        Statement::Assignment(assignment) => {
+            unshare_expression(&mut assignment.target);
+            unshare_expression(&mut assignment.value);
+        }
+        Statement::Expression(expr) => unshare_expression(expr),
+        Statement::If(if_stmt) => {
+            unshare_expression(&mut if_stmt.condition);
+            unshare_block(&mut if_stmt.then_block);
+            if let Some(else_block) = &mut if_stmt.else_block {
+                unshare_block(else_block);
+            }
+        }
+        Statement::For(for_stmt) => {
+            for clause in [&mut for_stmt.init, &mut for_stmt.update].into_iter().flatten() {
+                unshare_statement(clause);
+            }
+            if let Some(condition) = &mut for_stmt.condition {
+                unshare_expression(condition);
+            }
+            unshare_block(&mut for_stmt.body);
+        }
+        Statement::While(while_stmt) => {
+            unshare_expression(&mut while_stmt.condition);
+            unshare_block(&mut while_stmt.body);
+        }
+        Statement::Switch(switch_stmt) => {
+            unshare_expression(&mut switch_stmt.expr);
+            for case in &mut switch_stmt.cases {
+                unshare_expression(&mut case.value);
+                unshare_block(&mut case.body);
+            }
+            if let Some(default_case) = &mut switch_stmt.default_case {
+                unshare_block(default_case);
+            }
+        }
+        Statement::ParFor(par_for) => unshare_par_for(par_for),
+        Statement::Return(expr) => {
+            if let Some(expr) = expr {
+                unshare_expression(expr);
+            }
+        }
+        Statement::Break | Statement::Continue => {}
+    }
+}
+
+pub(crate) fn unshare_par_for(par_for: &mut ParForStatement) {
+    unshare_expression(&mut par_for.start);
+    unshare_expression(&mut par_for.end);
+    unshare_block(&mut par_for.body);
+}
+
+fn unshare_expression(expr: &mut Expression) {
+    match expr {
+        Expression::Literal(value) => *value = unshare_value(value),
+        Expression::Identifier(_) | Expression::Local(_) => {}
+        Expression::Binary(binary_op) => {
+            unshare_expression(&mut binary_op.left);
+            unshare_expression(&mut binary_op.right);
+        }
+        Expression::Unary(unary_op) => unshare_expression(&mut unary_op.operand),
+        Expression::Call(call) => call.args.iter_mut().for_each(unshare_expression),
+        Expression::MethodCall(method_call) => {
+            unshare_expression(&mut method_call.object);
+            method_call.args.iter_mut().for_each(unshare_expression);
+        }
+        Expression::Index(index_access) => {
+            unshare_expression(&mut index_access.object);
+            index_access.indices.iter_mut().for_each(unshare_expression);
+        }
+        Expression::FieldAccess(field_access) => unshare_expression(&mut field_access.object),
+        Expression::ArrayLiteral(elements) => elements.iter_mut().for_each(unshare_expression),
+        Expression::MapLiteral(pairs) => {
+            for (key, value) in pairs {
+                unshare_expression(key);
+                unshare_expression(value);
+            }
+        }
+        Expression::StructLiteral(struct_literal) => {
+            for (_, value) in &mut struct_literal.fields {
+                unshare_expression(value);
+            }
+        }
+        Expression::Reference(inner) | Expression::Dereference(inner) => unshare_expression(inner),
+        Expression::Template(template) => {
+            for part in &mut template.parts {
+                if let TemplatePart::Hole { expr, .. } = part {
+                    unshare_expression(expr);
+                }
+            }
+        }
+    }
+}
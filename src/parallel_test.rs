@@ -0,0 +1,156 @@
+#[cfg(test)]
+mod tests {
+    use crate::ast::*;
+    use crate::interpreter::Interpreter;
+    use crate::lexer::Lexer;
+    use crate::parallel::check_par_for;
+    use crate::parser::Parser;
+
+    fn parse(source: &str) -> Program {
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        Parser::new(tokens).parse().expect("source should parse")
+    }
+
+    // check_par_for on the first par for in main, with body as its body and
+    // setup declared in front of it
+    fn check(setup: &str, header: &str, body: &str) -> Result<(), String> {
+        let source = format!(
+            "fn touch(ref x: int) int {{ x = 1; ret 0; }}\nchif main() {{\n{}\npar for ({}) {{\n{}\n}}\n}}",
+            setup, header, body
+        );
+        let program = parse(&source);
+        let main = program.items.iter()
+            .find_map(|item| match item {
+                Item::Function(func) if func.is_main => Some(func),
+                _ => None,
+            })
+            .expect("main should parse");
+        let par_for = main.body.statements.iter()
+            .find_map(|statement| match statement {
+                Statement::ParFor(par_for) => Some(par_for),
+                _ => None,
+            })
+            .expect("main should contain a par for");
+        check_par_for(par_for)
+    }
+
+    fn assert_rejected(setup: &str, header: &str, body: &str, reason: &str) {
+        match check(setup, header, body) {
+            Ok(()) => panic!("par for body should be rejected: {}", body),
+            Err(message) => assert!(message.contains(reason), "Expected an error about '{}', got: {}", reason, message),
+        }
+    }
+
+    fn output(source: &str) -> String {
+        let mut interpreter = Interpreter::new();
+        interpreter.capture_output();
+        interpreter.execute(&parse(source)).expect("program should run");
+        interpreter.captured_output().to_string()
+    }
+
+    #[test]
+    fn test_accepts_private_writes_and_reductions() {
+        let result = check(
+            "var total: int = 0;\nlist items: int[] = [1, 2, 3];",
+            "i in 0..10; sum total",
+            "var square: int = i * i;\nlist local: int[] = [];\nlocal.add(square + items[0]);\nfor (j = 0; j < 3; j = j + 1) {\nif (j == 1) {\nbreak;\n}\n}\ncontinue;\ntotal = total + square;",
+        );
+        assert_eq!(result, Ok(()));
+    }
+
+    #[test]
+    fn test_rejects_writes_to_shared_variables() {
+        assert_rejected("var count: int = 0;", "i in 0..10", "count = count + 1;", "shared variable 'count'");
+        assert_rejected("array cells: int[10] = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0];", "i in 0..10", "cells[i] = i;", "shared variable 'cells'");
+        assert_rejected("", "i in 0..10", "i = 5;", "loop variable 'i'");
+    }
+
+    #[test]
+    fn test_rejects_shared_references() {
+        assert_rejected("var count: int = 0;", "i in 0..10", "var r: int = touch(&count);", "by reference");
+    }
+
+    #[test]
+    fn test_rejects_ret_and_break() {
+        assert_rejected("", "i in 0..10", "ret;", "ret is not allowed");
+        assert_rejected("", "i in 0..10", "if (i == 3) {\nbreak;\n}", "break is not allowed");
+    }
+
+    #[test]
+    fn test_rejects_shared_list_mutation() {
+        let setup = "list items: int[] = [1, 2, 3];";
+        assert_rejected(setup, "i in 0..10", "items.add(i);", "shared list 'items'");
+        assert_rejected(setup, "i in 0..10", "items.addAt(i, 0);", "shared list 'items'");
+        assert_rejected(setup, "i in 0..10", "items.del(0);", "shared list 'items'");
+    }
+
+    #[test]
+    fn test_reductions_match_sequential_loop() {
+        let body = r#"
+            var c: int = i * i % 97;
+            total = total + c;
+            if (c < low) {
+                low = c;
+            }
+            if (c > high) {
+                high = c;
+            }
+            scaled = scaled + c / 2.0;
+        "#;
+        let program = |header: &str| format!(
+            "chif main() {{\nvar total: int = 5;\nvar low: int = 50;\nvar high: int = 0;\nvar scaled: float = 0.5;\n{} {{\n{}\n}}\ncon.out(\"{{total}} {{low}} {{high}} {{scaled}}\");\n}}",
+            header, body
+        );
+        let parallel = output(&program("par for (i in 0..2000; sum total, min low, max high, sum scaled)"));
+        let sequential = output(&program("for (i = 0; i < 2000; i = i + 1)"));
+        assert_eq!(parallel, sequential);
+    }
+
+    #[test]
+    fn test_workers_read_captured_variables() {
+        // Elements are read from the shared snapshot, whole values are
+        // copied on first read, and the loop runs again for every pass of
+        // the outer one
+        let body = r#"
+            var fromArray: int = data[i % 5];
+            var fromMap: int = weights[keys[i % 3]];
+            var p: Point = points[i % 2];
+            total = total + fromArray * fromMap + p.x + sumOf(data) + offset;
+        "#;
+        let program = |header: &str| format!(
+            r#"
+            struct Point {{
+                x: int,
+                y: int,
+            }}
+
+            fn sumOf(values: array[int]) int {{
+                var s: int = 0;
+                for (k = 0; k < 5; k = k + 1) {{
+                    s = s + values[k];
+                }}
+                ret s;
+            }}
+
+            chif main() {{
+                array data: int[5] = [1, 2, 3, 4, 5];
+                list keys: str[] = ["a", "b", "c"];
+                var weights: map[str:int] = {{"a": 1, "b": 10, "c": 100}};
+                list points: Point[] = [Point {{ x = 7, y = 0 }}, Point {{ x = 11, y = 0 }}];
+                var total: int = 0;
+                for (round = 0; round < 3; round = round + 1) {{
+                    var offset: int = round;
+                    {} {{
+                        {}
+                    }}
+                }}
+                con.out("{{total}}");
+            }}
+            "#,
+            header, body
+        );
+        let parallel = output(&program("par for (i in 0..500; sum total)"));
+        let sequential = output(&program("for (i = 0; i < 500; i = i + 1)"));
+        assert_eq!(parallel, sequential);
+    }
+}
@@ -1,16 +1,18 @@
 use crate::ast::*;
 use crate::error::{ChifError, Result};
-use crate::lexer::Token;
+use crate::lexer::{Lexer, Symbol, Token, Tokens};
 use crate::types::{ChifType, ChifValue};
 
-pub struct Parser {
-    tokens: Vec<Token>,
+pub struct Parser<'a> {
+    tokens: Tokens<'a>,
     current: usize,
+    // Built the first time a block needs statement lines
+    line_starts: Vec<usize>,
 }
 
-impl Parser {
-    pub fn new(tokens: Vec<Token>) -> Self {
-        Self { tokens, current: 0 }
+impl<'a> Parser<'a> {
+    pub fn new(tokens: Tokens<'a>) -> Self {
+        Self { tokens, current: 0, line_starts: Vec::new() }
     }
     
     pub fn parse(&mut self) -> Result<Program> {
@@ -23,6 +25,90 @@ impl Parser {
         Ok(Program { items })
     }
     
+    // Parse a token stream holding exactly one expression, e.g. the inside of
+    // an interpolation hole "{a + b}"
+    pub fn parse_single_expression(&mut self) -> Result<Expression> {
+        let expr = self.parse_expression()?;
+        if !self.is_at_end() {
+            return Err(ChifError::ParserError {
+                message: format!("Unexpected token after expression: {}", self.describe(self.peek())),
+            });
+        }
+        Ok(expr)
+    }
+    
+    // Literals with braces become templates, so their holes are parsed here
+    // once instead of on every evaluation. A literal with an unclosed `{`
+    // stays plain and is reported when it is interpolated.
+    fn string_literal(value: String) -> Expression {
+        if value.contains(['{', '}']) {
+            if let Some(parts) = Self::parse_template(&value) {
+                return Expression::Template(Template { source: value, parts });
+            }
+        }
+        Expression::Literal(ChifValue::Str(value.into()))
+    }
+    
+    // Split an interpolated string into literal text and holes: "{{" and "}}"
+    // are escaped braces, a hole that doesn't parse as an expression is kept
+    // as literal text. None if a `{` is never closed.
+    pub fn parse_template(s: &str) -> Option<Vec<TemplatePart>> {
+        let mut parts = Vec::new();
+        let mut literal = String::new();
+        let mut chars = s.chars().peekable();
+        
+        while let Some(ch) = chars.next() {
+            if ch == '{' {
+                if chars.peek() == Some(&'{') {
+                    chars.next();
+                    literal.push('{');
+                    continue;
+                }
+                
+                let mut hole = String::new();
+                let mut found_closing = false;
+                while let Some(ch) = chars.next() {
+                    if ch == '}' {
+                        found_closing = true;
+                        break;
+                    }
+                    hole.push(ch);
+                }
+                if !found_closing {
+                    return None;
+                }
+                
+                let part = if hole.trim().is_empty() {
+                    TemplatePart::Positional
+                } else {
+                    match Lexer::new(&hole).tokenize().and_then(|tokens| Parser::new(tokens).parse_single_expression()) {
+                        Ok(expr) => TemplatePart::Hole { expr, text: hole },
+                        Err(_) => {
+                            literal.push('{');
+                            literal.push_str(&hole);
+                            literal.push('}');
+                            continue;
+                        }
+                    }
+                };
+                if !literal.is_empty() {
+                    parts.push(TemplatePart::Literal(std::mem::take(&mut literal)));
+                }
+                parts.push(part);
+            } else if ch == '}' && chars.peek() == Some(&'}') {
+                chars.next();
+                literal.push('}');
+            } else {
+                literal.push(ch);
+            }
+        }
+        if !literal.is_empty() {
+            parts.push(TemplatePart::Literal(literal));
+        }
+        
+        Some(parts)
+    }
+    
     fn parse_item(&mut self) -> Result<Item> {
         match &self.peek() {
             Token::Import => {
@@ -46,8 +132,14 @@ impl Parser {
                 let struct_def = self.parse_struct_def()?;
                 Ok(Item::Struct(struct_def))
             }
+            // `soa` is only a keyword in front of `struct`
+            Token::Identifier(Symbol::SOA) if matches!(self.peek_next(), Token::Struct) => {
+                self.advance(); // consume 'soa'
+                let struct_def = self.parse_struct_def()?;
+                Ok(Item::Struct(StructDef { soa: true, ..struct_def }))
+            }
             _ => Err(ChifError::ParserError {
-                message: format!("Expected import, function, struct, or struct implementation, found {:?}", self.peek()),
+                message: format!("Expected import, function, struct, or struct implementation, found {}", self.describe(self.peek())),
             }),
         }
     }
@@ -56,7 +148,7 @@ impl Parser {
         self.consume(Token::Import, "Expected 'import'")?;
         
         let path = match self.advance() {
-            Token::StringLiteral(path) => path,
+            Token::StringLiteral(path) => self.tokens.string(path).into_owned(),
             _ => return Err(ChifError::ParserError {
                 message: "Expected string literal after 'import'".to_string(),
             }),
@@ -64,7 +156,7 @@ impl Parser {
         
         let alias = if self.match_token(&Token::As) {
             match self.advance() {
-                Token::Identifier(alias) => Some(alias),
+                Token::Identifier(alias) => Some(self.name(alias)),
                 _ => return Err(ChifError::ParserError {
                     message: "Expected identifier after 'as'".to_string(),
                 }),
@@ -84,7 +176,7 @@ impl Parser {
         }
         
         let name = match self.advance() {
-            Token::Identifier(name) => name,
+            Token::Identifier(name) => self.name(name),
             _ => return Err(ChifError::ParserError {
                 message: "Expected function name".to_string(),
             }),
@@ -104,7 +196,7 @@ impl Parser {
                 };
                 
                 let param_name = match self.advance() {
-                    Token::Identifier(name) => name,
+                    Token::Identifier(name) => self.name(name),
                     _ => return Err(ChifError::ParserError {
                         message: "Expected parameter name".to_string(),
                     }),
@@ -146,6 +238,7 @@ impl Parser {
             return_type,
             body,
             is_main,
+            locals: Default::default(),
         })
     }
     
@@ -153,7 +246,7 @@ impl Parser {
         self.consume(Token::Struct, "Expected 'struct'")?;
         
         let name = match self.advance() {
-            Token::Identifier(name) => name,
+            Token::Identifier(name) => self.name(name),
             _ => return Err(ChifError::ParserError {
                 message: "Expected struct name".to_string(),
             }),
@@ -164,7 +257,7 @@ impl Parser {
         let mut fields = Vec::new();
         while !self.check(&Token::RightBrace) && !self.is_at_end() {
             let field_name = match self.advance() {
-                Token::Identifier(name) => name,
+                Token::Identifier(name) => self.name(name),
                 _ => return Err(ChifError::ParserError {
                     message: "Expected field name".to_string(),
                 }),
@@ -182,14 +275,14 @@ impl Parser {
         
         self.consume(Token::RightBrace, "Expected '}' after struct fields")?;
         
-        Ok(StructDef { name, fields })
+        Ok(StructDef { name, fields, soa: false })
     }
     
     fn parse_struct_impl(&mut self) -> Result<StructImpl> {
         self.consume(Token::FnFor, "Expected 'fn_for'")?;
         
         let struct_name = match self.advance() {
-            Token::Identifier(name) => name,
+            Token::Identifier(name) => self.name(name),
             _ => return Err(ChifError::ParserError {
                 message: "Expected struct name".to_string(),
             }),
@@ -309,9 +402,9 @@ impl Parser {
                 self.consume(Token::RightBracket, "Expected ']' after map type")?;
                 Ok(ChifType::Map(Box::new(key_type), Box::new(value_type)))
             }
-            Token::Identifier(name) => Ok(ChifType::Struct(name)),
+            Token::Identifier(name) => Ok(ChifType::Struct(self.name(name))),
             token => Err(ChifError::ParserError {
-                message: format!("Expected type, found {:?}", token),
+                message: format!("Expected type, found {}", self.describe(token)),
             }),
         }
     }
@@ -320,13 +413,24 @@ impl Parser {
         self.consume(Token::LeftBrace, "Expected '{'")?;
         
         let mut statements = Vec::new();
+        let mut lines = Vec::new();
         while !self.check(&Token::RightBrace) && !self.is_at_end() {
+            lines.push(self.line());
             statements.push(self.parse_statement()?);
         }
         
         self.consume(Token::RightBrace, "Expected '}'")?;
         
-        Ok(Block { statements })
+        Ok(Block { statements, lines })
+    }
+    
+    // 1-based source line of the current token
+    fn line(&mut self) -> u32 {
+        if self.line_starts.is_empty() {
+            self.line_starts = self.tokens.line_starts();
+        }
+        let offset = self.tokens.spans[self.current].start;
+        self.line_starts.partition_point(|&start| start <= offset) as u32
     }
     
     fn parse_statement(&mut self) -> Result<Statement> {
@@ -340,6 +444,10 @@ impl Parser {
             Token::Ret => self.parse_return_statement(),
             Token::Break => self.parse_break_statement(),
             Token::Continue => self.parse_continue_statement(),
+            // `par` is only a keyword in front of `for`
+            Token::Identifier(Symbol::PAR) if matches!(self.peek_next(), Token::For) => {
+                self.parse_par_for_statement()
+            }
             _ => {
                 let expr = self.parse_expression()?;
                 
@@ -371,7 +479,7 @@ impl Parser {
         };
         
         let name = match self.advance() {
-            Token::Identifier(name) => name,
+            Token::Identifier(name) => self.name(name),
             _ => return Err(ChifError::ParserError {
                 message: "Expected variable name".to_string(),
             }),
@@ -433,6 +541,7 @@ impl Parser {
             var_type,
             value,
             is_mutable,
+            slot: None,
         }))
     }
     
@@ -467,7 +576,7 @@ impl Parser {
                 // Parse variable declaration: var i: int = 0
                 self.advance(); // consume 'var'
                 let name = match self.advance() {
-                    Token::Identifier(name) => name,
+                    Token::Identifier(name) => self.name(name),
                     _ => return Err(ChifError::ParserError {
                         message: "Expected variable name".to_string(),
                     }),
@@ -487,11 +596,12 @@ impl Parser {
                     var_type,
                     value,
                     is_mutable: true,
+                    slot: None,
                 })))
             } else {
                 // Parse assignment: i = 0
                 let var_name = match self.advance() {
-                    Token::Identifier(name) => name,
+                    Token::Identifier(name) => self.name(name),
                     _ => return Err(ChifError::ParserError {
                         message: "Expected variable name in for loop initialization".to_string(),
                     }),
@@ -522,7 +632,7 @@ impl Parser {
         let update = if !self.check(&Token::RightParen) {
             // Parse update as assignment: i = i + 1
             let var_name = match self.advance() {
-                Token::Identifier(name) => name,
+                Token::Identifier(name) => self.name(name),
                 _ => return Err(ChifError::ParserError {
                     message: "Expected variable name in for loop update".to_string(),
                 }),
@@ -550,6 +660,65 @@ impl Parser {
         }))
     }
     
+    // par for (i in start..end; sum a, max b) { ... }
+    fn parse_par_for_statement(&mut self) -> Result<Statement> {
+        self.advance(); // consume 'par'
+        self.consume(Token::For, "Expected 'for' after 'par'")?;
+        self.consume(Token::LeftParen, "Expected '(' after 'par for'")?;
+        
+        let var = match self.advance() {
+            Token::Identifier(name) => self.name(name),
+            _ => return Err(ChifError::ParserError {
+                message: "Expected loop variable in par for".to_string(),
+            }),
+        };
+        match self.advance() {
+            Token::Identifier(Symbol::IN) => {}
+            token => return Err(ChifError::ParserError {
+                message: format!("Expected 'in' after par for variable, found {}", self.describe(token)),
+            }),
+        }
+        let start = self.parse_expression()?;
+        self.consume(Token::DotDot, "Expected '..' in par for range")?;
+        let end = self.parse_expression()?;
+        
+        let mut reductions = Vec::new();
+        if self.match_token(&Token::Semicolon) {
+            loop {
+                let op = match self.advance() {
+                    Token::Identifier(Symbol::SUM) => ReductionOp::Sum,
+                    Token::Identifier(Symbol::MIN) => ReductionOp::Min,
+                    Token::Identifier(Symbol::MAX) => ReductionOp::Max,
+                    token => return Err(ChifError::ParserError {
+                        message: format!("Expected reduction 'sum', 'min' or 'max', found {}", self.describe(token)),
+                    }),
+                };
+                let name = match self.advance() {
+                    Token::Identifier(name) => self.name(name),
+                    _ => return Err(ChifError::ParserError {
+                        message: "Expected variable name after reduction".to_string(),
+                    }),
+                };
+                reductions.push(Reduction { op, name });
+                if !self.match_token(&Token::Comma) {
+                    break;
+                }
+            }
+        }
+        self.consume(Token::RightParen, "Expected ')' after par for clauses")?;
+        
+        let body = self.parse_block()?;
+        
+        Ok(Statement::ParFor(ParForStatement {
+            var,
+            start,
+            end,
+            reductions,
+            body,
+            slot: None,
+        }))
+    }
+    
     fn parse_while_statement(&mut self) -> Result<Statement> {
         self.consume(Token::While, "Expected 'while'")?;
         self.consume(Token::LeftParen, "Expected '(' after 'while'")?;
@@ -768,7 +937,7 @@ impl Parser {
             } else if self.match_token(&Token::Dot) {
                 // Field access or method call
                 let field_name = match self.advance() {
-                    Token::Identifier(name) => name,
+                    Token::Identifier(name) => self.name(name),
                     _ => return Err(ChifError::ParserError {
                         message: "Expected field or method name after '.'".to_string(),
                     }),
@@ -811,10 +980,11 @@ impl Parser {
         match self.advance() {
             Token::IntLiteral(value) => Ok(Expression::Literal(ChifValue::Int(value))),
             Token::FloatLiteral(value) => Ok(Expression::Literal(ChifValue::Float(value))),
-            Token::StringLiteral(value) => Ok(Expression::Literal(ChifValue::Str(value))),
+            Token::StringLiteral(value) => Ok(Self::string_literal(self.tokens.string(value).into_owned())),
             Token::BoolLiteral(value) => Ok(Expression::Literal(ChifValue::Bool(value))),
             Token::Nil => Ok(Expression::Literal(ChifValue::Nil)),
             Token::Identifier(name) => {
+                let name = self.name(name);
                 // Check if this is a struct literal: StructName { ... }
                 if self.check(&Token::LeftBrace) {
                     self.advance(); // consume '{'
@@ -823,7 +993,7 @@ impl Parser {
                     if !self.check(&Token::RightBrace) {
                         loop {
                             let field_name = match self.advance() {
-                                Token::Identifier(field) => field,
+                                Token::Identifier(field) => self.name(field),
                                 _ => return Err(ChifError::ParserError {
                                     message: "Expected field name in struct literal".to_string(),
                                 }),
@@ -874,7 +1044,7 @@ impl Parser {
             }
             Token::LeftBrace => {
                 // Map literal or struct literal
-                if self.check(&Token::StringLiteral("".to_string())) || self.check(&Token::Identifier("".to_string())) {
+                if matches!(self.peek(), Token::StringLiteral(_) | Token::Identifier(_)) {
                     // This is a heuristic - we'll need to improve this
                     let mut pairs = Vec::new();
                     if !self.check(&Token::RightBrace) {
@@ -897,7 +1067,7 @@ impl Parser {
                 }
             }
             token => Err(ChifError::ParserError {
-                message: format!("Unexpected token: {:?}", token),
+                message: format!("Unexpected token: {}", self.describe(token)),
             }),
         }
     }
@@ -1010,11 +1180,29 @@ impl Parser {
     }
     
     fn peek(&self) -> Token {
-        self.tokens[self.current].clone()
+        self.tokens.tokens[self.current]
+    }
+    
+    fn peek_next(&self) -> Token {
+        self.tokens.tokens.get(self.current + 1).copied().unwrap_or(Token::Eof)
     }
     
     fn previous(&self) -> Token {
-        self.tokens[self.current - 1].clone()
+        self.tokens.tokens[self.current - 1]
+    }
+    
+    // AST nodes own their names
+    fn name(&self, symbol: Symbol) -> String {
+        self.tokens.name(symbol).to_string()
+    }
+    
+    // A token for error messages, with the text of names and strings
+    fn describe(&self, token: Token) -> String {
+        match token {
+            Token::Identifier(symbol) => format!("Identifier({:?})", self.tokens.name(symbol)),
+            Token::StringLiteral(span) => format!("StringLiteral({:?})", self.tokens.string(span)),
+            token => format!("{:?}", token),
+        }
     }
     
     fn consume(&mut self, token: Token, message: &str) -> Result<Token> {
@@ -1022,7 +1210,7 @@ impl Parser {
             Ok(self.advance())
         } else {
             Err(ChifError::ParserError {
-                message: format!("{}, found {:?}", message, self.peek()),
+                message: format!("{}, found {}", message, self.describe(self.peek())),
             })
         }
     }
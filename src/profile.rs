@@ -0,0 +1,264 @@
+use crate::ast::Function;
+use crate::bench;
+
+use std::collections::HashMap;
+use std::io::{self, Write};
+use std::time::{Duration, Instant};
+
+// `rono run --profile`: the interpreter reports every Rono function call
+// and statement here, and the profile is printed when the program ends.
+//
+// Per function: calls, inclusive time (recursive calls counted once, at
+// the outermost one), exclusive time and allocations made outside callees.
+// Per source line: executions, inclusive time, and self time and
+// allocations excluding nested statements and the calls it makes.
+// Allocations come from rono's counting allocator (see bench.rs) and stay
+// zero where the interpreter is embedded without it.
+//
+// Exclusive time is also kept per call stack, which is written in the
+// collapsed format flamegraph.pl and inferno read: `main;run;fib 1234`,
+// weighted in microseconds.
+//
+// The profiler's own bookkeeping only allocates the first time it sees a
+// function, line or call stack, so steady-state counts are the program's.
+
+pub struct Profiler {
+    // Function id by address of the interpreter's Rc<Function>
+    ids: HashMap<*const Function, usize>,
+    functions: Vec<FunctionStats>,
+    lines: HashMap<(usize, u32), LineStats>,
+    // Call stacks: (parent stack, function) -> stack id; stack 0 is the root
+    stack_ids: HashMap<(usize, usize), usize>,
+    stacks: Vec<StackStats>,
+    calls: Vec<ActiveCall>,
+    statements: Vec<ActiveStatement>,
+}
+
+struct FunctionStats {
+    name: String,
+    calls: u64,
+    // Calls of this function currently running, to count recursion once
+    active: u32,
+    inclusive: Duration,
+    exclusive: Duration,
+    allocations: u64,
+}
+
+#[derive(Default)]
+struct LineStats {
+    hits: u64,
+    inclusive: Duration,
+    exclusive: Duration,
+    allocations: u64,
+}
+
+struct StackStats {
+    parent: usize,
+    function: usize,
+    exclusive: Duration,
+}
+
+struct ActiveCall {
+    function: usize,
+    stack: usize,
+    start: Instant,
+    allocations: u64,
+    child_time: Duration,
+    child_allocations: u64,
+}
+
+struct ActiveStatement {
+    start: Instant,
+    allocations: u64,
+    child_time: Duration,
+    child_allocations: u64,
+}
+
+impl Profiler {
+    pub fn new() -> Self {
+        Self {
+            ids: HashMap::new(),
+            functions: Vec::new(),
+            lines: HashMap::new(),
+            stack_ids: HashMap::new(),
+            stacks: vec![StackStats { parent: 0, function: usize::MAX, exclusive: Duration::ZERO }],
+            calls: Vec::new(),
+            statements: Vec::new(),
+        }
+    }
+
+    // Names a loaded function for the report: `Point.move_by` for methods,
+    // `math.square` for module functions. Unnamed functions use their own name.
+    pub fn name(&mut self, func: &Function, name: String) {
+        let id = self.functions.len();
+        self.functions.push(FunctionStats {
+            name,
+            calls: 0,
+            active: 0,
+            inclusive: Duration::ZERO,
+            exclusive: Duration::ZERO,
+            allocations: 0,
+        });
+        self.ids.insert(func as *const Function, id);
+    }
+
+    fn function_id(&mut self, func: &Function) -> usize {
+        match self.ids.get(&(func as *const Function)) {
+            Some(&id) => id,
+            None => {
+                self.name(func, func.name.clone());
+                self.functions.len() - 1
+            }
+        }
+    }
+
+    pub fn enter_call(&mut self, func: &Function) {
+        let function = self.function_id(func);
+        let parent = self.calls.last().map_or(0, |call| call.stack);
+        let next_stack = self.stacks.len();
+        let stack = *self.stack_ids.entry((parent, function)).or_insert(next_stack);
+        if stack == next_stack {
+            self.stacks.push(StackStats { parent, function, exclusive: Duration::ZERO });
+        }
+
+        let stats = &mut self.functions[function];
+        stats.calls += 1;
+        stats.active += 1;
+        self.calls.push(ActiveCall {
+            function,
+            stack,
+            start: Instant::now(),
+            allocations: bench::allocations(),
+            child_time: Duration::ZERO,
+            child_allocations: 0,
+        });
+    }
+
+    pub fn leave_call(&mut self) {
+        let call = match self.calls.pop() {
+            Some(call) => call,
+            None => return,
+        };
+        let elapsed = call.start.elapsed();
+        let allocations = bench::allocations() - call.allocations;
+
+        let stats = &mut self.functions[call.function];
+        stats.active -= 1;
+        if stats.active == 0 {
+            stats.inclusive += elapsed;
+        }
+        let exclusive = elapsed.saturating_sub(call.child_time);
+        stats.exclusive += exclusive;
+        stats.allocations += allocations.saturating_sub(call.child_allocations);
+        self.stacks[call.stack].exclusive += exclusive;
+
+        if let Some(caller) = self.calls.last_mut() {
+            caller.child_time += elapsed;
+            caller.child_allocations += allocations;
+        }
+    }
+
+    pub fn enter_statement(&mut self) {
+        self.statements.push(ActiveStatement {
+            start: Instant::now(),
+            allocations: bench::allocations(),
+            child_time: Duration::ZERO,
+            child_allocations: 0,
+        });
+    }
+
+    // `line` of the function currently running; 0 when the parser didn't record one
+    pub fn leave_statement(&mut self, line: u32) {
+        let statement = match self.statements.pop() {
+            Some(statement) => statement,
+            None => return,
+        };
+        let elapsed = statement.start.elapsed();
+        let allocations = bench::allocations() - statement.allocations;
+
+        if let Some(call) = self.calls.last() {
+            let stats = self.lines.entry((call.function, line)).or_default();
+            stats.hits += 1;
+            stats.inclusive += elapsed;
+            stats.exclusive += elapsed.saturating_sub(statement.child_time);
+            stats.allocations += allocations.saturating_sub(statement.child_allocations);
+        }
+
+        // Statements of called functions are children of the calling statement too
+        if let Some(parent) = self.statements.last_mut() {
+            parent.child_time += elapsed;
+            parent.child_allocations += allocations;
+        }
+    }
+
+    // Tables of functions and of the hottest lines, by exclusive time
+    pub fn write_report(&self, out: &mut impl Write) -> io::Result<()> {
+        let mut functions: Vec<&FunctionStats> = self.functions.iter().filter(|stats| stats.calls > 0).collect();
+        functions.sort_by(|a, b| b.exclusive.cmp(&a.exclusive));
+
+        writeln!(out, "{:>10} {:>12} {:>12} {:>12}  function", "calls", "total ms", "self ms", "self allocs")?;
+        for stats in functions {
+            writeln!(
+                out,
+                "{:>10} {:>12.3} {:>12.3} {:>12}  {}",
+                stats.calls,
+                millis(stats.inclusive),
+                millis(stats.exclusive),
+                stats.allocations,
+                stats.name
+            )?;
+        }
+
+        let mut lines: Vec<(&(usize, u32), &LineStats)> = self.lines.iter().collect();
+        lines.sort_by(|a, b| b.1.exclusive.cmp(&a.1.exclusive));
+
+        writeln!(out)?;
+        writeln!(out, "{:>10} {:>12} {:>12} {:>12}  line", "hits", "total ms", "self ms", "self allocs")?;
+        for (&(function, line), stats) in lines.into_iter().take(LINES_SHOWN) {
+            let location = match line {
+                0 => self.functions[function].name.clone(),
+                line => format!("{}:{}", self.functions[function].name, line),
+            };
+            writeln!(
+                out,
+                "{:>10} {:>12.3} {:>12.3} {:>12}  {}",
+                stats.hits,
+                millis(stats.inclusive),
+                millis(stats.exclusive),
+                stats.allocations,
+                location
+            )?;
+        }
+        Ok(())
+    }
+
+    // One line per call stack: frames from main outwards, then microseconds
+    pub fn write_collapsed(&self, out: &mut impl Write) -> io::Result<()> {
+        let mut frames = Vec::new();
+        for stats in self.stacks.iter().skip(1) {
+            let micros = stats.exclusive.as_micros();
+            if micros == 0 {
+                continue;
+            }
+            frames.clear();
+            let mut stack = stats;
+            loop {
+                frames.push(self.functions[stack.function].name.as_str());
+                if stack.parent == 0 {
+                    break;
+                }
+                stack = &self.stacks[stack.parent];
+            }
+            frames.reverse();
+            writeln!(out, "{} {}", frames.join(";"), micros)?;
+        }
+        Ok(())
+    }
+}
+
+// Rows of the line table
+const LINES_SHOWN: usize = 30;
+
+fn millis(duration: Duration) -> f64 {
+    duration.as_secs_f64() * 1000.0
+}
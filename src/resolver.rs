@@ -0,0 +1,236 @@
+use crate::ast::*;
+use std::collections::HashMap;
+use std::rc::Rc;
+
+// Assigns every local of a function a slot in a flat frame, so the
+// interpreter reads and writes variables by index instead of walking
+// scope maps by name.
+//
+// Scoping follows the interpreter: blocks don't open scopes, and `for`
+// loop variables stay visible after the loop, so one namespace per
+// function is exact. Parameters take the first slots in order.
+//
+// Identifiers the interpreter still looks up by name are left alone:
+// method call receivers (modules, `con`, mutating list and struct
+// methods), operands of `&` / `*`, and assignments to fields or indices.
+// Those lookups find resolved locals through the frame's slot names.
+pub fn resolve_function(func: &mut Function) {
+    let mut resolver = Resolver::default();
+    for param in &func.params {
+        resolver.declare(&param.name);
+    }
+    resolver.collect_block(&func.body);
+    resolver.resolve_block(&mut func.body);
+    func.locals = Rc::new(resolver.names);
+}
+
+// Names the interpreter treats as builtins before looking at variables
+const BUILTIN_NAMES: [&str; 4] = ["randi", "randf", "rands", "randseed"];
+
+#[derive(Default)]
+struct Resolver {
+    names: Vec<String>,
+    slots: HashMap<String, usize>,
+}
+
+impl Resolver {
+    fn declare(&mut self, name: &str) -> usize {
+        if let Some(&slot) = self.slots.get(name) {
+            return slot;
+        }
+        let slot = self.names.len();
+        self.names.push(name.to_string());
+        self.slots.insert(name.to_string(), slot);
+        slot
+    }
+
+    // First pass: every name a statement can define gets a slot, so reads
+    // that appear before the definition in the source resolve as well
+    fn collect_block(&mut self, block: &Block) {
+        for statement in &block.statements {
+            self.collect_statement(statement);
+        }
+    }
+
+    fn collect_statement(&mut self, statement: &Statement) {
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                self.declare(&var_decl.name);
+            }
+            Statement::Assignment(assignment) => {
+                if let Expression::Identifier(name) = &assignment.target {
+                    self.declare(name);
+                }
+            }
+            Statement::If(if_stmt) => {
+                self.collect_block(&if_stmt.then_block);
+                if let Some(else_block) = &if_stmt.else_block {
+                    self.collect_block(else_block);
+                }
+            }
+            Statement::For(for_stmt) => {
+                if let Some(init) = &for_stmt.init {
+                    self.collect_statement(init);
+                }
+                if let Some(update) = &for_stmt.update {
+                    self.collect_statement(update);
+                }
+                self.collect_block(&for_stmt.body);
+            }
+            Statement::While(while_stmt) => {
+                self.collect_block(&while_stmt.body);
+            }
+            Statement::Switch(switch_stmt) => {
+                for case in &switch_stmt.cases {
+                    self.collect_block(&case.body);
+                }
+                if let Some(default_case) = &switch_stmt.default_case {
+                    self.collect_block(default_case);
+                }
+            }
+            Statement::ParFor(par_for) => {
+                self.declare(&par_for.var);
+                self.collect_block(&par_for.body);
+            }
+            Statement::Expression(_) | Statement::Return(_) | Statement::Break | Statement::Continue => {}
+        }
+    }
+
+    fn resolve_block(&self, block: &mut Block) {
+        for statement in &mut block.statements {
+            self.resolve_statement(statement);
+        }
+    }
+
+    fn resolve_statement(&self, statement: &mut Statement) {
+        match statement {
+            Statement::VarDecl(var_decl) => {
+                var_decl.slot = self.slots.get(&var_decl.name).copied();
+                if let Some(value) = &mut var_decl.value {
+                    self.resolve_expression(value);
+                }
+            }
+            Statement::Assignment(assignment) => {
+                if let Expression::Identifier(name) = &assignment.target {
+                    if let Some(&slot) = self.slots.get(name) {
+                        assignment.target = Expression::Local(LocalVar { name: name.clone(), slot });
+                    }
+                }
+                self.resolve_expression(&mut assignment.value);
+            }
+            Statement::Expression(expr) => self.resolve_expression(expr),
+            Statement::If(if_stmt) => {
+                self.resolve_expression(&mut if_stmt.condition);
+                self.resolve_block(&mut if_stmt.then_block);
+                if let Some(else_block) = &mut if_stmt.else_block {
+                    self.resolve_block(else_block);
+                }
+            }
+            Statement::For(for_stmt) => {
+                if let Some(init) = &mut for_stmt.init {
+                    self.resolve_statement(init);
+                }
+                if let Some(condition) = &mut for_stmt.condition {
+                    self.resolve_expression(condition);
+                }
+                if let Some(update) = &mut for_stmt.update {
+                    self.resolve_statement(update);
+                }
+                self.resolve_block(&mut for_stmt.body);
+            }
+            Statement::While(while_stmt) => {
+                self.resolve_expression(&mut while_stmt.condition);
+                self.resolve_block(&mut while_stmt.body);
+            }
+            Statement::Switch(switch_stmt) => {
+                self.resolve_expression(&mut switch_stmt.expr);
+                for case in &mut switch_stmt.cases {
+                    self.resolve_expression(&mut case.value);
+                    self.resolve_block(&mut case.body);
+                }
+                if let Some(default_case) = &mut switch_stmt.default_case {
+                    self.resolve_block(default_case);
+                }
+            }
+            Statement::ParFor(par_for) => {
+                par_for.slot = self.slots.get(&par_for.var).copied();
+                self.resolve_expression(&mut par_for.start);
+                self.resolve_expression(&mut par_for.end);
+                self.resolve_block(&mut par_for.body);
+            }
+            Statement::Return(expr) => {
+                if let Some(expr) = expr {
+                    self.resolve_expression(expr);
+                }
+            }
+            Statement::Break | Statement::Continue => {}
+        }
+    }
+
+    fn resolve_expression(&self, expr: &mut Expression) {
+        match expr {
+            Expression::Identifier(name) => {
+                if BUILTIN_NAMES.contains(&name.as_str()) {
+                    return;
+                }
+                if let Some(&slot) = self.slots.get(name.as_str()) {
+                    *expr = Expression::Local(LocalVar { name: std::mem::take(name), slot });
+                }
+            }
+            Expression::Binary(binary_op) => {
+                self.resolve_expression(&mut binary_op.left);
+                self.resolve_expression(&mut binary_op.right);
+            }
+            Expression::Unary(unary_op) => self.resolve_expression(&mut unary_op.operand),
+            Expression::Call(call) => {
+                for arg in &mut call.args {
+                    self.resolve_expression(arg);
+                }
+            }
+            Expression::MethodCall(method_call) => {
+                if !matches!(&*method_call.object, Expression::Identifier(_)) {
+                    self.resolve_expression(&mut method_call.object);
+                }
+                for arg in &mut method_call.args {
+                    self.resolve_expression(arg);
+                }
+            }
+            Expression::Index(index_access) => {
+                self.resolve_expression(&mut index_access.object);
+                for index in &mut index_access.indices {
+                    self.resolve_expression(index);
+                }
+            }
+            Expression::FieldAccess(field_access) => self.resolve_expression(&mut field_access.object),
+            Expression::ArrayLiteral(elements) => {
+                for element in elements {
+                    self.resolve_expression(element);
+                }
+            }
+            Expression::MapLiteral(pairs) => {
+                for (key, value) in pairs {
+                    self.resolve_expression(key);
+                    self.resolve_expression(value);
+                }
+            }
+            Expression::StructLiteral(struct_literal) => {
+                for (_, value) in &mut struct_literal.fields {
+                    self.resolve_expression(value);
+                }
+            }
+            Expression::Reference(inner) | Expression::Dereference(inner) => {
+                if !matches!(&**inner, Expression::Identifier(_)) {
+                    self.resolve_expression(inner);
+                }
+            }
+            Expression::Template(template) => {
+                for part in &mut template.parts {
+                    if let TemplatePart::Hole { expr, .. } = part {
+                        self.resolve_expression(expr);
+                    }
+                }
+            }
+            Expression::Literal(_) | Expression::Local(_) => {}
+        }
+    }
+}
@@ -0,0 +1,165 @@
+#[cfg(test)]
+mod tests {
+    use crate::ast::*;
+    use crate::interpreter::Interpreter;
+    use crate::lexer::Lexer;
+    use crate::parser::Parser;
+    use crate::resolver::resolve_function;
+
+    fn parse(source: &str) -> Program {
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        Parser::new(tokens).parse().expect("source should parse")
+    }
+
+    // The named function of source, resolved
+    fn resolved(source: &str, name: &str) -> Function {
+        let mut func = parse(source).items.into_iter()
+            .find_map(|item| match item {
+                Item::Function(func) if func.name == name => Some(func),
+                _ => None,
+            })
+            .unwrap_or_else(|| panic!("function {} should parse", name));
+        resolve_function(&mut func);
+        func
+    }
+
+    fn output(source: &str) -> String {
+        let mut interpreter = Interpreter::new();
+        interpreter.capture_output();
+        interpreter.execute(&parse(source)).expect("program should run");
+        interpreter.captured_output().to_string()
+    }
+
+    // Slots of every declaration of name, in source order
+    fn declaration_slots(statements: &[Statement], name: &str, slots: &mut Vec<Option<usize>>) {
+        for statement in statements {
+            match statement {
+                Statement::VarDecl(var_decl) if var_decl.name == name => slots.push(var_decl.slot),
+                Statement::If(if_stmt) => {
+                    declaration_slots(&if_stmt.then_block.statements, name, slots);
+                    if let Some(else_block) = &if_stmt.else_block {
+                        declaration_slots(&else_block.statements, name, slots);
+                    }
+                }
+                Statement::For(for_stmt) => declaration_slots(&for_stmt.body.statements, name, slots),
+                Statement::While(while_stmt) => declaration_slots(&while_stmt.body.statements, name, slots),
+                _ => {}
+            }
+        }
+    }
+
+    #[test]
+    fn test_nested_redeclaration_shares_the_slot() {
+        // Blocks don't open scopes: the inner x is the outer x
+        let source = r#"
+            fn shadow(a: int) int {
+                var x: int = a;
+                if (a > 0) {
+                    var x: int = a * 2;
+                    if (a > 1) {
+                        var x: int = a * 3;
+                        var y: int = x;
+                    }
+                }
+                ret x;
+            }
+
+            chif main() {
+                var none: int = shadow(0);
+                var once: int = shadow(1);
+                var twice: int = shadow(2);
+                con.out("{none} {once} {twice}");
+            }
+        "#;
+        let func = resolved(source, "shadow");
+        assert_eq!(*func.locals, vec!["a".to_string(), "x".to_string(), "y".to_string()]);
+
+        let mut slots = Vec::new();
+        declaration_slots(&func.body.statements, "x", &mut slots);
+        assert_eq!(slots, vec![Some(1); 3]);
+        assert!(
+            matches!(func.body.statements.last(), Some(Statement::Return(Some(Expression::Local(local)))) if local.slot == 1),
+            "ret x should read slot 1"
+        );
+        assert_eq!(output(source), "0 2 6\n");
+    }
+
+    #[test]
+    fn test_loops_redeclaring_variables() {
+        let source = r#"
+            chif main() {
+                var total: int = 0;
+                for (i = 0; i < 4; i = i + 1) {
+                    var square: int = i * i;
+                    var j: int = 0;
+                    while (j < i) {
+                        var step: int = j;
+                        j = j + 1;
+                    }
+                    total = total + square + j;
+                }
+                con.out("{i} {total}");
+            }
+        "#;
+        let func = resolved(source, "main");
+        for name in ["total", "i", "square", "j", "step"] {
+            assert_eq!(
+                func.locals.iter().filter(|local| local.as_str() == name).count(), 1,
+                "{} should have exactly one slot in {:?}", name, func.locals
+            );
+        }
+        let mut slots = Vec::new();
+        declaration_slots(&func.body.statements, "square", &mut slots);
+        assert_eq!(slots.len(), 1);
+        assert!(slots[0].is_some());
+
+        // The loop counter stays visible after the loop
+        assert_eq!(output(source), "4 20\n");
+    }
+
+    #[test]
+    fn test_recursive_calls_keep_their_own_frames() {
+        let source = r#"
+            fn fib(n: int) int {
+                if (n < 2) {
+                    ret n;
+                }
+                var left: int = fib(n - 1);
+                var right: int = fib(n - 2);
+                ret left + right;
+            }
+
+            chif main() {
+                var result: int = fib(15);
+                con.out("{result}");
+            }
+        "#;
+        let func = resolved(source, "fib");
+        assert_eq!(*func.locals, vec!["n".to_string(), "left".to_string(), "right".to_string()]);
+        assert_eq!(output(source), "610\n");
+    }
+
+    #[test]
+    fn test_unassigned_slot_falls_back_to_name_lookup() {
+        // peek has a slot for total, but never assigns it when the branch
+        // isn't taken; the read then finds the caller's total by name
+        let source = r#"
+            fn peek(reset: bool) int {
+                if (reset) {
+                    var total: int = 0;
+                }
+                ret total;
+            }
+
+            chif main() {
+                var total: int = 7;
+                var outer: int = peek(false);
+                var own: int = peek(true);
+                con.out("{outer} {own}");
+            }
+        "#;
+        let func = resolved(source, "peek");
+        assert!(func.locals.iter().any(|local| local == "total"), "total should get a slot in peek");
+        assert_eq!(output(source), "7 0\n");
+    }
+}
@@ -3,383 +3,3005 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <curl/curl.h>
 
-// Runtime function for console output
-void rono_print_int(int64_t value) {
-    printf("%lld\n", (long long)value);
+// Runtime metrics, compiled in with -DRONO_METRICS (`rono compile
+// --metrics`, or the `metrics` cargo feature for the runtime inside rono)
+// and reduced to nothing otherwise. Every thread counts into its own block,
+// registered once on a lock-free list and never freed, so hot paths do a
+// relaxed load and store on memory no other thread writes. Readers sum the
+// blocks of all threads, including threads that have exited.
+//
+// HTTP requests are counted per method with connect, TLS and transfer time
+// from curl_easy_getinfo and a latency histogram of power-of-two buckets in
+// microseconds. When RONO_METRICS is set in the environment the totals are
+// written as JSON at exit and on SIGUSR1: to stderr for "1" or "stderr",
+// otherwise to the file it names (rewritten on every dump).
+#ifdef RONO_METRICS
+#include <signal.h>
+#include <stddef.h>
+
+enum {
+    RONO_M_REGION_ALLOCS,   // rono_alloc calls: strings and values in regions
+    RONO_M_REGION_BYTES,
+    RONO_M_HEAP_ALLOCS,     // malloc / calloc / realloc made by the runtime
+    RONO_M_HEAP_BYTES,
+    RONO_M_OUT_LINES,       // lines printed
+    RONO_M_OUT_BYTES,
+    RONO_M_OUT_WRITES,      // writev calls on stdout
+    RONO_M_IN_LINES,        // lines read by con.in
+    RONO_M_IN_BYTES,
+    RONO_M_IN_READS,        // read calls on stdin
+    RONO_M_HTTP_BUFFERED,   // body bytes WriteCallback copied into response buffers
+    RONO_M_HTTP_GROWS,      // response buffer (re)allocations
+    RONO_M_COUNT
+};
+
+enum { RONO_HTTP_GET, RONO_HTTP_POST, RONO_HTTP_PUT, RONO_HTTP_DELETE, RONO_HTTP_OTHER, RONO_HTTP_METHODS };
+
+// Bucket i counts latencies in [2^i, 2^(i+1)) microseconds; the last one
+// everything slower
+#define RONO_METRICS_BUCKETS 32
+
+typedef struct {
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t connect_us;
+    uint64_t tls_us;
+    uint64_t transfer_us;
+    uint64_t latency[RONO_METRICS_BUCKETS];
+} RonoHttpMetrics;
+
+typedef struct RonoMetrics {
+    uint64_t counters[RONO_M_COUNT];
+    RonoHttpMetrics http[RONO_HTTP_METHODS];
+    struct RonoMetrics* next;
+} RonoMetrics;
+
+static RonoMetrics* rono_metrics_threads = NULL;
+static __thread RonoMetrics* rono_metrics_tls = NULL;
+
+// The calling thread's block, registered on first use. NULL only if the
+// block can't be allocated, and then nothing is counted for the thread.
+static RonoMetrics* rono_metrics_thread(void) {
+    RonoMetrics* metrics = rono_metrics_tls;
+    if (metrics != NULL) {
+        return metrics;
+    }
+    metrics = calloc(1, sizeof(RonoMetrics));
+    if (metrics == NULL) {
+        return NULL;
+    }
+    metrics->next = __atomic_load_n(&rono_metrics_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&rono_metrics_threads, &metrics->next, metrics, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    rono_metrics_tls = metrics;
+    return metrics;
 }
 
-void rono_print_float(double value) {
-    printf("%f\n", value);
+// Only the owning thread writes a counter, so no read-modify-write is
+// needed; the atomic accesses keep concurrent dumps from reading torn values
+static inline void rono_metrics_bump(uint64_t* counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
 }
 
-void rono_print_bool(int8_t value) {
-    printf("%s\n", value ? "true" : "false");
+static inline void rono_metrics_add(int counter, uint64_t n) {
+    RonoMetrics* metrics = rono_metrics_thread();
+    if (metrics != NULL) {
+        rono_metrics_bump(&metrics->counters[counter], n);
+    }
 }
 
-void rono_print_string(const char* str) {
-    if (str) {
-        printf("%s\n", str);
-    } else {
-        printf("(null)\n");
+#define RONO_METRIC_ADD(counter, n) rono_metrics_add(RONO_M_##counter, (uint64_t)(n))
+#define RONO_METRIC_HTTP(curl, method, data, result) rono_metrics_http((curl), (method), (data), (result))
+
+static void rono_metrics_http(CURL* curl, const char* method, const char* data, CURLcode result);
+#else
+#define RONO_METRIC_ADD(counter, n) ((void)0)
+#define RONO_METRIC_HTTP(curl, method, data, result) ((void)0)
+#endif
+
+// Runtime strings (rono_str). The character data is NUL-terminated and
+// preceded by a header holding its length and capacity, so compiled code
+// keeps passing a single pointer that is still a valid const char* for C,
+// while rono_str_len is O(1) and the data may contain NUL bytes. Literals
+// emitted by ir_gen carry a header with cap 0.
+typedef struct {
+    int64_t len;   // Bytes of data, excluding the terminating NUL
+    int64_t cap;   // Bytes available for data, 0 for literals
+} RonoStrHeader;
+
+#define RONO_STR_HEADER(s) ((RonoStrHeader*)((char*)(s) - sizeof(RonoStrHeader)))
+
+// Empty rono_str for runtime functions that have no data to return; unlike
+// a bare "" it carries a real header.
+static const struct {
+    RonoStrHeader header;
+    char data[1];
+} rono_str_empty = {{0, 0}, ""};
+
+int64_t rono_str_len(const char* s) {
+    return s != NULL ? RONO_STR_HEADER(s)->len : 0;
+}
+
+// Grow a malloc-owned rono_str (NULL for a new one) to hold cap bytes of
+// data. Returns the possibly moved string, or NULL when out of memory.
+static char* rono_str_heap_reserve(char* s, size_t cap) {
+    RonoStrHeader* header = s != NULL ? RONO_STR_HEADER(s) : NULL;
+    if (header != NULL && (size_t)header->cap >= cap) {
+        return s;
     }
+    header = realloc(header, sizeof(RonoStrHeader) + cap + 1);
+    if (header == NULL) {
+        return NULL;
+    }
+    RONO_METRIC_ADD(HEAP_ALLOCS, 1);
+    RONO_METRIC_ADD(HEAP_BYTES, sizeof(RonoStrHeader) + cap + 1);
+    if (s == NULL) {
+        header->len = 0;
+        ((char*)(header + 1))[0] = '\0';
+    }
+    header->cap = (int64_t)cap;
+    return (char*)(header + 1);
 }
 
-// String interpolation support
-void rono_print_interpolated(const char* format, int64_t value) {
-    // Simple implementation: replace {} with %lld
-    char* result = malloc(strlen(format) + 32); // Extra space for number
-    char* src = (char*)format;
-    char* dst = result;
-    
-    while (*src) {
-        if (*src == '{' && *(src + 1) == '}') {
-            // Replace {} with the value
-            dst += sprintf(dst, "%lld", (long long)value);
-            src += 2; // Skip {}
-        } else {
-            *dst++ = *src++;
-        }
+static void rono_str_heap_set_len(char* s, size_t len) {
+    RONO_STR_HEADER(s)->len = (int64_t)len;
+    s[len] = '\0';
+}
+
+static void rono_str_heap_free(char* s) {
+    if (s != NULL) {
+        free(RONO_STR_HEADER(s));
     }
-    *dst = '\0';
-    
-    printf("%s\n", result);
-    free(result);
 }
 
-// Formatted output with interpolation
-void rono_print_format_int(const char* format, int64_t value) {
-    if (format == NULL) {
-        // Default format for when we can't pass string constants yet
-        printf("%lld\n", (long long)value);
-    } else {
-        rono_print_interpolated(format, value);
+// Region allocator for strings handed to compiled code. Generated functions
+// enter a region on entry and leave it on every return, which releases all
+// runtime strings allocated while the function ran; a string the function
+// returns is first copied into the caller's region. Allocation is a pointer
+// bump into a per-thread chain of blocks.
+#define RONO_ARENA_BLOCK_SIZE (64 * 1024)
+#define RONO_ARENA_ALIGN 16
+
+typedef struct RonoArenaBlock {
+    struct RonoArenaBlock* prev;
+    size_t used;
+    size_t cap;
+    char data[];
+} RonoArenaBlock;
+
+typedef struct {
+    RonoArenaBlock* block;
+    size_t used;
+} RonoArenaMark;
+
+typedef struct {
+    RonoArenaBlock* top;      // Block allocations are bumped into
+    RonoArenaBlock* spare;    // Last released block, kept to avoid malloc churn
+    RonoArenaMark* marks;     // Where each open region started
+    int64_t depth;
+    int64_t marks_cap;
+} RonoArena;
+
+static __thread RonoArena rono_arena;
+
+void* rono_alloc(int64_t size) {
+    RonoArena* arena = &rono_arena;
+    size_t needed = size > 0 ? ((size_t)size + RONO_ARENA_ALIGN - 1) & ~(size_t)(RONO_ARENA_ALIGN - 1) : RONO_ARENA_ALIGN;
+    RONO_METRIC_ADD(REGION_ALLOCS, 1);
+    RONO_METRIC_ADD(REGION_BYTES, needed);
+
+    RonoArenaBlock* block = arena->top;
+    if (block == NULL || block->cap - block->used < needed) {
+        if (arena->spare != NULL && arena->spare->cap >= needed) {
+            block = arena->spare;
+            arena->spare = NULL;
+        } else {
+            size_t cap = needed > RONO_ARENA_BLOCK_SIZE ? needed : RONO_ARENA_BLOCK_SIZE;
+            block = malloc(sizeof(RonoArenaBlock) + cap);
+            if (block == NULL) {
+                return NULL;
+            }
+            RONO_METRIC_ADD(HEAP_ALLOCS, 1);
+            RONO_METRIC_ADD(HEAP_BYTES, sizeof(RonoArenaBlock) + cap);
+            block->cap = cap;
+        }
+        block->used = 0;
+        block->prev = arena->top;
+        arena->top = block;
     }
+
+    void* result = block->data + block->used;
+    block->used += needed;
+    return result;
 }
 
-// Console input functions
-char* rono_input_string() {
-    char* buffer = malloc(1024); // Allocate buffer for input
-    if (buffer == NULL) {
-        return NULL;
+// New rono_str of len bytes in the current region; the data is left for the
+// caller to fill, the terminating NUL is already in place
+char* rono_str_new(int64_t len) {
+    if (len < 0) {
+        len = 0;
     }
-    
-    if (fgets(buffer, 1024, stdin) != NULL) {
-        // Remove trailing newline if present
-        size_t len = strlen(buffer);
-        if (len > 0 && buffer[len - 1] == '\n') {
-            buffer[len - 1] = '\0';
-        }
-        return buffer;
-    } else {
-        free(buffer);
+    RonoStrHeader* header = rono_alloc((int64_t)sizeof(RonoStrHeader) + len + 1);
+    if (header == NULL) {
         return NULL;
     }
+    header->len = len;
+    header->cap = len;
+    char* data = (char*)(header + 1);
+    data[len] = '\0';
+    return data;
 }
 
-int64_t rono_input_int() {
-    char* input = rono_input_string();
-    if (input == NULL) {
-        return 0;
+// Copy len bytes into the current region as a rono_str
+char* rono_alloc_string(const char* data, int64_t len) {
+    char* result = rono_str_new(len);
+    if (result != NULL && len > 0) {
+        memmove(result, data, (size_t)len);
     }
-    
-    int64_t result = strtoll(input, NULL, 10);
-    free(input);
     return result;
 }
 
-double rono_input_float() {
-    char* input = rono_input_string();
-    if (input == NULL) {
-        return 0.0;
+// a + b as a new string in the current region
+char* rono_str_concat(const char* a, const char* b) {
+    int64_t a_len = rono_str_len(a);
+    int64_t b_len = rono_str_len(b);
+    char* result = rono_str_new(a_len + b_len);
+    if (result != NULL) {
+        if (a_len > 0) {
+            memcpy(result, a, (size_t)a_len);
+        }
+        if (b_len > 0) {
+            memcpy(result + a_len, b, (size_t)b_len);
+        }
     }
-    
-    double result = strtod(input, NULL);
-    free(input);
     return result;
 }
 
-int8_t rono_input_bool() {
-    char* input = rono_input_string();
-    if (input == NULL) {
+int8_t rono_str_eq(const char* a, const char* b) {
+    int64_t len = rono_str_len(a);
+    if (len != rono_str_len(b)) {
         return 0;
     }
-    
-    int8_t result = 0;
-    if (strcmp(input, "true") == 0 || strcmp(input, "1") == 0) {
-        result = 1;
-    } else if (strcmp(input, "false") == 0 || strcmp(input, "0") == 0) {
-        result = 0;
-    }
-    
-    free(input);
-    return result;
+    return len == 0 || a == b || memcmp(a, b, (size_t)len) == 0;
 }
 
-// Random number generation functions
-static int rono_rand_initialized = 0;
-
-void rono_rand_init() {
-    if (!rono_rand_initialized) {
-        srand((unsigned int)time(NULL));
-        rono_rand_initialized = 1;
+// Open a region. Returns its handle for rono_region_leave.
+int64_t rono_region_enter(void) {
+    RonoArena* arena = &rono_arena;
+    if (arena->depth == arena->marks_cap) {
+        int64_t new_cap = arena->marks_cap > 0 ? arena->marks_cap * 2 : 64;
+        RonoArenaMark* marks = realloc(arena->marks, (size_t)new_cap * sizeof(RonoArenaMark));
+        if (marks == NULL) {
+            return 0;
+        }
+        arena->marks = marks;
+        arena->marks_cap = new_cap;
     }
+
+    RonoArenaMark* mark = &arena->marks[arena->depth++];
+    mark->block = arena->top;
+    mark->used = arena->top != NULL ? arena->top->used : 0;
+    return arena->depth;
 }
 
-int64_t rono_rand_int(int64_t min, int64_t max) {
-    rono_rand_init();
-    
-    if (min > max) {
-        // Swap if min > max
-        int64_t temp = min;
-        min = max;
-        max = temp;
+// Roll the arena back to where region started (closing any regions nested
+// in it). Blocks past the mark are returned as a list for the caller to
+// recycle, so data in them stays readable until then.
+static RonoArenaBlock* rono_region_rewind(int64_t region) {
+    RonoArena* arena = &rono_arena;
+    if (region < 1 || region > arena->depth) {
+        return NULL;
     }
-    
-    if (min == max) {
-        return min;
+
+    RonoArenaMark mark = arena->marks[region - 1];
+    arena->depth = region - 1;
+
+    RonoArenaBlock* released = NULL;
+    while (arena->top != mark.block) {
+        RonoArenaBlock* block = arena->top;
+        arena->top = block->prev;
+        block->prev = released;
+        released = block;
     }
-    
-    // Generate random number in range [min, max]
-    int64_t range = max - min + 1;
-    return min + (rand() % range);
+    if (arena->top != NULL) {
+        arena->top->used = mark.used;
+    }
+    return released;
 }
 
-double rono_rand_float(double min, double max) {
-    rono_rand_init();
-    
-    if (min > max) {
-        // Swap if min > max
-        double temp = min;
-        min = max;
-        max = temp;
+static void rono_region_recycle(RonoArenaBlock* released) {
+    RonoArena* arena = &rono_arena;
+    while (released != NULL) {
+        RonoArenaBlock* next = released->prev;
+        if (arena->spare == NULL && released->cap == RONO_ARENA_BLOCK_SIZE) {
+            arena->spare = released;
+        } else {
+            free(released);
+        }
+        released = next;
     }
-    
-    if (min == max) {
-        return min;
+}
+
+// Release everything allocated since rono_region_enter returned region
+void rono_region_leave(int64_t region) {
+    rono_region_recycle(rono_region_rewind(region));
+}
+
+// Copy of s in the current region
+char* rono_str_copy(const char* s) {
+    return s != NULL ? rono_alloc_string(s, rono_str_len(s)) : NULL;
+}
+
+// Leave region and copy the returned string into the enclosing region
+char* rono_region_leave_str(int64_t region, const char* value) {
+    RonoArenaBlock* released = rono_region_rewind(region);
+    char* result = rono_str_copy(value);
+    rono_region_recycle(released);
+    return result;
+}
+
+// Leave region like rono_region_leave, but keep its memory readable until
+// rono_region_release, so a returned struct and the strings it refers to
+// can be copied into the enclosing region first (see ir_gen.rs)
+int64_t rono_region_pop(int64_t region) {
+    return (int64_t)(intptr_t)rono_region_rewind(region);
+}
+
+void rono_region_release(int64_t released) {
+    rono_region_recycle((RonoArenaBlock*)(intptr_t)released);
+}
+
+// Buffered console output. All rono_print_* functions append to one
+// runtime-owned buffer that is written with writev when full, on rono_flush
+// and at exit. When stdout is a terminal the buffer is also flushed after
+// every line so interactive output shows up immediately.
+#define RONO_OUT_DEFAULT_SIZE (64 * 1024)
+
+static char* rono_out_buf = NULL;
+static size_t rono_out_len = 0;
+static size_t rono_out_cap = 0;
+static int rono_out_line_flush = 0;
+static int rono_out_ready = 0;
+static pthread_mutex_t rono_out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void rono_flush(void);
+
+// Write every iovec fully, retrying on short writes and EINTR
+static void rono_out_writev(struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(STDOUT_FILENO, iov, count);
+        RONO_METRIC_ADD(OUT_WRITES, 1);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // Nothing sensible to do if stdout is gone
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
     }
-    
-    // Generate random float in range [min, max)
-    double range = max - min;
-    return min + ((double)rand() / RAND_MAX) * range;
 }
 
-char* rono_rand_string(int64_t length) {
-    rono_rand_init();
-    
-    if (length <= 0) {
-        char* empty = malloc(1);
-        if (empty) empty[0] = '\0';
-        return empty;
+// Lazy setup, called with rono_out_lock held
+static void rono_out_init(void) {
+    if (rono_out_ready) {
+        return;
     }
-    
-    char* result = malloc(length + 1);
-    if (!result) {
-        return NULL;
+    rono_out_ready = 1;
+
+    size_t size = RONO_OUT_DEFAULT_SIZE;
+    const char* env_size = getenv("RONO_OUTPUT_BUFFER");
+    if (env_size && *env_size) {
+        long long value = strtoll(env_size, NULL, 10);
+        if (value >= 0) {
+            size = (size_t)value;
+        }
     }
-    
-    const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-    const int charset_size = sizeof(charset) - 1;
-    
-    for (int64_t i = 0; i < length; i++) {
-        result[i] = charset[rand() % charset_size];
+    rono_out_cap = size;
+    rono_out_buf = size ? malloc(size) : NULL;
+    if (rono_out_buf == NULL) {
+        rono_out_cap = 0; // Unbuffered
     }
-    result[length] = '\0';
-    
-    return result;
+    rono_out_line_flush = isatty(STDOUT_FILENO);
+    atexit(rono_flush);
 }
 
-// Generate random character in range (simplified implementation)
-char* rono_rand_char_range(const char* from, const char* to) {
-    rono_rand_init();
-    
-    if (!from || !to || strlen(from) == 0 || strlen(to) == 0) {
-        char* result = malloc(2);
-        if (result) {
-            result[0] = 'a';
-            result[1] = '\0';
+// Called with rono_out_lock held. Pending bytes and data go out in a single
+// writev when data doesn't fit into the buffer.
+static void rono_out_append(const char* data, size_t len) {
+    rono_out_init();
+    RONO_METRIC_ADD(OUT_BYTES, len);
+
+    if (rono_out_len + len <= rono_out_cap) {
+        memcpy(rono_out_buf + rono_out_len, data, len);
+        rono_out_len += len;
+    } else {
+        struct iovec iov[2];
+        int count = 0;
+        if (rono_out_len > 0) {
+            iov[count].iov_base = rono_out_buf;
+            iov[count].iov_len = rono_out_len;
+            count++;
         }
-        return result;
+        iov[count].iov_base = (void*)data;
+        iov[count].iov_len = len;
+        count++;
+        rono_out_writev(iov, count);
+        rono_out_len = 0;
     }
-    
-    char from_char = from[0];
-    char to_char = to[0];
-    
-    if (from_char > to_char) {
-        // Swap if from > to
-        char temp = from_char;
-        from_char = to_char;
-        to_char = temp;
+}
+
+// Called with rono_out_lock held, after a complete line was appended
+static void rono_out_end_line(void) {
+    RONO_METRIC_ADD(OUT_LINES, 1);
+    if (rono_out_line_flush && rono_out_len > 0) {
+        struct iovec iov = { rono_out_buf, rono_out_len };
+        rono_out_writev(&iov, 1);
+        rono_out_len = 0;
     }
-    
-    char* result = malloc(2);
-    if (!result) {
-        return NULL;
+}
+
+// Append one output line (text followed by a newline)
+// Also called by compiled code, which formats integers inline
+void rono_out_line(const char* text, size_t len) {
+    pthread_mutex_lock(&rono_out_lock);
+    rono_out_append(text, len);
+    rono_out_append("\n", 1);
+    rono_out_end_line();
+    pthread_mutex_unlock(&rono_out_lock);
+}
+
+// Write out everything buffered so far
+void rono_flush(void) {
+    pthread_mutex_lock(&rono_out_lock);
+    if (rono_out_len > 0) {
+        struct iovec iov = { rono_out_buf, rono_out_len };
+        rono_out_writev(&iov, 1);
+        rono_out_len = 0;
     }
-    
-    // Generate random character in range [from_char, to_char]
-    int range = to_char - from_char + 1;
-    result[0] = from_char + (rand() % range);
-    result[1] = '\0';
-    
-    return result;
+    pthread_mutex_unlock(&rono_out_lock);
 }
 
-// HTTP response structure
-typedef struct {
-    char* data;
-    size_t size;
-} HttpResponse;
+// Resize the output buffer (0 = unbuffered) and choose line flushing:
+// line_flush < 0 flushes per line only on a TTY, 0 never, > 0 always
+void rono_output_configure(int64_t buffer_size, int64_t line_flush) {
+    rono_flush();
 
-// Callback function for writing HTTP response data
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, HttpResponse* response) {
-    size_t realsize = size * nmemb;
-    char* ptr = realloc(response->data, response->size + realsize + 1);
-    
-    if (ptr == NULL) {
-        // Out of memory
-        return 0;
+    pthread_mutex_lock(&rono_out_lock);
+    rono_out_init();
+    if (buffer_size >= 0 && (size_t)buffer_size != rono_out_cap) {
+        char* buffer = buffer_size ? realloc(rono_out_buf, (size_t)buffer_size) : NULL;
+        if (buffer_size == 0) {
+            free(rono_out_buf);
+        }
+        if (buffer || buffer_size == 0) {
+            rono_out_buf = buffer;
+            rono_out_cap = (size_t)buffer_size;
+        }
     }
-    
-    response->data = ptr;
-    memcpy(&(response->data[response->size]), contents, realsize);
-    response->size += realsize;
-    response->data[response->size] = 0; // Null terminate
-    
-    return realsize;
+    rono_out_line_flush = line_flush < 0 ? isatty(STDOUT_FILENO) : line_flush > 0;
+    pthread_mutex_unlock(&rono_out_lock);
 }
 
-// Initialize curl (called once)
-static int curl_initialized = 0;
+// Hand-rolled number formatting, used instead of printf on the output
+// paths. Callers provide at least RONO_NUMBER_MAX bytes: floats print
+// without an exponent, so the smallest subnormal takes 2 + 323 zeros + 17
+// digits and a sign.
+#define RONO_NUMBER_MAX 352
 
-void rono_http_init() {
-    if (!curl_initialized) {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl_initialized = 1;
+static const double rono_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static size_t rono_format_uint(uint64_t value, char* out) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (size_t i = 0; i < count; i++) {
+        out[i] = digits[count - 1 - i];
     }
+    return count;
 }
 
-// HTTP GET function
-char* rono_http_get(const char* url) {
-    rono_http_init();
-    
-    CURL* curl;
-    CURLcode res;
-    HttpResponse response = {0};
-    
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Rono-HTTP/1.0");
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L); // 30 second timeout
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            if (response.data) {
-                free(response.data);
-            }
-            return NULL;
-        }
+static size_t rono_format_int(int64_t value, char* out) {
+    if (value < 0) {
+        out[0] = '-';
+        return 1 + rono_format_uint((uint64_t)0 - (uint64_t)value, out + 1);
     }
-    
-    return response.data; // Caller must free this
+    return rono_format_uint((uint64_t)value, out);
 }
 
-// HTTP POST function
-char* rono_http_post(const char* url, const char* data) {
-    rono_http_init();
-    
-    CURL* curl;
-    CURLcode res;
-    HttpResponse response = {0};
-    
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Rono-HTTP/1.0");
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            if (response.data) {
-                free(response.data);
-            }
-            return NULL;
+// Digits of printf's "d.ddde±x" without the point, and the exponent
+static int rono_scientific_digits(const char* scientific, char* digits, int* exponent) {
+    int count = 0;
+    const char* p = scientific;
+    for (; *p != 'e'; p++) {
+        if (*p != '.') {
+            digits[count++] = *p;
         }
     }
-    
-    return response.data; // Caller must free this
+    *exponent = atoi(p + 1);
+    return count;
 }
 
-// HTTP PUT function
-char* rono_http_put(const char* url, const char* data) {
-    rono_http_init();
-    
-    CURL* curl;
-    CURLcode res;
-    HttpResponse response = {0};
-    
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Rono-HTTP/1.0");
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            if (response.data) {
-                free(response.data);
-            }
-            return NULL;
+// Whether value lies exactly halfway between two decimals of `precision`
+// significant digits: its exact expansion is those digits, left in digits,
+// and a 5
+static int rono_float_is_tie(double value, int precision, char* digits, int* exponent) {
+    char scientific[40];
+    snprintf(scientific, sizeof(scientific), "%.*e", precision, value);
+    int count = rono_scientific_digits(scientific, digits, exponent);
+    if (digits[count - 1] != '5') {
+        return 0;
+    }
+    uint64_t n = 0;
+    for (int i = 0; i < count; i++) {
+        n = n * 10 + (uint64_t)(digits[i] - '0');
+    }
+    // The tie is n * 10^-scale = n * 5^-scale * 2^-scale
+    int scale = precision - *exponent;
+    for (int i = 0; i < scale; i++) {
+        if (n % 5 != 0) {
+            return 0;
         }
+        n /= 5;
     }
-    
-    return response.data; // Caller must free this
+    for (int i = scale; i < 0; i++) {
+        if (n > UINT64_MAX / 5) {
+            return 0;
+        }
+        n *= 5;
+    }
+    // A hex float reads back exactly when it is representable
+    char binary[40];
+    snprintf(binary, sizeof(binary), "0x%llxp%d", (unsigned long long)n, -scale);
+    return n < (1ULL << 53) && strtod(binary, NULL) == value;
 }
 
-// HTTP DELETE function
-char* rono_http_delete(const char* url) {
-    rono_http_init();
-    
-    CURL* curl;
-    CURLcode res;
-    HttpResponse response = {0};
-    
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Rono-HTTP/1.0");
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            if (response.data) {
-                free(response.data);
-            }
-            return NULL;
+// Prints like the interpreter, which uses Rust's `{}`: the shortest digits
+// that read back as the same double, the upper one of two equally close
+// candidates, written out in full without an exponent
+// (0.30000000000000004, 100000000000000020, 0.00000000000000000001),
+// integral values without a fractional part, "NaN" / "inf". Integral values
+// below 2^53 are their own shortest digits. Otherwise printf rounds to 15,
+// 16 and then 17 significant digits until strtod gives the value back. Any
+// decimal of up to 15 digits survives a trip through a normal double, so a
+// shorter one that reads back shows up as trailing zeros of the 15-digit
+// form; subnormals have less precision and start from one digit.
+static size_t rono_format_float(double value, char* out) {
+    size_t len = 0;
+    if (value != value) {
+        memcpy(out, "NaN", 3);
+        return 3;
+    }
+    if (value < 0 || (value == 0 && 1 / value < 0)) {
+        out[len++] = '-';
+        value = -value;
+    }
+    if (value > 1.7976931348623157e308) {
+        memcpy(out + len, "inf", 3);
+        return len + 3;
+    }
+    if (value < 9007199254740992.0 && value == (double)(uint64_t)value) {
+        return len + rono_format_uint((uint64_t)value, out + len);
+    }
+
+    char scientific[40];
+    int precision = value < 2.2250738585072014e-308 ? 1 : 15;
+    for (;; precision++) {
+        snprintf(scientific, sizeof(scientific), "%.*e", precision - 1, value);
+        if (precision == 17 || strtod(scientific, NULL) == value) {
+            break;
         }
     }
-    
-    return response.data; // Caller must free this
-}
\ No newline at end of file
+    char digits[20];
+    int exponent;
+    int count = rono_scientific_digits(scientific, digits, &exponent);
+    char up[20];
+    int up_exponent;
+    if (rono_float_is_tie(value, precision, up, &up_exponent)) {
+        // printf rounds a tie to even; take the upper candidate if it reads
+        // back as well
+        int i = count - 1;
+        while (i >= 0 && up[i] == '9') {
+            up[i--] = '0';
+        }
+        if (i >= 0) {
+            up[i]++;
+        } else {
+            up[0] = '1';
+            up_exponent++;
+        }
+        snprintf(scientific, sizeof(scientific), "%c.%.*se%d", up[0], count - 1, up + 1, up_exponent);
+        if (strtod(scientific, NULL) == value) {
+            memcpy(digits, up, (size_t)count);
+            exponent = up_exponent;
+        }
+    }
+    while (count > 1 && digits[count - 1] == '0') {
+        count--;
+    }
+
+    if (exponent < 0) {
+        // 0.000ddd
+        out[len++] = '0';
+        out[len++] = '.';
+        memset(out + len, '0', (size_t)(-exponent - 1));
+        len += (size_t)(-exponent - 1);
+        memcpy(out + len, digits, (size_t)count);
+        return len + (size_t)count;
+    }
+    if (exponent >= count - 1) {
+        // ddd000
+        memcpy(out + len, digits, (size_t)count);
+        len += (size_t)count;
+        memset(out + len, '0', (size_t)(exponent - count + 1));
+        return len + (size_t)(exponent - count + 1);
+    }
+    // dd.ddd
+    memcpy(out + len, digits, (size_t)exponent + 1);
+    len += (size_t)exponent + 1;
+    out[len++] = '.';
+    memcpy(out + len, digits + exponent + 1, (size_t)(count - exponent - 1));
+    return len + (size_t)(count - exponent - 1);
+}
+
+// Runtime function for console output
+void rono_print_int(int64_t value) {
+    char text[RONO_NUMBER_MAX];
+    rono_out_line(text, rono_format_int(value, text));
+}
+
+void rono_print_float(double value) {
+    char text[RONO_NUMBER_MAX];
+    rono_out_line(text, rono_format_float(value, text));
+}
+
+void rono_print_bool(int8_t value) {
+    if (value) {
+        rono_out_line("true", 4);
+    } else {
+        rono_out_line("false", 5);
+    }
+}
+
+void rono_print_string(const char* str) {
+    if (str) {
+        rono_out_line(str, (size_t)rono_str_len(str));
+    } else {
+        rono_out_line("(null)", 6);
+    }
+}
+
+// Precompiled interpolation templates. ir_gen parses an interpolated string
+// once at compile time into a read-only byte program:
+//   RONO_TPL_LIT <u32 little-endian length> <bytes>   literal segment
+//   RONO_TPL_INT / _FLOAT / _BOOL / _STR              typed hole
+//   RONO_TPL_END
+// Hole values are passed as an array of 8-byte slots in hole order.
+#define RONO_TPL_END 0
+#define RONO_TPL_LIT 1
+#define RONO_TPL_INT 2
+#define RONO_TPL_FLOAT 3
+#define RONO_TPL_BOOL 4
+#define RONO_TPL_STR 5
+
+// Render a template as one output line, directly into the output buffer
+void rono_print_template(const uint8_t* template, const int64_t* args) {
+    char number[RONO_NUMBER_MAX];
+    const uint8_t* op = template;
+    size_t arg = 0;
+
+    pthread_mutex_lock(&rono_out_lock);
+    for (;;) {
+        switch (*op++) {
+            case RONO_TPL_LIT: {
+                uint32_t len = (uint32_t)op[0] | (uint32_t)op[1] << 8 | (uint32_t)op[2] << 16 | (uint32_t)op[3] << 24;
+                op += 4;
+                rono_out_append((const char*)op, len);
+                op += len;
+                break;
+            }
+            case RONO_TPL_INT:
+                rono_out_append(number, rono_format_int(args[arg++], number));
+                break;
+            case RONO_TPL_FLOAT: {
+                double value;
+                memcpy(&value, &args[arg++], sizeof(value));
+                rono_out_append(number, rono_format_float(value, number));
+                break;
+            }
+            case RONO_TPL_BOOL: {
+                int8_t value;
+                memcpy(&value, &args[arg++], sizeof(value));
+                if (value) {
+                    rono_out_append("true", 4);
+                } else {
+                    rono_out_append("false", 5);
+                }
+                break;
+            }
+            case RONO_TPL_STR: {
+                const char* str = (const char*)(intptr_t)args[arg++];
+                if (str) {
+                    rono_out_append(str, (size_t)rono_str_len(str));
+                } else {
+                    rono_out_append("(null)", 6);
+                }
+                break;
+            }
+            default:
+                // RONO_TPL_END (or a corrupt template)
+                rono_out_append("\n", 1);
+                rono_out_end_line();
+                pthread_mutex_unlock(&rono_out_lock);
+                return;
+        }
+    }
+}
+
+// String interpolation support: replaces every {} in format with value.
+// Kept for compatibility, compiled code uses rono_print_template.
+void rono_print_interpolated(const char* format, int64_t value) {
+    char number[RONO_NUMBER_MAX];
+    size_t number_len = rono_format_int(value, number);
+    const char* segment = format;
+
+    pthread_mutex_lock(&rono_out_lock);
+    for (const char* src = format; *src; src++) {
+        if (src[0] == '{' && src[1] == '}') {
+            rono_out_append(segment, (size_t)(src - segment));
+            rono_out_append(number, number_len);
+            src++;
+            segment = src + 1;
+        }
+    }
+    rono_out_append(segment, strlen(segment));
+    rono_out_append("\n", 1);
+    rono_out_end_line();
+    pthread_mutex_unlock(&rono_out_lock);
+}
+
+// Formatted output with interpolation
+void rono_print_format_int(const char* format, int64_t value) {
+    if (format == NULL) {
+        // Default format for when we can't pass string constants yet
+        rono_print_int(value);
+    } else {
+        rono_print_interpolated(format, value);
+    }
+}
+
+// Collections backing list and map values in compiled code. Every element,
+// key and value is one 8-byte slot: integers and pointers as they are,
+// floats by their bits, bools as 0/1. Lists and maps are handles whose
+// address stays the same when they grow, so copies of a list variable and
+// lists passed to functions keep seeing the same collection. They are
+// heap-allocated and live until the program exits. Strings stored in them
+// are copied out of the caller's region unless they are literals; structs
+// are copied to the heap by compiled code before they are stored.
+#define RONO_ELEM_VALUE 0
+#define RONO_ELEM_STR 1
+
+// Report an out-of-range list index the way the interpreter does and exit
+void rono_index_error(int64_t index, int64_t len) {
+    rono_flush();
+    fprintf(stderr, "Runtime error: Index %lld out of bounds for list of length %lld\n", (long long)index, (long long)len);
+    exit(1);
+}
+
+static void rono_collection_oom(void) {
+    rono_flush();
+    fprintf(stderr, "Runtime error: out of memory\n");
+    exit(1);
+}
+
+// Zeroed block for a fixed-size array (dimension header followed by the
+// elements, laid out by ir_gen.rs) that does not fit in or outlives its
+// function's stack frame
+void* rono_array_new(int64_t size) {
+    void* array = calloc(1, size > 0 ? (size_t)size : 1);
+    if (array == NULL) {
+        rono_collection_oom();
+    }
+    RONO_METRIC_ADD(HEAP_ALLOCS, 1);
+    RONO_METRIC_ADD(HEAP_BYTES, size > 0 ? (size_t)size : 1);
+    return array;
+}
+
+// Heap copy of a string that has to outlive the current region. Literals
+// (cap 0) already live for the whole program; an empty region string has
+// cap 0 too, so those are copied as well. Compiled code calls it for
+// strings stored into arrays and list slots directly.
+int64_t rono_str_persist(int64_t value) {
+    const char* s = (const char*)(intptr_t)value;
+    if (s == NULL || (RONO_STR_HEADER(s)->cap == 0 && RONO_STR_HEADER(s)->len > 0)) {
+        return value;
+    }
+    size_t len = (size_t)rono_str_len(s);
+    char* copy = rono_str_heap_reserve(NULL, len);
+    if (copy == NULL) {
+        rono_collection_oom();
+    }
+    memcpy(copy, s, len);
+    rono_str_heap_set_len(copy, len);
+    return (int64_t)(intptr_t)copy;
+}
+
+// Growable vector. Compiled code reads len and items directly for
+// indexing, so the field order is part of the ABI (see ir_gen.rs).
+typedef struct {
+    int64_t len;
+    int64_t cap;
+    int64_t* items;
+    int64_t kind;   // RONO_ELEM_*
+} RonoList;
+
+static void rono_list_reserve(RonoList* list, int64_t needed) {
+    if (needed <= list->cap) {
+        return;
+    }
+    int64_t cap = list->cap > 0 ? list->cap : 8;
+    while (cap < needed) {
+        cap *= 2;
+    }
+    int64_t* items = realloc(list->items, (size_t)cap * sizeof(int64_t));
+    if (items == NULL) {
+        rono_collection_oom();
+    }
+    RONO_METRIC_ADD(HEAP_ALLOCS, 1);
+    RONO_METRIC_ADD(HEAP_BYTES, (size_t)cap * sizeof(int64_t));
+    list->items = items;
+    list->cap = cap;
+}
+
+RonoList* rono_list_new(int64_t kind, int64_t capacity) {
+    RonoList* list = calloc(1, sizeof(RonoList));
+    if (list == NULL) {
+        rono_collection_oom();
+    }
+    RONO_METRIC_ADD(HEAP_ALLOCS, 1);
+    RONO_METRIC_ADD(HEAP_BYTES, sizeof(RonoList));
+    list->kind = kind;
+    rono_list_reserve(list, capacity);
+    return list;
+}
+
+int64_t rono_list_len(const RonoList* list) {
+    return list != NULL ? list->len : 0;
+}
+
+int64_t rono_list_get(const RonoList* list, int64_t index) {
+    int64_t len = rono_list_len(list);
+    if ((uint64_t)index >= (uint64_t)len) {
+        rono_index_error(index, len);
+    }
+    return list->items[index];
+}
+
+void rono_list_push(RonoList* list, int64_t value) {
+    if (list->kind == RONO_ELEM_STR) {
+        value = rono_str_persist(value);
+    }
+    rono_list_reserve(list, list->len + 1);
+    list->items[list->len++] = value;
+}
+
+// list.addAt(value, index): index may be len, which appends
+void rono_list_insert(RonoList* list, int64_t value, int64_t index) {
+    if ((uint64_t)index > (uint64_t)list->len) {
+        rono_index_error(index, list->len);
+    }
+    if (list->kind == RONO_ELEM_STR) {
+        value = rono_str_persist(value);
+    }
+    rono_list_reserve(list, list->len + 1);
+    memmove(&list->items[index + 1], &list->items[index], (size_t)(list->len - index) * sizeof(int64_t));
+    list->items[index] = value;
+    list->len++;
+}
+
+void rono_list_remove(RonoList* list, int64_t index) {
+    if ((uint64_t)index >= (uint64_t)list->len) {
+        rono_index_error(index, list->len);
+    }
+    memmove(&list->items[index], &list->items[index + 1], (size_t)(list->len - index - 1) * sizeof(int64_t));
+    list->len--;
+}
+
+// `con.out(list)`: "[1, 2, 3]" like the interpreter. elem_type is one of
+// the RONO_TPL_* hole types.
+void rono_print_list(const RonoList* list, int64_t elem_type) {
+    char number[RONO_NUMBER_MAX];
+    int64_t len = rono_list_len(list);
+
+    pthread_mutex_lock(&rono_out_lock);
+    rono_out_append("[", 1);
+    for (int64_t i = 0; i < len; i++) {
+        if (i > 0) {
+            rono_out_append(", ", 2);
+        }
+        int64_t slot = list->items[i];
+        switch (elem_type) {
+            case RONO_TPL_FLOAT: {
+                double value;
+                memcpy(&value, &slot, sizeof(value));
+                rono_out_append(number, rono_format_float(value, number));
+                break;
+            }
+            case RONO_TPL_BOOL:
+                if (slot & 0xff) {
+                    rono_out_append("true", 4);
+                } else {
+                    rono_out_append("false", 5);
+                }
+                break;
+            case RONO_TPL_STR:
+                if (slot != 0) {
+                    rono_out_append((const char*)(intptr_t)slot, (size_t)rono_str_len((const char*)(intptr_t)slot));
+                }
+                break;
+            default:
+                rono_out_append(number, rono_format_int(slot, number));
+                break;
+        }
+    }
+    rono_out_append("]\n", 2);
+    rono_out_end_line();
+    pthread_mutex_unlock(&rono_out_lock);
+}
+
+// wyhash (final version 4, public domain by Wang Yi), used for map keys
+static const uint64_t rono_wyp[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+static inline void rono_wymum(uint64_t* a, uint64_t* b) {
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t rono_wymix(uint64_t a, uint64_t b) {
+    rono_wymum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t rono_wyr8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t rono_wyr4(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t rono_wyr3(const uint8_t* p, size_t k) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+static uint64_t rono_wyhash(const void* key, size_t len, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)key;
+    seed ^= rono_wymix(seed ^ rono_wyp[0], rono_wyp[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (rono_wyr4(p) << 32) | rono_wyr4(p + ((len >> 3) << 2));
+            b = (rono_wyr4(p + len - 4) << 32) | rono_wyr4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = rono_wyr3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i >= 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = rono_wymix(rono_wyr8(p) ^ rono_wyp[1], rono_wyr8(p + 8) ^ seed);
+                see1 = rono_wymix(rono_wyr8(p + 16) ^ rono_wyp[2], rono_wyr8(p + 24) ^ see1);
+                see2 = rono_wymix(rono_wyr8(p + 32) ^ rono_wyp[3], rono_wyr8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = rono_wymix(rono_wyr8(p) ^ rono_wyp[1], rono_wyr8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = rono_wyr8(p + i - 16);
+        b = rono_wyr8(p + i - 8);
+    }
+    a ^= rono_wyp[1];
+    b ^= seed;
+    rono_wymum(&a, &b);
+    return rono_wymix(a ^ rono_wyp[0] ^ len, b ^ rono_wyp[1]);
+}
+
+// Open-addressing hash map in the style of SwissTable. Slots are split
+// into groups of 16 with one control byte each: EMPTY, DELETED, or the
+// low 7 bits of the key's hash for a full slot. A lookup probes whole
+// groups, comparing all 16 control bytes against the hash at once (SSE2
+// where available) and only then comparing keys. Keys are integers or
+// strings (RONO_ELEM_*); string keys are copied into the map.
+#define RONO_MAP_GROUP 16
+#define RONO_MAP_EMPTY ((uint8_t)0x80)
+#define RONO_MAP_DELETED ((uint8_t)0xFE)
+
+typedef struct {
+    int64_t len;
+    int64_t cap;         // Slots, a power of two and a multiple of RONO_MAP_GROUP
+    int64_t tombstones;
+    int64_t key_kind;    // RONO_ELEM_*
+    int64_t value_kind;  // RONO_ELEM_*
+    uint8_t* ctrl;
+    int64_t* keys;
+    int64_t* values;
+} RonoMap;
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+// Bit i set where ctrl[i] == byte
+static inline uint32_t rono_map_group_match(const uint8_t* ctrl, uint8_t byte) {
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+}
+#else
+static inline uint32_t rono_map_group_match(const uint8_t* ctrl, uint8_t byte) {
+    uint32_t mask = 0;
+    for (int i = 0; i < RONO_MAP_GROUP; i++) {
+        mask |= (uint32_t)(ctrl[i] == byte) << i;
+    }
+    return mask;
+}
+#endif
+
+static uint64_t rono_map_hash(const RonoMap* map, int64_t key) {
+    if (map->key_kind == RONO_ELEM_STR) {
+        const char* s = (const char*)(intptr_t)key;
+        return rono_wyhash(s != NULL ? s : "", (size_t)rono_str_len(s), 0);
+    }
+    return rono_wymix((uint64_t)key ^ rono_wyp[0], rono_wyp[1]);
+}
+
+static int rono_map_key_eq(const RonoMap* map, int64_t a, int64_t b) {
+    if (map->key_kind == RONO_ELEM_STR) {
+        return rono_str_eq((const char*)(intptr_t)a, (const char*)(intptr_t)b);
+    }
+    return a == b;
+}
+
+static void rono_map_alloc(RonoMap* map, int64_t cap) {
+    map->ctrl = malloc((size_t)cap);
+    map->keys = malloc((size_t)cap * sizeof(int64_t));
+    map->values = malloc((size_t)cap * sizeof(int64_t));
+    if (map->ctrl == NULL || map->keys == NULL || map->values == NULL) {
+        rono_collection_oom();
+    }
+    RONO_METRIC_ADD(HEAP_ALLOCS, 3);
+    RONO_METRIC_ADD(HEAP_BYTES, (size_t)cap * (1 + 2 * sizeof(int64_t)));
+    memset(map->ctrl, RONO_MAP_EMPTY, (size_t)cap);
+    map->cap = cap;
+    map->len = 0;
+    map->tombstones = 0;
+}
+
+// Slot holding key, or -1. Groups are probed with triangular steps, which
+// visit every group of a power-of-two table.
+static int64_t rono_map_find(const RonoMap* map, int64_t key, uint64_t hash) {
+    int64_t groups = map->cap / RONO_MAP_GROUP;
+    int64_t group = (int64_t)(hash >> 7) & (groups - 1);
+    uint8_t h2 = (uint8_t)(hash & 0x7f);
+    for (int64_t step = 1; step <= groups; step++) {
+        const uint8_t* ctrl = map->ctrl + group * RONO_MAP_GROUP;
+        for (uint32_t match = rono_map_group_match(ctrl, h2); match != 0; match &= match - 1) {
+            int64_t slot = group * RONO_MAP_GROUP + __builtin_ctz(match);
+            if (rono_map_key_eq(map, map->keys[slot], key)) {
+                return slot;
+            }
+        }
+        if (rono_map_group_match(ctrl, RONO_MAP_EMPTY) != 0) {
+            return -1;
+        }
+        group = (group + step) & (groups - 1);
+    }
+    return -1;
+}
+
+// First empty or deleted slot on key's probe sequence; the table always
+// has one because it is kept at most 7/8 full
+static int64_t rono_map_free_slot(const RonoMap* map, uint64_t hash) {
+    int64_t groups = map->cap / RONO_MAP_GROUP;
+    int64_t group = (int64_t)(hash >> 7) & (groups - 1);
+    for (int64_t step = 1;; step++) {
+        const uint8_t* ctrl = map->ctrl + group * RONO_MAP_GROUP;
+        uint32_t free_slots = rono_map_group_match(ctrl, RONO_MAP_EMPTY) | rono_map_group_match(ctrl, RONO_MAP_DELETED);
+        if (free_slots != 0) {
+            return group * RONO_MAP_GROUP + __builtin_ctz(free_slots);
+        }
+        group = (group + step) & (groups - 1);
+    }
+}
+
+static void rono_map_place(RonoMap* map, int64_t key, int64_t value, uint64_t hash) {
+    int64_t slot = rono_map_free_slot(map, hash);
+    if (map->ctrl[slot] == RONO_MAP_DELETED) {
+        map->tombstones--;
+    }
+    map->ctrl[slot] = (uint8_t)(hash & 0x7f);
+    map->keys[slot] = key;
+    map->values[slot] = value;
+    map->len++;
+}
+
+// Rehash into a table with room for at least needed entries
+static void rono_map_resize(RonoMap* map, int64_t needed) {
+    int64_t cap = RONO_MAP_GROUP;
+    while (cap - cap / 8 < needed) {
+        cap *= 2;
+    }
+    uint8_t* old_ctrl = map->ctrl;
+    int64_t* old_keys = map->keys;
+    int64_t* old_values = map->values;
+    int64_t old_cap = map->cap;
+
+    rono_map_alloc(map, cap);
+    for (int64_t slot = 0; slot < old_cap; slot++) {
+        if (!(old_ctrl[slot] & 0x80)) {
+            rono_map_place(map, old_keys[slot], old_values[slot], rono_map_hash(map, old_keys[slot]));
+        }
+    }
+    free(old_ctrl);
+    free(old_keys);
+    free(old_values);
+}
+
+RonoMap* rono_map_new(int64_t key_kind, int64_t value_kind, int64_t capacity) {
+    RonoMap* map = calloc(1, sizeof(RonoMap));
+    if (map == NULL) {
+        rono_collection_oom();
+    }
+    map->key_kind = key_kind;
+    map->value_kind = value_kind;
+    rono_map_resize(map, capacity);
+    return map;
+}
+
+int64_t rono_map_len(const RonoMap* map) {
+    return map != NULL ? map->len : 0;
+}
+
+void rono_map_set(RonoMap* map, int64_t key, int64_t value) {
+    if (map->value_kind == RONO_ELEM_STR) {
+        value = rono_str_persist(value);
+    }
+    uint64_t hash = rono_map_hash(map, key);
+    int64_t slot = rono_map_find(map, key, hash);
+    if (slot >= 0) {
+        map->values[slot] = value;
+        return;
+    }
+    if (map->len + map->tombstones + 1 > map->cap - map->cap / 8) {
+        rono_map_resize(map, map->len + 1 > map->cap / 2 ? map->len * 2 + 1 : map->len + 1);
+    }
+    if (map->key_kind == RONO_ELEM_STR) {
+        key = rono_str_persist(key);
+    }
+    rono_map_place(map, key, value, hash);
+}
+
+// Value stored under key; a missing key reads as 0 (0.0, false, empty string)
+int64_t rono_map_get(const RonoMap* map, int64_t key) {
+    if (map == NULL || map->len == 0) {
+        return 0;
+    }
+    int64_t slot = rono_map_find(map, key, rono_map_hash(map, key));
+    return slot >= 0 ? map->values[slot] : 0;
+}
+
+int8_t rono_map_has(const RonoMap* map, int64_t key) {
+    return map != NULL && map->len > 0 && rono_map_find(map, key, rono_map_hash(map, key)) >= 0;
+}
+
+void rono_map_remove(RonoMap* map, int64_t key) {
+    int64_t slot = rono_map_len(map) > 0 ? rono_map_find(map, key, rono_map_hash(map, key)) : -1;
+    if (slot >= 0) {
+        map->ctrl[slot] = RONO_MAP_DELETED;
+        map->len--;
+        map->tombstones++;
+    }
+}
+
+// Data-parallel `par for`. The iterations [start, end) are handed out in
+// chunks from a shared counter, so workers that finish early take over the
+// remaining work. ir_gen outlines the loop body into a RonoParBody that
+// runs once on every worker: it claims chunks with rono_par_next until none
+// are left, then folds its reduction partials into env under rono_par_lock.
+// The calling thread works too; the pool threads are started on first use,
+// RONO_THREADS or one per online CPU in total. Regions and the PRNG are
+// per-thread already, so every worker has its own. A par for nested in
+// another one runs on the thread that reaches it.
+
+// Kept in sync with parallel::CHUNKS_PER_WORKER
+#define RONO_PAR_CHUNKS_PER_WORKER 8
+#define RONO_PAR_MAX_THREADS 256
+
+typedef struct RonoParCtx {
+    int64_t start;
+    uint64_t count;
+    uint64_t chunk;
+    uint64_t next; // offset of the next unclaimed chunk, updated atomically
+    pthread_mutex_t lock;
+} RonoParCtx;
+
+typedef void (*RonoParBody)(void* env, RonoParCtx* ctx);
+
+static pthread_mutex_t rono_par_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rono_par_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t rono_par_idle = PTHREAD_COND_INITIALIZER;
+// Serializes loops started by different threads; the loser runs alone
+static pthread_mutex_t rono_par_run_lock = PTHREAD_MUTEX_INITIALIZER;
+static int rono_par_threads = 0; // pool threads plus the caller, 0 until started
+static uint64_t rono_par_generation = 0;
+static int rono_par_busy = 0; // pool threads still working on the current loop
+static RonoParBody rono_par_job_body;
+static void* rono_par_job_env;
+static RonoParCtx* rono_par_job_ctx;
+static __thread int rono_par_inside = 0;
+
+// Claim the next chunk into range[0] .. range[1]; 0 when the loop is done
+int64_t rono_par_next(RonoParCtx* ctx, int64_t* range) {
+    uint64_t offset = __atomic_fetch_add(&ctx->next, ctx->chunk, __ATOMIC_RELAXED);
+    if (offset >= ctx->count) {
+        return 0;
+    }
+    uint64_t len = ctx->count - offset < ctx->chunk ? ctx->count - offset : ctx->chunk;
+    range[0] = (int64_t)((uint64_t)ctx->start + offset);
+    range[1] = (int64_t)((uint64_t)range[0] + len);
+    return 1;
+}
+
+void rono_par_lock(RonoParCtx* ctx) {
+    pthread_mutex_lock(&ctx->lock);
+}
+
+void rono_par_unlock(RonoParCtx* ctx) {
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void* rono_par_worker(void* arg) {
+    (void)arg;
+    rono_par_inside = 1;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&rono_par_pool_lock);
+    for (;;) {
+        while (rono_par_generation == seen) {
+            pthread_cond_wait(&rono_par_wake, &rono_par_pool_lock);
+        }
+        seen = rono_par_generation;
+        RonoParBody body = rono_par_job_body;
+        void* env = rono_par_job_env;
+        RonoParCtx* ctx = rono_par_job_ctx;
+        pthread_mutex_unlock(&rono_par_pool_lock);
+
+        body(env, ctx);
+
+        pthread_mutex_lock(&rono_par_pool_lock);
+        if (--rono_par_busy == 0) {
+            pthread_cond_signal(&rono_par_idle);
+        }
+    }
+    return NULL;
+}
+
+// Called with rono_par_run_lock held
+static void rono_par_start_pool(void) {
+    if (rono_par_threads > 0) {
+        return;
+    }
+    const char* env = getenv("RONO_THREADS");
+    long threads = env && *env ? strtol(env, NULL, 10) : 0;
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > RONO_PAR_MAX_THREADS) {
+        threads = RONO_PAR_MAX_THREADS;
+    }
+
+    rono_par_threads = 1;
+    for (long i = 1; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, rono_par_worker, NULL) != 0) {
+            break; // Run with the threads we have
+        }
+        pthread_detach(thread);
+        rono_par_threads++;
+    }
+}
+
+void rono_par_for(RonoParBody body, void* env, int64_t start, int64_t end) {
+    if (end <= start) {
+        return;
+    }
+    RonoParCtx ctx;
+    ctx.start = start;
+    ctx.count = (uint64_t)end - (uint64_t)start;
+    ctx.next = 0;
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    int shared = !rono_par_inside && ctx.count > 1 && pthread_mutex_trylock(&rono_par_run_lock) == 0;
+    if (shared) {
+        rono_par_start_pool();
+    }
+    int workers = shared ? rono_par_threads : 1;
+    ctx.chunk = ctx.count / ((uint64_t)workers * RONO_PAR_CHUNKS_PER_WORKER);
+    if (ctx.chunk == 0) {
+        ctx.chunk = 1;
+    }
+
+    if (workers > 1) {
+        pthread_mutex_lock(&rono_par_pool_lock);
+        rono_par_job_body = body;
+        rono_par_job_env = env;
+        rono_par_job_ctx = &ctx;
+        rono_par_busy = workers - 1;
+        rono_par_generation++;
+        pthread_cond_broadcast(&rono_par_wake);
+        pthread_mutex_unlock(&rono_par_pool_lock);
+    }
+
+    int was_inside = rono_par_inside;
+    rono_par_inside = 1;
+    body(env, &ctx);
+    rono_par_inside = was_inside;
+
+    if (workers > 1) {
+        pthread_mutex_lock(&rono_par_pool_lock);
+        while (rono_par_busy > 0) {
+            pthread_cond_wait(&rono_par_idle, &rono_par_pool_lock);
+        }
+        pthread_mutex_unlock(&rono_par_pool_lock);
+    }
+    if (shared) {
+        pthread_mutex_unlock(&rono_par_run_lock);
+    }
+    pthread_mutex_destroy(&ctx.lock);
+}
+
+// Console input. stdin is read in large chunks into one reusable buffer, or
+// mapped directly when it is a regular file, and lines are handed out as
+// views into that buffer instead of heap copies. A view stays valid until
+// the next rono_input_* call.
+#define RONO_IN_DEFAULT_SIZE (1024 * 1024)
+#define RONO_FLOAT_TOKEN_MAX 128
+
+static char* rono_in_buf = NULL;
+static size_t rono_in_pos = 0;
+static size_t rono_in_end = 0;
+static size_t rono_in_cap = 0;
+static int rono_in_eof = 0;
+static int rono_in_ready = 0;
+static pthread_mutex_t rono_in_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Called with rono_in_lock held
+static void rono_in_init(void) {
+    rono_in_ready = 1;
+
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+        if (offset >= 0 && offset < st.st_size) {
+            void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+                rono_in_buf = map;
+                rono_in_pos = (size_t)offset;
+                rono_in_end = (size_t)st.st_size;
+                rono_in_cap = (size_t)st.st_size;
+                rono_in_eof = 1;
+                return;
+            }
+        }
+    }
+
+    size_t size = RONO_IN_DEFAULT_SIZE;
+    const char* env = getenv("RONO_INPUT_BUFFER");
+    if (env != NULL && atol(env) > 0) {
+        size = (size_t)atol(env);
+    }
+    rono_in_buf = malloc(size);
+    rono_in_cap = rono_in_buf != NULL ? size : 0;
+}
+
+// Read more of stdin after the unconsumed tail, compacting the buffer and
+// doubling it when a single line fills it. Returns 0 at end of input.
+static int rono_in_fill(void) {
+    if (rono_in_eof) {
+        return 0;
+    }
+
+    if (rono_in_pos > 0) {
+        memmove(rono_in_buf, rono_in_buf + rono_in_pos, rono_in_end - rono_in_pos);
+        rono_in_end -= rono_in_pos;
+        rono_in_pos = 0;
+    }
+
+    if (rono_in_end == rono_in_cap) {
+        size_t new_cap = rono_in_cap > 0 ? rono_in_cap * 2 : RONO_IN_DEFAULT_SIZE;
+        char* new_buf = realloc(rono_in_buf, new_cap);
+        if (new_buf == NULL) {
+            return 0;
+        }
+        rono_in_buf = new_buf;
+        rono_in_cap = new_cap;
+    }
+
+    for (;;) {
+        ssize_t n = read(STDIN_FILENO, rono_in_buf + rono_in_end, rono_in_cap - rono_in_end);
+        RONO_METRIC_ADD(IN_READS, 1);
+        if (n > 0) {
+            rono_in_end += (size_t)n;
+            return 1;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        rono_in_eof = 1;
+        return 0;
+    }
+}
+
+// Consume the next line and point *data at it. Returns its length without
+// the newline, or -1 at end of input. Called with rono_in_lock held.
+static int64_t rono_in_next_line(const char** data) {
+    if (!rono_in_ready) {
+        rono_in_init();
+    }
+
+    size_t scanned = 0;
+    for (;;) {
+        size_t avail = rono_in_end - rono_in_pos;
+        if (scanned < avail) {
+            const char* start = rono_in_buf + rono_in_pos;
+            const char* newline = memchr(start + scanned, '\n', avail - scanned);
+            if (newline != NULL) {
+                size_t len = (size_t)(newline - start);
+                *data = start;
+                rono_in_pos += len + 1;
+                RONO_METRIC_ADD(IN_LINES, 1);
+                RONO_METRIC_ADD(IN_BYTES, len + 1);
+                return (int64_t)len;
+            }
+            scanned = avail;
+        }
+        if (!rono_in_fill()) {
+            break;
+        }
+    }
+
+    // Last line without a trailing newline
+    size_t avail = rono_in_end - rono_in_pos;
+    if (avail == 0) {
+        return -1;
+    }
+    *data = rono_in_buf + rono_in_pos;
+    rono_in_pos = rono_in_end;
+    RONO_METRIC_ADD(IN_LINES, 1);
+    RONO_METRIC_ADD(IN_BYTES, avail);
+    return (int64_t)avail;
+}
+
+static int rono_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Same result as strtoll(text, NULL, 10), saturating on overflow
+static int64_t rono_parse_int(const char* text, int64_t len) {
+    int64_t i = 0;
+    while (i < len && rono_is_space(text[i])) {
+        i++;
+    }
+
+    int negative = 0;
+    if (i < len && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i] == '-';
+        i++;
+    }
+
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t value = 0;
+    for (; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+        uint64_t digit = (uint64_t)(text[i] - '0');
+        if (value > (limit - digit) / 10) {
+            return negative ? INT64_MIN : INT64_MAX;
+        }
+        value = value * 10 + digit;
+    }
+
+    return negative ? (int64_t)(0 - value) : (int64_t)value;
+}
+
+// Decimals whose mantissa fits in 53 bits and whose exponent is within the
+// exactly representable powers of ten are converted with one multiply or
+// divide, which is correctly rounded. Everything else (long mantissas,
+// inf/nan, hex floats) goes through strtod.
+static double rono_parse_float(const char* text, int64_t len) {
+    int64_t i = 0;
+    while (i < len && rono_is_space(text[i])) {
+        i++;
+    }
+    int64_t token_start = i;
+
+    int negative = 0;
+    if (i < len && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i] == '-';
+        i++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int seen_digit = 0;
+    int exponent = 0;
+    int in_fraction = 0;
+    for (; i < len; i++) {
+        if (text[i] == '.' && !in_fraction) {
+            in_fraction = 1;
+            continue;
+        }
+        if (text[i] < '0' || text[i] > '9') {
+            break;
+        }
+        seen_digit = 1;
+        exponent -= in_fraction;
+        if (mantissa == 0 && text[i] == '0') {
+            continue;
+        }
+        if (++digits > 19) {
+            goto slow;
+        }
+        mantissa = mantissa * 10 + (uint64_t)(text[i] - '0');
+    }
+    if (!seen_digit || (i < len && (text[i] == 'x' || text[i] == 'X'))) {
+        goto slow;
+    }
+    if (i < len && (text[i] == 'e' || text[i] == 'E')) {
+        int64_t j = i + 1;
+        int exp_negative = 0;
+        if (j < len && (text[j] == '-' || text[j] == '+')) {
+            exp_negative = text[j] == '-';
+            j++;
+        }
+        if (j < len && text[j] >= '0' && text[j] <= '9') {
+            int exp_value = 0;
+            for (; j < len && text[j] >= '0' && text[j] <= '9'; j++) {
+                if (exp_value > 1000) {
+                    goto slow;
+                }
+                exp_value = exp_value * 10 + (text[j] - '0');
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+        }
+    }
+
+    if (mantissa <= (UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / rono_pow10[-exponent] : value * rono_pow10[exponent];
+        return negative ? -value : value;
+    }
+
+slow:;
+    char stack_token[RONO_FLOAT_TOKEN_MAX];
+    int64_t token_len = len - token_start;
+    char* token = token_len < RONO_FLOAT_TOKEN_MAX ? stack_token : malloc((size_t)token_len + 1);
+    if (token == NULL) {
+        return 0.0;
+    }
+    memcpy(token, text + token_start, (size_t)token_len);
+    token[token_len] = '\0';
+    double result = strtod(token, NULL);
+    if (token != stack_token) {
+        free(token);
+    }
+    return result;
+}
+
+// Read the next line as a view into the input buffer, without the trailing
+// newline. Returns the length, or -1 at end of input.
+int64_t rono_input_line(const char** data) {
+    // Make pending output (e.g. a prompt) visible before blocking on input
+    rono_flush();
+
+    pthread_mutex_lock(&rono_in_lock);
+    int64_t len = rono_in_next_line(data);
+    pthread_mutex_unlock(&rono_in_lock);
+    return len;
+}
+
+char* rono_input_string() {
+    const char* line;
+    int64_t len = rono_input_line(&line);
+    if (len < 0) {
+        return NULL;
+    }
+
+    return rono_alloc_string(line, len);
+}
+
+int64_t rono_input_int() {
+    rono_flush();
+
+    pthread_mutex_lock(&rono_in_lock);
+    const char* line;
+    int64_t len = rono_in_next_line(&line);
+    int64_t result = len < 0 ? 0 : rono_parse_int(line, len);
+    pthread_mutex_unlock(&rono_in_lock);
+    return result;
+}
+
+double rono_input_float() {
+    rono_flush();
+
+    pthread_mutex_lock(&rono_in_lock);
+    const char* line;
+    int64_t len = rono_in_next_line(&line);
+    double result = len < 0 ? 0.0 : rono_parse_float(line, len);
+    pthread_mutex_unlock(&rono_in_lock);
+    return result;
+}
+
+int8_t rono_input_bool() {
+    rono_flush();
+
+    pthread_mutex_lock(&rono_in_lock);
+    const char* line;
+    int64_t len = rono_in_next_line(&line);
+    int8_t result = 0;
+    if ((len == 4 && memcmp(line, "true", 4) == 0) || (len == 1 && line[0] == '1')) {
+        result = 1;
+    }
+    pthread_mutex_unlock(&rono_in_lock);
+    return result;
+}
+
+// Random number generation. Every thread owns a xoshiro256** state; it is
+// seeded from the clock on first use, or from the value passed to
+// rono_rand_seed so runs can be reproduced. Ranges are reduced with
+// Lemire's multiply-shift method plus rejection, so results are unbiased.
+#define RONO_RAND_LANES 4
+
+typedef struct {
+    uint64_t s[4];
+    uint64_t epoch;
+    int seeded;
+} RonoRandState;
+
+static __thread RonoRandState rono_rand_tls;
+static uint64_t rono_rand_seed_value = 0;
+static uint64_t rono_rand_epoch = 0;
+static uint64_t rono_rand_streams = 0;
+static pthread_mutex_t rono_rand_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t rono_splitmix64(uint64_t* x) {
+    uint64_t z = (*x += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rono_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static void rono_rand_reseed(RonoRandState* state, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * UINT64_C(0xD1B54A32D192ED03));
+    for (int i = 0; i < 4; i++) {
+        state->s[i] = rono_splitmix64(&x);
+    }
+    state->seeded = 1;
+}
+
+static RonoRandState* rono_rand_thread(void) {
+    RonoRandState* state = &rono_rand_tls;
+    if (state->seeded && state->epoch == __atomic_load_n(&rono_rand_epoch, __ATOMIC_ACQUIRE)) {
+        return state;
+    }
+
+    pthread_mutex_lock(&rono_rand_lock);
+    uint64_t seed = rono_rand_seed_value;
+    if (rono_rand_epoch == 0) {
+        // Never seeded explicitly: mix the clock with the thread's address
+        seed = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^ (uint64_t)(uintptr_t)state;
+    }
+    rono_rand_reseed(state, seed, rono_rand_streams++);
+    state->epoch = rono_rand_epoch;
+    pthread_mutex_unlock(&rono_rand_lock);
+    return state;
+}
+
+static inline uint64_t rono_rand_next(RonoRandState* state) {
+    uint64_t* s = state->s;
+    uint64_t result = rono_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rono_rotl(s[3], 45);
+    return result;
+}
+
+// Finish reducing the first draw x to [0, range); range == 0 means the full
+// 64-bit range. Compiled code inlines the common case and only calls this
+// when the draw may have to be rejected.
+uint64_t rono_rand_reduce(RonoRandState* state, uint64_t x, uint64_t range) {
+    if (range == 0) {
+        return x;
+    }
+    __uint128_t m = (__uint128_t)x * range;
+    uint64_t low = (uint64_t)m;
+    if (low < range) {
+        uint64_t threshold = (0 - range) % range;
+        while (low < threshold) {
+            x = rono_rand_next(state);
+            m = (__uint128_t)x * range;
+            low = (uint64_t)m;
+        }
+    }
+    return (uint64_t)(m >> 64);
+}
+
+static inline uint64_t rono_rand_below(RonoRandState* state, uint64_t range) {
+    return rono_rand_reduce(state, rono_rand_next(state), range);
+}
+
+// The calling thread's generator state, for compiled code that steps it
+// inline. The four state words come first in RonoRandState.
+RonoRandState* rono_rand_state(void) {
+    return rono_rand_thread();
+}
+
+static inline double rono_rand_unit(uint64_t x) {
+    return (double)(x >> 11) * 0x1.0p-53;
+}
+
+// Kept for compatibility: seeding now happens lazily per thread
+void rono_rand_init() {
+    rono_rand_thread();
+}
+
+// Reseed the generator. The calling thread restarts from the seed right
+// away; other threads pick up a distinct stream derived from it on their
+// next call.
+void rono_rand_seed(int64_t seed) {
+    pthread_mutex_lock(&rono_rand_lock);
+    rono_rand_seed_value = (uint64_t)seed;
+    rono_rand_streams = 1;
+    rono_rand_reseed(&rono_rand_tls, rono_rand_seed_value, 0);
+    rono_rand_tls.epoch = rono_rand_epoch + 1;
+    __atomic_store_n(&rono_rand_epoch, rono_rand_epoch + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&rono_rand_lock);
+}
+
+int64_t rono_rand_int(int64_t min, int64_t max) {
+    RonoRandState* state = rono_rand_thread();
+    
+    if (min > max) {
+        // Swap if min > max
+        int64_t temp = min;
+        min = max;
+        max = temp;
+    }
+    
+    // Generate random number in range [min, max]
+    uint64_t range = (uint64_t)max - (uint64_t)min + 1;
+    return (int64_t)((uint64_t)min + rono_rand_below(state, range));
+}
+
+double rono_rand_float(double min, double max) {
+    RonoRandState* state = rono_rand_thread();
+    
+    if (min > max) {
+        // Swap if min > max
+        double temp = min;
+        min = max;
+        max = temp;
+    }
+    
+    // Generate random float in range [min, max)
+    return min + rono_rand_unit(rono_rand_next(state)) * (max - min);
+}
+
+// Bulk generation runs RONO_RAND_LANES independent xoshiro256** streams
+// side by side (seeded from the thread generator), which the compiler can
+// keep in vector registers.
+static void rono_rand_fill_raw(RonoRandState* state, uint64_t* out, int64_t count) {
+    uint64_t s0[RONO_RAND_LANES], s1[RONO_RAND_LANES], s2[RONO_RAND_LANES], s3[RONO_RAND_LANES];
+    for (int lane = 0; lane < RONO_RAND_LANES; lane++) {
+        s0[lane] = rono_rand_next(state);
+        s1[lane] = rono_rand_next(state);
+        s2[lane] = rono_rand_next(state);
+        s3[lane] = rono_rand_next(state);
+    }
+
+    int64_t i = 0;
+    for (; i + RONO_RAND_LANES <= count; i += RONO_RAND_LANES) {
+        for (int lane = 0; lane < RONO_RAND_LANES; lane++) {
+            out[i + lane] = rono_rotl(s1[lane] * 5, 7) * 9;
+            uint64_t t = s1[lane] << 17;
+            s2[lane] ^= s0[lane];
+            s3[lane] ^= s1[lane];
+            s1[lane] ^= s2[lane];
+            s0[lane] ^= s3[lane];
+            s2[lane] ^= t;
+            s3[lane] = rono_rotl(s3[lane], 45);
+        }
+    }
+    for (; i < count; i++) {
+        out[i] = rono_rand_next(state);
+    }
+}
+
+// Fill out[0..count) with integers in [min, max]
+void rono_rand_fill_int(int64_t* out, int64_t count, int64_t min, int64_t max) {
+    if (out == NULL || count <= 0) {
+        return;
+    }
+    RonoRandState* state = rono_rand_thread();
+    if (min > max) {
+        int64_t temp = min;
+        min = max;
+        max = temp;
+    }
+
+    uint64_t* raw = (uint64_t*)out;
+    rono_rand_fill_raw(state, raw, count);
+
+    uint64_t range = (uint64_t)max - (uint64_t)min + 1;
+    if (range == 0) {
+        return;
+    }
+    uint64_t threshold = (0 - range) % range;
+    for (int64_t i = 0; i < count; i++) {
+        __uint128_t m = (__uint128_t)raw[i] * range;
+        if ((uint64_t)m < threshold) {
+            // Rejected sample: redraw from the scalar generator
+            out[i] = (int64_t)((uint64_t)min + rono_rand_below(state, range));
+        } else {
+            out[i] = (int64_t)((uint64_t)min + (uint64_t)(m >> 64));
+        }
+    }
+}
+
+// Fill out[0..count) with floats in [min, max)
+void rono_rand_fill_float(double* out, int64_t count, double min, double max) {
+    if (out == NULL || count <= 0) {
+        return;
+    }
+    RonoRandState* state = rono_rand_thread();
+    if (min > max) {
+        double temp = min;
+        min = max;
+        max = temp;
+    }
+
+    uint64_t* raw = (uint64_t*)out;
+    rono_rand_fill_raw(state, raw, count);
+
+    double range = max - min;
+    for (int64_t i = 0; i < count; i++) {
+        out[i] = min + rono_rand_unit(raw[i]) * range;
+    }
+}
+
+char* rono_rand_string(int64_t length) {
+    RonoRandState* state = rono_rand_thread();
+    
+    if (length <= 0) {
+        return rono_alloc_string("", 0);
+    }
+    
+    char* result = rono_str_new(length);
+    if (!result) {
+        return NULL;
+    }
+    
+    const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    const int charset_size = sizeof(charset) - 1;
+    
+    for (int64_t i = 0; i < length; i++) {
+        result[i] = charset[rono_rand_below(state, charset_size)];
+    }
+    result[length] = '\0';
+    
+    return result;
+}
+
+// Generate random character in range (simplified implementation)
+char* rono_rand_char_range(const char* from, const char* to) {
+    RonoRandState* state = rono_rand_thread();
+    
+    if (rono_str_len(from) == 0 || rono_str_len(to) == 0) {
+        return rono_alloc_string("a", 1);
+    }
+    
+    char from_char = from[0];
+    char to_char = to[0];
+    
+    if (from_char > to_char) {
+        // Swap if from > to
+        char temp = from_char;
+        from_char = to_char;
+        to_char = temp;
+    }
+    
+    char* result = rono_str_new(1);
+    if (!result) {
+        return NULL;
+    }
+    
+    // Generate random character in range [from_char, to_char]
+    uint64_t range = (uint64_t)(to_char - from_char + 1);
+    result[0] = (char)(from_char + (char)rono_rand_below(state, range));
+    result[1] = '\0';
+    
+    return result;
+}
+
+// HTTP response structure
+typedef struct {
+    char* data;        // malloc-owned rono_str
+    size_t size;
+    size_t capacity;
+} HttpResponse;
+
+#define RONO_HTTP_INITIAL_CAPACITY 4096
+// Upper bound for the Content-Length pre-size, so a bogus header can't make us
+// reserve gigabytes up front; the buffer still grows past it if needed
+#define RONO_HTTP_MAX_PRESIZE (64 * 1024 * 1024)
+
+// Make room for at least needed bytes plus the terminating NUL. Capacity grows
+// geometrically so accumulating a body costs amortized O(n) copies.
+static int rono_http_reserve(HttpResponse* response, size_t needed) {
+    if (response->data != NULL && needed <= response->capacity) {
+        return 1;
+    }
+
+    size_t capacity = response->capacity ? response->capacity : RONO_HTTP_INITIAL_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    char* ptr = rono_str_heap_reserve(response->data, capacity);
+    if (ptr == NULL) {
+        return 0;
+    }
+    RONO_METRIC_ADD(HTTP_GROWS, 1);
+    response->data = ptr;
+    response->capacity = capacity;
+    return 1;
+}
+
+// Callback function for writing HTTP response data
+static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    HttpResponse* response = (HttpResponse*)userp;
+    size_t realsize = size * nmemb;
+    if (!rono_http_reserve(response, response->size + realsize)) {
+        // Out of memory
+        return 0;
+    }
+    
+    memcpy(&(response->data[response->size]), contents, realsize);
+    response->size += realsize;
+    RONO_METRIC_ADD(HTTP_BUFFERED, realsize);
+    rono_str_heap_set_len(response->data, response->size);
+    
+    return realsize;
+}
+
+// Parse "Content-Length: N" out of a header line, returns -1 if it isn't one
+static long long rono_http_content_length(const char* header, size_t len) {
+    static const char name[] = "content-length:";
+    size_t name_len = sizeof(name) - 1;
+    if (len <= name_len || strncasecmp(header, name, name_len) != 0) {
+        return -1;
+    }
+
+    long long value = 0;
+    size_t i = name_len;
+    while (i < len && (header[i] == ' ' || header[i] == '\t')) i++;
+    if (i >= len || header[i] < '0' || header[i] > '9') {
+        return -1;
+    }
+    while (i < len && header[i] >= '0' && header[i] <= '9') {
+        value = value * 10 + (header[i] - '0');
+        i++;
+    }
+    return value;
+}
+
+// Header callback: pre-size the body buffer from Content-Length
+static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userp) {
+    HttpResponse* response = (HttpResponse*)userp;
+    size_t realsize = size * nitems;
+    long long length = rono_http_content_length(buffer, realsize);
+    if (length > 0) {
+        if (length > RONO_HTTP_MAX_PRESIZE) {
+            length = RONO_HTTP_MAX_PRESIZE;
+        }
+        // Failing to pre-size is not an error, WriteCallback grows on demand
+        rono_http_reserve(response, response->size + (size_t)length);
+    }
+    return realsize;
+}
+
+// Connection pool configuration. Both values can be overridden with the
+// RONO_HTTP_POOL_SIZE / RONO_HTTP_IDLE_TIMEOUT environment variables or at
+// runtime through rono_http_configure().
+#define RONO_HTTP_DEFAULT_POOL_SIZE 8
+#define RONO_HTTP_DEFAULT_IDLE_TIMEOUT 60
+#define RONO_HTTP_MAX_HOST 256
+
+// Timeouts in seconds. A buffered request is limited as a whole; streams
+// and downloads can run as long as data keeps arriving and are only
+// aborted once they stall below RONO_HTTP_LOW_SPEED_LIMIT bytes/s.
+#define RONO_HTTP_TIMEOUT 30
+#define RONO_HTTP_CONNECT_TIMEOUT 10
+#define RONO_HTTP_LOW_SPEED_LIMIT 1
+#define RONO_HTTP_LOW_SPEED_TIME 30
+
+// Reusable easy handle bound to the host it last talked to. curl keeps the
+// connection of a handle alive between transfers, so handing the same handle
+// back to requests for the same host skips connect, TLS and DNS.
+typedef struct {
+    CURL* handle;
+    char host[RONO_HTTP_MAX_HOST];
+    time_t last_used;
+    int in_use;
+} PooledHandle;
+
+static pthread_once_t curl_init_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t http_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t http_share_locks[CURL_LOCK_DATA_LAST];
+static CURLSH* http_share = NULL;
+static PooledHandle* http_pool = NULL;
+static size_t http_pool_size = RONO_HTTP_DEFAULT_POOL_SIZE;
+static size_t http_pending_pool_size = 0; // 0: no resize waiting for idle handles
+static long http_idle_timeout = RONO_HTTP_DEFAULT_IDLE_TIMEOUT;
+
+static void rono_http_share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    pthread_mutex_lock(&http_share_locks[data]);
+}
+
+static void rono_http_share_unlock(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    (void)userptr;
+    pthread_mutex_unlock(&http_share_locks[data]);
+}
+
+static long rono_http_env_long(const char* name, long fallback) {
+    const char* value = getenv(name);
+    if (value == NULL || *value == '\0') {
+        return fallback;
+    }
+
+    char* end = NULL;
+    long result = strtol(value, &end, 10);
+    if (end == value || result <= 0) {
+        return fallback;
+    }
+    return result;
+}
+
+// Release every pooled handle and the share object (registered with atexit)
+static void rono_http_cleanup(void) {
+    pthread_mutex_lock(&http_pool_lock);
+    if (http_pool) {
+        for (size_t i = 0; i < http_pool_size; i++) {
+            if (http_pool[i].handle) {
+                curl_easy_cleanup(http_pool[i].handle);
+            }
+        }
+        free(http_pool);
+        http_pool = NULL;
+    }
+    pthread_mutex_unlock(&http_pool_lock);
+
+    if (http_share) {
+        curl_share_cleanup(http_share);
+        http_share = NULL;
+    }
+    curl_global_cleanup();
+}
+
+static void rono_http_init_once(void) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    http_pool_size = (size_t)rono_http_env_long("RONO_HTTP_POOL_SIZE", RONO_HTTP_DEFAULT_POOL_SIZE);
+    http_idle_timeout = rono_http_env_long("RONO_HTTP_IDLE_TIMEOUT", RONO_HTTP_DEFAULT_IDLE_TIMEOUT);
+
+    // Share DNS cache, TLS sessions and the connection cache between all handles
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&http_share_locks[i], NULL);
+    }
+    http_share = curl_share_init();
+    if (http_share) {
+        curl_share_setopt(http_share, CURLSHOPT_LOCKFUNC, rono_http_share_lock);
+        curl_share_setopt(http_share, CURLSHOPT_UNLOCKFUNC, rono_http_share_unlock);
+        curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+    atexit(rono_http_cleanup);
+}
+
+// Initialize curl (called once)
+void rono_http_init() {
+    pthread_once(&curl_init_once, rono_http_init_once);
+}
+
+// Rebuild the pool at the pending size once no pooled handle is in use.
+// Called with http_pool_lock held.
+static void rono_http_apply_pool_size(void) {
+    if (http_pending_pool_size == 0) {
+        return;
+    }
+    if (http_pool) {
+        for (size_t i = 0; i < http_pool_size; i++) {
+            if (http_pool[i].in_use) {
+                return;
+            }
+        }
+        for (size_t i = 0; i < http_pool_size; i++) {
+            if (http_pool[i].handle) {
+                curl_easy_cleanup(http_pool[i].handle);
+            }
+        }
+        free(http_pool);
+        http_pool = NULL;
+    }
+    http_pool_size = http_pending_pool_size;
+    http_pending_pool_size = 0;
+}
+
+// Set pool size and idle timeout (seconds). Values <= 0 keep the current
+// setting. While pooled handles are in use a new size is kept pending and
+// applied by the release that leaves the pool idle.
+void rono_http_configure(int64_t pool_size, int64_t idle_timeout) {
+    rono_http_init();
+
+    pthread_mutex_lock(&http_pool_lock);
+    if (idle_timeout > 0) {
+        http_idle_timeout = (long)idle_timeout;
+    }
+    if (pool_size > 0) {
+        http_pending_pool_size = (size_t)pool_size == http_pool_size ? 0 : (size_t)pool_size;
+        rono_http_apply_pool_size();
+    }
+    pthread_mutex_unlock(&http_pool_lock);
+}
+
+// Extract "host[:port]" from a URL into out
+static void rono_http_url_host(const char* url, char* out, size_t out_size) {
+    const char* start = strstr(url, "://");
+    start = start ? start + 3 : url;
+
+    size_t len = strcspn(start, "/?#");
+    if (len >= out_size) {
+        len = out_size - 1;
+    }
+    memcpy(out, start, len);
+    out[len] = '\0';
+}
+
+// Take a handle for the host of url out of the pool. Prefers an idle handle
+// that already talked to the same host, then an empty slot, then the least
+// recently used idle handle. When every slot is busy a standalone handle is
+// returned and *slot is set to NULL.
+static CURL* rono_http_acquire(const char* url, PooledHandle** slot) {
+    char host[RONO_HTTP_MAX_HOST];
+    rono_http_url_host(url, host, sizeof(host));
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&http_pool_lock);
+    if (http_pool == NULL) {
+        http_pool = calloc(http_pool_size, sizeof(PooledHandle));
+    }
+
+    PooledHandle* match = NULL;
+    PooledHandle* empty = NULL;
+    PooledHandle* oldest = NULL;
+    if (http_pool) {
+        for (size_t i = 0; i < http_pool_size; i++) {
+            PooledHandle* entry = &http_pool[i];
+            if (entry->in_use) {
+                continue;
+            }
+            if (entry->handle && now - entry->last_used > http_idle_timeout) {
+                // Idle too long, the server has most likely dropped the connection
+                curl_easy_cleanup(entry->handle);
+                entry->handle = NULL;
+            }
+            if (entry->handle == NULL) {
+                if (!empty) empty = entry;
+            } else if (strcmp(entry->host, host) == 0) {
+                match = entry;
+                break;
+            } else if (!oldest || entry->last_used < oldest->last_used) {
+                oldest = entry;
+            }
+        }
+    }
+
+    PooledHandle* chosen = match ? match : (empty ? empty : oldest);
+    if (chosen) {
+        chosen->in_use = 1;
+        if (chosen != match) {
+            strcpy(chosen->host, host);
+        }
+    }
+    pthread_mutex_unlock(&http_pool_lock);
+
+    CURL* curl = NULL;
+    if (chosen) {
+        if (chosen->handle == NULL) {
+            chosen->handle = curl_easy_init();
+        }
+        curl = chosen->handle;
+        if (curl == NULL) {
+            pthread_mutex_lock(&http_pool_lock);
+            chosen->in_use = 0;
+            pthread_mutex_unlock(&http_pool_lock);
+            chosen = NULL;
+        }
+    } else {
+        curl = curl_easy_init();
+    }
+
+    *slot = chosen;
+    return curl;
+}
+
+// Return a handle to the pool; curl_easy_reset keeps live connections and caches
+static void rono_http_release(CURL* curl, PooledHandle* slot) {
+    if (slot == NULL) {
+        curl_easy_cleanup(curl);
+        return;
+    }
+
+    curl_easy_reset(curl);
+    pthread_mutex_lock(&http_pool_lock);
+    slot->last_used = time(NULL);
+    slot->in_use = 0;
+    rono_http_apply_pool_size();
+    pthread_mutex_unlock(&http_pool_lock);
+}
+
+// Options shared by every request. The body is accumulated into response
+// unless it is NULL; streaming callers pass NULL and get the stall timeout
+// instead of the overall one.
+static void rono_http_setup(CURL* curl, const char* method, const char* url, const char* data, HttpResponse* response) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    if (method) {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+    }
+    if (data) {
+        // The length comes from the rono_str header: no strlen, and binary
+        // bodies with NUL bytes go through unchanged without a copy
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)rono_str_len(data));
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
+    }
+    // Streaming callers install their own write callback
+    if (response) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, response);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)RONO_HTTP_TIMEOUT);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (long)RONO_HTTP_LOW_SPEED_LIMIT);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)RONO_HTTP_LOW_SPEED_TIME);
+    }
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)RONO_HTTP_CONNECT_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Rono-HTTP/1.0");
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, http_idle_timeout);
+    if (http_share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, http_share);
+    }
+}
+
+// Perform a request on a pooled handle. method is NULL for GET/POST.
+static char* rono_http_perform(const char* method, const char* url, const char* data) {
+    rono_http_init();
+
+    HttpResponse response = {0};
+    PooledHandle* slot = NULL;
+    CURL* curl = rono_http_acquire(url, &slot);
+    if (curl == NULL) {
+        return NULL;
+    }
+
+    rono_http_setup(curl, method, url, data, &response);
+    CURLcode res = curl_easy_perform(curl);
+    RONO_METRIC_HTTP(curl, method, data, res);
+    rono_http_release(curl, slot);
+
+    char* body = NULL;
+    if (res == CURLE_OK && response.data) {
+        // Hand the body to the caller's region
+        body = rono_alloc_string(response.data, (int64_t)response.size);
+    }
+    rono_str_heap_free(response.data);
+    return body;
+}
+
+// HTTP GET function
+char* rono_http_get(const char* url) {
+    return rono_http_perform(NULL, url, NULL);
+}
+
+// HTTP POST function
+char* rono_http_post(const char* url, const char* data) {
+    return rono_http_perform(NULL, url, data);
+}
+
+// HTTP PUT function
+char* rono_http_put(const char* url, const char* data) {
+    return rono_http_perform("PUT", url, data);
+}
+
+// HTTP DELETE function
+char* rono_http_delete(const char* url) {
+    return rono_http_perform("DELETE", url, NULL);
+}
+
+// Result of one request in a batch. Every field is 8 bytes wide so compiled
+// code can read it like any other Rono struct (status, body, content_type).
+typedef struct {
+    int64_t status;       // HTTP status code, 0 if the transfer failed
+    char* body;           // Response body, or curl error message on failure
+    char* content_type;   // Content-Type header, NULL if absent
+} RonoHttpResponse;
+
+// Batch result as a one-dimensional Rono array: the element count, then a
+// pointer to each response (struct array elements are held by pointer)
+typedef struct {
+    int64_t count;
+    RonoHttpResponse* items[];
+} RonoHttpResponses;
+
+// Per-transfer state while a batch is in flight
+typedef struct {
+    CURL* curl;
+    PooledHandle* slot;
+    HttpResponse response;
+} HttpTransfer;
+
+// Copy a C string into the current region
+static char* rono_region_strdup(const char* str) {
+    return str != NULL ? rono_alloc_string(str, (int64_t)strlen(str)) : NULL;
+}
+
+// Run count requests concurrently with curl_multi, keeping at most
+// max_concurrency transfers in flight (<= 0 means all at once). methods and
+// bodies may be NULL, as may individual entries (GET without a body).
+// The results, their bodies included, are allocated in the current region
+// like the body returned by rono_http_get, and released with it. Returns
+// NULL only when out of memory.
+RonoHttpResponses* rono_http_request_many(const char** methods, const char** urls, const char** bodies,
+                                          int64_t count, int64_t max_concurrency) {
+    rono_http_init();
+
+    if (count < 0 || urls == NULL) {
+        count = 0;
+    }
+    if (max_concurrency <= 0 || max_concurrency > count) {
+        max_concurrency = count;
+    }
+
+    RonoHttpResponses* results = rono_alloc((int64_t)(sizeof(RonoHttpResponses) + (size_t)count * sizeof(RonoHttpResponse*)));
+    RonoHttpResponse* items = rono_alloc(count * (int64_t)sizeof(RonoHttpResponse));
+    if (results == NULL || items == NULL) {
+        return NULL;
+    }
+    results->count = count;
+    for (int64_t i = 0; i < count; i++) {
+        items[i] = (RonoHttpResponse){0, NULL, NULL};
+        results->items[i] = &items[i];
+    }
+    if (count == 0) {
+        return results;
+    }
+
+    HttpTransfer* transfers = calloc((size_t)count, sizeof(HttpTransfer));
+    CURLM* multi = curl_multi_init();
+    if (transfers == NULL || multi == NULL) {
+        free(transfers);
+        if (multi) curl_multi_cleanup(multi);
+        return NULL;
+    }
+
+    int64_t next = 0;
+    int64_t active = 0;
+    int64_t done = 0;
+
+    while (done < count) {
+        // Top up the in-flight set to the concurrency cap
+        while (active < max_concurrency && next < count) {
+            int64_t index = next++;
+            HttpTransfer* transfer = &transfers[index];
+            const char* method = methods ? methods[index] : NULL;
+            const char* body = bodies ? bodies[index] : NULL;
+
+            transfer->curl = urls[index] ? rono_http_acquire(urls[index], &transfer->slot) : NULL;
+            if (transfer->curl == NULL) {
+                items[index].body = rono_region_strdup("Request failed: could not create handle");
+                done++;
+                continue;
+            }
+
+            rono_http_setup(transfer->curl, method, urls[index], body, &transfer->response);
+            curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+            curl_multi_add_handle(multi, transfer->curl);
+            active++;
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg* msg;
+        int queued = 0;
+        while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            HttpTransfer* transfer = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+            int64_t index = transfer - transfers;
+            RonoHttpResponse* result = &items[index];
+            RONO_METRIC_HTTP(transfer->curl, methods ? methods[index] : NULL, bodies ? bodies[index] : NULL,
+                             msg->data.result);
+
+            if (msg->data.result == CURLE_OK) {
+                long status = 0;
+                char* content_type = NULL;
+                curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &status);
+                curl_easy_getinfo(transfer->curl, CURLINFO_CONTENT_TYPE, &content_type);
+                result->status = status;
+                result->body = rono_alloc_string(transfer->response.data, (int64_t)transfer->response.size);
+                result->content_type = rono_region_strdup(content_type);
+            } else {
+                result->body = rono_region_strdup(curl_easy_strerror(msg->data.result));
+            }
+            rono_str_heap_free(transfer->response.data);
+            transfer->response.data = NULL;
+
+            curl_multi_remove_handle(multi, transfer->curl);
+            rono_http_release(transfer->curl, transfer->slot);
+            transfer->curl = NULL;
+            active--;
+            done++;
+        }
+
+        if (active > 0) {
+            curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+    }
+
+    curl_multi_cleanup(multi);
+    free(transfers);
+    return results;
+}
+
+// Concurrent GET of every URL in urls
+RonoHttpResponses* rono_http_get_many(const char** urls, int64_t count, int64_t max_concurrency) {
+    return rono_http_request_many(NULL, urls, NULL, count, max_concurrency);
+}
+
+// Streaming responses. Chunks are copied into one reusable NUL-terminated
+// buffer, so memory stays bounded by the largest libcurl chunk (16 KiB by
+// default) no matter how large the body is.
+typedef struct {
+    char* data;   // rono_str, reused for every chunk
+    size_t size;
+} HttpChunk;
+
+static int rono_http_chunk_set(HttpChunk* chunk, const char* contents, size_t len) {
+    char* ptr = rono_str_heap_reserve(chunk->data, len);
+    if (ptr == NULL) {
+        return 0;
+    }
+    chunk->data = ptr;
+    memcpy(chunk->data, contents, len);
+    rono_str_heap_set_len(chunk->data, len);
+    chunk->size = len;
+    return 1;
+}
+
+static long rono_http_status(CURL* curl) {
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    return status;
+}
+
+// Per-chunk handler, called with a NUL-terminated chunk and its length.
+// Returning non-zero stops the transfer.
+typedef int64_t (*RonoHttpChunkHandler)(const char* chunk, int64_t length);
+
+typedef struct {
+    RonoHttpChunkHandler handler;
+    HttpChunk chunk;
+} HttpHandlerStream;
+
+static size_t HandlerCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    HttpHandlerStream* stream = (HttpHandlerStream*)userp;
+    size_t realsize = size * nmemb;
+    if (!rono_http_chunk_set(&stream->chunk, contents, realsize)) {
+        return 0;
+    }
+    if (stream->handler(stream->chunk.data, (int64_t)realsize) != 0) {
+        return 0; // Aborts with CURLE_WRITE_ERROR
+    }
+    return realsize;
+}
+
+// HTTP GET delivering the body chunk by chunk to handler. Returns the HTTP
+// status, or 0 if the transfer failed before a response arrived.
+int64_t rono_http_get_stream(const char* url, RonoHttpChunkHandler handler) {
+    rono_http_init();
+
+    if (handler == NULL) {
+        return 0;
+    }
+
+    PooledHandle* slot = NULL;
+    CURL* curl = rono_http_acquire(url, &slot);
+    if (curl == NULL) {
+        return 0;
+    }
+
+    HttpHandlerStream stream = { handler, {0} };
+    rono_http_setup(curl, NULL, url, NULL, NULL);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HandlerCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream);
+
+    CURLcode res = curl_easy_perform(curl);
+    RONO_METRIC_HTTP(curl, NULL, NULL, res);
+    long status = (res == CURLE_OK || res == CURLE_WRITE_ERROR) ? rono_http_status(curl) : 0;
+    rono_http_release(curl, slot);
+    rono_str_heap_free(stream.chunk.data);
+
+    return status;
+}
+
+static size_t FdCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    int* fd = (int*)userp;
+    size_t realsize = size * nmemb;
+    const char* ptr = contents;
+    size_t left = realsize;
+    while (left > 0) {
+        ssize_t written = write(*fd, ptr, left);
+        if (written < 0) {
+            return 0;
+        }
+        ptr += written;
+        left -= (size_t)written;
+    }
+    return realsize;
+}
+
+// HTTP GET writing the body straight to fd without buffering it in memory.
+// Returns the number of bytes written, or -1 on failure.
+int64_t rono_http_get_fd(const char* url, int64_t fd) {
+    rono_http_init();
+
+    PooledHandle* slot = NULL;
+    CURL* curl = rono_http_acquire(url, &slot);
+    if (curl == NULL) {
+        return -1;
+    }
+
+    int out_fd = (int)fd;
+    rono_http_setup(curl, NULL, url, NULL, NULL);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, FdCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &out_fd);
+
+    CURLcode res = curl_easy_perform(curl);
+    RONO_METRIC_HTTP(curl, NULL, NULL, res);
+    curl_off_t downloaded = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    rono_http_release(curl, slot);
+
+    return res == CURLE_OK ? (int64_t)downloaded : -1;
+}
+
+// Download url into the file at path (created or truncated)
+int64_t rono_http_download(const char* url, const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    int64_t result = rono_http_get_fd(url, fd);
+    if (close(fd) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+// Pull-style stream: rono_http_next_chunk advances to the next body chunk,
+// rono_http_chunk_data returns it. libcurl is paused while the program holds
+// a chunk, so at most one chunk is buffered at a time.
+typedef struct {
+    CURLM* multi;
+    CURL* curl;
+    PooledHandle* slot;
+    HttpChunk chunk;
+    int has_chunk;
+    int paused;
+    int done;
+    CURLcode result;  // Of the finished transfer, once done
+} RonoHttpStream;
+
+static size_t IteratorCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    RonoHttpStream* stream = (RonoHttpStream*)userp;
+    size_t realsize = size * nmemb;
+    if (stream->has_chunk) {
+        // Previous chunk not consumed yet, libcurl hands this data back on unpause
+        stream->paused = 1;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+    if (!rono_http_chunk_set(&stream->chunk, contents, realsize)) {
+        return 0;
+    }
+    stream->has_chunk = 1;
+    return realsize;
+}
+
+// Start a streaming GET. Returns NULL if the transfer could not be set up.
+RonoHttpStream* rono_http_open(const char* url) {
+    rono_http_init();
+
+    RonoHttpStream* stream = calloc(1, sizeof(RonoHttpStream));
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    stream->multi = curl_multi_init();
+    stream->curl = stream->multi ? rono_http_acquire(url, &stream->slot) : NULL;
+    if (stream->curl == NULL) {
+        if (stream->multi) curl_multi_cleanup(stream->multi);
+        free(stream);
+        return NULL;
+    }
+
+    rono_http_setup(stream->curl, NULL, url, NULL, NULL);
+    curl_easy_setopt(stream->curl, CURLOPT_WRITEFUNCTION, IteratorCallback);
+    curl_easy_setopt(stream->curl, CURLOPT_WRITEDATA, stream);
+    curl_multi_add_handle(stream->multi, stream->curl);
+    return stream;
+}
+
+// Advance to the next chunk. Returns its length, 0 once the body is exhausted.
+int64_t rono_http_next_chunk(RonoHttpStream* stream) {
+    if (stream == NULL) {
+        return 0;
+    }
+
+    stream->has_chunk = 0;
+    stream->chunk.size = 0;
+    if (stream->paused) {
+        stream->paused = 0;
+        curl_easy_pause(stream->curl, CURLPAUSE_CONT);
+    }
+
+    while (!stream->has_chunk && !stream->done) {
+        int running = 0;
+        curl_multi_perform(stream->multi, &running);
+
+        CURLMsg* msg;
+        int queued = 0;
+        while ((msg = curl_multi_info_read(stream->multi, &queued)) != NULL) {
+            if (msg->msg == CURLMSG_DONE) {
+                stream->done = 1;
+                stream->result = msg->data.result;
+            }
+        }
+
+        if (!stream->has_chunk && !stream->done) {
+            curl_multi_poll(stream->multi, NULL, 0, 1000, NULL);
+        }
+    }
+
+    return stream->has_chunk ? (int64_t)stream->chunk.size : 0;
+}
+
+// Current chunk (NUL-terminated), valid until the next rono_http_next_chunk
+const char* rono_http_chunk_data(RonoHttpStream* stream) {
+    if (stream == NULL || !stream->has_chunk) {
+        return rono_str_empty.data;
+    }
+    return stream->chunk.data;
+}
+
+// HTTP status of a stream, 0 until the response headers have arrived
+int64_t rono_http_stream_status(RonoHttpStream* stream) {
+    return stream ? rono_http_status(stream->curl) : 0;
+}
+
+// Finish (or abort) a stream and return its handle to the pool
+void rono_http_close(RonoHttpStream* stream) {
+    if (stream == NULL) {
+        return;
+    }
+    // A stream closed before its body ended counts as aborted
+    RONO_METRIC_HTTP(stream->curl, NULL, NULL, stream->done ? stream->result : CURLE_ABORTED_BY_CALLBACK);
+    curl_multi_remove_handle(stream->multi, stream->curl);
+    rono_http_release(stream->curl, stream->slot);
+    curl_multi_cleanup(stream->multi);
+    rono_str_heap_free(stream->chunk.data);
+    free(stream);
+}
+
+#ifdef RONO_METRICS
+static int rono_metrics_method(const char* method, const char* data) {
+    if (method == NULL) {
+        return data != NULL ? RONO_HTTP_POST : RONO_HTTP_GET;
+    }
+    if (strcasecmp(method, "GET") == 0) return RONO_HTTP_GET;
+    if (strcasecmp(method, "POST") == 0) return RONO_HTTP_POST;
+    if (strcasecmp(method, "PUT") == 0) return RONO_HTTP_PUT;
+    if (strcasecmp(method, "DELETE") == 0) return RONO_HTTP_DELETE;
+    return RONO_HTTP_OTHER;
+}
+
+static uint64_t rono_metrics_micros(curl_off_t value) {
+    return value > 0 ? (uint64_t)value : 0;
+}
+
+// Record a finished transfer; called before the handle goes back to the
+// pool, while its timings are still there. method and data are as passed
+// to rono_http_setup.
+static void rono_metrics_http(CURL* curl, const char* method, const char* data, CURLcode result) {
+    RonoMetrics* metrics = rono_metrics_thread();
+    if (metrics == NULL) {
+        return;
+    }
+    RonoHttpMetrics* http = &metrics->http[rono_metrics_method(method, data)];
+
+    // Times are microseconds since the transfer started
+    curl_off_t connect = 0, appconnect = 0, total = 0, down = 0, up = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &down);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &up);
+    // Reused connections report 0 for both; plain HTTP has no appconnect
+    uint64_t connected = rono_metrics_micros(appconnect > connect ? appconnect : connect);
+    uint64_t elapsed = rono_metrics_micros(total);
+
+    rono_metrics_bump(&http->requests, 1);
+    if (result != CURLE_OK) {
+        rono_metrics_bump(&http->errors, 1);
+    }
+    rono_metrics_bump(&http->bytes_in, rono_metrics_micros(down));
+    rono_metrics_bump(&http->bytes_out, rono_metrics_micros(up));
+    rono_metrics_bump(&http->connect_us, rono_metrics_micros(connect));
+    rono_metrics_bump(&http->tls_us, appconnect > connect ? rono_metrics_micros(appconnect - connect) : 0);
+    rono_metrics_bump(&http->transfer_us, elapsed > connected ? elapsed - connected : 0);
+
+    int bucket = elapsed > 0 ? 63 - __builtin_clzll(elapsed) : 0;
+    if (bucket >= RONO_METRICS_BUCKETS) {
+        bucket = RONO_METRICS_BUCKETS - 1;
+    }
+    rono_metrics_bump(&http->latency[bucket], 1);
+}
+
+// JSON is assembled in a static buffer with rono_format_uint and written
+// with write(2), so a dump is safe from the SIGUSR1 handler
+#define RONO_METRICS_JSON_MAX (32 * 1024)
+
+static char rono_metrics_json[RONO_METRICS_JSON_MAX];
+static size_t rono_metrics_json_len;
+static const char* rono_metrics_target = NULL;
+static int rono_metrics_dumping = 0;
+
+static void rono_metrics_put(const char* text) {
+    size_t len = strlen(text);
+    if (rono_metrics_json_len + len <= RONO_METRICS_JSON_MAX) {
+        memcpy(rono_metrics_json + rono_metrics_json_len, text, len);
+        rono_metrics_json_len += len;
+    }
+}
+
+static void rono_metrics_put_uint(uint64_t value) {
+    char digits[RONO_NUMBER_MAX];
+    size_t len = rono_format_uint(value, digits);
+    digits[len] = '\0';
+    rono_metrics_put(digits);
+}
+
+static void rono_metrics_field(const char* name, uint64_t value, int last) {
+    rono_metrics_put("\"");
+    rono_metrics_put(name);
+    rono_metrics_put("\": ");
+    rono_metrics_put_uint(value);
+    rono_metrics_put(last ? "" : ", ");
+}
+
+// Sum over every thread's block of the counter at offset
+static uint64_t rono_metrics_sum(size_t offset) {
+    uint64_t total = 0;
+    for (RonoMetrics* metrics = __atomic_load_n(&rono_metrics_threads, __ATOMIC_ACQUIRE);
+         metrics != NULL; metrics = metrics->next) {
+        total += __atomic_load_n((uint64_t*)((char*)metrics + offset), __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+#define RONO_METRICS_COUNTER(counter) rono_metrics_sum(offsetof(RonoMetrics, counters) + (counter) * sizeof(uint64_t))
+#define RONO_METRICS_HTTP_AT(method, offset) \
+    rono_metrics_sum(offsetof(RonoMetrics, http) + (method) * sizeof(RonoHttpMetrics) + (offset))
+#define RONO_METRICS_HTTP(method, field) RONO_METRICS_HTTP_AT(method, offsetof(RonoHttpMetrics, field))
+
+static void rono_metrics_dump(void) {
+    if (__atomic_exchange_n(&rono_metrics_dumping, 1, __ATOMIC_ACQUIRE)) {
+        return; // A signal arrived during another dump
+    }
+
+    static const char* const methods[RONO_HTTP_METHODS] = { "GET", "POST", "PUT", "DELETE", "OTHER" };
+    int threads = 0;
+    for (RonoMetrics* metrics = __atomic_load_n(&rono_metrics_threads, __ATOMIC_ACQUIRE);
+         metrics != NULL; metrics = metrics->next) {
+        threads++;
+    }
+
+    rono_metrics_json_len = 0;
+    rono_metrics_put("{\"threads\": ");
+    rono_metrics_put_uint((uint64_t)threads);
+
+    rono_metrics_put(", \"http\": {");
+    int first = 1;
+    for (int method = 0; method < RONO_HTTP_METHODS; method++) {
+        if (RONO_METRICS_HTTP(method, requests) == 0) {
+            continue;
+        }
+        rono_metrics_put(first ? "\"" : ", \"");
+        first = 0;
+        rono_metrics_put(methods[method]);
+        rono_metrics_put("\": {");
+        rono_metrics_field("requests", RONO_METRICS_HTTP(method, requests), 0);
+        rono_metrics_field("errors", RONO_METRICS_HTTP(method, errors), 0);
+        rono_metrics_field("bytes_in", RONO_METRICS_HTTP(method, bytes_in), 0);
+        rono_metrics_field("bytes_out", RONO_METRICS_HTTP(method, bytes_out), 0);
+        rono_metrics_field("connect_us", RONO_METRICS_HTTP(method, connect_us), 0);
+        rono_metrics_field("tls_us", RONO_METRICS_HTTP(method, tls_us), 0);
+        rono_metrics_field("transfer_us", RONO_METRICS_HTTP(method, transfer_us), 0);
+        // [upper bound in microseconds, count] for every non-empty bucket
+        rono_metrics_put("\"latency_us\": [");
+        int first_bucket = 1;
+        for (int bucket = 0; bucket < RONO_METRICS_BUCKETS; bucket++) {
+            uint64_t count = RONO_METRICS_HTTP_AT(method, offsetof(RonoHttpMetrics, latency) + bucket * sizeof(uint64_t));
+            if (count == 0) {
+                continue;
+            }
+            rono_metrics_put(first_bucket ? "[" : ", [");
+            first_bucket = 0;
+            rono_metrics_put_uint((uint64_t)1 << (bucket + 1));
+            rono_metrics_put(", ");
+            rono_metrics_put_uint(count);
+            rono_metrics_put("]");
+        }
+        rono_metrics_put("]}");
+    }
+    rono_metrics_put("}, \"http_buffer\": {");
+    rono_metrics_field("bytes", RONO_METRICS_COUNTER(RONO_M_HTTP_BUFFERED), 0);
+    rono_metrics_field("grows", RONO_METRICS_COUNTER(RONO_M_HTTP_GROWS), 1);
+
+    rono_metrics_put("}, \"alloc\": {");
+    rono_metrics_field("region_allocs", RONO_METRICS_COUNTER(RONO_M_REGION_ALLOCS), 0);
+    rono_metrics_field("region_bytes", RONO_METRICS_COUNTER(RONO_M_REGION_BYTES), 0);
+    rono_metrics_field("heap_allocs", RONO_METRICS_COUNTER(RONO_M_HEAP_ALLOCS), 0);
+    rono_metrics_field("heap_bytes", RONO_METRICS_COUNTER(RONO_M_HEAP_BYTES), 1);
+
+    rono_metrics_put("}, \"output\": {");
+    rono_metrics_field("lines", RONO_METRICS_COUNTER(RONO_M_OUT_LINES), 0);
+    rono_metrics_field("bytes", RONO_METRICS_COUNTER(RONO_M_OUT_BYTES), 0);
+    rono_metrics_field("writes", RONO_METRICS_COUNTER(RONO_M_OUT_WRITES), 1);
+
+    rono_metrics_put("}, \"input\": {");
+    rono_metrics_field("lines", RONO_METRICS_COUNTER(RONO_M_IN_LINES), 0);
+    rono_metrics_field("bytes", RONO_METRICS_COUNTER(RONO_M_IN_BYTES), 0);
+    rono_metrics_field("reads", RONO_METRICS_COUNTER(RONO_M_IN_READS), 1);
+    rono_metrics_put("}}\n");
+
+    int to_stderr = strcmp(rono_metrics_target, "1") == 0 || strcmp(rono_metrics_target, "stderr") == 0;
+    int fd = to_stderr ? STDERR_FILENO : open(rono_metrics_target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        const char* data = rono_metrics_json;
+        size_t left = rono_metrics_json_len;
+        while (left > 0) {
+            ssize_t written = write(fd, data, left);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            data += written;
+            left -= (size_t)written;
+        }
+        if (!to_stderr) {
+            close(fd);
+        }
+    }
+
+    __atomic_store_n(&rono_metrics_dumping, 0, __ATOMIC_RELEASE);
+}
+
+static void rono_metrics_signal(int signal) {
+    (void)signal;
+    int saved_errno = errno;
+    rono_metrics_dump();
+    errno = saved_errno;
+}
+
+// Runs before main. Registered first, the exit dump runs after the output
+// flush and the HTTP cleanup registered later.
+__attribute__((constructor)) static void rono_metrics_init(void) {
+    const char* target = getenv("RONO_METRICS");
+    if (target == NULL || *target == '\0') {
+        return;
+    }
+    rono_metrics_target = target;
+    atexit(rono_metrics_dump);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = rono_metrics_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+}
+#endif
@@ -1,8 +1,9 @@
 use crate::ast::*;
 use crate::types::{ChifType, ChifValue};
 use crate::compiler::SourceLocation;
+use crate::modules;
+use crate::parallel;
 use std::collections::HashMap;
-use std::fs;
 use thiserror::Error;
 
 #[derive(Debug, Error)]
@@ -388,6 +389,18 @@ impl SemanticAnalyzer {
                 
                 self.symbol_table.pop_scope()?;
             }
+            Statement::ParFor(par_for) => {
+                self.check_par_for_header(par_for)?;
+                self.symbol_table.push_scope();
+                self.define_par_for_var(par_for)?;
+                
+                let old_in_loop = self.in_loop;
+                self.in_loop = true;
+                self.check_block_types(&par_for.body, expected_return_type)?;
+                self.in_loop = old_in_loop;
+                
+                self.symbol_table.pop_scope()?;
+            }
             Statement::Switch(switch_stmt) => {
                 let switch_type = self.analyze_expression(&switch_stmt.expr)?;
                 
@@ -439,7 +452,16 @@ impl SemanticAnalyzer {
             // Numeric conversions
             (ChifType::Float, ChifType::Int) => true, // Int can be promoted to Float
             
-            // Array/List compatibility
+            // Empty `[]` and `{}` literals fit any list, array or map
+            (ChifType::Array(..) | ChifType::List(..), ChifType::Array(actual_elem, _)) if **actual_elem == ChifType::Nil => true,
+            (ChifType::Map(..), ChifType::Map(actual_key, _)) if **actual_key == ChifType::Nil => true,
+            
+            // Array/List compatibility; a nested literal `[[..], [..]]` is
+            // one array type with several dimensions
+            (ChifType::Array(expected_elem, _), ChifType::Array(actual_elem, actual_dims))
+                if matches!(**expected_elem, ChifType::Array(..)) && actual_dims.len() > 1 => {
+                self.types_compatible(expected_elem, &ChifType::Array(actual_elem.clone(), actual_dims[1..].to_vec()))
+            }
             (ChifType::Array(expected_elem, _), ChifType::Array(actual_elem, _)) => {
                 self.types_compatible(expected_elem, actual_elem)
             }
@@ -524,6 +546,8 @@ impl SemanticAnalyzer {
     }
     
     pub fn analyze(&mut self, program: &Program) -> Result<AnalyzedProgram, SemanticError> {
+        modules::preload(&program.items);
+        
         // First pass: collect all function and struct definitions
         self.collect_definitions(program)?;
         
@@ -751,6 +775,18 @@ impl SemanticAnalyzer {
                 
                 self.symbol_table.pop_scope()?;
             }
+            Statement::ParFor(par_for) => {
+                self.check_par_for_header(par_for)?;
+                self.symbol_table.push_scope();
+                self.define_par_for_var(par_for)?;
+                
+                let old_in_loop = self.in_loop;
+                self.in_loop = true;
+                self.analyze_block(&par_for.body)?;
+                self.in_loop = old_in_loop;
+                
+                self.symbol_table.pop_scope()?;
+            }
             Statement::Switch(switch_stmt) => {
                 self.analyze_expression(&switch_stmt.expr)?;
                 for case in &switch_stmt.cases {
@@ -778,6 +814,54 @@ impl SemanticAnalyzer {
         Ok(())
     }
     
+    // The body may run in parallel (see parallel::check_par_for), the range
+    // is int and reduction targets are int or float variables
+    fn check_par_for_header(&mut self, par_for: &ParForStatement) -> Result<(), SemanticError> {
+        parallel::check_par_for(par_for).map_err(|message| SemanticError::InvalidOperation {
+            location: SourceLocation::unknown(),
+            message,
+        })?;
+        
+        for bound in [&par_for.start, &par_for.end] {
+            let bound_type = self.analyze_expression(bound)?;
+            if bound_type != ChifType::Int {
+                return Err(SemanticError::TypeMismatch {
+                    location: SourceLocation::unknown(),
+                    expected: ChifType::Int,
+                    found: bound_type,
+                });
+            }
+        }
+        
+        for reduction in &par_for.reductions {
+            match self.symbol_table.lookup_symbol(&reduction.name).map(|symbol| &symbol.symbol_type) {
+                Some(SymbolType::Variable(ChifType::Int | ChifType::Float)) => {}
+                Some(SymbolType::Variable(other)) => {
+                    return Err(SemanticError::InvalidOperation {
+                        location: SourceLocation::unknown(),
+                        message: format!("Reduction variable '{}' must be int or float, found {}", reduction.name, other),
+                    });
+                }
+                _ => {
+                    return Err(SemanticError::UndefinedSymbol {
+                        symbol: reduction.name.clone(),
+                        location: SourceLocation::unknown(),
+                    });
+                }
+            }
+        }
+        Ok(())
+    }
+    
+    fn define_par_for_var(&mut self, par_for: &ParForStatement) -> Result<(), SemanticError> {
+        self.symbol_table.define_symbol(Symbol {
+            name: par_for.var.clone(),
+            symbol_type: SymbolType::Variable(ChifType::Int),
+            location: SourceLocation::unknown(),
+            is_mutable: false,
+        })
+    }
+    
     fn analyze_expression(&mut self, expression: &Expression) -> Result<ChifType, SemanticError> {
         match expression {
             Expression::Literal(value) => {
@@ -897,6 +981,61 @@ impl SemanticAnalyzer {
                     arg_types.push(self.analyze_expression(arg)?);
                 }
                 
+                // Conversions accept any scalar argument
+                let conversion_type = match func_call.name.as_str() {
+                    "toInt" => Some(ChifType::Int),
+                    "toFloat" => Some(ChifType::Float),
+                    "toStr" => Some(ChifType::Str),
+                    _ => None,
+                };
+                if let Some(return_type) = conversion_type {
+                    return match arg_types.as_slice() {
+                        [ChifType::Int | ChifType::Float | ChifType::Str | ChifType::Bool] => Ok(return_type),
+                        [other] => Err(SemanticError::TypeMismatch {
+                            location: SourceLocation::unknown(),
+                            expected: ChifType::Str,
+                            found: other.clone(),
+                        }),
+                        _ => Err(SemanticError::InvalidOperation {
+                            location: SourceLocation::unknown(),
+                            message: format!("Function '{}' expects 1 arguments, got {}", func_call.name, arg_types.len()),
+                        }),
+                    };
+                }
+                
+                // randfill(a, min, max) fills an int or float array of any
+                // shape in place; the bounds have the element type
+                if func_call.name == "randfill" {
+                    let element_type = match arg_types.first() {
+                        Some(ChifType::Array(element, _)) => {
+                            let mut element = &**element;
+                            while let ChifType::Array(inner, _) = element {
+                                element = inner;
+                            }
+                            element.clone()
+                        }
+                        _ => ChifType::Nil,
+                    };
+                    return match (&element_type, &arg_types[..]) {
+                        (ChifType::Int | ChifType::Float, [_, min, max]) => {
+                            for bound in [min, max] {
+                                if *bound != element_type {
+                                    return Err(SemanticError::TypeMismatch {
+                                        location: SourceLocation::unknown(),
+                                        expected: element_type.clone(),
+                                        found: bound.clone(),
+                                    });
+                                }
+                            }
+                            Ok(ChifType::Nil)
+                        }
+                        _ => Err(SemanticError::InvalidOperation {
+                            location: SourceLocation::unknown(),
+                            message: "randfill expects an int or float array and two bounds of its element type".to_string(),
+                        }),
+                    };
+                }
+                
                 // Check if function exists
                 if let Some(symbol) = self.symbol_table.lookup_symbol(&func_call.name) {
                     match &symbol.symbol_type {
@@ -1064,6 +1203,34 @@ impl SemanticAnalyzer {
                             self.analyze_expression(arg)?;
                         }
                         return Ok(ChifType::Nil); // con.out returns void
+                    } else if object_name == "con" && method_call.method == "flush" {
+                        // con.flush() writes out buffered output
+                        if !method_call.args.is_empty() {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: "con.flush expects no arguments".to_string(),
+                            });
+                        }
+                        return Ok(ChifType::Nil);
+                    } else if object_name == "con" && method_call.method == "buffer" {
+                        // con.buffer(size, line_flush) configures output buffering
+                        if method_call.args.len() != 2 {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: "con.buffer expects 2 arguments (size, line_flush)".to_string(),
+                            });
+                        }
+                        for arg in &method_call.args {
+                            let arg_type = self.analyze_expression(arg)?;
+                            if arg_type != ChifType::Int {
+                                return Err(SemanticError::TypeMismatch {
+                                    location: SourceLocation::unknown(),
+                                    expected: ChifType::Int,
+                                    found: arg_type,
+                                });
+                            }
+                        }
+                        return Ok(ChifType::Nil);
                     } else if object_name == "con" && method_call.method == "in" {
                         // con.in takes no arguments and returns int for now
                         if !method_call.args.is_empty() {
@@ -1150,6 +1317,125 @@ impl SemanticAnalyzer {
                             });
                         }
                         return Ok(ChifType::Str);
+                    } else if object_name == "http" && (method_call.method == "get_many" || method_call.method == "request_many") {
+                        // http.get_many(urls, [count,] max_concurrency)
+                        // http.request_many(methods, urls, bodies, [count,] max_concurrency)
+                        // Both return an array of HttpResponse
+                        let array_args = if method_call.method == "get_many" { 1 } else { 3 };
+                        let arg_count = method_call.args.len();
+                        if arg_count != array_args + 1 && arg_count != array_args + 2 {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: format!(
+                                    "http.{} expects {} or {} arguments",
+                                    method_call.method, array_args + 1, array_args + 2
+                                ),
+                            });
+                        }
+                        for (i, arg) in method_call.args.iter().enumerate() {
+                            let arg_type = self.analyze_expression(arg)?;
+                            let valid = if i < array_args {
+                                matches!(&arg_type, ChifType::Array(elem, _) | ChifType::List(elem, _) if **elem == ChifType::Str)
+                            } else {
+                                arg_type == ChifType::Int
+                            };
+                            if !valid {
+                                return Err(SemanticError::TypeMismatch {
+                                    location: SourceLocation::unknown(),
+                                    expected: if i < array_args {
+                                        ChifType::Array(Box::new(ChifType::Str), vec![])
+                                    } else {
+                                        ChifType::Int
+                                    },
+                                    found: arg_type,
+                                });
+                            }
+                        }
+                        return Ok(ChifType::Array(Box::new(ChifType::Struct("HttpResponse".to_string())), vec![]));
+                    } else if object_name == "http" && method_call.method == "stream" {
+                        // http.stream(url, handler) returns the HTTP status;
+                        // handler must be fn (chunk: str, len: int) int
+                        if method_call.args.len() != 2 {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: "http.stream expects 2 arguments (url, handler)".to_string(),
+                            });
+                        }
+                        let url_type = self.analyze_expression(&method_call.args[0])?;
+                        if url_type != ChifType::Str {
+                            return Err(SemanticError::TypeMismatch {
+                                location: SourceLocation::unknown(),
+                                expected: ChifType::Str,
+                                found: url_type,
+                            });
+                        }
+                        let handler_ok = match &method_call.args[1] {
+                            Expression::Identifier(handler_name) => match self.symbol_table.lookup_symbol(handler_name) {
+                                Some(Symbol { symbol_type: SymbolType::Function(signature), .. }) => {
+                                    signature.parameters.len() == 2
+                                        && signature.parameters[0].param_type == ChifType::Str
+                                        && signature.parameters[1].param_type == ChifType::Int
+                                        && signature.return_type == ChifType::Int
+                                }
+                                _ => false,
+                            },
+                            _ => false,
+                        };
+                        if !handler_ok {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: "http.stream handler must be fn (chunk: str, len: int) int".to_string(),
+                            });
+                        }
+                        return Ok(ChifType::Int);
+                    } else if object_name == "http" && matches!(
+                        method_call.method.as_str(),
+                        "download" | "open" | "next_chunk" | "chunk" | "stream_status" | "close"
+                    ) {
+                        // Streams are opaque handles carried as int
+                        let (param_types, return_type) = match method_call.method.as_str() {
+                            "download" => (vec![ChifType::Str, ChifType::Str], ChifType::Int),
+                            "open" => (vec![ChifType::Str], ChifType::Int),
+                            "chunk" => (vec![ChifType::Int], ChifType::Str),
+                            "close" => (vec![ChifType::Int], ChifType::Nil),
+                            _ => (vec![ChifType::Int], ChifType::Int),
+                        };
+                        if method_call.args.len() != param_types.len() {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: format!("http.{} expects {} argument(s)", method_call.method, param_types.len()),
+                            });
+                        }
+                        for (arg, expected) in method_call.args.iter().zip(param_types) {
+                            let arg_type = self.analyze_expression(arg)?;
+                            if arg_type != expected {
+                                return Err(SemanticError::TypeMismatch {
+                                    location: SourceLocation::unknown(),
+                                    expected,
+                                    found: arg_type,
+                                });
+                            }
+                        }
+                        return Ok(return_type);
+                    } else if object_name == "http" && method_call.method == "configure" {
+                        // http.configure(pool_size, idle_timeout) returns void
+                        if method_call.args.len() != 2 {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: "http.configure expects 2 arguments (pool_size, idle_timeout)".to_string(),
+                            });
+                        }
+                        for arg in &method_call.args {
+                            let arg_type = self.analyze_expression(arg)?;
+                            if arg_type != ChifType::Int {
+                                return Err(SemanticError::TypeMismatch {
+                                    location: SourceLocation::unknown(),
+                                    expected: ChifType::Int,
+                                    found: arg_type,
+                                });
+                            }
+                        }
+                        return Ok(ChifType::Nil);
                     }
                 }
                 
@@ -1210,6 +1496,35 @@ impl SemanticAnalyzer {
                             })
                         }
                     }
+                    ChifType::Str | ChifType::Array(..) | ChifType::List(..) | ChifType::Map(..) if method_call.method == "len" && arg_types.is_empty() => Ok(ChifType::Int),
+                    ChifType::List(element_type, dimensions) if matches!(method_call.method.as_str(), "add" | "addAt" | "del") => {
+                        let element_type = if dimensions.len() > 1 {
+                            ChifType::List(element_type, dimensions[1..].to_vec())
+                        } else {
+                            *element_type
+                        };
+                        let expected = match method_call.method.as_str() {
+                            "add" => vec![element_type],
+                            "addAt" => vec![element_type, ChifType::Int],
+                            _ => vec![ChifType::Int],
+                        };
+                        if arg_types.len() != expected.len() {
+                            return Err(SemanticError::InvalidOperation {
+                                location: SourceLocation::unknown(),
+                                message: format!("{} method expects {} argument(s)", method_call.method, expected.len()),
+                            });
+                        }
+                        for (expected, found) in expected.into_iter().zip(arg_types) {
+                            if !self.types_compatible(&expected, &found) {
+                                return Err(SemanticError::TypeMismatch {
+                                    location: SourceLocation::unknown(),
+                                    expected,
+                                    found,
+                                });
+                            }
+                        }
+                        Ok(ChifType::Nil)
+                    }
                     _ => Err(SemanticError::InvalidOperation {
                         location: SourceLocation::unknown(),
                         message: format!("Cannot call method '{}' on non-struct type {:?}", method_call.method, object_type),
@@ -1255,6 +1570,25 @@ impl SemanticAnalyzer {
                 // Analyze the array expression
                 let array_type = self.analyze_expression(&index_access.object)?;
                 
+                // A map is indexed by a single key and yields its value type
+                if let ChifType::Map(key_type, value_type) = &array_type {
+                    if index_access.indices.len() != 1 {
+                        return Err(SemanticError::InvalidOperation {
+                            location: SourceLocation::unknown(),
+                            message: "Maps are indexed by a single key".to_string(),
+                        });
+                    }
+                    let index_type = self.analyze_expression(&index_access.indices[0])?;
+                    if !self.types_compatible(key_type, &index_type) {
+                        return Err(SemanticError::TypeMismatch {
+                            location: SourceLocation::unknown(),
+                            expected: (**key_type).clone(),
+                            found: index_type,
+                        });
+                    }
+                    return Ok((**value_type).clone());
+                }
+                
                 // Analyze all index expressions
                 for index_expr in &index_access.indices {
                     let index_type = self.analyze_expression(index_expr)?;
@@ -1285,7 +1619,14 @@ impl SemanticAnalyzer {
                             }
                         }
                     }
-                    ChifType::List(element_type, _) => Ok(*element_type),
+                    ChifType::List(element_type, dimensions) => {
+                        // Indexing a nested list peels one dimension per index
+                        if index_access.indices.len() < dimensions.len() {
+                            Ok(ChifType::List(element_type, dimensions[index_access.indices.len()..].to_vec()))
+                        } else {
+                            Ok(*element_type)
+                        }
+                    }
                     _ => Err(SemanticError::InvalidOperation {
                         location: SourceLocation::unknown(),
                         message: format!("Cannot index non-array type {:?}", array_type),
@@ -1308,6 +1649,32 @@ impl SemanticAnalyzer {
                     }),
                 }
             }
+            // Holes are evaluated at run time; one that fails is printed as written
+            Expression::Template(_) => Ok(ChifType::Str),
+            Expression::MapLiteral(pairs) => {
+                // `{}` is typed by the variable it initializes
+                let mut pair_types = Vec::with_capacity(pairs.len());
+                for (key, value) in pairs {
+                    pair_types.push((self.analyze_expression(key)?, self.analyze_expression(value)?));
+                }
+                match pair_types.first().cloned() {
+                    None => Ok(ChifType::Map(Box::new(ChifType::Nil), Box::new(ChifType::Nil))),
+                    Some((key_type, value_type)) => {
+                        for (key, value) in &pair_types[1..] {
+                            for (expected, found) in [(&key_type, key), (&value_type, value)] {
+                                if !self.types_compatible(expected, found) {
+                                    return Err(SemanticError::TypeMismatch {
+                                        location: SourceLocation::unknown(),
+                                        expected: expected.clone(),
+                                        found: found.clone(),
+                                    });
+                                }
+                            }
+                        }
+                        Ok(ChifType::Map(Box::new(key_type), Box::new(value_type)))
+                    }
+                }
+            }
             _ => {
                 // TODO: Handle other expression types
                 Ok(ChifType::Nil)
@@ -1378,39 +1745,41 @@ impl SemanticAnalyzer {
         };
         self.symbol_table.define_symbol(rands_symbol)?;
         
-        // Добавляем функции конвертации типов
-        // toInt() может принимать строку или число с плавающей точкой
-        let int_signature = FunctionSignature {
-            name: "toInt".to_string(),
+        let randseed_signature = FunctionSignature {
+            name: "randseed".to_string(),
             parameters: vec![
-                Parameter { name: "value".to_string(), param_type: ChifType::Float, is_reference: false },
+                Parameter { name: "seed".to_string(), param_type: ChifType::Int, is_reference: false },
             ],
-            return_type: ChifType::Int,
-            is_mutating: false,
+            return_type: ChifType::Nil,
+            is_mutating: false,  // Встроенные функции не мутируют
         };
-        let int_symbol = Symbol {
-            name: "toInt".to_string(),
-            symbol_type: SymbolType::Function(int_signature),
+        let randseed_symbol = Symbol {
+            name: "randseed".to_string(),
+            symbol_type: SymbolType::Function(randseed_signature),
             location: SourceLocation::unknown(),
             is_mutable: false,
         };
-        self.symbol_table.define_symbol(int_symbol)?;
+        self.symbol_table.define_symbol(randseed_symbol)?;
         
-        let int_str_signature = FunctionSignature {
+        // Добавляем функции конвертации типов. Они перегружены по типу
+        // аргумента, поэтому в таблице одна сигнатура на имя, а аргумент
+        // проверяется в analyze_expression
+        // toInt() может принимать строку или число с плавающей точкой
+        let int_signature = FunctionSignature {
             name: "toInt".to_string(),
             parameters: vec![
-                Parameter { name: "value".to_string(), param_type: ChifType::Str, is_reference: false },
+                Parameter { name: "value".to_string(), param_type: ChifType::Float, is_reference: false },
             ],
             return_type: ChifType::Int,
             is_mutating: false,
         };
-        let int_str_symbol = Symbol {
+        let int_symbol = Symbol {
             name: "toInt".to_string(),
-            symbol_type: SymbolType::Function(int_str_signature),
+            symbol_type: SymbolType::Function(int_signature),
             location: SourceLocation::unknown(),
             is_mutable: false,
         };
-        self.symbol_table.define_symbol(int_str_symbol)?;
+        self.symbol_table.define_symbol(int_symbol)?;
         
         // toFloat() может принимать строку или целое число
         let float_signature = FunctionSignature {
@@ -1429,22 +1798,6 @@ impl SemanticAnalyzer {
         };
         self.symbol_table.define_symbol(float_symbol)?;
         
-        let float_str_signature = FunctionSignature {
-            name: "toFloat".to_string(),
-            parameters: vec![
-                Parameter { name: "value".to_string(), param_type: ChifType::Str, is_reference: false },
-            ],
-            return_type: ChifType::Float,
-            is_mutating: false,
-        };
-        let float_str_symbol = Symbol {
-            name: "toFloat".to_string(),
-            symbol_type: SymbolType::Function(float_str_signature),
-            location: SourceLocation::unknown(),
-            is_mutable: false,
-        };
-        self.symbol_table.define_symbol(float_str_symbol)?;
-        
         // toStr() может принимать целое число или число с плавающей точкой
         let str_int_signature = FunctionSignature {
             name: "toStr".to_string(),
@@ -1462,20 +1815,6 @@ impl SemanticAnalyzer {
         };
         self.symbol_table.define_symbol(str_int_symbol)?;
         
-        let str_float_signature = FunctionSignature {
-            name: "toStr".to_string(),
-            parameters: vec![
-                Parameter { name: "value".to_string(), param_type: ChifType::Float, is_reference: false },
-            ],
-            return_type: ChifType::Str,
-            is_mutating: false,
-        };
-        let str_float_symbol = Symbol {
-            name: "toStr".to_string(),
-            symbol_type: SymbolType::Function(str_float_signature),
-            location: SourceLocation::unknown(),
-            is_mutable: false,
-        };
         let float_signature = FunctionSignature {
             name: "float".to_string(),
             parameters: vec![
@@ -1519,40 +1858,37 @@ impl SemanticAnalyzer {
         
         self.symbol_table.define_symbol(http_symbol)?;
         
+        // Element type of http.get_many / http.request_many results
+        let http_response_symbol = Symbol {
+            name: "HttpResponse".to_string(),
+            symbol_type: SymbolType::Struct(StructDefinition {
+                name: "HttpResponse".to_string(),
+                fields: vec![
+                    StructField { name: "status".to_string(), field_type: ChifType::Int },
+                    StructField { name: "body".to_string(), field_type: ChifType::Str },
+                    StructField { name: "content_type".to_string(), field_type: ChifType::Str },
+                ],
+            }),
+            location: SourceLocation::unknown(),
+            is_mutable: false,
+        };
+        
+        self.symbol_table.define_symbol(http_response_symbol)?;
+        
         Ok(())
     }
     
     fn process_import(&mut self, import: &ImportStatement) -> Result<(), SemanticError> {
-        // Add .rono extension if not present
-        let file_path = if import.path.ends_with(".rono") {
-            import.path.clone()
-        } else {
-            format!("{}.rono", import.path)
-        };
-        
-        // Read the imported file
-        let source = fs::read_to_string(&file_path).map_err(|_| {
-            SemanticError::InvalidOperation {
-                location: SourceLocation::unknown(),
-                message: format!("Could not read module file: {}", file_path),
-            }
-        })?;
-        
-        // Parse the imported file
-        use crate::{lexer::Lexer, parser::Parser};
-        let mut lexer = Lexer::new(&source);
-        let tokens = lexer.tokenize().map_err(|e| {
-            SemanticError::InvalidOperation {
-                location: SourceLocation::unknown(),
-                message: format!("Failed to tokenize module {}: {}", file_path, e),
-            }
-        })?;
+        // A module reached again through another import is already loaded
+        let module_name = modules::module_name(import);
+        if self.modules.contains_key(&module_name) {
+            return Ok(());
+        }
         
-        let mut parser = Parser::new(tokens);
-        let imported_program = parser.parse().map_err(|e| {
+        let imported_program = modules::load(import).map_err(|e| {
             SemanticError::InvalidOperation {
                 location: SourceLocation::unknown(),
-                message: format!("Failed to parse module {}: {}", file_path, e),
+                message: e.to_string(),
             }
         })?;
         
@@ -1572,14 +1908,6 @@ impl SemanticAnalyzer {
                     module_functions.insert(func.name.clone(), signature.clone());
                     
                     // Add function to global symbol table with module prefix
-                    let module_name = import.alias.clone().unwrap_or_else(|| {
-                        std::path::Path::new(&import.path)
-                            .file_stem()
-                            .unwrap()
-                            .to_string_lossy()
-                            .to_string()
-                    });
-                    
                     let qualified_name = format!("{}_{}", module_name, func.name);
                     let symbol = Symbol {
                         name: qualified_name,
@@ -1598,14 +1926,6 @@ impl SemanticAnalyzer {
                     module_structs.insert(struct_def.name.clone(), struct_definition.clone());
                     
                     // Add struct to global symbol table with module prefix
-                    let module_name = import.alias.clone().unwrap_or_else(|| {
-                        std::path::Path::new(&import.path)
-                            .file_stem()
-                            .unwrap()
-                            .to_string_lossy()
-                            .to_string()
-                    });
-                    
                     let qualified_name = format!("{}_{}", module_name, struct_def.name);
                     let symbol = Symbol {
                         name: qualified_name,
@@ -1618,14 +1938,6 @@ impl SemanticAnalyzer {
                 }
                 Item::StructImpl(impl_block) => {
                     // Add methods to symbol table with module and struct prefix
-                    let module_name = import.alias.clone().unwrap_or_else(|| {
-                        std::path::Path::new(&import.path)
-                            .file_stem()
-                            .unwrap()
-                            .to_string_lossy()
-                            .to_string()
-                    });
-                    
                     for method in &impl_block.methods {
                         let method_name = format!("{}_{}_{}", module_name, impl_block.struct_name, method.name);
                         let signature = FunctionSignature {
@@ -1645,19 +1957,11 @@ impl SemanticAnalyzer {
                         self.symbol_table.define_symbol(symbol)?;
                     }
                 }
-                _ => {} // Ignore nested imports for now
+                Item::Import(_) => {} // Loaded below, once this module is registered
             }
         }
         
         // Store module information
-        let module_name = import.alias.clone().unwrap_or_else(|| {
-            std::path::Path::new(&import.path)
-                .file_stem()
-                .unwrap()
-                .to_string_lossy()
-                .to_string()
-        });
-        
         let module_info = ModuleInfo {
             name: module_name.clone(),
             functions: module_functions,
@@ -1666,6 +1970,12 @@ impl SemanticAnalyzer {
         
         self.modules.insert(module_name, module_info);
         
+        for item in &imported_program.items {
+            if let Item::Import(nested) = item {
+                self.process_import(nested)?;
+            }
+        }
+        
         Ok(())
     }
     
@@ -24,9 +24,11 @@ mod tests {
                     body: Block {
                         statements: vec![
                             Statement::Return(Some(Expression::Identifier("x".to_string())))
-                        ]
+                        ],
+                        lines: Vec::new(),
                     },
                     is_main: false,
+                    locals: Default::default(),
                 })
             ]
         };
@@ -49,9 +51,11 @@ mod tests {
                     body: Block {
                         statements: vec![
                             Statement::Return(Some(Expression::Identifier("undefined_var".to_string())))
-                        ]
+                        ],
+                        lines: Vec::new(),
                     },
                     is_main: false,
+                    locals: Default::default(),
                 })
             ]
         };
@@ -76,12 +80,15 @@ mod tests {
                             Statement::VarDecl(VarDecl {
                                 name: "x".to_string(),
                                 var_type: ChifType::Int,
-                                value: Some(Expression::Literal(ChifValue::Str("hello".to_string()))),
+                                value: Some(Expression::Literal(ChifValue::Str("hello".into()))),
                                 is_mutable: false,
+                                slot: None,
                             })
-                        ]
+                        ],
+                        lines: Vec::new(),
                     },
                     is_main: false,
+                    locals: Default::default(),
                 })
             ]
         };
@@ -112,11 +119,14 @@ mod tests {
                                     right: Box::new(Expression::Literal(ChifValue::Int(3))),
                                 })),
                                 is_mutable: false,
+                                slot: None,
                             }),
                             Statement::Return(Some(Expression::Identifier("x".to_string())))
-                        ]
+                        ],
+                        lines: Vec::new(),
                     },
                     is_main: false,
+                    locals: Default::default(),
                 })
             ]
         };
@@ -143,11 +153,14 @@ mod tests {
                                 var_type: ChifType::Int,
                                 value: Some(Expression::Literal(ChifValue::Int(42))),
                                 is_mutable: false,
+                                slot: None,
                             })
                             // Missing return statement
-                        ]
+                        ],
+                        lines: Vec::new(),
                     },
                     is_main: false,
+                    locals: Default::default(),
                 })
             ]
         };
@@ -180,17 +193,21 @@ mod tests {
                                 then_block: Block {
                                     statements: vec![
                                         Statement::Return(Some(Expression::Literal(ChifValue::Int(1))))
-                                    ]
+                                    ],
+                                    lines: Vec::new(),
                                 },
                                 else_block: Some(Block {
                                     statements: vec![
                                         Statement::Return(Some(Expression::Literal(ChifValue::Int(0))))
-                                    ]
+                                    ],
+                                    lines: Vec::new(),
                                 }),
                             })
-                        ]
+                        ],
+                        lines: Vec::new(),
                     },
                     is_main: false,
+                    locals: Default::default(),
                 })
             ]
         };
@@ -0,0 +1,350 @@
+use crate::ast::*;
+use crate::compiler::OptLevel;
+use crate::jit;
+use crate::semantic::SemanticAnalyzer;
+use crate::types::{ChifType, ChifValue};
+
+use cranelift_jit::JITModule;
+use std::collections::{HashMap, HashSet};
+use std::rc::Rc;
+
+// Tiered execution behind `rono run --tiered`: the interpreter counts calls
+// and loop back-edges per function, and a function that gets hot is
+// compiled with the JIT code generator and called natively from then on.
+//
+// Only functions whose native code behaves exactly like the interpreter are
+// promoted: int/float/bool parameters, locals and results, arithmetic,
+// comparisons, `if` / `while` / `for` and calls to other such functions.
+// Anything else (strings, containers, structs, output, builtins, operations
+// that fail at run time in the interpreter) keeps the function interpreted.
+// Compilation happens synchronously on the call that crosses a threshold.
+pub struct Tier {
+    opt_level: OptLevel,
+    profiles: HashMap<String, Profile>,
+    // Unresolved definitions by function name, as the code generator takes them
+    sources: HashMap<String, Function>,
+    // Compiled code stays mapped while any native entry point may be called
+    modules: Vec<JITModule>,
+}
+
+// Calls before a function is compiled
+pub(crate) const TIER_CALL_THRESHOLD: u32 = 1000;
+// Loop iterations, summed over finished calls, before a function is compiled
+pub(crate) const TIER_LOOP_THRESHOLD: u64 = 100_000;
+
+// Calls the interpreter handles itself before looking at user functions
+const BUILTIN_NAMES: [&str; 8] = ["toInt", "toFloat", "toStr", "randi", "randf", "rands", "randfill", "randseed"];
+
+struct Profile {
+    // Frame slot names of the resolved function, shared by all its copies;
+    // tells the registered function apart from a struct method of the same name
+    locals: Rc<Vec<String>>,
+    calls: u32,
+    back_edges: u64,
+    state: TierState,
+}
+
+enum TierState {
+    Counting,
+    Native(NativeFunction),
+    Rejected,
+}
+
+struct NativeFunction {
+    entry: extern "C" fn(*const u64, *mut u64),
+    params: Vec<ChifType>,
+    return_type: Option<ChifType>,
+}
+
+impl Tier {
+    pub fn new(opt_level: OptLevel) -> Self {
+        Self {
+            opt_level,
+            profiles: HashMap::new(),
+            sources: HashMap::new(),
+            modules: Vec::new(),
+        }
+    }
+
+    // `source` is the function as parsed, `resolved` the copy the
+    // interpreter calls
+    pub fn register(&mut self, source: &Function, resolved: &Function) {
+        self.sources.insert(source.name.clone(), source.clone());
+        self.profiles.insert(source.name.clone(), Profile {
+            locals: Rc::clone(&resolved.locals),
+            calls: 0,
+            back_edges: 0,
+            state: TierState::Counting,
+        });
+    }
+
+    // Result of running the call natively, or None to interpret it
+    pub fn call(&mut self, func: &Function, args: &[ChifValue]) -> Option<ChifValue> {
+        let profile = self.profiles.get_mut(&func.name)?;
+        if !Rc::ptr_eq(&profile.locals, &func.locals) {
+            return None;
+        }
+
+        if let TierState::Counting = profile.state {
+            profile.calls += 1;
+            if profile.calls < TIER_CALL_THRESHOLD && profile.back_edges < TIER_LOOP_THRESHOLD {
+                return None;
+            }
+            let state = self.promote(&func.name);
+            self.profiles.get_mut(&func.name)?.state = state;
+        }
+
+        match &self.profiles.get(&func.name)?.state {
+            TierState::Native(native) => native.invoke(args),
+            _ => None,
+        }
+    }
+
+    pub fn record_back_edges(&mut self, func: &Function, back_edges: u64) {
+        if let Some(profile) = self.profiles.get_mut(&func.name) {
+            if Rc::ptr_eq(&profile.locals, &func.locals) {
+                profile.back_edges += back_edges;
+            }
+        }
+    }
+
+    // Whether calls to the function run its native code
+    pub fn is_native(&self, name: &str) -> bool {
+        matches!(self.profiles.get(name), Some(Profile { state: TierState::Native(_), .. }))
+    }
+
+    fn promote(&mut self, name: &str) -> TierState {
+        match self.compile(name) {
+            Some(native) => TierState::Native(native),
+            None => TierState::Rejected,
+        }
+    }
+
+    // Compiles the function together with every function it calls
+    fn compile(&mut self, name: &str) -> Option<NativeFunction> {
+        let mut checked = HashSet::new();
+        if !self.check_function(name, &mut checked) {
+            return None;
+        }
+
+        let items = checked.iter().map(|name| Item::Function(self.sources[name].clone())).collect();
+        let analyzed_program = SemanticAnalyzer::new().analyze(&Program { items }).ok()?;
+
+        let mut ir_generator = jit::new_generator(&self.opt_level).ok()?;
+        ir_generator.generate(&analyzed_program).ok()?;
+        let entry_id = ir_generator.generate_entry_trampoline(name).ok()?;
+        let mut module = ir_generator.finalize();
+        module.finalize_definitions().ok()?;
+
+        let source = &self.sources[name];
+        // The trampoline is generated with the host's C calling convention
+        let entry: extern "C" fn(*const u64, *mut u64) =
+            unsafe { std::mem::transmute(module.get_finalized_function(entry_id)) };
+        let native = NativeFunction {
+            entry,
+            params: source.params.iter().map(|param| param.param_type.clone()).collect(),
+            return_type: source.return_type.clone().filter(|return_type| *return_type != ChifType::Nil),
+        };
+        self.modules.push(module);
+        Some(native)
+    }
+
+    // Whether the function and its callees can be compiled; `checked`
+    // collects all of them. Recursive calls count as compilable.
+    fn check_function(&self, name: &str, checked: &mut HashSet<String>) -> bool {
+        if !checked.insert(name.to_string()) {
+            return true;
+        }
+        let func = match self.sources.get(name) {
+            Some(func) if !func.is_main => func,
+            _ => return false,
+        };
+
+        let scalar_params = func.params.iter().all(|param| !param.is_reference && is_scalar(&param.param_type));
+        let return_type = match &func.return_type {
+            None | Some(ChifType::Nil) => None,
+            Some(return_type) if is_scalar(return_type) => Some(return_type.clone()),
+            Some(_) => return false,
+        };
+        if !scalar_params {
+            return false;
+        }
+
+        let mut checker = Checker {
+            tier: self,
+            return_type,
+            locals: func.params.iter().map(|param| (param.name.clone(), param.param_type.clone())).collect(),
+            callees: Vec::new(),
+        };
+        if !checker.block(&func.body, false) {
+            return false;
+        }
+
+        let callees = std::mem::take(&mut checker.callees);
+        callees.iter().all(|callee| self.check_function(callee, checked))
+    }
+}
+
+impl Drop for Tier {
+    fn drop(&mut self) {
+        for module in self.modules.drain(..) {
+            unsafe { module.free_memory() };
+        }
+    }
+}
+
+impl NativeFunction {
+    // Arguments of another type than declared (the interpreter doesn't
+    // check them) are left to the interpreter
+    fn invoke(&self, args: &[ChifValue]) -> Option<ChifValue> {
+        let mut raw_args = Vec::with_capacity(args.len());
+        for (arg, param_type) in args.iter().zip(&self.params) {
+            raw_args.push(match (arg, param_type) {
+                (ChifValue::Int(value), ChifType::Int) => *value as u64,
+                (ChifValue::Float(value), ChifType::Float) => value.to_bits(),
+                (ChifValue::Bool(value), ChifType::Bool) => *value as u64,
+                _ => return None,
+            });
+        }
+
+        let mut raw_result = 0u64;
+        (self.entry)(raw_args.as_ptr(), &mut raw_result);
+
+        Some(match self.return_type {
+            Some(ChifType::Int) => ChifValue::Int(raw_result as i64),
+            Some(ChifType::Float) => ChifValue::Float(f64::from_bits(raw_result)),
+            Some(ChifType::Bool) => ChifValue::Bool(raw_result != 0),
+            _ => ChifValue::Nil,
+        })
+    }
+}
+
+fn is_scalar(chif_type: &ChifType) -> bool {
+    matches!(chif_type, ChifType::Int | ChifType::Float | ChifType::Bool)
+}
+
+// Type check of one function body against what the code generator lowers
+// the same way the interpreter evaluates it
+struct Checker<'a> {
+    tier: &'a Tier,
+    return_type: Option<ChifType>,
+    locals: HashMap<String, ChifType>,
+    callees: Vec<String>,
+}
+
+impl Checker<'_> {
+    // A `return` has to end its block, and not directly a loop body:
+    // the code generator appends the block's jump after it
+    fn block(&mut self, block: &Block, loop_body: bool) -> bool {
+        let count = block.statements.len();
+        block.statements.iter().enumerate().all(|(i, statement)| match statement {
+            Statement::Return(_) if i + 1 < count || loop_body => false,
+            _ => self.statement(statement),
+        })
+    }
+
+    fn statement(&mut self, statement: &Statement) -> bool {
+        match statement {
+            // The code generator gives every declaration a new variable, so
+            // a name is declared once per function
+            Statement::VarDecl(var_decl) => {
+                let value_type = var_decl.value.as_ref().and_then(|value| self.expression(value));
+                if !is_scalar(&var_decl.var_type) || value_type.as_ref() != Some(&var_decl.var_type)
+                    || self.locals.contains_key(&var_decl.name) {
+                    return false;
+                }
+                self.locals.insert(var_decl.name.clone(), var_decl.var_type.clone());
+                true
+            }
+            Statement::Assignment(assignment) => match &assignment.target {
+                Expression::Identifier(name) => {
+                    self.locals.get(name).cloned().is_some_and(|var_type| self.expression(&assignment.value) == Some(var_type))
+                }
+                _ => false,
+            },
+            Statement::Expression(Expression::Call(call)) => self.call(call).is_some(),
+            Statement::If(if_stmt) => {
+                self.condition(&if_stmt.condition)
+                    && self.block(&if_stmt.then_block, false)
+                    && if_stmt.else_block.as_ref().map_or(true, |else_block| self.block(else_block, false))
+            }
+            Statement::While(while_stmt) => self.condition(&while_stmt.condition) && self.block(&while_stmt.body, true),
+            Statement::For(for_stmt) => {
+                for_stmt.init.as_ref().map_or(true, |init| self.statement(init))
+                    && for_stmt.condition.as_ref().map_or(true, |condition| self.condition(condition))
+                    && for_stmt.update.as_ref().map_or(true, |update| self.statement(update))
+                    && self.block(&for_stmt.body, true)
+            }
+            Statement::Return(value) => match (value, &self.return_type) {
+                (None, None) => true,
+                (Some(value), Some(return_type)) => {
+                    let return_type = return_type.clone();
+                    self.expression(value) == Some(return_type)
+                }
+                _ => false,
+            },
+            // Break and continue aren't lowered by the code generator yet
+            _ => false,
+        }
+    }
+
+    fn condition(&mut self, condition: &Expression) -> bool {
+        self.expression(condition) == Some(ChifType::Bool)
+    }
+
+    // Type of a value-producing expression, None when it can't be compiled
+    fn expression(&mut self, expr: &Expression) -> Option<ChifType> {
+        match expr {
+            Expression::Literal(value @ (ChifValue::Int(_) | ChifValue::Float(_) | ChifValue::Bool(_))) => Some(value.get_type()),
+            Expression::Identifier(name) => self.locals.get(name).cloned(),
+            Expression::Binary(binary_op) => {
+                let left = self.expression(&binary_op.left)?;
+                let right = self.expression(&binary_op.right)?;
+                if left != right {
+                    return None;
+                }
+                match (&binary_op.operator, &left) {
+                    (BinaryOperator::Add | BinaryOperator::Subtract | BinaryOperator::Multiply, ChifType::Int | ChifType::Float) => Some(left),
+                    (BinaryOperator::Divide, ChifType::Float) => Some(left),
+                    // Native division by zero traps instead of raising a runtime error
+                    (BinaryOperator::Divide, ChifType::Int) => match &*binary_op.right {
+                        Expression::Literal(ChifValue::Int(divisor)) if *divisor != 0 && *divisor != -1 => Some(left),
+                        _ => None,
+                    },
+                    (BinaryOperator::Less | BinaryOperator::Greater | BinaryOperator::LessEqual | BinaryOperator::GreaterEqual,
+                        ChifType::Int | ChifType::Float) => Some(ChifType::Bool),
+                    // Float equality in the interpreter is within f64::EPSILON
+                    (BinaryOperator::Equal | BinaryOperator::NotEqual, ChifType::Int | ChifType::Bool) => Some(ChifType::Bool),
+                    _ => None,
+                }
+            }
+            Expression::Unary(unary_op) => {
+                let operand = self.expression(&unary_op.operand)?;
+                match (&unary_op.operator, &operand) {
+                    (UnaryOperator::Minus, ChifType::Int | ChifType::Float) | (UnaryOperator::Not, ChifType::Bool) => Some(operand),
+                    _ => None,
+                }
+            }
+            Expression::Call(call) => self.call(call).flatten(),
+            _ => None,
+        }
+    }
+
+    // Some(return type) of a call to a compilable user function
+    fn call(&mut self, call: &FunctionCall) -> Option<Option<ChifType>> {
+        if BUILTIN_NAMES.contains(&call.name.as_str()) || call.name.starts_with("http_") {
+            return None;
+        }
+        let callee = self.tier.sources.get(&call.name)?;
+        if callee.params.len() != call.args.len() {
+            return None;
+        }
+        for (param, arg) in callee.params.iter().zip(&call.args) {
+            if self.expression(arg).as_ref() != Some(&param.param_type) {
+                return None;
+            }
+        }
+        self.callees.push(call.name.clone());
+        Some(callee.return_type.clone().filter(|return_type| *return_type != ChifType::Nil))
+    }
+}
@@ -0,0 +1,141 @@
+#[cfg(test)]
+mod tests {
+    use crate::ast::Program;
+    use crate::compiler::OptLevel;
+    use crate::interpreter::Interpreter;
+    use crate::lexer::Lexer;
+    use crate::parser::Parser;
+    use crate::tier::{TIER_CALL_THRESHOLD, TIER_LOOP_THRESHOLD};
+
+    fn parse(source: &str) -> Program {
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        Parser::new(tokens).parse().expect("source should parse")
+    }
+
+    fn interpreted(program: &Program) -> String {
+        let mut interpreter = Interpreter::new();
+        interpreter.capture_output();
+        interpreter.execute(program).expect("interpreter should run the program");
+        interpreter.captured_output().to_string()
+    }
+
+    // Output of a `--tiered` run, with the interpreter to ask which
+    // functions were promoted
+    fn tiered(program: &Program) -> (String, Interpreter) {
+        let mut interpreter = Interpreter::new();
+        interpreter.enable_tiering(OptLevel::Speed);
+        interpreter.capture_output();
+        interpreter.execute(program).expect("tiered run should succeed");
+        let output = interpreter.captured_output().to_string();
+        (output, interpreter)
+    }
+
+    fn assert_native(interpreter: &Interpreter, name: &str, native: bool) {
+        let tier = interpreter.tier().expect("tiering should be enabled");
+        assert_eq!(tier.is_native(name), native, "{} should {}run natively", name, if native { "" } else { "not " });
+    }
+
+    #[test]
+    fn test_hot_functions_match_the_interpreter() {
+        // scale and positive cross the call threshold in the main loop, fib
+        // crosses it inside its own recursion, sumTo crosses the loop
+        // threshold after two calls
+        let source = format!(
+            r#"
+            fn scale(x: float, flip: bool) float {{
+                if (flip) {{
+                    ret 0.0 - x * 1.5;
+                }}
+                ret x * 1.5 + 0.25;
+            }}
+
+            fn positive(x: float) bool {{
+                ret x > 0.0;
+            }}
+
+            fn fib(n: int) int {{
+                if (n < 2) {{
+                    ret n;
+                }}
+                ret fib(n - 1) + fib(n - 2);
+            }}
+
+            fn sumTo(n: int) int {{
+                var s: int = 0;
+                var i: int = 0;
+                while (i < n) {{
+                    s = s + i * 3 - 1;
+                    i = i + 1;
+                }}
+                ret s;
+            }}
+
+            chif main() {{
+                var total: float = 0.0;
+                var x: float = -40.0;
+                var flip: bool = false;
+                var positives: int = 0;
+                for (i = 0; i < {calls}; i = i + 1) {{
+                    total = total + scale(x, flip);
+                    if (positive(total)) {{
+                        positives = positives + 1;
+                    }}
+                    x = x + 0.37;
+                    flip = !flip;
+                }}
+                var f: int = fib(18);
+                var sums: int = 0;
+                for (k = 0; k < 5; k = k + 1) {{
+                    sums = sums + sumTo({iterations} + k);
+                }}
+                con.out("{{total}} {{positives}} {{f}} {{sums}}");
+            }}
+            "#,
+            calls = TIER_CALL_THRESHOLD * 3,
+            iterations = TIER_LOOP_THRESHOLD / 2 + 1,
+        );
+        let program = parse(&source);
+        let (output, interpreter) = tiered(&program);
+        assert_eq!(output, interpreted(&program));
+        for name in ["scale", "positive", "fib", "sumTo"] {
+            assert_native(&interpreter, name, true);
+        }
+    }
+
+    #[test]
+    fn test_rejected_functions_stay_interpreted() {
+        // Native division by a variable would trap on zero where the
+        // interpreter reports an error, so ratio and its caller stay
+        // interpreted; halve divides by a literal and is compiled
+        let source = format!(
+            r#"
+            fn ratio(a: int, b: int) int {{
+                ret a / b;
+            }}
+
+            fn mean(a: int, b: int) int {{
+                ret ratio(a + b, 2);
+            }}
+
+            fn halve(a: int) int {{
+                ret a / 2;
+            }}
+
+            chif main() {{
+                var total: int = 0;
+                for (i = 1; i < {calls}; i = i + 1) {{
+                    total = total + ratio(i * 7, i) + mean(i, 3) + halve(i);
+                }}
+                con.out("{{total}}");
+            }}
+            "#,
+            calls = TIER_CALL_THRESHOLD * 2,
+        );
+        let program = parse(&source);
+        let (output, interpreter) = tiered(&program);
+        assert_eq!(output, interpreted(&program));
+        assert_native(&interpreter, "ratio", false);
+        assert_native(&interpreter, "mean", false);
+        assert_native(&interpreter, "halve", true);
+    }
+}
@@ -1,5 +1,6 @@
 use std::collections::HashMap;
 use std::fmt;
+use std::rc::Rc;
 
 #[derive(Debug, Clone, PartialEq)]
 pub enum ChifType {
@@ -15,21 +16,42 @@ pub enum ChifType {
     Pointer(Box<ChifType>),
 }
 
+// Strings and containers are reference-counted, so cloning a value is O(1).
+// Mutation goes through Rc::make_mut, which copies only when shared.
 #[derive(Debug, Clone)]
 pub enum ChifValue {
     Int(i64),
     Float(f64),
-    Str(String),
+    Str(Rc<str>),
     Bool(bool),
     Nil,
-    Array(Vec<ChifValue>),
-    List(Vec<ChifValue>),
-    Map(HashMap<String, ChifValue>),
-    Struct(String, HashMap<String, ChifValue>),
+    Array(Rc<Vec<ChifValue>>),
+    List(Rc<Vec<ChifValue>>),
+    Map(Rc<HashMap<String, ChifValue>>),
+    Struct(Rc<StructLayout>, Rc<Vec<ChifValue>>), // field values in layout order
     Pointer(Box<ChifValue>),
     Reference(String), // Reference to a variable name
 }
 
+// Name and field order of an interpreted struct type, interned once and
+// shared by every instance, which stores only its field values by position
+#[derive(Debug, PartialEq)]
+pub struct StructLayout {
+    pub name: String,
+    pub fields: Vec<String>,
+}
+
+impl StructLayout {
+    pub fn new(name: impl Into<String>, fields: Vec<String>) -> Rc<Self> {
+        Rc::new(Self { name: name.into(), fields })
+    }
+    
+    // Structs have a handful of fields, so a scan is cheaper than hashing
+    pub fn field_index(&self, field: &str) -> Option<usize> {
+        self.fields.iter().position(|name| name == field)
+    }
+}
+
 impl fmt::Display for ChifType {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
         match self {
@@ -91,9 +113,9 @@ impl fmt::Display for ChifValue {
                 }
                 write!(f, "}}")
             }
-            ChifValue::Struct(name, fields) => {
-                write!(f, "{} {{ ", name)?;
-                for (i, (key, val)) in fields.iter().enumerate() {
+            ChifValue::Struct(layout, fields) => {
+                write!(f, "{} {{ ", layout.name)?;
+                for (i, (key, val)) in layout.fields.iter().zip(fields.iter()).enumerate() {
                     if i > 0 { write!(f, ", ")?; }
                     write!(f, "{}: {}", key, val)?;
                 }
@@ -134,7 +156,7 @@ impl ChifValue {
                     ChifType::Map(Box::new(ChifType::Str), Box::new(ChifType::Nil))
                 }
             }
-            ChifValue::Struct(name, _) => ChifType::Struct(name.clone()),
+            ChifValue::Struct(layout, _) => ChifType::Struct(layout.name.clone()),
             ChifValue::Pointer(val) => ChifType::Pointer(Box::new(val.get_type())),
             ChifValue::Reference(_) => ChifType::Pointer(Box::new(ChifType::Nil)),
         }
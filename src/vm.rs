@@ -0,0 +1,194 @@
+use crate::ast::Program;
+use crate::bytecode::{self, BytecodeProgram, Chunk, Op, ProgramInfo, Reg};
+use crate::error::{ChifError, Result};
+use crate::interpreter::{ControlFlow, Frame, Interpreter};
+use crate::types::ChifValue;
+use std::borrow::Cow;
+use std::collections::HashSet;
+use std::rc::Rc;
+
+// Register VM behind `rono run --engine=vm`. It runs on the interpreter's
+// frames and shares its value semantics (operators, formatting, builtins),
+// so both engines print the same output; the interpreter stays the
+// reference engine.
+pub struct Vm {
+    interpreter: Interpreter,
+    program: BytecodeProgram,
+}
+
+impl Vm {
+    pub fn new() -> Self {
+        Self {
+            interpreter: Interpreter::new(),
+            program: BytecodeProgram { chunks: Vec::new(), function_ids: Default::default() },
+        }
+    }
+
+    pub fn execute(&mut self, program: &Program) -> Result<()> {
+        self.interpreter.load(program)?;
+        let main_func = self.interpreter.main_function()?;
+
+        let modules: HashSet<String> = self.interpreter.modules.keys().cloned().collect();
+        let struct_names: HashSet<String> = self.interpreter.struct_methods.keys().cloned().collect();
+        self.program = bytecode::compile_program(&ProgramInfo {
+            functions: &self.interpreter.functions,
+            modules: &modules,
+            struct_names: &struct_names,
+        });
+
+        let main_id = self.program.function_ids[&main_func.name];
+        let result = self.call(main_id, Vec::new());
+        // Flush before the caller reports a possible error on stderr
+        self.interpreter.flush_output();
+        result?;
+
+        Ok(())
+    }
+
+    #[cfg(test)]
+    pub(crate) fn interpreter_mut(&mut self) -> &mut Interpreter {
+        &mut self.interpreter
+    }
+
+    fn call(&mut self, func: u32, args: Vec<ChifValue>) -> Result<ChifValue> {
+        let chunk = Rc::clone(&self.program.chunks[func as usize]);
+        if args.len() != chunk.param_slots.len() {
+            return Err(ChifError::RuntimeError {
+                message: format!(
+                    "Function '{}' expects {} arguments, got {}",
+                    chunk.name,
+                    chunk.param_slots.len(),
+                    args.len()
+                ),
+            });
+        }
+
+        let frame = self.interpreter.enter_frame(chunk.locals.clone(), chunk.registers);
+        for (&slot, arg) in chunk.param_slots.iter().zip(args) {
+            frame.slots[slot as usize] = Some(arg);
+        }
+
+        let result = self.run(&chunk);
+        self.interpreter.leave_frame();
+        result
+    }
+
+    fn frame(&self) -> &Frame {
+        self.interpreter.locals.last().expect("VM frame")
+    }
+
+    // A register's value. Locals not assigned in this call yet are looked
+    // up by name further out, like the interpreter does.
+    fn read(&self, reg: Reg) -> Result<Cow<'_, ChifValue>> {
+        let frame = self.frame();
+        match &frame.slots[reg as usize] {
+            Some(value) => Ok(Cow::Borrowed(value)),
+            None => match frame.names.get(reg as usize) {
+                Some(name) => self.interpreter.get_variable(name).map(Cow::Owned),
+                None => Ok(Cow::Owned(ChifValue::Nil)),
+            },
+        }
+    }
+
+    fn write(&mut self, reg: Reg, value: ChifValue) {
+        self.interpreter.locals.last_mut().expect("VM frame").slots[reg as usize] = Some(value);
+    }
+
+    fn run(&mut self, chunk: &Chunk) -> Result<ChifValue> {
+        let mut pc = 0;
+        loop {
+            let op = &chunk.code[pc];
+            pc += 1;
+            match op {
+                Op::Const { dst, index } => {
+                    self.write(*dst, chunk.constants[*index as usize].clone());
+                }
+                Op::Move { dst, src } => {
+                    let value = self.read(*src)?.into_owned();
+                    self.write(*dst, value);
+                }
+                Op::ToList { reg } => {
+                    let value = self.read(*reg)?.into_owned();
+                    if let ChifValue::Array(arr) = value {
+                        self.write(*reg, ChifValue::List(arr));
+                    }
+                }
+                Op::Binary { op, dst, lhs, rhs } => {
+                    let value = {
+                        let left = self.read(*lhs)?;
+                        let right = self.read(*rhs)?;
+                        self.interpreter.apply_binary_op(op, &left, &right)?
+                    };
+                    self.write(*dst, value);
+                }
+                Op::Unary { op, dst, src } => {
+                    let value = self.interpreter.apply_unary_op(op, &*self.read(*src)?)?;
+                    self.write(*dst, value);
+                }
+                Op::Index { dst, object, index } => {
+                    let value = self.interpreter.get_index(&*self.read(*object)?, &*self.read(*index)?)?;
+                    self.write(*dst, value);
+                }
+                Op::Field { dst, object, field } => {
+                    let value = self.interpreter.get_field(&*self.read(*object)?, &chunk.names[*field as usize])?;
+                    self.write(*dst, value);
+                }
+                Op::Len { dst, object, fallback } => {
+                    let len = match &*self.read(*object)? {
+                        ChifValue::Str(s) => Some(s.len()),
+                        ChifValue::Array(items) | ChifValue::List(items) => Some(items.len()),
+                        _ => None,
+                    };
+                    let value = match len {
+                        Some(len) => ChifValue::Int(len as i64),
+                        None => self.interpreter.evaluate_expression(&chunk.exprs[*fallback as usize])?,
+                    };
+                    self.write(*dst, value);
+                }
+                Op::Call { dst, func, args, argc } => {
+                    let mut values = Vec::with_capacity(*argc as usize);
+                    for reg in *args..*args + *argc {
+                        let slot = &mut self.interpreter.locals.last_mut().expect("VM frame").slots[reg as usize];
+                        values.push(slot.take().unwrap_or(ChifValue::Nil));
+                    }
+                    let value = self.call(*func, values)?;
+                    self.write(*dst, value);
+                }
+                Op::Print { src, interpolate } => {
+                    let (text, is_str) = match &*self.read(*src)? {
+                        ChifValue::Str(s) => (s.to_string(), true),
+                        other => (other.to_string(), false),
+                    };
+                    // Strings built at run time are interpolated, as in the interpreter
+                    let text = if is_str && *interpolate { self.interpreter.interpolate_string(&text)? } else { text };
+                    self.interpreter.write_line(&text);
+                }
+                Op::Jump { target } => pc = *target as usize,
+                Op::JumpIfFalse { cond, target } => {
+                    if !self.interpreter.is_truthy(&*self.read(*cond)?) {
+                        pc = *target as usize;
+                    }
+                }
+                Op::JumpIfNotEqual { lhs, rhs, target } => {
+                    if !self.interpreter.values_equal(&*self.read(*lhs)?, &*self.read(*rhs)?) {
+                        pc = *target as usize;
+                    }
+                }
+                Op::Eval { dst, expr } => {
+                    let value = self.interpreter.evaluate_expression(&chunk.exprs[*expr as usize])?;
+                    self.write(*dst, value);
+                }
+                // Exec'd statements contain no loops or returns, so anything
+                // but Normal is a break or continue outside a loop
+                Op::Exec { stmt } => {
+                    let flow = self.interpreter.execute_statement(&chunk.stmts[*stmt as usize])?;
+                    if !matches!(flow, ControlFlow::Normal) {
+                        Interpreter::call_result(flow)?;
+                    }
+                }
+                Op::Return { src } => return Ok(self.read(*src)?.into_owned()),
+                Op::ReturnNil => return Ok(ChifValue::Nil),
+            }
+        }
+    }
+}
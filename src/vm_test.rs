@@ -0,0 +1,157 @@
+#[cfg(test)]
+mod tests {
+    use crate::ast::Program;
+    use crate::interpreter::Interpreter;
+    use crate::lexer::Lexer;
+    use crate::parser::Parser;
+    use crate::vm::Vm;
+
+    use std::io::{Read, Write};
+    use std::net::{TcpListener, TcpStream};
+    use std::path::Path;
+
+    // The programs benches/pipeline.rs measures; http.rono needs MOCK_URL
+    // replaced with a server's address
+    const CORPUS: &[&str] = &["recursion", "lists", "structs", "interpolation", "http"];
+
+    const MOCK_BODY: &str = "{\"status\":\"ok\",\"items\":[1,2,3,4,5,6,7,8,9,10]}";
+
+    fn parse(source: &str) -> Program {
+        let tokens = Lexer::new(source).tokenize().expect("source should lex");
+        Parser::new(tokens).parse().expect("source should parse")
+    }
+
+    fn interpreted(program: &Program) -> String {
+        let mut interpreter = Interpreter::new();
+        interpreter.capture_output();
+        interpreter.execute(program).expect("interpreter should run the program");
+        interpreter.captured_output().to_string()
+    }
+
+    fn vm(program: &Program) -> String {
+        let mut vm = Vm::new();
+        vm.interpreter_mut().capture_output();
+        vm.execute(program).expect("VM should run the program");
+        vm.interpreter_mut().captured_output().to_string()
+    }
+
+    // Both engines must print the same, and print something
+    fn assert_same_output(name: &str, source: &str) {
+        let program = parse(source);
+        let expected = interpreted(&program);
+        assert!(!expected.is_empty(), "{} should print something", name);
+        assert_eq!(vm(&program), expected, "VM and interpreter disagree on {}", name);
+    }
+
+    // HTTP/1.1 server answering every request with MOCK_BODY, as in the
+    // benches. Returns its URL.
+    fn start_mock_server() -> String {
+        let listener = TcpListener::bind("127.0.0.1:0").expect("mock server should bind");
+        let url = format!("http://{}/", listener.local_addr().unwrap());
+        std::thread::spawn(move || {
+            for stream in listener.incoming().flatten() {
+                std::thread::spawn(move || serve(stream));
+            }
+        });
+        url
+    }
+
+    fn serve(mut stream: TcpStream) {
+        let response = format!(
+            "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: {}\r\n\r\n{}",
+            MOCK_BODY.len(),
+            MOCK_BODY
+        );
+        let mut request = Vec::new();
+        let mut buffer = [0u8; 4096];
+        loop {
+            while let Some(end) = request.windows(4).position(|window| window == b"\r\n\r\n") {
+                request.drain(..end + 4);
+                if stream.write_all(response.as_bytes()).is_err() {
+                    return;
+                }
+            }
+            match stream.read(&mut buffer) {
+                Ok(0) | Err(_) => return,
+                Ok(read) => request.extend_from_slice(&buffer[..read]),
+            }
+        }
+    }
+
+    #[test]
+    fn test_vm_matches_interpreter_on_corpus() {
+        let mock_url = start_mock_server();
+        for name in CORPUS {
+            let path = Path::new(env!("CARGO_MANIFEST_DIR")).join("benches/corpus").join(format!("{}.rono", name));
+            let source = std::fs::read_to_string(&path).unwrap_or_else(|e| panic!("{}: {}", path.display(), e));
+            assert_same_output(name, &source.replace("MOCK_URL", &mock_url));
+        }
+    }
+
+    #[test]
+    fn test_vm_matches_interpreter_on_fallbacks() {
+        // Builtins, struct methods, maps and calls passing &x run through
+        // Eval, field assignments through Exec, against the VM's frame
+        let source = r#"
+            struct Counter {
+                count: int,
+                label: str,
+            }
+
+            fn_for Counter {
+                fn describe(self) str {
+                    ret "{self.label}={self.count}";
+                }
+            }
+
+            fn set(ref x: int) int {
+                x = 42;
+                ret 1;
+            }
+
+            fn grade(score: int) str {
+                switch score / 10:
+                case 10 {
+                    ret "A";
+                }
+                case 9 {
+                    ret "A";
+                }
+                case 8 {
+                    ret "B";
+                }
+                default {
+                    ret "C";
+                }
+            }
+
+            chif main() {
+                var counter: Counter = Counter { count = 0, label = "hits" };
+                var ages: map[str:int] = {"ann": 30, "bob": 25};
+                list names: str[] = [];
+                for (i = 0; i < 10; i = i + 1) {
+                    if (i % 3 == 0) {
+                        continue;
+                    }
+                    if (i > 7) {
+                        break;
+                    }
+                    counter.count = counter.count + i;
+                    names.add("n" + toStr(i));
+                }
+                ages["bob"] = ages["bob"] + toInt("5");
+                var ratio: float = toFloat(counter.count) / 4.0;
+                var last: str = names[names.len() - 1];
+                var bob: int = ages["bob"];
+                con.out(counter.describe());
+                con.out("{names.len()} names, last {last}");
+                con.out("bob is {bob}, ratio {ratio}");
+                con.out("{grade(95)} {grade(81)} {grade(42)}");
+                var n: int = 5;
+                var flag: int = set(&n);
+                con.out("{n} {flag}");
+            }
+        "#;
+        assert_same_output("fallbacks", source);
+    }
+}